@@ -3,6 +3,7 @@
 #include <cassert>
 
 #include <cannon/log/registry.hpp>
+#include <cannon/utils/profiler.hpp>
 
 using namespace cannon::log;
 using namespace cannon::logic;
@@ -217,6 +218,7 @@ int DPLLState::compute_lbd(std::shared_ptr<FormulaState> fs, const Clause& c) {
 }
 
 int DPLLState::learn_clause(std::shared_ptr<FormulaState> fs, unsigned int c, unsigned int prop) {
+  PROFILE_HOT_SCOPE("DPLL clause learning");
   // We have a conflict, so we can terminate
 
   assert(formula_.clauses_[c].eval(fs->a) == PropAssignment::False);
@@ -418,6 +420,7 @@ std::pair<std::set<std::pair<unsigned int, unsigned int>>,
 }
 
 bool DPLLState::do_splitting_rule(const std::shared_ptr<FormulaState> fs) {
+  PROFILE_HOT_SCOPE("DPLL splitting");
   // Create vector of all propositions
   std::vector<unsigned int> all_props = fs->untried_props;
   if (all_props.size() == 0) {
@@ -510,6 +513,7 @@ void DPLLState::do_unit_preference(std::shared_ptr<FormulaState> fs, unsigned in
 
 bool DPLLState::update_watch_and_propagate(std::shared_ptr<FormulaState> fs,
     std::set<std::pair<unsigned int, unsigned int>> unit_clauses) {
+  PROFILE_HOT_SCOPE("DPLL unit propagation");
   bool found_conflict = false;
 
   std::stack<std::pair<unsigned int, unsigned int>> working;
@@ -575,6 +579,7 @@ void DPLLState::do_backjump() {
 }
 
 std::pair<DPLLResult, Assignment> DPLLState::iterate() {
+  PROFILE_HOT_SCOPE("DPLL iteration");
   Assignment empty;
 
   if (frontier_.size() == 0) {
@@ -687,6 +692,7 @@ std::pair<DPLLResult, Assignment> DPLLState::iterate() {
 // Free Functions
 std::tuple<DPLLResult, Assignment, int> cannon::logic::dpll(CNFFormula f,
     PropFunc ph_func, AssignFunc ah_func, const std::chrono::seconds cutoff) {
+  PROFILE_SCOPE("DPLL solve");
 
   if (f.get_num_props() == 0) {
     std::valarray<PropAssignment> empty = {};
@@ -1,27 +1,76 @@
 #include <cannon/math/perlin.hpp>
 
+#include <algorithm>
+#include <stdexcept>
+
 using namespace cannon::math;
 
+Perlin::Perlin() : Perlin(thread_rng()) {}
+
+Perlin::Perlin(Rng& rng) {
+  for (int i = 0; i < point_count_; i++) {
+    Vector3d v = random_unit_vec(rng);
+    ranvec_x_[i] = v.x();
+    ranvec_y_[i] = v.y();
+    ranvec_z_[i] = v.z();
+  }
+
+  int p[point_count_];
+  for (auto perm : {&perm_x_, &perm_y_, &perm_z_}) {
+    for (int i = 0; i < point_count_; i++)
+      p[i] = i;
+
+    permute(rng, p, point_count_);
+    set_perm_(*perm, p);
+  }
+}
+
 double Perlin::noise(const Vector3d& p) const {
-  auto u = p.x() - std::floor(p.x());
-  auto v = p.y() - std::floor(p.y());
-  auto w = p.z() - std::floor(p.z());
+  double fx = std::floor(p.x());
+  double fy = std::floor(p.y());
+  double fz = std::floor(p.z());
+
+  auto u = p.x() - fx;
+  auto v = p.y() - fy;
+  auto w = p.z() - fz;
 
-  auto i = static_cast<int>(std::floor(p.x()));
-  auto j = static_cast<int>(std::floor(p.y()));
-  auto k = static_cast<int>(std::floor(p.z()));
+  auto uu = hermitian_smooth(u);
+  auto vv = hermitian_smooth(v);
+  auto ww = hermitian_smooth(w);
+
+  auto i = static_cast<int>(fx);
+  auto j = static_cast<int>(fy);
+  auto k = static_cast<int>(fz);
+
+  // Each axis contributes one of two permutation entries to the hash of a
+  // corner, so only six table lookups are needed for all eight corners
+  int hash_x[2] = {perm_x_[i & 255], perm_x_[(i + 1) & 255]};
+  int hash_y[2] = {perm_y_[j & 255], perm_y_[(j + 1) & 255]};
+  int hash_z[2] = {perm_z_[k & 255], perm_z_[(k + 1) & 255]};
 
-  Vector3d c[2][2][2];
+  double accum = 0.0;
   for (int di = 0; di < 2; di++) {
+    double weight_i = di ? uu : 1 - uu;
     for (int dj = 0; dj < 2; dj++) {
+      double weight_ij = weight_i * (dj ? vv : 1 - vv);
+      int hash_ij = hash_x[di] ^ hash_y[dj];
       for (int dk = 0; dk < 2; dk++) {
-        c[di][dj][dk] = ranvec_[perm_x_[(i+di) & 255] ^ perm_y_[(j+dj) & 255]
-          ^ perm_z_[(k+dk) & 255]];
+        int h = hash_ij ^ hash_z[dk];
+        double dot = ranvec_x_[h] * (u - di) + ranvec_y_[h] * (v - dj) + ranvec_z_[h] * (w - dk);
+        accum += weight_ij * (dk ? ww : 1 - ww) * dot;
       }
     }
   }
 
-  return trilinear_interp(c, u, v, w);
+  return accum;
+}
+
+VectorXd Perlin::noise(const Matrix3Xd& points) const {
+  VectorXd values(points.cols());
+  for (Index c = 0; c < points.cols(); c++)
+    values[c] = noise(Vector3d(points.col(c)));
+
+  return values;
 }
 
 double Perlin::turbulence(const Vector3d& p, int depth) const {
@@ -38,21 +87,80 @@ double Perlin::turbulence(const Vector3d& p, int depth) const {
   return std::fabs(accum);
 }
 
-// Free Functions
-int* cannon::math::perlin_generate_perm() {
-  auto p = new int[Perlin::point_count_];
+VectorXd Perlin::turbulence(const Matrix3Xd& points, int depth) const {
+  VectorXd values(points.cols());
+  for (Index c = 0; c < points.cols(); c++)
+    values[c] = turbulence(Vector3d(points.col(c)), depth);
+
+  return values;
+}
+
+void Perlin::set_perm_(std::array<uint8_t, point_count_>& perm, const int* p) {
+  for (int i = 0; i < point_count_; i++)
+    perm[i] = static_cast<uint8_t>(p[i]);
+}
+
+NoiseVolume::NoiseVolume(const Perlin& perlin, const Vector3d& min, const
+    Vector3d& max, const Vector3i& resolution, int depth) : min_(min),
+  max_(max), resolution_(resolution) {
+  if ((resolution_.array() < 2).any())
+    throw std::runtime_error("Noise volume resolution must be at least two along each axis");
+
+  if ((max_.array() <= min_.array()).any())
+    throw std::runtime_error("Noise volume must have positive extent");
+
+  values_.resize(static_cast<size_t>(resolution_.x()) * resolution_.y() * resolution_.z());
+
+  // Bake one row along x at a time through the batch interface
+  Vector3d spacing = (max_ - min_).cwiseQuotient((resolution_ - Vector3i::Ones()).cast<double>());
+  Matrix3Xd row(3, resolution_.x());
+  for (int k = 0; k < resolution_.z(); k++) {
+    for (int j = 0; j < resolution_.y(); j++) {
+      for (int i = 0; i < resolution_.x(); i++)
+        row.col(i) = min_ + Vector3d(i, j, k).cwiseProduct(spacing);
+
+      VectorXd turbulence = perlin.turbulence(row, depth);
+      size_t offset = (static_cast<size_t>(k) * resolution_.y() + j) * resolution_.x();
+      for (int i = 0; i < resolution_.x(); i++)
+        values_[offset + i] = static_cast<float>(turbulence[i]);
+    }
+  }
+}
+
+bool NoiseVolume::contains(const Vector3d& p) const {
+  return (p.array() >= min_.array()).all() && (p.array() <= max_.array()).all();
+}
 
-  for (int i = 0; i < Perlin::point_count_; i++) {
-    p[i] = i;
+double NoiseVolume::lookup(const Vector3d& p) const {
+  // Continuous grid coordinates, clamped to the grid
+  Vector3d g = (p - min_).cwiseQuotient(max_ - min_).cwiseProduct(
+      (resolution_ - Vector3i::Ones()).cast<double>());
+
+  int idx[3];
+  double frac[3];
+  for (int a = 0; a < 3; a++) {
+    double c = std::min(std::max(g[a], 0.0), static_cast<double>(resolution_[a] - 1));
+    idx[a] = std::min(static_cast<int>(c), resolution_[a] - 2);
+    frac[a] = c - idx[a];
   }
 
-  permute(p, Perlin::point_count_);
-  return p;
+  double c[2][2][2];
+  for (int di = 0; di < 2; di++)
+    for (int dj = 0; dj < 2; dj++)
+      for (int dk = 0; dk < 2; dk++)
+        c[di][dj][dk] = value_(idx[0] + di, idx[1] + dj, idx[2] + dk);
+
+  return trilinear_interp(c, frac[0], frac[1], frac[2]);
 }
 
+// Free Functions
 void cannon::math::permute(int* p, int n) {
+  permute(thread_rng(), p, n);
+}
+
+void cannon::math::permute(Rng& rng, int* p, int n) {
   for (int i = n - 1; i > 0; i--) {
-    int target = static_cast<int>(random_double(0, i+1));
+    int target = static_cast<int>(random_double(rng, 0, i+1));
     int tmp = p[i];
     p[i] = p[target];
     p[target] = tmp;
@@ -65,7 +173,7 @@ double cannon::math::trilinear_interp(double c[2][2][2], double u, double v, dou
   for (int i = 0; i < 2; i++) {
     for (int j = 0; j < 2; j++) {
       for (int k = 0; k < 2; k++) {
-        accum += (i*u + (1-i)*(1-u)) * 
+        accum += (i*u + (1-i)*(1-u)) *
                   (j*v + (1-j)*(1-v)) *
                   (k*w + (1-k)*(1-w)) * c[i][j][k];
       }
@@ -86,7 +194,7 @@ double cannon::math::trilinear_interp(Vector3d c[2][2][2], double u, double v, d
       for (int k = 0; k < 2; k++) {
         Vector3d weight(u-i, v-j, w-k);
 
-        accum += (i*uu + (1-i)*(1-uu)) * 
+        accum += (i*uu + (1-i)*(1-uu)) *
                  (j*vv + (1-j)*(1-vv)) *
                  (k*ww + (1-k)*(1-ww)) * c[i][j][k].dot(weight);
       }
@@ -95,7 +203,3 @@ double cannon::math::trilinear_interp(Vector3d c[2][2][2], double u, double v, d
 
   return accum;
 }
-
-inline double cannon::math::hermitian_smooth(double x) {
-  return x * x * (3 - 2*x);
-}
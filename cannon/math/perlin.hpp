@@ -1,33 +1,44 @@
 #pragma once
 #ifndef CANNON_MATH_PERLIN_H
-#define CANNON_MATH_PERLIN_H 
+#define CANNON_MATH_PERLIN_H
 
 /*!
  * \file cannon/math/perlin.hpp
- * File containing Perlin class definition.
+ * File containing Perlin and NoiseVolume class definitions.
  */
 
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Dense>
+
 #include <cannon/math/random_double.hpp>
 
+using namespace Eigen;
+
 namespace cannon {
   namespace math {
 
     // Free Functions
 
     /*!
-     * \brief Generate permutation of noise.
+     * \brief Permute the input int array of length n.
      *
-     * \returns Permutation of length Perlin::point_count_;
+     * \param p The array to permute.
+     * \param n The length of the input array.
      */
-    int* perlin_generate_perm();
+    void permute(int* p, int n);
 
     /*!
-     * \brief Permute the input int array of length n.
-     * 
+     * \brief Permute the input int array of length n using the input
+     * generator.
+     *
+     * \param rng The generator to use.
      * \param p The array to permute.
      * \param n The length of the input array.
      */
-    void permute(int* p, int n);
+    void permute(Rng& rng, int* p, int n);
 
     /*!
      * \brief Compute trilinear interpolation of the input array.
@@ -60,37 +71,32 @@ namespace cannon {
      *
      * \returns Hermitian smoothed input.
      */
-    inline double hermitian_smooth(double x);
+    inline double hermitian_smooth(double x) {
+      return x * x * (3 - 2*x);
+    }
 
     /*!
-     * \brief Class representing a perlin noise generator.
+     * \brief Class representing a perlin noise generator. Gradients are
+     * stored by component and permutations as bytes, inline in the
+     * generator, so that the tables for all octaves fit in a few kilobytes
+     * of contiguous memory and the generator can be copied safely.
      */
     class Perlin {
       public:
 
         /*!
-         * \brief Default constructor.
+         * \brief Default constructor, drawing gradients and permutations
+         * from the global generator.
          */
-        Perlin() {
-          ranvec_ = new Vector3d[point_count_];
-          for (int i = 0; i < point_count_; i++) {
-            ranvec_[i] = random_unit_vec();
-          }
-
-          perm_x_ = perlin_generate_perm();
-          perm_y_ = perlin_generate_perm();
-          perm_z_ = perlin_generate_perm();
-        }
+        Perlin();
 
         /*!
-         * \brief Destructor.
+         * \brief Constructor drawing gradients and permutations from the
+         * input generator, for reproducible noise.
+         *
+         * \param rng The generator to use.
          */
-        ~Perlin() {
-          delete[] ranvec_;
-          delete[] perm_x_;
-          delete[] perm_y_;
-          delete[] perm_z_;
-        }
+        Perlin(Rng& rng);
 
         /*!
          * \brief Get Perlin noise value for an input 3D point.
@@ -101,6 +107,15 @@ namespace cannon {
          */
         double noise(const Vector3d& p) const;
 
+        /*!
+         * \brief Get Perlin noise values for a batch of points.
+         *
+         * \param points The points to evaluate, one per column.
+         *
+         * \returns Noise value for each point.
+         */
+        VectorXd noise(const Matrix3Xd& points) const;
+
         /*!
          * \brief Get Perlin noise turbulence.
          *
@@ -111,15 +126,93 @@ namespace cannon {
          */
         double turbulence(const Vector3d& p, int depth=7) const;
 
+        /*!
+         * \brief Get Perlin noise turbulence for a batch of points.
+         *
+         * \param points The points to evaluate, one per column.
+         * \param depth Depth of turbulence (via repeated noise application)
+         *
+         * \returns Turbulence value for each point.
+         */
+        VectorXd turbulence(const Matrix3Xd& points, int depth=7) const;
+
         static const int point_count_ = 256; //!< Number of random floats to generate.
 
       private:
-        Vector3d* ranvec_; //!< Array of cached random vectors.
-        int* perm_x_; //!< X-axis permutation.
-        int* perm_y_; //!< Y-axis permutation.
-        int* perm_z_; //!< Z-axis permutation.
+
+        /*!
+         * \brief Fill a permutation table from a random permutation.
+         */
+        static void set_perm_(std::array<uint8_t, point_count_>& perm, const int* p);
+
+        std::array<double, point_count_> ranvec_x_; //!< X components of cached random vectors.
+        std::array<double, point_count_> ranvec_y_; //!< Y components of cached random vectors.
+        std::array<double, point_count_> ranvec_z_; //!< Z components of cached random vectors.
+        std::array<uint8_t, point_count_> perm_x_; //!< X-axis permutation.
+        std::array<uint8_t, point_count_> perm_y_; //!< Y-axis permutation.
+        std::array<uint8_t, point_count_> perm_z_; //!< Z-axis permutation.
     };
 
+    /*!
+     * \brief Class representing turbulence baked onto a regular grid over a
+     * box, for static noise textures. Lookups interpolate trilinearly
+     * between grid points, so octaves finer than the grid spacing are
+     * smoothed away.
+     */
+    class NoiseVolume {
+      public:
+
+        NoiseVolume() = delete;
+
+        /*!
+         * \brief Constructor baking turbulence from the input generator.
+         *
+         * \param perlin Noise generator to bake.
+         * \param min Minimum corner of the baked box.
+         * \param max Maximum corner of the baked box.
+         * \param resolution Number of grid points along each axis, at least
+         * two.
+         * \param depth Depth of baked turbulence.
+         */
+        NoiseVolume(const Perlin& perlin, const Vector3d& min, const
+            Vector3d& max, const Vector3i& resolution, int depth=7);
+
+        /*!
+         * \brief Check whether a point lies within the baked box.
+         */
+        bool contains(const Vector3d& p) const;
+
+        /*!
+         * \brief Look up baked turbulence at a point, which is clamped to
+         * the baked box.
+         *
+         * \param p The point to look up.
+         *
+         * \returns Interpolated turbulence value.
+         */
+        double lookup(const Vector3d& p) const;
+
+        /*!
+         * \brief Get the memory used by the baked grid.
+         */
+        size_t memory_bytes() const {
+          return values_.size() * sizeof(float);
+        }
+
+      private:
+
+        /*!
+         * \brief Get a baked grid value.
+         */
+        float value_(int i, int j, int k) const {
+          return values_[(static_cast<size_t>(k) * resolution_.y() + j) * resolution_.x() + i];
+        }
+
+        Vector3d min_; //!< Minimum corner of the baked box
+        Vector3d max_; //!< Maximum corner of the baked box
+        Vector3i resolution_; //!< Number of grid points along each axis
+        std::vector<float> values_; //!< Baked turbulence, with x varying fastest
+    };
 
   } // namespace math
 } // namespace cannon
@@ -1,7 +1,71 @@
+#include <cmath>
+
 #include <catch2/catch.hpp>
 
 #include <cannon/math/perlin.hpp>
 
+using namespace cannon::math;
+
 TEST_CASE("Perlin", "[math]") {
+  Rng rng(7);
+  Perlin perlin(rng);
+
+  // Generators with the same seed produce the same noise
+  Rng other_rng(7);
+  Perlin other(other_rng);
+  REQUIRE(perlin.noise(Vector3d(0.3, 1.7, -2.2)) == other.noise(Vector3d(0.3, 1.7, -2.2)));
+
+  // Noise vanishes at lattice points, and is bounded
+  REQUIRE(perlin.noise(Vector3d(3, -4, 5)) == Approx(0.0).margin(1e-12));
+
+  Matrix3Xd points(3, 103);
+  for (int i = 0; i < points.cols(); i++)
+    points.col(i) = Vector3d(random_double(rng, -20, 20), random_double(rng,
+          -20, 20), random_double(rng, -20, 20));
+
+  // Batched evaluation matches evaluating one point at a time, and
+  // octaves evaluated together match summing octaves one at a time
+  VectorXd noise = perlin.noise(points);
+  VectorXd turbulence = perlin.turbulence(points);
+  for (int i = 0; i < points.cols(); i++) {
+    Vector3d p = points.col(i);
+    REQUIRE(std::fabs(noise[i]) <= std::sqrt(3.0));
+    REQUIRE(noise[i] == Approx(perlin.noise(p)).margin(1e-12));
+
+    double accum = 0.0, weight = 1.0;
+    Vector3d temp_p = p;
+    for (int o = 0; o < 7; o++) {
+      accum += weight * perlin.noise(temp_p);
+      weight *= 0.5;
+      temp_p *= 2;
+    }
+    REQUIRE(perlin.turbulence(p) == Approx(std::fabs(accum)).margin(1e-12));
+    REQUIRE(turbulence[i] == Approx(std::fabs(accum)).margin(1e-12));
+    REQUIRE(perlin.turbulence(p, 3) == Approx(perlin.turbulence(Matrix3Xd(points.leftCols(i + 1)), 3)[i]).margin(1e-12));
+  }
+}
+
+TEST_CASE("NoiseVolume", "[math]") {
+  Rng rng(11);
+  Perlin perlin(rng);
+
+  Vector3d min(-1, 0, 2), max(1, 1, 4);
+  Vector3i resolution(33, 17, 33);
+  NoiseVolume volume(perlin, min, max, resolution, 2);
+  REQUIRE(volume.memory_bytes() == 33 * 17 * 33 * sizeof(float));
+
+  // Grid points reproduce turbulence exactly, up to float precision
+  Vector3d spacing = (max - min).cwiseQuotient(Vector3d(32, 16, 32));
+  Vector3d grid_point = min + Vector3d(5, 3, 7).cwiseProduct(spacing);
+  REQUIRE(volume.lookup(grid_point) == Approx(perlin.turbulence(grid_point, 2)).margin(1e-6));
+
+  // Between grid points, coarse octaves are well approximated
+  for (int i = 0; i < 100; i++) {
+    Vector3d p(random_double(rng, -1, 1), random_double(rng, 0, 1), random_double(rng, 2, 4));
+    REQUIRE(volume.contains(p));
+    REQUIRE(volume.lookup(p) == Approx(perlin.turbulence(p, 2)).margin(0.05));
+  }
 
+  REQUIRE(!volume.contains(Vector3d(0, 0, 0)));
+  REQUIRE_THROWS(NoiseVolume(perlin, min, max, Vector3i(1, 4, 4)));
 }
@@ -1,19 +1,24 @@
 #include <cannon/math/random_double.hpp>
 
+#include <cmath>
+#include <chrono>
 #include <thread>
-#include <random>
-#include <cassert>
+#include <functional>
 
 using namespace cannon::math;
 
-double cannon::math::random_double() {
-  // Making random number generator thread-safe
-  static thread_local std::mt19937* generator = nullptr;
-  static std::hash<std::thread::id> hasher;
-  if (!generator) generator = new std::mt19937(clock() + hasher(std::this_thread::get_id()));
-  static std::uniform_real_distribution<double> distribution(0.0, 1.0);
+Rng& cannon::math::thread_rng() {
+  // Each thread gets its own generator, seeded differently so that threads
+  // do not repeat each other's streams
+  static thread_local Rng generator(
+      std::hash<std::thread::id>()(std::this_thread::get_id()),
+      Rng::mix_bits(std::chrono::steady_clock::now().time_since_epoch().count()));
 
-  return distribution(*generator);
+  return generator;
+}
+
+double cannon::math::random_double() {
+  return thread_rng().uniform_double();
 }
 
 double cannon::math::random_double(double min, double max) {
@@ -39,18 +44,25 @@ Vector3d cannon::math::random_vec(double min, double max) {
 }
 
 Vector3d cannon::math::random_in_unit_sphere() {
-  // Note this is rejection sampling, and there's definitely a better way.
-  while (true) {
-    auto p = random_vec(-1, 1);
-    if (p.dot(p) >= 1)
-      continue;
-    else
-      return p;
-  }
+  return random_in_unit_sphere(thread_rng());
+}
+
+Vector3d cannon::math::random_in_unit_sphere(Rng& rng) {
+  // A uniform direction scaled by the cube root of a uniform radius fraction
+  // is uniform in volume, without rejection
+  return std::cbrt(rng.uniform_double()) * random_unit_vec(rng);
 }
 
 Vector3d cannon::math::random_unit_vec() {
-  return random_in_unit_sphere().normalized();
+  return random_unit_vec(thread_rng());
+}
+
+Vector3d cannon::math::random_unit_vec(Rng& rng) {
+  // Archimedes: z is uniform on a sphere
+  double z = 1.0 - 2.0 * rng.uniform_double();
+  double r = std::sqrt(std::max(0.0, 1.0 - z * z));
+  double phi = 2.0 * M_PI * rng.uniform_double();
+  return Vector3d(r * std::cos(phi), r * std::sin(phi), z);
 }
 
 Vector3d cannon::math::random_in_hemisphere(const Vector3d& normal) {
@@ -63,10 +75,11 @@ Vector3d cannon::math::random_in_hemisphere(const Vector3d& normal) {
 }
 
 Vector3d cannon::math::random_in_disk() {
-  // Again, rejection sampling
-  while (true) {
-    auto p = Vector3d(random_double(-1, 1), random_double(-1, 1), 0);
-    if (p.dot(p) >= 1) continue;
-    return p;
-  }
+  return random_in_disk(thread_rng());
+}
+
+Vector3d cannon::math::random_in_disk(Rng& rng) {
+  double r = std::sqrt(rng.uniform_double());
+  double theta = 2.0 * M_PI * rng.uniform_double();
+  return Vector3d(r * std::cos(theta), r * std::sin(theta), 0);
 }
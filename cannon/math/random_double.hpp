@@ -9,11 +9,23 @@
 
 #include <Eigen/Dense>
 
+#include <cannon/math/rng.hpp>
+
 using namespace Eigen;
 
 namespace cannon {
   namespace math {
 
+    /*!
+     * \brief Get the random number generator for the calling thread, which
+     * is used by the functions here that do not take a generator. It is
+     * seeded from the clock and thread id on first use, and may be reseeded
+     * for reproducible results.
+     *
+     * \returns The thread's generator.
+     */
+    Rng& thread_rng();
+
     /*!
      * \brief Generate a random double uniformly at random between 0 and 1 in a
      * thread-safe way.
@@ -22,6 +34,18 @@ namespace cannon {
      */
     double random_double();
 
+    /*!
+     * \brief Generate a random double uniformly at random between 0 and 1
+     * using the input generator.
+     *
+     * \param rng The generator to use.
+     *
+     * \returns The generated double.
+     */
+    inline double random_double(Rng& rng) {
+      return rng.uniform_double();
+    }
+
     /*!
      * \brief Generate a random double between min and max.
      *
@@ -32,6 +56,20 @@ namespace cannon {
      */
     double random_double(double min, double max);
 
+    /*!
+     * \brief Generate a random double between min and max using the input
+     * generator.
+     *
+     * \param rng The generator to use.
+     * \param min The minimum number that can be generated.
+     * \param max The maximum number that can be generated.
+     *
+     * \returns The generated double.
+     */
+    inline double random_double(Rng& rng, double min, double max) {
+      return min + (max - min) * rng.uniform_double();
+    }
+
     /*!
      * \brief Generate a random vector with entries sampled uniformly at random
      * between 0 and 1.
@@ -58,6 +96,16 @@ namespace cannon {
      */
     Vector3d random_in_unit_sphere();
 
+    /*!
+     * \brief Generate a random vector in the unit sphere using the input
+     * generator.
+     *
+     * \param rng The generator to use.
+     *
+     * \returns The generated vector.
+     */
+    Vector3d random_in_unit_sphere(Rng& rng);
+
     /*!
      * \brief Generate a random unit vector.
      * 
@@ -65,6 +113,15 @@ namespace cannon {
      */
     Vector3d random_unit_vec();
 
+    /*!
+     * \brief Generate a random unit vector using the input generator.
+     *
+     * \param rng The generator to use.
+     *
+     * \returns The generated vector.
+     */
+    Vector3d random_unit_vec(Rng& rng);
+
     /*!
      * \brief Generate a random vector in the unit hemisphere around the input
      * normal vector.
@@ -82,6 +139,16 @@ namespace cannon {
      */
     Vector3d random_in_disk();
 
+    /*!
+     * \brief Generate a random vector in the unit disk in the X-Y plane using
+     * the input generator.
+     *
+     * \param rng The generator to use.
+     *
+     * \returns The generated vector.
+     */
+    Vector3d random_in_disk(Rng& rng);
+
   } // namespace math
 } // namespace cannon
 
@@ -1,3 +1,5 @@
+#include <cmath>
+
 #include <catch2/catch.hpp>
 
 #include <cannon/math/random_double.hpp>
@@ -18,4 +20,22 @@ TEST_CASE("RandomDouble", "[math]") {
     REQUIRE(sample < 20.0);
   }
 
+  Rng rng(1);
+  for (unsigned int i = 0; i < 1000; i++) {
+    REQUIRE(random_in_unit_sphere(rng).norm() < 1.0);
+    REQUIRE(random_unit_vec(rng).norm() == Approx(1.0));
+
+    Vector3d p = random_in_disk(rng);
+    REQUIRE(p.z() == 0.0);
+    REQUIRE(p.norm() < 1.0);
+  }
+
+  // Points in the unit sphere are uniform in volume, so half lie within
+  // radius 2^(-1/3)
+  int inner = 0;
+  for (unsigned int i = 0; i < 10000; i++) {
+    if (random_in_unit_sphere(rng).norm() < std::cbrt(0.5))
+      inner++;
+  }
+  REQUIRE(std::abs(inner - 5000) < 250);
 }
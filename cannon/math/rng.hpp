@@ -0,0 +1,136 @@
+#pragma once
+#ifndef CANNON_MATH_RNG_H
+#define CANNON_MATH_RNG_H
+
+/*!
+ * \file cannon/math/rng.hpp
+ * \brief File containing Rng class definition.
+ */
+
+#include <cstdint>
+
+namespace cannon {
+  namespace math {
+
+    /*!
+     * \brief Class representing a small, fast pseudorandom number generator
+     * (PCG32, after O'Neill). State is two 64-bit words, so generators are
+     * cheap to create and reseed, and independent streams can be selected by
+     * sequence index. Adapted from PBRT.
+     */
+    class Rng {
+      public:
+
+        /*!
+         * \brief Default constructor, using a fixed default stream.
+         */
+        Rng() : state_(default_state_), inc_(default_stream_) {}
+
+        /*!
+         * \brief Constructor taking sequence index and seed. See
+         * set_sequence().
+         */
+        Rng(uint64_t sequence_index, uint64_t seed=mix_bits(default_state_)) {
+          set_sequence(sequence_index, seed);
+        }
+
+        /*!
+         * \brief Select the stream of this generator and its starting point
+         * within the stream. Generators with different sequence indices
+         * produce independent streams.
+         *
+         * \param sequence_index Index of the stream.
+         * \param seed Seed for the starting point in the stream.
+         */
+        void set_sequence(uint64_t sequence_index, uint64_t seed) {
+          state_ = 0u;
+          inc_ = (sequence_index << 1u) | 1u;
+          uniform_uint32();
+          state_ += seed;
+          uniform_uint32();
+        }
+
+        /*!
+         * \brief Generate a uniformly random 32-bit integer.
+         */
+        uint32_t uniform_uint32() {
+          uint64_t old_state = state_;
+          state_ = old_state * multiplier_ + inc_;
+          uint32_t xor_shifted = static_cast<uint32_t>(((old_state >> 18u) ^ old_state) >> 27u);
+          uint32_t rot = static_cast<uint32_t>(old_state >> 59u);
+          return (xor_shifted >> rot) | (xor_shifted << ((~rot + 1u) & 31));
+        }
+
+        /*!
+         * \brief Generate a uniformly random integer less than the input
+         * bound, without modulo bias.
+         *
+         * \param bound Exclusive upper bound, greater than zero.
+         */
+        uint32_t uniform_uint32(uint32_t bound) {
+          uint32_t threshold = (~bound + 1u) % bound;
+          while (true) {
+            uint32_t r = uniform_uint32();
+            if (r >= threshold)
+              return r % bound;
+          }
+        }
+
+        /*!
+         * \brief Generate a uniformly random double in [0, 1).
+         */
+        double uniform_double() {
+          // 53 random bits fill the mantissa, so the result is strictly
+          // less than 1
+          uint64_t bits = (static_cast<uint64_t>(uniform_uint32()) << 32) | uniform_uint32();
+          return (bits >> 11) * 0x1p-53;
+        }
+
+        /*!
+         * \brief Skip ahead (or back, for negative delta) in the stream, in
+         * time logarithmic in delta.
+         *
+         * \param delta Number of 32-bit outputs to skip.
+         */
+        void advance(int64_t delta) {
+          uint64_t cur_mult = multiplier_, cur_plus = inc_, acc_mult = 1u;
+          uint64_t acc_plus = 0u, delta_u = static_cast<uint64_t>(delta);
+          while (delta_u > 0) {
+            if (delta_u & 1) {
+              acc_mult *= cur_mult;
+              acc_plus = acc_plus * cur_mult + cur_plus;
+            }
+            cur_plus = (cur_mult + 1) * cur_plus;
+            cur_mult *= cur_mult;
+            delta_u /= 2;
+          }
+          state_ = acc_mult * state_ + acc_plus;
+        }
+
+        /*!
+         * \brief Scramble the bits of a 64-bit integer, for turning
+         * structured values such as pixel coordinates into seeds.
+         */
+        static uint64_t mix_bits(uint64_t v) {
+          v ^= (v >> 31);
+          v *= 0x7fb5d329728ea185ull;
+          v ^= (v >> 27);
+          v *= 0x81dadef4bc2dd44dull;
+          v ^= (v >> 33);
+          return v;
+        }
+
+      private:
+        static constexpr uint64_t default_state_ = 0x853c49e6748fea9bull; //!< Default generator state
+        static constexpr uint64_t default_stream_ = 0xda3e39cb94b95bdbull; //!< Default stream increment
+        static constexpr uint64_t multiplier_ = 0x5851f42d4c957f2dull; //!< LCG multiplier
+
+        uint64_t state_; //!< Current LCG state
+        uint64_t inc_; //!< Stream increment, always odd
+
+    };
+
+  } // namespace math
+} // namespace cannon
+
+#endif /* ifndef CANNON_MATH_RNG_H */
@@ -0,0 +1,45 @@
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include <cannon/math/rng.hpp>
+
+using namespace cannon::math;
+
+TEST_CASE("Rng", "[math]") {
+  // Generators with the same sequence and seed repeat each other
+  Rng a(3, 7), b(3, 7), c(4, 7);
+  bool any_different = false;
+  for (int i = 0; i < 100; i++) {
+    uint32_t va = a.uniform_uint32();
+    REQUIRE(va == b.uniform_uint32());
+    if (va != c.uniform_uint32())
+      any_different = true;
+  }
+  REQUIRE(any_different);
+
+  // Advancing skips outputs, in either direction
+  Rng d(5, 11), e(5, 11);
+  for (int i = 0; i < 37; i++)
+    d.uniform_uint32();
+  e.advance(37);
+  REQUIRE(d.uniform_uint32() == e.uniform_uint32());
+  e.advance(-38);
+  Rng f(5, 11);
+  REQUIRE(e.uniform_uint32() == f.uniform_uint32());
+
+  // Doubles are uniform in [0, 1)
+  Rng g;
+  std::vector<int> buckets(10, 0);
+  for (int i = 0; i < 10000; i++) {
+    double v = g.uniform_double();
+    REQUIRE(v >= 0.0);
+    REQUIRE(v < 1.0);
+    buckets[static_cast<int>(v * 10)]++;
+  }
+  for (int count : buckets)
+    REQUIRE(std::abs(count - 1000) < 150);
+
+  for (int i = 0; i < 1000; i++)
+    REQUIRE(g.uniform_uint32(7) < 7);
+}
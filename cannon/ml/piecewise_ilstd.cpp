@@ -1,6 +1,7 @@
 #include <cannon/ml/piecewise_ilstd.hpp>
 
 #include <cannon/log/registry.hpp>
+#include <cannon/utils/profiler.hpp>
 
 using namespace cannon::ml;
 using namespace cannon::log;
@@ -11,6 +12,7 @@ void PiecewiseILSTDFilter::process_datum(const VectorXd &in_vec,
                                          const VectorXd &next_in_vec,
                                          unsigned int idx,
                                          unsigned int next_idx, double reward) {
+  PROFILE_HOT_SCOPE("Piecewise iLSTD update");
   RowVectorXd feat = make_feature_vec_(in_vec, idx);
   RowVectorXd next_feat = make_feature_vec_(next_in_vec, next_idx);
 
@@ -3,6 +3,7 @@
 #include <cassert>
 
 #include <cannon/log/registry.hpp>
+#include <cannon/utils/profiler.hpp>
 
 using namespace cannon::ml;
 using namespace cannon::log;
@@ -10,6 +11,7 @@ using namespace cannon::log;
 // Public
 void PiecewiseLSTDFilter::process_datum(const VectorXd& in_vec, const VectorXd& next_in_vec,
     unsigned int idx, unsigned int next_idx, double reward) {
+  PROFILE_HOT_SCOPE("Piecewise LSTD update");
   RowVectorXd feat = make_feature_vec_(in_vec, idx);
   RowVectorXd next_feat = make_feature_vec_(next_in_vec, next_idx);
 
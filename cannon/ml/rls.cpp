@@ -5,12 +5,14 @@
 #include <cmath>
 
 #include <cannon/log/registry.hpp>
+#include <cannon/utils/profiler.hpp>
 
 using namespace cannon::ml;
 using namespace cannon::log;
 
 // Public methods
 void RLSFilter::process_datum(const VectorXd& in_vec, const VectorXd& output) {
+  PROFILE_HOT_SCOPE("RLS update");
   RowVectorXd feat = make_feature_vec_(in_vec);
   t_ += 1.0;
 
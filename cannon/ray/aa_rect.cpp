@@ -2,13 +2,28 @@
 
 #include <cannon/ray/aabb.hpp>
 #include <cannon/ray/ray.hpp>
+#include <cannon/math/random_double.hpp>
 
 using namespace cannon::ray;
+using namespace cannon::math;
+
+/*!
+ * Compute the solid angle density of a direction when sampling points
+ * uniformly by area on a rectangle, given where the direction hits it.
+ */
+static double rect_pdf_value(const Vector3d& direction, const hit_record& rec, double area) {
+  double distance_squared = rec.t * rec.t * direction.squaredNorm();
+  double cosine = std::fabs(direction.dot(rec.normal)) / direction.norm();
+  if (cosine <= 0.0)
+    return 0.0;
+
+  return distance_squared / (cosine * area);
+}
 
 bool XYRect::object_space_hit(const Ray& r, double t_min, double t_max, hit_record& rec) const {
   auto t = (k_ - r.orig_.z()) / r.dir_.z();
 
-  if (t < t_min || t > t_max)
+  if (t <= t_min || t > t_max)
     return false;
 
   auto x = r.orig_.x() + t * r.dir_.x();
@@ -19,10 +34,17 @@ bool XYRect::object_space_hit(const Ray& r, double t_min, double t_max, hit_reco
   // Fill out hit pointer
   rec.u = (x - x0_) / (x1_ - x0_);
   rec.v = (y - y0_) / (y1_ - y0_);
+  rec.dpdu = Vector3d(x1_ - x0_, 0, 0);
+  rec.dpdv = Vector3d(0, y1_ - y0_, 0);
   rec.t = t;
   rec.set_face_normal(r, Vector3d(0, 0, 1));
-  rec.mat_ptr = mat_ptr_;
+  rec.mat_ptr = mat_ptr_.get();
   rec.p = r.at(t);
+
+  // The hit point lies exactly on the plane, so it has no error along the
+  // normal
+  rec.p[2] = k_;
+  rec.p_error = Vector3d::Zero();
   return true;
 }
 
@@ -32,10 +54,24 @@ bool XYRect::object_space_bounding_box(double /*time_0*/, double /*time_1*/, Aab
   return true;
 }
 
+double XYRect::object_space_pdf_value(const Vector3d& origin, const Vector3d&
+    direction, double time) const {
+  hit_record rec;
+  if (!object_space_hit(Ray(origin, direction, time), 0.0, std::numeric_limits<double>::infinity(), rec))
+    return 0.0;
+
+  return rect_pdf_value(direction, rec, (x1_ - x0_) * (y1_ - y0_));
+}
+
+Vector3d XYRect::object_space_random_direction(const Vector3d& origin,
+    double /*time*/, Rng& rng) const {
+  return Vector3d(random_double(rng, x0_, x1_), random_double(rng, y0_, y1_), k_) - origin;
+}
+
 bool XZRect::object_space_hit(const Ray& r, double t_min, double t_max, hit_record& rec) const {
   auto t = (k_ - r.orig_.y()) / r.dir_.y();
 
-  if (t < t_min || t > t_max)
+  if (t <= t_min || t > t_max)
     return false;
 
   auto x = r.orig_.x() + t * r.dir_.x();
@@ -46,10 +82,14 @@ bool XZRect::object_space_hit(const Ray& r, double t_min, double t_max, hit_reco
   // Fill out hit pointer
   rec.u = (x - x0_) / (x1_ - x0_);
   rec.v = (z - z0_) / (z1_ - z0_);
+  rec.dpdu = Vector3d(x1_ - x0_, 0, 0);
+  rec.dpdv = Vector3d(0, 0, z1_ - z0_);
   rec.t = t;
   rec.set_face_normal(r, Vector3d(0, 1, 0));
-  rec.mat_ptr = mat_ptr_;
+  rec.mat_ptr = mat_ptr_.get();
   rec.p = r.at(t);
+  rec.p[1] = k_;
+  rec.p_error = Vector3d::Zero();
   return true;
 }
 
@@ -59,10 +99,24 @@ bool XZRect::object_space_bounding_box(double /*time_0*/, double /*time_1*/, Aab
   return true;
 }
 
+double XZRect::object_space_pdf_value(const Vector3d& origin, const Vector3d&
+    direction, double time) const {
+  hit_record rec;
+  if (!object_space_hit(Ray(origin, direction, time), 0.0, std::numeric_limits<double>::infinity(), rec))
+    return 0.0;
+
+  return rect_pdf_value(direction, rec, (x1_ - x0_) * (z1_ - z0_));
+}
+
+Vector3d XZRect::object_space_random_direction(const Vector3d& origin,
+    double /*time*/, Rng& rng) const {
+  return Vector3d(random_double(rng, x0_, x1_), k_, random_double(rng, z0_, z1_)) - origin;
+}
+
 bool YZRect::object_space_hit(const Ray& r, double t_min, double t_max, hit_record& rec) const {
   auto t = (k_ - r.orig_.x()) / r.dir_.x();
 
-  if (t < t_min || t > t_max)
+  if (t <= t_min || t > t_max)
     return false;
 
   auto y = r.orig_.y() + t * r.dir_.y();
@@ -73,10 +127,14 @@ bool YZRect::object_space_hit(const Ray& r, double t_min, double t_max, hit_reco
   // Fill out hit pointer
   rec.u = (y - y0_) / (y1_ - y0_);
   rec.v = (z - z0_) / (z1_ - z0_);
+  rec.dpdu = Vector3d(0, y1_ - y0_, 0);
+  rec.dpdv = Vector3d(0, 0, z1_ - z0_);
   rec.t = t;
   rec.set_face_normal(r, Vector3d(1, 0, 0));
-  rec.mat_ptr = mat_ptr_;
+  rec.mat_ptr = mat_ptr_.get();
   rec.p = r.at(t);
+  rec.p[0] = k_;
+  rec.p_error = Vector3d::Zero();
   return true;
 }
 
@@ -86,6 +144,20 @@ bool YZRect::object_space_bounding_box(double /*time_0*/, double /*time_1*/, Aab
   return true;
 }
 
+double YZRect::object_space_pdf_value(const Vector3d& origin, const Vector3d&
+    direction, double time) const {
+  hit_record rec;
+  if (!object_space_hit(Ray(origin, direction, time), 0.0, std::numeric_limits<double>::infinity(), rec))
+    return 0.0;
+
+  return rect_pdf_value(direction, rec, (y1_ - y0_) * (z1_ - z0_));
+}
+
+Vector3d YZRect::object_space_random_direction(const Vector3d& origin,
+    double /*time*/, Rng& rng) const {
+  return Vector3d(k_, random_double(rng, y0_, y1_), random_double(rng, z0_, z1_)) - origin;
+}
+
 bool Box::object_space_bounding_box(double /*time_0*/, double /*time_1*/, Aabb& output_box) const {
   output_box = Aabb(box_min_, box_max_);
   return true;
@@ -49,6 +49,18 @@ namespace cannon {
         virtual bool object_space_bounding_box(double time_0, double time_1,
             Aabb& output_box) const override;
 
+        /*!
+         * Inherited from Hittable.
+         */
+        virtual double object_space_pdf_value(const Vector3d& origin, const
+            Vector3d& direction, double time) const override;
+
+        /*!
+         * Inherited from Hittable.
+         */
+        virtual Vector3d object_space_random_direction(const Vector3d& origin,
+            double time, Rng& rng) const override;
+
       public:
         double x0_, x1_, y0_, y1_, k_; //!< Rectangle extent parameters
         std::shared_ptr<Material> mat_ptr_; //!< Material
@@ -90,6 +102,18 @@ namespace cannon {
         virtual bool object_space_bounding_box(double time_0, double time_1,
             Aabb& output_box) const override;
 
+        /*!
+         * Inherited from Hittable.
+         */
+        virtual double object_space_pdf_value(const Vector3d& origin, const
+            Vector3d& direction, double time) const override;
+
+        /*!
+         * Inherited from Hittable.
+         */
+        virtual Vector3d object_space_random_direction(const Vector3d& origin,
+            double time, Rng& rng) const override;
+
       public:
         double x0_, x1_, z0_, z1_, k_; //!< Rectangle extent parameters
         std::shared_ptr<Material> mat_ptr_; //!< Material
@@ -131,6 +155,18 @@ namespace cannon {
         virtual bool object_space_bounding_box(double time_0, double time_1,
             Aabb& output_box) const override;
 
+        /*!
+         * Inherited from Hittable.
+         */
+        virtual double object_space_pdf_value(const Vector3d& origin, const
+            Vector3d& direction, double time) const override;
+
+        /*!
+         * Inherited from Hittable.
+         */
+        virtual Vector3d object_space_random_direction(const Vector3d& origin,
+            double time, Rng& rng) const override;
+
       public:
         double y0_, y1_, z0_, z1_, k_; //!< Rectangle extent parameters
         std::shared_ptr<Material> mat_ptr_; //!< Material
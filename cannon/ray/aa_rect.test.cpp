@@ -1,7 +1,69 @@
 #include <catch2/catch.hpp>
 
 #include <cannon/ray/aa_rect.hpp>
+#include <cannon/ray/material.hpp>
+#include <cannon/ray/ray.hpp>
+#include <cannon/math/random_double.hpp>
+
+using namespace cannon::ray;
+using namespace cannon::math;
 
 TEST_CASE("AARect", "[ray]") {
+  auto mat = std::make_shared<Lambertian>(Vector3d(0.5, 0.5, 0.5));
+  XZRect rect(-1, 1, -1, 1, 1, mat);
+  Vector3d origin = Vector3d::Zero();
+  Rng rng;
+
+  // Sampled directions all reach the rect
+  for (int i = 0; i < 100; i++) {
+    Vector3d d = rect.random_direction(origin, 0.0, rng);
+    REQUIRE(d.y() == Approx(1.0));
+    REQUIRE(rect.pdf_value(origin, d, 0.0) > 0.0);
+  }
+
+  REQUIRE(rect.pdf_value(origin, -Vector3d::UnitY(), 0.0) == 0.0);
+
+  // Density integrates to one over the sphere of directions
+  int n = 200000;
+  double sum = 0.0;
+  for (int i = 0; i < n; i++)
+    sum += rect.pdf_value(origin, random_unit_vec(), 0.0);
+  REQUIRE(4.0 * M_PI * sum / n == Approx(1.0).epsilon(0.05));
+}
+
+TEST_CASE("AARect_differentials", "[ray]") {
+  auto mat = std::make_shared<Lambertian>(Vector3d(0.5, 0.5, 0.5));
+  XYRect rect(0, 4, 0, 2, 0, mat);
+
+  Ray r(Vector3d(1, 1, 10), Vector3d(0, 0, -1));
+  r.cone_spread_ = 0.01;
+
+  hit_record rec;
+  REQUIRE(rect.hit(r, 0.0, std::numeric_limits<double>::infinity(), rec));
+  REQUIRE(rec.dpdu.isApprox(Vector3d(4, 0, 0)));
+  REQUIRE(rec.dpdv.isApprox(Vector3d(0, 2, 0)));
+
+  // Head-on, the footprint is a circle as wide as the cone, so it spans
+  // 0.1 / 4 of u and 0.1 / 2 of v
+  rec.compute_differentials(r);
+  Vector2d dx(rec.dudx, rec.dvdx);
+  Vector2d dy(rec.dudy, rec.dvdy);
+  REQUIRE(std::fabs(dx.x() * dy.y() - dx.y() * dy.x()) == Approx(0.1 / 4 * 0.1 / 2));
+  REQUIRE(std::max(std::fabs(rec.dudx), std::fabs(rec.dudy)) == Approx(0.1 / 4));
+
+  // At a grazing angle, the footprint stretches along the ray
+  Ray grazing(Vector3d(1, -9, 1), Vector3d(0, 10, -1));
+  grazing.cone_spread_ = 0.01;
+  REQUIRE(rect.hit(grazing, 0.0, std::numeric_limits<double>::infinity(), rec));
+  rec.compute_differentials(grazing);
+  double dv = std::max(std::fabs(rec.dvdx), std::fabs(rec.dvdy));
+  double du = std::max(std::fabs(rec.dudx), std::fabs(rec.dudy));
+  REQUIRE(dv * 2 > 5 * du * 4);
 
+  // Rays without a cone have no footprint
+  Ray plain(Vector3d(1, 1, 10), Vector3d(0, 0, -1));
+  REQUIRE(rect.hit(plain, 0.0, std::numeric_limits<double>::infinity(), rec));
+  rec.compute_differentials(plain);
+  REQUIRE(rec.dudx == 0);
+  REQUIRE(rec.dvdy == 0);
 }
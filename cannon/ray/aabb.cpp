@@ -1,5 +1,7 @@
 #include <cannon/ray/aabb.hpp>
 
+#include <limits>
+
 #include <cannon/ray/ray.hpp>
 
 using namespace cannon::ray;
@@ -23,7 +25,43 @@ bool Aabb::hit(const Ray& r, double t_min, double t_max) const {
   return true;
 }
 
+double Aabb::surface_area() const {
+  Vector3d d = maximum_ - minimum_;
+  return 2 * (d.x() * d.y() + d.x() * d.z() + d.y() * d.z());
+}
+
+Vector3d Aabb::centroid() const {
+  return 0.5 * (minimum_ + maximum_);
+}
+
+int Aabb::maximum_extent() const {
+  Vector3d d = maximum_ - minimum_;
+  if (d.x() > d.y() && d.x() > d.z())
+    return 0;
+  else if (d.y() > d.z())
+    return 1;
+  else
+    return 2;
+}
+
+Vector3d Aabb::offset(const Vector3d& p) const {
+  Vector3d o = p - minimum_;
+  for (int i = 0; i < 3; i++) {
+    if (maximum_[i] > minimum_[i])
+      o[i] /= maximum_[i] - minimum_[i];
+  }
+
+  return o;
+}
+
 // Free functions
+Aabb cannon::ray::empty_box() {
+  Aabb box;
+  box.minimum_ = Vector3d::Constant(std::numeric_limits<double>::infinity());
+  box.maximum_ = Vector3d::Constant(-std::numeric_limits<double>::infinity());
+  return box;
+}
+
 Aabb cannon::ray::surrounding_box(const Aabb& box_0, const Aabb& box_1) {
   Vector3d small(std::fmin(box_0.minimum_.x(), box_1.minimum_.x()),
       std::fmin(box_0.minimum_.y(), box_1.minimum_.y()), 
@@ -50,6 +50,38 @@ namespace cannon {
          */
         bool hit(const Ray& r, double t_min, double t_max) const;
 
+        /*!
+         * Compute the surface area of this AABB.
+         *
+         * \returns The surface area.
+         */
+        double surface_area() const;
+
+        /*!
+         * Compute the center point of this AABB.
+         *
+         * \returns The centroid.
+         */
+        Vector3d centroid() const;
+
+        /*!
+         * Get the axis along which this AABB is longest.
+         *
+         * \returns Index of the axis of maximum extent.
+         */
+        int maximum_extent() const;
+
+        /*!
+         * Compute the position of a point relative to the corners of this
+         * AABB, so that the minimum corner maps to (0, 0, 0) and the maximum
+         * corner to (1, 1, 1).
+         *
+         * \param p The point to compute an offset for.
+         *
+         * \returns The relative offset.
+         */
+        Vector3d offset(const Vector3d& p) const;
+
       public:
         Vector3d minimum_; //!< Minimal corner of this AABB.
         Vector3d maximum_; //!< Maximal corner of this AABB.
@@ -57,6 +89,12 @@ namespace cannon {
     };
 
     // Free functions
+
+    /*!
+     * Function to create an empty AABB, which acts as the identity for
+     * surrounding_box.
+     */
+    Aabb empty_box();
     
     /*!
      * Function to compute bounding box surrounding both input boxes.
@@ -2,6 +2,17 @@
 
 #include <cannon/ray/aabb.hpp>
 
+using namespace cannon::ray;
+
 TEST_CASE("AABB", "[ray]") {
+  Aabb box(Vector3d(0, 0, 0), Vector3d(1, 2, 3));
+
+  REQUIRE(box.surface_area() == Approx(22.0));
+  REQUIRE(box.centroid().isApprox(Vector3d(0.5, 1.0, 1.5)));
+  REQUIRE(box.maximum_extent() == 2);
+  REQUIRE(box.offset(Vector3d(0.5, 1.0, 3.0)).isApprox(Vector3d(0.5, 0.5, 1.0)));
 
+  Aabb grown = surrounding_box(empty_box(), box);
+  REQUIRE(grown.minimum_.isApprox(box.minimum_));
+  REQUIRE(grown.maximum_.isApprox(box.maximum_));
 }
@@ -30,6 +30,32 @@ bool BvhNode::object_space_bounding_box(double /*time_0*/, double /*time_1*/, Aa
   return true;
 }
 
+double BvhNode::sah_cost() const {
+  double root_area = box_.surface_area();
+  if (root_area <= 0.0)
+    return 1.0;
+
+  return sah_cost_(root_area);
+}
+
+double BvhNode::sah_cost_(double root_area) const {
+  double p = box_.surface_area() / root_area;
+  double cost = p * 0.125;
+
+  // Single-object nodes store the same child twice, but test it once
+  auto children = (left_ == right_) ? std::vector<std::shared_ptr<Hittable>>{left_}
+                                    : std::vector<std::shared_ptr<Hittable>>{left_, right_};
+  for (auto& child : children) {
+    auto child_node = std::dynamic_pointer_cast<BvhNode>(child);
+    if (child_node)
+      cost += child_node->sah_cost_(root_area);
+    else
+      cost += p;
+  }
+
+  return cost;
+}
+
 // Free Functions
 inline bool cannon::ray::box_compare(const std::shared_ptr<Hittable> a, const
     std::shared_ptr<Hittable> b, int axis) {
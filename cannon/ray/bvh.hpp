@@ -128,6 +128,26 @@ namespace cannon {
          */
         virtual bool object_space_bounding_box(double time_0, double time_1, Aabb& output_box) const override;
 
+        /*!
+         * Compute the surface area heuristic cost of the hierarchy rooted at
+         * this node, in units of primitive intersection tests, for comparison
+         * with LinearBvh::sah_cost().
+         *
+         * \returns The SAH cost.
+         */
+        double sah_cost() const;
+
+      private:
+
+        /*!
+         * Compute the SAH cost contributed by the subtree rooted at this
+         * node, relative to the surface area of the root.
+         *
+         * \param root_area Surface area of the root bounding box.
+         *
+         * \returns The SAH cost of this subtree.
+         */
+        double sah_cost_(double root_area) const;
 
       public:
         std::shared_ptr<Hittable> left_; //!< Left child
@@ -8,9 +8,12 @@ Ray Camera::get_ray(double s, double t) const {
   Vector3d rd = lens_radius_ * random_in_disk();
   Vector3d offset = u_ * rd.x() + v_ * rd.y();
 
-  return Ray(origin_ + offset, 
+  Ray ray(origin_ + offset, 
       lower_left_corner_ + s*horizontal_ + t*vertical_ - origin_ - offset, 
       random_double(time_0_, time_1_));
+  ray.cone_spread_ = pixel_spread_;
+
+  return ray;
 }
 
 Ray Camera::get_ray(double s, double t, const CameraSample& sample) const {
@@ -35,7 +38,10 @@ Ray Camera::get_ray(double s, double t, const CameraSample& sample) const {
   Vector3d rd = lens_radius_ * lens_sample;
   Vector3d offset = u_ * rd.x() + v_ * rd.y();
 
-  return Ray(origin_ + offset, 
+  Ray ray(origin_ + offset, 
       lower_left_corner_ + s*horizontal_ + t*vertical_ - origin_ - offset, 
       time_0_ + (time_1_ - time_0_) * sample.time);
+  ray.cone_spread_ = pixel_spread_;
+
+  return ray;
 }
@@ -58,6 +58,7 @@ namespace cannon {
           lower_left_corner_ = origin_ - horizontal_/2 - vertical_/2 - focus_dist * w_; 
 
           lens_radius_ = aperture / 2;
+          viewport_height_ = viewport_height;
 
           time_0_ = time_0;
           time_1_ = time_1;
@@ -84,6 +85,17 @@ namespace cannon {
          */
         Ray get_ray(double s, double t, const CameraSample& sample) const;
 
+        /*!
+         * Set the height in pixels of the image rendered with this camera,
+         * so that generated rays carry a cone one pixel wide for texture
+         * filtering. Rays have no cone until this is set.
+         *
+         * \param image_height Image height in pixels.
+         */
+        void set_image_height(int image_height) {
+          pixel_spread_ = viewport_height_ / image_height;
+        }
+
       private:
         Vector3d origin_; //!< Camera origin
         Vector3d lower_left_corner_; //!< Lower-left corner of camera view plane
@@ -91,6 +103,8 @@ namespace cannon {
         Vector3d vertical_; //!< Vertical extent of camera view plane
         Vector3d u_, v_, w_; //!< Basis vectors for camera
         double lens_radius_; //!< Simulated thin lens radius
+        double viewport_height_; //!< Height of view plane at unit distance
+        double pixel_spread_ = 0.0; //!< Angle subtended by one pixel
         double time_0_, time_1_; //!< Shutter open and close time
     };
 
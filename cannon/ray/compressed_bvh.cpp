@@ -0,0 +1,301 @@
+#include <cannon/ray/compressed_bvh.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <cannon/ray/linear_bvh.hpp>
+#include <cannon/ray/hittable_list.hpp>
+#include <cannon/ray/ray.hpp>
+#include <cannon/ray/mesh.hpp>
+#include <cannon/utils/statistics.hpp>
+
+using namespace cannon::ray;
+using namespace cannon::utils;
+
+STAT_RATIO("Integrator/Compressed BVH node visits per hit test", nCompressedBvhNodeVisits, nCompressedBvhHitTests);
+STAT_COUNTER("Accelerator/Compressed BVH nodes built", nCompressedBvhNodes);
+STAT_MEMORY_COUNTER("Accelerator/Compressed BVH memory", nCompressedBvhBytes);
+
+static constexpr int max_traversal_stack = 256; //!< Traversal stack size, bounded by three entries per level of a hierarchy of depth at most 60
+
+/*!
+ * Compute the surface area of a binary node.
+ */
+static double binary_node_area(const LinearBvhNode& node) {
+  double dx = node.bounds_max_[0] - node.bounds_min_[0];
+  double dy = node.bounds_max_[1] - node.bounds_min_[1];
+  double dz = node.bounds_max_[2] - node.bounds_min_[2];
+  return 2 * (dx * dy + dx * dz + dy * dz);
+}
+
+/*!
+ * Set the quantization grid of a node to cover the union of its children,
+ * and quantize each child's bounds outwards onto it.
+ */
+static void quantize_children(CompressedBvhNode& node, const Aabb boxes[4], int n_children) {
+  Aabb bounds = empty_box();
+  for (int c = 0; c < n_children; c++)
+    bounds = surrounding_box(bounds, boxes[c]);
+
+  for (int i = 0; i < 3; i++) {
+    float origin = static_cast<float>(bounds.minimum_[i]);
+    if (origin > bounds.minimum_[i])
+      origin = std::nextafter(origin, -std::numeric_limits<float>::infinity());
+
+    // Cells are the smallest power of two for which 255 cells span the node
+    double extent = bounds.maximum_[i] - origin;
+    int exponent = std::numeric_limits<int8_t>::min();
+    if (extent > 0.0) {
+      exponent = std::max<int>(exponent, std::ceil(std::log2(extent / 255.0)));
+      while (std::ldexp(255.0, exponent) < extent)
+        exponent++;
+    }
+
+    node.origin_[i] = origin;
+    node.exponent_[i] = std::min<int>(exponent, std::numeric_limits<int8_t>::max());
+
+    double scale = std::ldexp(1.0, node.exponent_[i]);
+    for (int c = 0; c < n_children; c++) {
+      double lo = std::floor((boxes[c].minimum_[i] - origin) / scale);
+      double hi = std::ceil((boxes[c].maximum_[i] - origin) / scale);
+      node.child_min_[i][c] = std::min(std::max(lo, 0.0), 255.0);
+      node.child_max_[i][c] = std::min(std::max(hi, 0.0), 255.0);
+    }
+  }
+}
+
+/*!
+ * Recursively collapse the binary subtree rooted at an interior node into
+ * four-wide nodes, appending them in depth-first order. Each node starts
+ * with the binary node's two children and repeatedly replaces the interior
+ * child with the largest surface area by its own children.
+ *
+ * \param binary Nodes of the binary hierarchy.
+ * \param index Index of the interior binary node to collapse.
+ * \param nodes Node array to append the collapsed subtree to.
+ *
+ * \returns Index of the collapsed node.
+ */
+static int32_t collapse(const std::vector<LinearBvhNode>& binary, int index,
+    std::vector<CompressedBvhNode>& nodes) {
+  int children[4] = {index + 1, binary[index].second_child_offset_};
+  int n_children = 2;
+
+  while (n_children < 4) {
+    int largest = -1;
+    double largest_area = -1.0;
+    for (int c = 0; c < n_children; c++) {
+      const LinearBvhNode& child = binary[children[c]];
+      if (child.n_primitives_ == 0 && binary_node_area(child) > largest_area) {
+        largest = c;
+        largest_area = binary_node_area(child);
+      }
+    }
+
+    if (largest < 0)
+      break;
+
+    int expanded = children[largest];
+    children[largest] = expanded + 1;
+    children[n_children++] = binary[expanded].second_child_offset_;
+  }
+
+  size_t node_index = nodes.size();
+  nodes.emplace_back();
+
+  CompressedBvhNode node = {};
+  node.n_children_ = n_children;
+
+  Aabb boxes[4];
+  for (int c = 0; c < n_children; c++) {
+    const LinearBvhNode& child = binary[children[c]];
+    boxes[c] = Aabb(Vector3d(child.bounds_min_[0], child.bounds_min_[1], child.bounds_min_[2]),
+        Vector3d(child.bounds_max_[0], child.bounds_max_[1], child.bounds_max_[2]));
+  }
+  quantize_children(node, boxes, n_children);
+
+  for (int c = 0; c < n_children; c++) {
+    const LinearBvhNode& child = binary[children[c]];
+    node.child_n_primitives_[c] = child.n_primitives_;
+    if (child.n_primitives_ > 0)
+      node.child_offset_[c] = child.primitives_offset_;
+    else
+      node.child_offset_[c] = collapse(binary, children[c], nodes);
+  }
+
+  nodes[node_index] = node;
+  return node_index;
+}
+
+CompressedBvh::CompressedBvh(std::shared_ptr<Affine3d> object_to_world, const
+    HittableListPtr list, double time_0, double time_1, unsigned int
+    max_prims_in_node, unsigned int num_threads) : CompressedBvh(object_to_world,
+      list->objects_, time_0, time_1, max_prims_in_node, num_threads) {}
+
+CompressedBvh::CompressedBvh(std::shared_ptr<Affine3d> object_to_world, const
+    std::vector<std::shared_ptr<Hittable>>& src_objects, double time_0, double
+    time_1, unsigned int max_prims_in_node, unsigned int num_threads) :
+  Hittable(object_to_world), box_(empty_box()) {
+  if (src_objects.empty())
+    return;
+
+  // The binary hierarchy is only needed until it has been collapsed
+  LinearBvh binary(object_to_world, src_objects, time_0, time_1,
+      max_prims_in_node, num_threads);
+
+  box_ = binary.box_;
+  primitives_ = std::move(binary.primitives_);
+  is_triangle_.resize(primitives_.size());
+  for (size_t i = 0; i < primitives_.size(); i++)
+    is_triangle_[i] = !binary.packet_triangle_index_.empty() && binary.packet_triangle_index_[i] >= 0;
+
+  // Each collapsed node replaces at least one binary interior node
+  nodes_.reserve(binary.nodes_.size() / 2 + 1);
+  if (binary.nodes_[0].n_primitives_ > 0) {
+    // A root leaf becomes a node with a single leaf child
+    CompressedBvhNode node = {};
+    node.n_children_ = 1;
+    quantize_children(node, &box_, 1);
+    node.child_n_primitives_[0] = binary.nodes_[0].n_primitives_;
+    node.child_offset_[0] = binary.nodes_[0].primitives_offset_;
+    nodes_.push_back(node);
+  } else {
+    collapse(binary.nodes_, 0, nodes_);
+  }
+  nodes_.shrink_to_fit();
+
+  nCompressedBvhNodes += nodes_.size();
+  nCompressedBvhBytes += memory_bytes();
+}
+
+bool CompressedBvh::object_space_hit(const Ray& r, double t_min, double t_max, hit_record& rec) const {
+  ++nCompressedBvhHitTests;
+
+  if (nodes_.empty())
+    return false;
+
+  Vector3d inv_dir(1.0 / r.dir_.x(), 1.0 / r.dir_.y(), 1.0 / r.dir_.z());
+  int dir_is_neg[3] = {inv_dir.x() < 0, inv_dir.y() < 0, inv_dir.z() < 0};
+
+  bool hit_anything = false;
+  const Triangle* closest_triangle = nullptr;
+  double closest_triangle_t = 0.0;
+  Vector3d closest_triangle_b;
+
+  // Entries are children still to visit, with the distance at which the
+  // ray enters their bounds so that they can be skipped once a closer hit
+  // is found
+  struct StackEntry {
+    double t_enter;
+    int32_t offset;
+    uint16_t n_primitives;
+  } to_visit[max_traversal_stack];
+  int to_visit_offset = 0;
+  to_visit[to_visit_offset++] = {t_min, 0, 0};
+
+  while (to_visit_offset > 0) {
+    StackEntry entry = to_visit[--to_visit_offset];
+    if (entry.t_enter > t_max)
+      continue;
+
+    if (entry.n_primitives > 0) {
+      for (int i = 0; i < entry.n_primitives; i++) {
+        int prim = entry.offset + i;
+
+        // Filling in triangle hit records is deferred until the closest
+        // intersection is known
+        if (is_triangle_[prim]) {
+          auto tri = static_cast<const Triangle*>(primitives_[prim].get());
+          double t;
+          Vector3d b;
+          if (tri->intersect(r, t_max, t, b)) {
+            hit_anything = true;
+            t_max = t;
+            closest_triangle = tri;
+            closest_triangle_t = t;
+            closest_triangle_b = b;
+          }
+        } else if (primitives_[prim]->hit(r, t_min, t_max, rec)) {
+          hit_anything = true;
+          t_max = rec.t;
+          closest_triangle = nullptr;
+        }
+      }
+
+      continue;
+    }
+
+    ++nCompressedBvhNodeVisits;
+    const CompressedBvhNode& node = nodes_[entry.offset];
+
+    // Slab test against each child's decoded bounds
+    double scale[3];
+    for (int i = 0; i < 3; i++)
+      scale[i] = std::ldexp(1.0, node.exponent_[i]);
+
+    StackEntry hits[4];
+    int n_hits = 0;
+    for (int c = 0; c < node.n_children_; c++) {
+      double t0 = t_min, t1 = t_max;
+      bool child_hit = true;
+      for (int i = 0; i < 3; i++) {
+        double lo = node.origin_[i] + node.child_min_[i][c] * scale[i];
+        double hi = node.origin_[i] + node.child_max_[i][c] * scale[i];
+        double near = ((dir_is_neg[i] ? hi : lo) - r.orig_[i]) * inv_dir[i];
+        double far = ((dir_is_neg[i] ? lo : hi) - r.orig_[i]) * inv_dir[i];
+
+        t0 = near > t0 ? near : t0;
+        t1 = far < t1 ? far : t1;
+
+        if (t1 < t0) {
+          child_hit = false;
+          break;
+        }
+      }
+
+      if (!child_hit)
+        continue;
+
+      // Insert in order of decreasing entry distance
+      int k = n_hits++;
+      for (; k > 0 && hits[k - 1].t_enter < t0; k--)
+        hits[k] = hits[k - 1];
+      hits[k] = {t0, node.child_offset_[c], node.child_n_primitives_[c]};
+    }
+
+    // The nearest child is pushed last, so that it is visited first
+    for (int k = 0; k < n_hits; k++)
+      to_visit[to_visit_offset++] = hits[k];
+  }
+
+  if (closest_triangle)
+    closest_triangle->finalize_hit(r, closest_triangle_t, closest_triangle_b, rec);
+
+  return hit_anything;
+}
+
+bool CompressedBvh::object_space_bounding_box(double /*time_0*/, double /*time_1*/, Aabb& output_box) const {
+  if (nodes_.empty())
+    return false;
+
+  output_box = box_;
+  return true;
+}
+
+Aabb CompressedBvh::child_bounds(const CompressedBvhNode& node, int child) {
+  Vector3d lo, hi;
+  for (int i = 0; i < 3; i++) {
+    double scale = std::ldexp(1.0, node.exponent_[i]);
+    lo[i] = node.origin_[i] + node.child_min_[i][child] * scale;
+    hi[i] = node.origin_[i] + node.child_max_[i][child] * scale;
+  }
+
+  return Aabb(lo, hi);
+}
+
+size_t CompressedBvh::memory_bytes() const {
+  return sizeof(CompressedBvh) + nodes_.capacity() * sizeof(CompressedBvhNode) +
+    primitives_.capacity() * sizeof(std::shared_ptr<Hittable>) +
+    (is_triangle_.size() + 7) / 8;
+}
@@ -0,0 +1,126 @@
+#pragma once
+#ifndef CANNON_RAY_COMPRESSED_BVH_H
+#define CANNON_RAY_COMPRESSED_BVH_H
+
+/*!
+ * \file cannon/ray/compressed_bvh.hpp
+ * \brief File containing CompressedBvh class definition, a four-wide
+ * bounding volume hierarchy with quantized child bounds.
+ */
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include <cannon/ray/hittable.hpp>
+#include <cannon/ray/aabb.hpp>
+#include <cannon/utils/class_forward.hpp>
+
+namespace cannon {
+  namespace ray {
+
+    CANNON_CLASS_FORWARD(HittableList);
+    CANNON_CLASS_FORWARD(CompressedBvh);
+
+    /*!
+     * \brief Struct representing a single node of a CompressedBvh, holding
+     * up to four children. Child bounds are stored as 8-bit offsets on a
+     * grid spanning the node's bounds, whose cells are a power of two wide
+     * along each axis so that decoding is exact. Quantization rounds
+     * outwards, so decoded bounds always contain the child. Each node fits
+     * in one 64-byte cache line.
+     */
+    struct alignas(64) CompressedBvhNode {
+      float origin_[3]; //!< Minimum corner of the quantization grid
+      int8_t exponent_[3]; //!< Base 2 logarithm of grid cell width along each axis
+      uint8_t n_children_; //!< Number of children, between 1 and 4
+
+      uint8_t child_min_[3][4]; //!< Quantized minimum corner of each child, per axis
+      uint8_t child_max_[3][4]; //!< Quantized maximum corner of each child, per axis
+
+      uint16_t child_n_primitives_[4]; //!< Number of primitives in each leaf child, 0 for interior children
+      int32_t child_offset_[4]; //!< Offset of each child's first primitive for leaves, or its node for interior children
+    };
+
+    static_assert(sizeof(CompressedBvhNode) == 64, "CompressedBvhNode should be 64 bytes");
+
+    /*!
+     * \brief Class representing a four-wide bounding volume hierarchy with
+     * quantized child bounds, for scenes where the memory used by the
+     * hierarchy matters. It is built by collapsing a binary LinearBvh,
+     * pulling the largest grandchildren up into each node, so it splits
+     * primitives the same way. A node takes 64 bytes and replaces about three
+     * 32-byte LinearBvh nodes, and each visit tests four boxes from a single
+     * cache line.
+     *
+     * Bounds are over the whole time interval, and packets are not
+     * supported, so LinearBvh remains preferable for moving primitives and
+     * camera rays.
+     */
+    class CompressedBvh : public Hittable {
+      public:
+
+        CompressedBvh() = delete;
+
+        /*!
+         * Constructor taking a HittableList and time interval, with the same
+         * arguments as LinearBvh.
+         */
+        CompressedBvh(std::shared_ptr<Affine3d> object_to_world, const
+            HittableListPtr list, double time_0, double time_1, unsigned int
+            max_prims_in_node = 4, unsigned int num_threads = 1);
+
+        /*!
+         * Constructor taking a vector of Hittables to include and a time
+         * interval, with the same arguments as LinearBvh.
+         */
+        CompressedBvh(std::shared_ptr<Affine3d> object_to_world, const
+            std::vector<std::shared_ptr<Hittable>>& src_objects, double time_0,
+            double time_1, unsigned int max_prims_in_node = 4, unsigned int
+            num_threads = 1);
+
+        /*!
+         * Destructor.
+         */
+        virtual ~CompressedBvh() {}
+
+        /*!
+         * Inherited from Hittable.
+         */
+        virtual bool object_space_hit(const Ray& r, double t_min, double t_max, hit_record& rec) const override;
+
+        /*!
+         * Inherited from Hittable.
+         */
+        virtual bool object_space_bounding_box(double time_0, double time_1, Aabb& output_box) const override;
+
+        /*!
+         * Decode the bounds of a child of a node.
+         *
+         * \param node The node holding the child.
+         * \param child Index of the child within the node.
+         *
+         * \returns Bounds containing the child.
+         */
+        static Aabb child_bounds(const CompressedBvhNode& node, int child);
+
+        /*!
+         * Compute the memory used by this hierarchy, excluding the
+         * primitives themselves.
+         *
+         * \returns The memory used, in bytes.
+         */
+        size_t memory_bytes() const;
+
+      public:
+        std::vector<std::shared_ptr<Hittable>> primitives_; //!< Primitives, ordered so that each leaf refers to a contiguous range
+        std::vector<CompressedBvhNode> nodes_; //!< Nodes in depth-first order, starting with the root
+        std::vector<bool> is_triangle_; //!< Whether each primitive is a Triangle, whose hit records can be deferred
+        Aabb box_; //!< Bounding box of the whole hierarchy
+
+    };
+
+  } // namespace ray
+} // namespace cannon
+
+#endif /* ifndef CANNON_RAY_COMPRESSED_BVH_H */
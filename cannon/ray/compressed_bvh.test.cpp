@@ -0,0 +1,97 @@
+#include <catch2/catch.hpp>
+
+#include <cannon/ray/compressed_bvh.hpp>
+#include <cannon/ray/linear_bvh.hpp>
+#include <cannon/ray/hittable_list.hpp>
+#include <cannon/ray/sphere.hpp>
+#include <cannon/ray/material.hpp>
+#include <cannon/ray/mesh.hpp>
+#include <cannon/ray/ray.hpp>
+#include <cannon/math/random_double.hpp>
+
+using namespace cannon::ray;
+using namespace cannon::math;
+
+TEST_CASE("CompressedBvh", "[ray]") {
+  auto mat = std::make_shared<Lambertian>(Vector3d(0.5, 0.5, 0.5));
+  auto t = std::make_shared<Affine3d>(Affine3d::Identity());
+
+  // Mix triangles, whose hit records are deferred, with analytic primitives
+  MatrixX3d vertices(3000, 3), normals(3000, 3);
+  MatrixX3u indices(1000, 3);
+  for (int i = 0; i < 1000; i++) {
+    Vector3d center = random_vec(-10, 10);
+    for (int j = 0; j < 3; j++) {
+      vertices.row(3 * i + j) = (center + random_vec(-1, 1)).transpose();
+      normals.row(3 * i + j) = Vector3d::UnitZ().transpose();
+      indices(i, j) = 3 * i + j;
+    }
+  }
+  auto mesh = std::make_shared<TriangleMesh>(t, mat, vertices, normals,
+      MatrixX2d::Zero(3000, 2), indices);
+  auto list = make_mesh_triangle_list(mesh);
+  for (int i = 0; i < 200; i++)
+    list->add(std::make_shared<Sphere>(random_vec(-10, 10), random_double(0.1, 1.0), mat));
+
+  CompressedBvh bvh(t, list, 0.0, 1.0);
+  LinearBvh linear(t, list, 0.0, 1.0);
+
+  REQUIRE(bvh.primitives_.size() == 1200);
+  REQUIRE(bvh.nodes_.size() < linear.nodes_.size() / 3);
+  REQUIRE(bvh.nodes_.size() * sizeof(CompressedBvhNode) < linear.nodes_.size() * sizeof(LinearBvhNode) * 3 / 4);
+  REQUIRE(bvh.memory_bytes() > bvh.nodes_.size() * sizeof(CompressedBvhNode));
+
+  // Every primitive should be referenced by exactly one leaf, within the
+  // decoded bounds of that leaf
+  unsigned int leaf_prims = 0;
+  for (auto& node : bvh.nodes_) {
+    REQUIRE(node.n_children_ >= 1);
+    REQUIRE(node.n_children_ <= 4);
+
+    for (int c = 0; c < node.n_children_; c++) {
+      Aabb child_box = CompressedBvh::child_bounds(node, c);
+      if (node.child_n_primitives_[c] == 0)
+        continue;
+
+      leaf_prims += node.child_n_primitives_[c];
+      for (int p = 0; p < node.child_n_primitives_[c]; p++) {
+        Aabb prim_box;
+        REQUIRE(bvh.primitives_[node.child_offset_[c] + p]->bounding_box(0.0, 1.0, prim_box));
+        REQUIRE((child_box.minimum_.array() <= prim_box.minimum_.array()).all());
+        REQUIRE((child_box.maximum_.array() >= prim_box.maximum_.array()).all());
+      }
+    }
+  }
+  REQUIRE(leaf_prims == 1200);
+
+  // Closest hits should agree with brute-force intersection
+  for (int i = 0; i < 1000; i++) {
+    Ray r(random_vec(-15, 15), random_unit_vec());
+
+    hit_record list_rec, bvh_rec;
+    bool list_hit = list->hit(r, 0.001, std::numeric_limits<double>::infinity(), list_rec);
+    bool bvh_hit = bvh.hit(r, 0.001, std::numeric_limits<double>::infinity(), bvh_rec);
+
+    REQUIRE(list_hit == bvh_hit);
+    if (list_hit) {
+      REQUIRE(list_rec.t == Approx(bvh_rec.t));
+      REQUIRE(list_rec.p.isApprox(bvh_rec.p));
+    }
+  }
+
+  // A single primitive makes a root with one leaf child
+  auto single = std::make_shared<HittableList>();
+  single->add(std::make_shared<Sphere>(Vector3d::Zero(), 1.0, mat));
+  CompressedBvh single_bvh(t, single, 0.0, 1.0);
+  hit_record rec;
+  REQUIRE(single_bvh.nodes_.size() == 1);
+  REQUIRE(single_bvh.nodes_[0].n_children_ == 1);
+  REQUIRE(single_bvh.hit(Ray(Vector3d(0, 0, -5), Vector3d::UnitZ()), 0.001, 10.0, rec));
+  REQUIRE(rec.t == Approx(4.0));
+
+  // Empty hierarchies have no bounding box and are never hit
+  CompressedBvh empty(t, std::make_shared<HittableList>(), 0.0, 1.0);
+  Aabb empty_box;
+  REQUIRE(!empty.bounding_box(0.0, 1.0, empty_box));
+  REQUIRE(!empty.hit(Ray(Vector3d::Zero(), Vector3d::Ones()), 0.0, 1.0, rec));
+}
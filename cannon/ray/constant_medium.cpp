@@ -1,5 +1,8 @@
 #include <cannon/ray/constant_medium.hpp>
 
+#include <algorithm>
+#include <limits>
+
 #include <cannon/ray/material.hpp>
 #include <cannon/ray/ray.hpp>
 
@@ -14,45 +17,55 @@ ConstantMedium::ConstantMedium(std::shared_ptr<Hittable> b, double d, const
   phase_function_(std::make_shared<Isotropic>(c)) {}
 
 bool ConstantMedium::object_space_hit(const Ray& r, double t_min, double t_max, hit_record& rec) const {
-  hit_record rec1, rec2;
-
-  // Initial hit
-  if (!boundary_->hit(r, -std::numeric_limits<double>::infinity(),
-        std::numeric_limits<double>::infinity(), rec1))
-    return false;
-
-  // Hit another side of boundary (Note this assumes convex geometry)
-  if (!boundary_->hit(r, rec1.t + 1e-3,
-        std::numeric_limits<double>::infinity(), rec2))
-    return false;
-
-  if (rec1.t < t_min)
-    rec1.t = t_min;
-
-  if (rec2.t > t_max)
-    rec2.t = t_max;
-
-  if (rec1.t >= rec2.t)
+  // The first boundary crossing after t_min tells whether the ray starts
+  // inside the medium, so it is the only search not bounded by t_max
+  hit_record crossing;
+  if (!boundary_->hit(r, t_min, std::numeric_limits<double>::infinity(), crossing))
     return false;
 
-  if (rec1.t < 0)
-    rec1.t = 0;
+  bool inside = !crossing.front_face;
+  double t = t_min;
+  double t_crossing = crossing.t;
 
   const auto ray_length = r.dir_.norm();
-  const auto distance_inside_boundary = (rec2.t - rec1.t) * ray_length;
-  
-  // Random scattering distance
-  const auto hit_distance = neg_inv_density_ * std::log(random_double());
-
-  if (hit_distance > distance_inside_boundary)
-    return false;
 
-  rec.t = rec1.t + hit_distance / ray_length;
+  // Random scattering distance, spent over however many stretches of the
+  // ray lie inside the boundary, so that boundaries need not be convex
+  auto hit_distance = neg_inv_density_ * std::log(random_double());
+
+  while (true) {
+    double t_end = std::min(t_crossing, t_max);
+    if (inside) {
+      const auto distance_inside_boundary = (t_end - t) * ray_length;
+      if (hit_distance < distance_inside_boundary)
+        break;
+
+      hit_distance -= distance_inside_boundary;
+    }
+
+    if (t_crossing >= t_max)
+      return false;
+
+    // Continue from just past the crossing, so that it is not found again
+    t = t_crossing;
+    inside = crossing.front_face;
+    Ray next = crossing.spawn_ray(r.dir_, r.time_);
+    if (boundary_->hit(next, 0.0, t_max - t, crossing))
+      t_crossing = t + crossing.t;
+    else
+      t_crossing = std::numeric_limits<double>::infinity();
+  }
+
+  rec.t = t + hit_distance / ray_length;
   rec.p = r.at(rec.t);
+  rec.p_error = Vector3d::Zero(); // Scattering is not off a surface, so needs no offset
 
   rec.normal = Vector3d(1, 0, 0); // Arbitrary
+  rec.geometric_normal = rec.normal;
+  rec.dpdu = Vector3d::Zero();
+  rec.dpdv = Vector3d::Zero();
   rec.front_face = true;          // Arbitrary
-  rec.mat_ptr = phase_function_;
+  rec.mat_ptr = phase_function_.get();
 
   return true;
 }
@@ -16,6 +16,12 @@ namespace cannon {
     CANNON_CLASS_FORWARD(Texture);
     CANNON_CLASS_FORWARD(Material);
 
+    /*!
+     * \brief Class representing a homogeneous scattering medium filling a
+     * closed boundary, which need not be convex. Scattering distances are
+     * sampled from an exponential distribution over the stretches of a ray
+     * inside the boundary.
+     */
     class ConstantMedium : public Hittable {
       public:
 
@@ -1,7 +1,53 @@
+#include <cmath>
+#include <limits>
+
 #include <catch2/catch.hpp> 
 
 #include <cannon/ray/constant_medium.hpp>
+#include <cannon/ray/hittable_list.hpp>
+#include <cannon/ray/ray.hpp>
+#include <cannon/ray/sphere.hpp>
+
+using namespace cannon::ray;
 
 TEST_CASE("ConstantMedium", "[ray]") {
+  // A boundary of two disjoint spheres, which is not convex
+  auto boundary = std::make_shared<HittableList>();
+  boundary->add(std::make_shared<Sphere>(Vector3d(0, 0, 0), 1, nullptr));
+  boundary->add(std::make_shared<Sphere>(Vector3d(4, 0, 0), 1, nullptr));
+
+  ConstantMedium medium(boundary, 0.5, Vector3d(0.5, 0.5, 0.5));
+
+  // The ray passes through four units of medium in total
+  Ray r(Vector3d(-5, 0, 0), Vector3d(1, 0, 0));
+  const int n = 20000;
+  int misses = 0;
+  int second_sphere_hits = 0;
+  for (int i = 0; i < n; i++) {
+    hit_record rec;
+    if (!medium.hit(r, 0.0, std::numeric_limits<double>::infinity(), rec)) {
+      misses++;
+      continue;
+    }
+
+    bool in_first = rec.t >= 4.0 && rec.t <= 6.0;
+    bool in_second = rec.t >= 8.0 && rec.t <= 10.0;
+    REQUIRE((in_first || in_second));
+    if (in_second)
+      second_sphere_hits++;
+  }
+
+  REQUIRE(static_cast<double>(misses) / n == Approx(std::exp(-2.0)).margin(0.015));
+  REQUIRE(static_cast<double>(second_sphere_hits) / n ==
+      Approx(std::exp(-1.0) - std::exp(-2.0)).margin(0.015));
+
+  // Rays starting inside the boundary scatter before leaving it
+  ConstantMedium dense(boundary, 1e6, Vector3d(0.5, 0.5, 0.5));
+  hit_record rec;
+  Ray inside(Vector3d(0, 0, 0), Vector3d(0, 1, 0));
+  REQUIRE(dense.hit(inside, 0.0, std::numeric_limits<double>::infinity(), rec));
+  REQUIRE(rec.t < 1e-3);
 
+  // Segments ending before the boundary never scatter
+  REQUIRE_FALSE(dense.hit(r, 0.0, 3.9, rec));
 }
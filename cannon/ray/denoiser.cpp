@@ -0,0 +1,145 @@
+#include <cannon/ray/denoiser.hpp>
+
+#include <cmath>
+#include <stdexcept>
+
+#include <cannon/utils/parallel_for.hpp>
+#include <cannon/utils/statistics.hpp>
+
+using namespace cannon::ray;
+using namespace cannon::utils;
+
+STAT_COUNTER("Denoiser/Pixels filtered", nDenoisedPixels);
+
+static constexpr double albedo_epsilon = 1e-3; //!< Smallest albedo divided out of colors
+static constexpr double atrous_kernel[5] = {1.0 / 16, 1.0 / 4, 3.0 / 8, 1.0 / 4, 1.0 / 16}; //!< B3-spline taps
+
+/*!
+ * Get the factor a color is divided by to remove albedo. Channels with
+ * (nearly) zero albedo, such as the background, are left as they are.
+ */
+static Vector3d demodulation_factor(const Vector3d& albedo) {
+  Vector3d factor;
+  for (int c = 0; c < 3; c++)
+    factor[c] = albedo[c] > albedo_epsilon ? albedo[c] : 1.0;
+
+  return factor;
+}
+
+std::vector<Vector3d> cannon::ray::denoise_atrous(unsigned int width,
+    unsigned int height, const std::vector<Vector3d>& color, const
+    std::vector<double>& variance, const std::vector<FilmFeatures>& features,
+    const DenoiserParams& params, unsigned int num_threads) {
+  size_t num_pixels = static_cast<size_t>(width) * height;
+  if (color.size() != num_pixels || variance.size() != num_pixels || features.size() != num_pixels)
+    throw std::runtime_error("Denoiser inputs do not match image dimensions");
+
+  // Filter illumination rather than color, so that albedo edges stay sharp.
+  // Light seen directly is not noisy, but is far brighter than its
+  // surroundings, so it is taken out before filtering and added back after.
+  std::vector<Vector3d> factors(num_pixels);
+  std::vector<Vector3d> illum(num_pixels);
+  std::vector<double> illum_var(num_pixels);
+  for (size_t i = 0; i < num_pixels; i++) {
+    factors[i] = demodulation_factor(features[i].albedo);
+    illum[i] = (color[i] - features[i].emission).cwiseQuotient(factors[i]);
+
+    double l = luminance(factors[i]);
+    illum_var[i] = variance[i] / (l * l);
+  }
+
+  std::vector<Vector3d> next_illum(num_pixels);
+  std::vector<double> next_var(num_pixels);
+  std::vector<double> blurred_var(num_pixels);
+
+  for (int iteration = 0; iteration < params.iterations; iteration++) {
+    int step = 1 << iteration;
+
+    // Variance estimates are themselves noisy, so the luminance weights use
+    // a 3x3 blur of them
+    parallel_for(0, height, num_threads, [&](size_t row_begin, size_t row_end) {
+        for (size_t y = row_begin; y < row_end; y++) {
+          for (int x = 0; x < static_cast<int>(width); x++) {
+            double sum = 0.0, weight_sum = 0.0;
+            for (int dy = -1; dy <= 1; dy++) {
+              for (int dx = -1; dx <= 1; dx++) {
+                int qx = x + dx, qy = static_cast<int>(y) + dy;
+                if (qx < 0 || qy < 0 || qx >= static_cast<int>(width) || qy >= static_cast<int>(height))
+                  continue;
+
+                double w = (dx == 0 ? 0.5 : 0.25) * (dy == 0 ? 0.5 : 0.25);
+                sum += w * illum_var[qy * width + qx];
+                weight_sum += w;
+              }
+            }
+
+            blurred_var[y * width + x] = sum / weight_sum;
+          }
+        }
+        });
+
+    parallel_for(0, height, num_threads, [&](size_t row_begin, size_t row_end) {
+        for (size_t y = row_begin; y < row_end; y++) {
+          for (int x = 0; x < static_cast<int>(width); x++) {
+            size_t p = y * width + x;
+            const FilmFeatures& fp = features[p];
+            double l_p = luminance(illum[p]);
+            double color_scale = params.color_sigma * std::sqrt(blurred_var[p]) + 1e-6;
+
+            Vector3d sum = Vector3d::Zero();
+            double var_sum = 0.0, weight_sum = 0.0;
+            for (int ky = 0; ky < 5; ky++) {
+              int qy = static_cast<int>(y) + (ky - 2) * step;
+              if (qy < 0 || qy >= static_cast<int>(height))
+                continue;
+
+              for (int kx = 0; kx < 5; kx++) {
+                int qx = x + (kx - 2) * step;
+                if (qx < 0 || qx >= static_cast<int>(width))
+                  continue;
+
+                size_t q = static_cast<size_t>(qy) * width + qx;
+                const FilmFeatures& fq = features[q];
+
+                // Background pixels have no normal, and only blend with
+                // other background pixels
+                double w_normal;
+                if (fp.normal.isZero() || fq.normal.isZero())
+                  w_normal = fp.normal.isZero() && fq.normal.isZero() ? 1.0 : 0.0;
+                else
+                  w_normal = std::pow(std::max(0.0, fp.normal.dot(fq.normal)), params.normal_power);
+
+                double distance = step * std::sqrt((kx - 2) * (kx - 2) + (ky - 2) * (ky - 2));
+                double w_depth = std::exp(-std::fabs(fp.depth - fq.depth) /
+                    (params.depth_sigma * fp.depth * distance + 1e-6));
+                double w_albedo = std::exp(-(fp.albedo - fq.albedo).squaredNorm() /
+                    (params.albedo_sigma * params.albedo_sigma));
+                double w_color = std::exp(-std::fabs(l_p - luminance(illum[q])) / color_scale);
+
+                double w = atrous_kernel[kx] * atrous_kernel[ky] * w_normal * w_depth * w_albedo * w_color;
+                sum += w * illum[q];
+                var_sum += w * w * illum_var[q];
+                weight_sum += w;
+              }
+            }
+
+            // The center tap always has full feature and color weight, so
+            // the weight sum is never zero
+            next_illum[p] = sum / weight_sum;
+            next_var[p] = var_sum / (weight_sum * weight_sum);
+          }
+        }
+        });
+
+    std::swap(illum, next_illum);
+    std::swap(illum_var, next_var);
+  }
+
+  nDenoisedPixels += num_pixels;
+
+  std::vector<Vector3d> denoised(num_pixels);
+  for (size_t i = 0; i < num_pixels; i++)
+    denoised[i] = illum[i].cwiseProduct(factors[i]) + features[i].emission;
+
+  return denoised;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#ifndef CANNON_RAY_DENOISER_H
+#define CANNON_RAY_DENOISER_H
+
+/*!
+ * \file cannon/ray/denoiser.hpp
+ * \brief File containing an edge-avoiding a-trous wavelet denoiser for
+ * rendered images.
+ */
+
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <cannon/ray/film.hpp>
+
+using namespace Eigen;
+
+namespace cannon {
+  namespace ray {
+
+    /*!
+     * \brief Struct containing denoiser settings.
+     */
+    struct DenoiserParams {
+      int iterations = 5; //!< Number of a-trous passes, each doubling the filter footprint
+      double color_sigma = 2.0; //!< Luminance difference tolerated between pixels, in standard deviations of luminance noise
+      double normal_power = 64.0; //!< Exponent applied to the cosine between pixel normals
+      double albedo_sigma = 0.1; //!< Albedo difference tolerated between pixels
+      double depth_sigma = 0.05; //!< Relative depth difference tolerated per pixel of distance
+    };
+
+    // Public Functions
+
+    /*!
+     * Compute the luminance of a linear RGB color, with Rec. 709 weights.
+     *
+     * \param color The color.
+     *
+     * \returns The luminance.
+     */
+    inline double luminance(const Vector3d& color) {
+      return 0.2126 * color.x() + 0.7152 * color.y() + 0.0722 * color.z();
+    }
+
+    /*!
+     * Denoise an image with an edge-avoiding a-trous wavelet filter, as in
+     * Dammertz et al. 2010 and Schied et al. 2017 (SVGF). Emission seen
+     * directly is subtracted from colors, which are divided by albedo so
+     * that texture detail is not blurred, then
+     * filtered by repeated 5x5 B-spline passes with doubling tap spacing.
+     * Each tap is weighted by how similar its normal, depth, and albedo
+     * are to the center pixel's, and by its luminance difference relative
+     * to the noise remaining in the center pixel, which is tracked through
+     * every pass. Finally the albedo is multiplied back in and the emission
+     * added back.
+     *
+     * \param width Width of the image.
+     * \param height Height of the image.
+     * \param color Linear colors, top row first.
+     * \param variance Variance of each pixel's luminance, as an estimate of
+     * the pixel's mean.
+     * \param features Features of each pixel.
+     * \param params Denoiser settings.
+     * \param num_threads Number of threads to filter rows with.
+     *
+     * \returns Denoised linear colors, top row first.
+     */
+    std::vector<Vector3d> denoise_atrous(unsigned int width, unsigned int
+        height, const std::vector<Vector3d>& color, const std::vector<double>&
+        variance, const std::vector<FilmFeatures>& features, const
+        DenoiserParams& params, unsigned int num_threads = 1);
+
+  } // namespace ray
+} // namespace cannon
+
+#endif /* ifndef CANNON_RAY_DENOISER_H */
@@ -0,0 +1,69 @@
+#include <catch2/catch.hpp>
+
+#include <cannon/ray/denoiser.hpp>
+#include <cannon/math/random_double.hpp>
+#include <cannon/math/rng.hpp>
+
+using namespace cannon::ray;
+using namespace cannon::math;
+
+TEST_CASE("Denoiser", "[ray]") {
+  // Two walls meeting down the middle of the image, each uniformly lit but
+  // rendered with noise, and the right one textured with stripes
+  const unsigned int width = 32, height = 16;
+  const double noise = 0.2;
+  Rng rng(3);
+
+  std::vector<Vector3d> truth(width * height), color(width * height);
+  std::vector<double> variance(width * height, noise * noise / 3);
+  std::vector<FilmFeatures> features(width * height);
+  for (unsigned int y = 0; y < height; y++) {
+    for (unsigned int x = 0; x < width; x++) {
+      size_t p = y * width + x;
+      bool left = x < width / 2;
+
+      features[p].albedo = left ? Vector3d::Constant(0.8) :
+        Vector3d::Constant(y % 2 == 0 ? 0.2 : 0.6);
+      features[p].normal = left ? Vector3d::UnitX() : Vector3d::UnitZ();
+      features[p].depth = 5.0;
+
+      truth[p] = features[p].albedo * (left ? 1.0 : 0.5);
+      color[p] = truth[p] + Vector3d::Constant(noise * (2 * random_double(rng) - 1));
+    }
+  }
+
+  DenoiserParams params;
+  auto denoised = denoise_atrous(width, height, color, variance, features, params, 2);
+  REQUIRE(denoised.size() == color.size());
+
+  double noisy_error = 0.0, denoised_error = 0.0;
+  for (size_t p = 0; p < truth.size(); p++) {
+    noisy_error += (color[p] - truth[p]).squaredNorm();
+    denoised_error += (denoised[p] - truth[p]).squaredNorm();
+  }
+
+  REQUIRE(denoised_error < 0.1 * noisy_error);
+
+  // Neither the edge between walls nor the stripes are blurred
+  double stripe_sums[2] = {0.0, 0.0};
+  for (unsigned int y = 0; y < height; y++) {
+    REQUIRE(denoised[y * width + width / 2 - 1].x() == Approx(0.8).margin(0.1));
+    stripe_sums[y % 2] += denoised[y * width + width / 2].x();
+  }
+
+  REQUIRE(stripe_sums[0] / (height / 2) == Approx(0.1).margin(0.03));
+  REQUIRE(stripe_sums[1] / (height / 2) == Approx(0.3).margin(0.03));
+
+  // Multithreaded filtering matches single-threaded filtering
+  auto serial = denoise_atrous(width, height, color, variance, features, params, 1);
+  for (size_t p = 0; p < truth.size(); p++)
+    REQUIRE(serial[p] == denoised[p]);
+
+  // Noiseless images are left as they are
+  auto clean = denoise_atrous(width, height, truth, std::vector<double>(width
+        * height, 0.0), features, params);
+  for (size_t p = 0; p < truth.size(); p++)
+    REQUIRE(clean[p].isApprox(truth[p]));
+
+  REQUIRE_THROWS(denoise_atrous(width, height - 1, color, variance, features, params));
+}
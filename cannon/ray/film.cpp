@@ -1,16 +1,88 @@
 #include <cannon/ray/film.hpp>
 
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <fstream>
 #include <cmath>
+#include <limits>
+#include <stdexcept>
 
+#include <cannon/ray/denoiser.hpp>
 #include <cannon/ray/filter.hpp>
+#include <cannon/ray/hdr_image.hpp>
 #include <cannon/log/registry.hpp>
 
 using namespace cannon::ray;
 using namespace cannon::log;
 
-void FilmTile::add_sample(const Vector2d& p_film, const Vector3d& color) {
+void FilmPixel::add_sample_statistics(const Vector3d& color) {
+  sample_count_++;
+  Vector3d delta = color - sample_mean_;
+  sample_mean_ += delta / sample_count_;
+  sample_m2_ += (delta.array() * (color - sample_mean_).array()).matrix();
+}
+
+void FilmPixel::merge_sample_statistics(const FilmPixel& other) {
+  if (other.sample_count_ == 0)
+    return;
+
+  // Parallel combination of running variance, as in Chan et al.
+  double n_a = sample_count_;
+  double n_b = other.sample_count_;
+  double n = n_a + n_b;
+
+  Vector3d delta = other.sample_mean_ - sample_mean_;
+  sample_mean_ += delta * (n_b / n);
+  sample_m2_ += other.sample_m2_ + (delta.array().square() * (n_a * n_b / n)).matrix();
+  sample_count_ += other.sample_count_;
+}
+
+Vector3d FilmPixel::variance() const {
+  if (sample_count_ < 2)
+    return Vector3d::Zero();
+
+  return sample_m2_ / (sample_count_ - 1);
+}
+
+double FilmPixel::relative_error() const {
+  if (sample_count_ < 2)
+    return std::numeric_limits<double>::infinity();
+
+  double std_error = std::sqrt(variance().sum() / sample_count_);
+  return std_error / std::max(sample_mean_.sum(), 1e-3);
+}
+
+void FilmPixel::add_features(const FilmFeatures& features, double filter_weight) {
+  feature_weight_sum_ += filter_weight;
+  albedo_sum_ += features.albedo * filter_weight;
+  normal_sum_ += features.normal * filter_weight;
+  depth_sum_ += features.depth * filter_weight;
+  emission_sum_ += features.emission * filter_weight;
+}
+
+FilmFeatures FilmPixel::features() const {
+  FilmFeatures features;
+  if (feature_weight_sum_ == 0.0)
+    return features;
+
+  features.albedo = albedo_sum_ / feature_weight_sum_;
+  features.normal = normal_sum_.stableNormalized();
+  features.depth = depth_sum_ / feature_weight_sum_;
+  features.emission = emission_sum_ / feature_weight_sum_;
+  return features;
+}
+
+void FilmTile::add_sample(const Vector2d& p_film, const Vector3d& color, const
+    FilmFeatures* features) {
+  // Track variance in the pixel that this sample was taken for
+  Vector2i p_pixel = p_film.array().floor().matrix().cast<int>();
+  if (p_pixel.x() >= (int)origin_x_ && p_pixel.x() < (int)(origin_x_ + extent_x_) &&
+      p_pixel.y() >= (int)origin_y_ && p_pixel.y() < (int)(origin_y_ + extent_y_)) {
+    FilmPixel& pixel = get_pixel(p_pixel.x(), p_pixel.y());
+    pixel.add_sample_statistics(color);
+  }
+
   // Compute sample raster bounds
   Vector2d p_film_discrete = p_film - Vector2d(0.5, 0.5);
   Vector2i p0 = (p_film_discrete - filter_radius_).array().ceil().matrix().cast<int>();
@@ -34,6 +106,8 @@ void FilmTile::add_sample(const Vector2d& p_film, const Vector3d& color) {
       FilmPixel& pixel = get_pixel(i, j);
       pixel.color_sum_ += color * filter_weight;
       pixel.filter_weight_sum_ += filter_weight;
+      if (features)
+        pixel.add_features(*features, filter_weight);
     }
   }
 }
@@ -47,6 +121,11 @@ Film::Film(unsigned int width, unsigned int height, unsigned int tile_size,
     : width_(width), height_(height), tile_size_(tile_size),
       pixels_(width * height), filter_(std::move(filter)) {
 
+  Vector2i tiles = num_tiles();
+  dirty_tiles_.reset(new std::atomic<bool>[tiles.x() * tiles.y()]);
+  for (int i = 0; i < tiles.x() * tiles.y(); i++)
+    dirty_tiles_[i] = false;
+
   // Precompute cached filter weights
   int offset = 0;
   for (int j = 0; j < filter_table_width_; j++) {
@@ -59,19 +138,84 @@ Film::Film(unsigned int width, unsigned int height, unsigned int tile_size,
   }
 }
 
+/*!
+ * Compute the range of pixels along one axis covered by tile i, which
+ * includes pixels within the filter radius of those sampled for the tile.
+ */
+static void tile_range(int i, unsigned int tile_size, double radius, unsigned
+    int size, unsigned int& origin, unsigned int& extent) {
+  origin = std::max(0.0, std::ceil(i * tile_size - 0.5 - radius));
+  extent = tile_size + (2 * radius);
+  if ((origin + extent) >= size)
+    extent = size - origin;
+}
+
+/*!
+ * Compute the range of pixels along one axis covered by tile i and by no
+ * other tile. Tiles are ordered along the axis, so only the neighboring tiles
+ * need to be checked.
+ */
+static void tile_interior_range(int i, int num_tiles, unsigned int tile_size,
+    double radius, unsigned int size, unsigned int& origin, unsigned int& extent) {
+  unsigned int tile_origin, tile_extent;
+  tile_range(i, tile_size, radius, size, tile_origin, tile_extent);
+
+  unsigned int begin = tile_origin;
+  unsigned int end = tile_origin + tile_extent;
+
+  if (i > 0) {
+    unsigned int prev_origin, prev_extent;
+    tile_range(i - 1, tile_size, radius, size, prev_origin, prev_extent);
+    begin = std::max(begin, prev_origin + prev_extent);
+  }
+
+  if (i + 1 < num_tiles) {
+    unsigned int next_origin, next_extent;
+    tile_range(i + 1, tile_size, radius, size, next_origin, next_extent);
+    end = std::min(end, next_origin);
+  }
+
+  if (end > begin) {
+    origin = begin;
+    extent = end - begin;
+  } else {
+    origin = tile_origin;
+    extent = 0;
+  }
+}
+
+/*!
+ * Add the samples and statistics accumulated in one pixel to another.
+ */
+static void merge_pixel(FilmPixel& dst, const FilmPixel& src) {
+  dst.color_sum_ += src.color_sum_;
+  dst.filter_weight_sum_ += src.filter_weight_sum_;
+  dst.merge_sample_statistics(src);
+
+  dst.feature_weight_sum_ += src.feature_weight_sum_;
+  dst.albedo_sum_ += src.albedo_sum_;
+  dst.normal_sum_ += src.normal_sum_;
+  dst.depth_sum_ += src.depth_sum_;
+  dst.emission_sum_ += src.emission_sum_;
+}
+
 std::unique_ptr<FilmTile> Film::get_film_tile(int i, int j) const {
   auto tile = std::make_unique<FilmTile>();
 
+  tile->sample_origin_x_ = i * tile_size_;
+  tile->sample_extent_x_ = std::min(tile_size_, width_ - tile->sample_origin_x_);
+  tile->sample_origin_y_ = j * tile_size_;
+  tile->sample_extent_y_ = std::min(tile_size_, height_ - tile->sample_origin_y_);
+
   // Extend tile to include filter sampling radius
-  tile->origin_x_ = std::max(0.0, std::ceil(i * tile_size_ - 0.5 - filter_->radius_.x()));
-  tile->extent_x_ = tile_size_ + (2 * filter_->radius_.x());
-  if ((tile->origin_x_ + tile->extent_x_) >= width_)
-    tile->extent_x_ = width_ - tile->origin_x_;
+  tile_range(i, tile_size_, filter_->radius_.x(), width_, tile->origin_x_, tile->extent_x_);
+  tile_range(j, tile_size_, filter_->radius_.y(), height_, tile->origin_y_, tile->extent_y_);
 
-  tile->origin_y_ = std::max(0.0, std::ceil(j * tile_size_ - 0.5 - filter_->radius_.y()));
-  tile->extent_y_ = tile_size_ + (2 * filter_->radius_.y());
-  if ((tile->origin_y_ + tile->extent_y_) >= height_)
-    tile->extent_y_ = height_ - tile->origin_y_;
+  Vector2i tiles = num_tiles();
+  tile_interior_range(i, tiles.x(), tile_size_, filter_->radius_.x(), width_,
+      tile->interior_origin_x_, tile->interior_extent_x_);
+  tile_interior_range(j, tiles.y(), tile_size_, filter_->radius_.y(), height_,
+      tile->interior_origin_y_, tile->interior_extent_y_);
 
   tile->filter_radius_ = filter_->radius_;
   tile->inv_filter_radius_ = filter_->inv_radius_;
@@ -84,37 +228,317 @@ std::unique_ptr<FilmTile> Film::get_film_tile(int i, int j) const {
 }
 
 void Film::merge_film_tile(std::unique_ptr<FilmTile> tile) {
-  std::lock_guard<std::mutex> lock(mut_);
+  for (unsigned int j = 0; j < tile->extent_y_; j++) {
+    unsigned int pixel_y = tile->origin_y_ + j;
+
+    // Image rows are stored top to bottom
+    FilmPixel* dst_row = &pixels_[(height_ - pixel_y - 1) * width_ + tile->origin_x_];
+    const FilmPixel* src_row = &tile->pixels_[j * tile->extent_x_];
 
-  for (unsigned int i = 0; i < tile->extent_x_; i++) {
-    for (unsigned int j = 0; j < tile->extent_y_; j++) {
-      int pixel_x = tile->origin_x_ + i;
-      int pixel_y = tile->origin_y_ + j;
+    // Columns [begin, end) of this row are covered only by this tile
+    unsigned int begin = tile->extent_x_;
+    unsigned int end = tile->extent_x_;
+    if (pixel_y >= tile->interior_origin_y_ &&
+        pixel_y < tile->interior_origin_y_ + tile->interior_extent_y_) {
+      begin = tile->interior_origin_x_ - tile->origin_x_;
+      end = begin + tile->interior_extent_x_;
+    }
+
+    for (unsigned int i = begin; i < end; i++)
+      merge_pixel(dst_row[i], src_row[i]);
 
-      pixels_[(height_ - pixel_y - 1) * width_ + pixel_x].color_sum_ += tile->pixels_[j * tile->extent_x_ + i].color_sum_;
-      pixels_[(height_ - pixel_y - 1) * width_ + pixel_x].filter_weight_sum_ += tile->pixels_[j * tile->extent_x_ + i].filter_weight_sum_;
+    if (begin > 0 || end < tile->extent_x_) {
+      std::lock_guard<std::mutex> lock(row_locks_[pixel_y % num_row_locks_]);
+
+      for (unsigned int i = 0; i < begin; i++)
+        merge_pixel(dst_row[i], src_row[i]);
+      for (unsigned int i = end; i < tile->extent_x_; i++)
+        merge_pixel(dst_row[i], src_row[i]);
+    }
+  }
+
+  // Mark every tile whose sampled pixels this tile touched for display
+  Vector2i tiles = num_tiles();
+  for (unsigned int j = tile->origin_y_ / tile_size_; j <= (tile->origin_y_ +
+        tile->extent_y_ - 1) / tile_size_; j++) {
+    for (unsigned int i = tile->origin_x_ / tile_size_; i <= (tile->origin_x_ +
+          tile->extent_x_ - 1) / tile_size_; i++) {
+      dirty_tiles_[j * tiles.x() + i] = true;
     }
   }
 }
 
-void Film::write_image(const std::string& filename) {
-  std::lock_guard<std::mutex> lock(mut_);
-  std::ofstream image_file(filename);
+const FilmPixel& Film::get_pixel(unsigned int x, unsigned int y) const {
+  return pixels_[(height_ - y - 1) * width_ + x];
+}
+
+Vector2i Film::num_tiles() const {
+  return Vector2i((width_ + tile_size_ - 1) / tile_size_,
+      (height_ + tile_size_ - 1) / tile_size_);
+}
+
+/*!
+ * Write pixels to the input file, in a format chosen by extension as in
+ * Film::write_image().
+ */
+static void write_pixels(const std::string& filename, const std::vector<FilmPixel>& pixels,
+    unsigned int width, unsigned int height) {
+  std::ofstream image_file(filename, std::ios::binary);
+  if (!image_file)
+    throw std::runtime_error("Could not open " + filename + " for writing");
+
+  auto has_extension = [&](const std::string& ext) {
+    return filename.size() >= ext.size() &&
+      filename.compare(filename.size() - ext.size(), ext.size(), ext) == 0;
+  };
+
+  if (has_extension(".pfm")) {
+    write_pfm(image_file, pixels, width, height);
+  } else if (has_extension(".cfilm")) {
+    write_film_channels(image_file, pixels, width, height);
+  } else {
+    if (!has_extension(".ppm"))
+      log_warning("Unrecognized image extension for", filename, ", writing PPM");
+    write_ppm_binary(image_file, pixels, width, height);
+  }
 
-  image_file << "P3\n" << width_ << ' ' << height_ << "\n255\n";
-  write_colors(image_file, pixels_);
   image_file.flush();
 }
 
+/*!
+ * Make film pixels holding the input colors, with unit filter weight.
+ */
+static std::vector<FilmPixel> make_pixels(const std::vector<Vector3d>& colors) {
+  std::vector<FilmPixel> pixels(colors.size());
+  for (size_t i = 0; i < colors.size(); i++) {
+    pixels[i].color_sum_ = colors[i];
+    pixels[i].filter_weight_sum_ = 1.0;
+  }
+
+  return pixels;
+}
+
+void Film::write_image(const std::string& filename) {
+  write_pixels(filename, pixels_, width_, height_);
+}
+
+static constexpr int checkpoint_pixel_values = 11; //!< Doubles saved per pixel for colors and statistics
+static constexpr int checkpoint_feature_values = 11; //!< Doubles saved per pixel for features
+
+/*!
+ * Store a double as eight little-endian bytes.
+ */
+static void put_double(unsigned char* dst, double value) {
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  for (int i = 0; i < 8; i++)
+    dst[i] = (bits >> (8 * i)) & 0xff;
+}
+
+/*!
+ * Load a double stored by put_double().
+ */
+static double get_double(const unsigned char* src) {
+  uint64_t bits = 0;
+  for (int i = 0; i < 8; i++)
+    bits |= static_cast<uint64_t>(src[i]) << (8 * i);
+
+  double value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+/*!
+ * Read a checkpoint header from the input stream, leaving it at the start
+ * of the pixel data.
+ */
+static FilmCheckpointInfo read_checkpoint_header(std::istream& is, const std::string& filename) {
+  std::string magic;
+  FilmCheckpointInfo info;
+  is >> magic >> info.width >> info.height >> info.first_sample >>
+    info.num_samples >> info.has_features;
+  if (!is || magic != "CFILMSTATE")
+    throw std::runtime_error(filename + " is not a film checkpoint");
+
+  // Single newline before binary data
+  is.get();
+  return info;
+}
+
+FilmCheckpointInfo cannon::ray::read_film_checkpoint_info(const std::string& filename) {
+  std::ifstream checkpoint_file(filename, std::ios::binary);
+  if (!checkpoint_file)
+    throw std::runtime_error("Could not open " + filename + " for reading");
+
+  return read_checkpoint_header(checkpoint_file, filename);
+}
+
+void Film::write_checkpoint(const std::string& filename, int first_sample, int num_samples) const {
+  bool has_features = false;
+  for (auto& pixel : pixels_) {
+    if (pixel.feature_weight_sum_ != 0.0) {
+      has_features = true;
+      break;
+    }
+  }
+
+  std::string tmp_filename = filename + ".tmp";
+  std::ofstream checkpoint_file(tmp_filename, std::ios::binary);
+  if (!checkpoint_file)
+    throw std::runtime_error("Could not open " + tmp_filename + " for writing");
+
+  checkpoint_file << "CFILMSTATE\n" << width_ << ' ' << height_ << ' ' <<
+    first_sample << ' ' << num_samples << ' ' << has_features << '\n';
+
+  int n_values = checkpoint_pixel_values + (has_features ? checkpoint_feature_values : 0);
+  std::vector<unsigned char> row(8 * n_values * width_);
+  for (unsigned int y = 0; y < height_; y++) {
+    for (unsigned int x = 0; x < width_; x++) {
+      const FilmPixel& pixel = pixels_[y * width_ + x];
+      double values[checkpoint_pixel_values + checkpoint_feature_values] = {
+        pixel.color_sum_.x(), pixel.color_sum_.y(), pixel.color_sum_.z(),
+        pixel.filter_weight_sum_, static_cast<double>(pixel.sample_count_),
+        pixel.sample_mean_.x(), pixel.sample_mean_.y(), pixel.sample_mean_.z(),
+        pixel.sample_m2_.x(), pixel.sample_m2_.y(), pixel.sample_m2_.z(),
+        pixel.feature_weight_sum_,
+        pixel.albedo_sum_.x(), pixel.albedo_sum_.y(), pixel.albedo_sum_.z(),
+        pixel.normal_sum_.x(), pixel.normal_sum_.y(), pixel.normal_sum_.z(),
+        pixel.depth_sum_,
+        pixel.emission_sum_.x(), pixel.emission_sum_.y(), pixel.emission_sum_.z()
+      };
+
+      for (int v = 0; v < n_values; v++)
+        put_double(&row[8 * (n_values * x + v)], values[v]);
+    }
+
+    checkpoint_file.write(reinterpret_cast<const char*>(row.data()), row.size());
+  }
+
+  checkpoint_file.close();
+  if (!checkpoint_file)
+    throw std::runtime_error("Could not write checkpoint to " + tmp_filename);
+
+  if (std::rename(tmp_filename.c_str(), filename.c_str()) != 0)
+    throw std::runtime_error("Could not replace " + filename + " with " + tmp_filename);
+}
+
+FilmCheckpointInfo Film::merge_checkpoint(const std::string& filename) {
+  std::ifstream checkpoint_file(filename, std::ios::binary);
+  if (!checkpoint_file)
+    throw std::runtime_error("Could not open " + filename + " for reading");
+
+  FilmCheckpointInfo info = read_checkpoint_header(checkpoint_file, filename);
+  if (info.width != width_ || info.height != height_)
+    throw std::runtime_error("Checkpoint " + filename + " does not match film dimensions");
+
+  int n_values = checkpoint_pixel_values + (info.has_features ? checkpoint_feature_values : 0);
+  std::vector<unsigned char> row(8 * n_values * width_);
+  for (unsigned int y = 0; y < height_; y++) {
+    if (!checkpoint_file.read(reinterpret_cast<char*>(row.data()), row.size()))
+      throw std::runtime_error("Checkpoint " + filename + " ended early");
+
+    for (unsigned int x = 0; x < width_; x++) {
+      double values[checkpoint_pixel_values + checkpoint_feature_values] = {0.0};
+      for (int v = 0; v < n_values; v++)
+        values[v] = get_double(&row[8 * (n_values * x + v)]);
+
+      FilmPixel pixel;
+      pixel.color_sum_ = Vector3d(values[0], values[1], values[2]);
+      pixel.filter_weight_sum_ = values[3];
+      pixel.sample_count_ = static_cast<unsigned int>(values[4]);
+      pixel.sample_mean_ = Vector3d(values[5], values[6], values[7]);
+      pixel.sample_m2_ = Vector3d(values[8], values[9], values[10]);
+      pixel.feature_weight_sum_ = values[11];
+      pixel.albedo_sum_ = Vector3d(values[12], values[13], values[14]);
+      pixel.normal_sum_ = Vector3d(values[15], values[16], values[17]);
+      pixel.depth_sum_ = values[18];
+      pixel.emission_sum_ = Vector3d(values[19], values[20], values[21]);
+
+      merge_pixel(pixels_[y * width_ + x], pixel);
+    }
+  }
+
+  // Every tile may have changed
+  Vector2i tiles = num_tiles();
+  for (int i = 0; i < tiles.x() * tiles.y(); i++)
+    dirty_tiles_[i] = true;
+
+  return info;
+}
+
+void Film::write_features(const std::string& prefix) const {
+  std::vector<Vector3d> albedo(pixels_.size()), normal(pixels_.size()), depth(pixels_.size());
+  for (size_t i = 0; i < pixels_.size(); i++) {
+    FilmFeatures features = pixels_[i].features();
+    albedo[i] = features.albedo;
+    normal[i] = features.normal;
+    depth[i] = Vector3d::Constant(features.depth);
+  }
+
+  write_pixels(prefix + "_albedo.pfm", make_pixels(albedo), width_, height_);
+  write_pixels(prefix + "_normal.pfm", make_pixels(normal), width_, height_);
+  write_pixels(prefix + "_depth.pfm", make_pixels(depth), width_, height_);
+}
+
+void Film::write_denoised_image(const std::string& filename, const
+    DenoiserParams& params, unsigned int num_threads) const {
+  std::vector<Vector3d> color(pixels_.size());
+  std::vector<double> variance(pixels_.size());
+  std::vector<FilmFeatures> features(pixels_.size());
+  for (size_t i = 0; i < pixels_.size(); i++) {
+    const FilmPixel& pixel = pixels_[i];
+    color[i] = pixel.filter_weight_sum_ == 0.0 ? Vector3d::Zero() :
+      Vector3d(pixel.color_sum_ / pixel.filter_weight_sum_);
+
+    // Variance of the pixel's mean, rather than of its samples
+    variance[i] = pixel.sample_count_ == 0 ? 0.0 :
+      luminance(pixel.variance()) / pixel.sample_count_;
+    features[i] = pixel.features();
+  }
+
+  write_pixels(filename, make_pixels(denoise_atrous(width_, height_, color,
+          variance, features, params, num_threads)), width_, height_);
+}
+
 void Film::write_image(float *data) {
-  std::lock_guard<std::mutex> lock(mut_);
+  Vector2i tiles = num_tiles();
+  for (int j = 0; j < tiles.y(); j++) {
+    for (int i = 0; i < tiles.x(); i++) {
+      dirty_tiles_[j * tiles.x() + i] = false;
+      write_tile_(i, j, data);
+    }
+  }
+}
+
+void Film::update_image(float *data) {
+  Vector2i tiles = num_tiles();
+  for (int j = 0; j < tiles.y(); j++) {
+    for (int i = 0; i < tiles.x(); i++) {
+      // Clear the flag first, so that merges during the write mark the tile
+      // again
+      if (dirty_tiles_[j * tiles.x() + i].exchange(false))
+        write_tile_(i, j, data);
+    }
+  }
+}
+
+void Film::write_tile_(int i, int j, float *data) const {
+  unsigned int origin_x = i * tile_size_;
+  unsigned int origin_y = j * tile_size_;
+  unsigned int end_x = std::min(origin_x + tile_size_, width_);
+  unsigned int end_y = std::min(origin_y + tile_size_, height_);
 
-  for (unsigned int i = 0; i < width_; i++) {
-    for (unsigned int j = 0; j < height_; j++) {
-      int offset = 3 * ((width_ - i) * height_  + j);
+  for (unsigned int y = origin_y; y < end_y; y++) {
+    for (unsigned int x = origin_x; x < end_x; x++) {
+      const FilmPixel& pixel = get_pixel(x, y);
+      int offset = 3 * (y * width_ + x);
 
-      Vector3d normalized_color = pixels_[i * height_ + j].color_sum_ /
-                                  pixels_[i * height_ + j].filter_weight_sum_;
+      if (pixel.filter_weight_sum_ == 0.0) {
+        data[offset] = data[offset+1] = data[offset+2] = 0.f;
+        continue;
+      }
+
+      Vector3d normalized_color = pixel.color_sum_ / pixel.filter_weight_sum_;
 
       // Correct for gamma=2.0
       data[offset] = std::min(0.999f, std::max(0.f, std::sqrt((float)normalized_color.x())));
@@ -122,6 +546,4 @@ void Film::write_image(float *data) {
       data[offset+2] = std::min(0.999f, std::max(0.f, std::sqrt((float)normalized_color.z())));
     }
   }
-
-
 }
@@ -7,8 +7,10 @@
  * \brief File containing Film and FilmTile class definitions.
  */
 
+#include <atomic>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <vector>
 
 #include <Eigen/Dense>
@@ -22,16 +24,114 @@ namespace cannon {
   namespace ray {
 
     CANNON_CLASS_FORWARD(Filter);
+    struct DenoiserParams;
+
+    /*!
+     * \brief Struct representing auxiliary features of the surface seen
+     * through a pixel, which guide denoising.
+     */
+    struct FilmFeatures {
+      Vector3d albedo = Vector3d::Zero(); //!< Albedo of the first non-specular surface hit, or the background color
+      Vector3d normal = Vector3d::Zero(); //!< World-space shading normal of that surface, or zero
+      double depth = 0.0; //!< Distance from the camera to the first surface hit, or zero
+      Vector3d emission = Vector3d::Zero(); //!< Light emitted towards the camera by surfaces up to and including the albedo surface
+    };
 
     /*!
      * \brief Struct representing a single tile in the image film. Accumulates
      * contributions from image samples.
      */
     struct FilmPixel {
+
+      /*!
+       * \brief Add an unfiltered sample taken for this pixel to the running
+       * estimate of its variance, using Welford's algorithm.
+       *
+       * \param color Color of sample
+       */
+      void add_sample_statistics(const Vector3d& color);
+
+      /*!
+       * \brief Merge the running variance estimate of another pixel into
+       * this one, as though its samples had been added here.
+       *
+       * \param other Pixel to merge statistics from.
+       */
+      void merge_sample_statistics(const FilmPixel& other);
+
+      /*!
+       * \brief Get the sample variance of colors sampled for this pixel.
+       *
+       * \returns Per-channel sample variance, or zero if fewer than two
+       * samples have been taken.
+       */
+      Vector3d variance() const;
+
+      /*!
+       * \brief Get the standard error of the mean color of this pixel,
+       * relative to the mean color. Both are summed over channels, with the
+       * mean clamped away from zero so that black pixels converge.
+       *
+       * \returns Relative error, or infinity if fewer than two samples have
+       * been taken.
+       */
+      double relative_error() const;
+
+      /*!
+       * \brief Add the features of a sample whose filter overlaps this
+       * pixel.
+       *
+       * \param features Features of sample
+       * \param filter_weight Filter weight of sample at this pixel
+       */
+      void add_features(const FilmFeatures& features, double filter_weight);
+
+      /*!
+       * \brief Get the features of samples overlapping this pixel,
+       * weighted by the pixel filter like colors are, so that features line
+       * up with color where the filter spreads small bright objects.
+       *
+       * \returns Weighted mean features, with the normal renormalized, or
+       * zero features if none have been added.
+       */
+      FilmFeatures features() const;
+
       Vector3d color_sum_ = Vector3d::Zero(); //!< Sum of color samples for this pixel
       double filter_weight_sum_ = 0.0; //!< Sum of filter weights for this pixel
+
+      unsigned int sample_count_ = 0; //!< Number of samples taken for this pixel
+      Vector3d sample_mean_ = Vector3d::Zero(); //!< Running mean of samples taken for this pixel
+      Vector3d sample_m2_ = Vector3d::Zero(); //!< Running sum of squared deviations from sample_mean_
+
+      double feature_weight_sum_ = 0.0; //!< Sum of filter weights of samples whose features were added
+      Vector3d albedo_sum_ = Vector3d::Zero(); //!< Weighted sum of sample albedos
+      Vector3d normal_sum_ = Vector3d::Zero(); //!< Weighted sum of sample normals
+      double depth_sum_ = 0.0; //!< Weighted sum of sample depths
+      Vector3d emission_sum_ = Vector3d::Zero(); //!< Weighted sum of sample emission
     };
 
+    /*!
+     * \brief Struct describing the film and samples saved in a film
+     * checkpoint.
+     */
+    struct FilmCheckpointInfo {
+      unsigned int width = 0; //!< Width of film
+      unsigned int height = 0; //!< Height of film
+      int first_sample = 0; //!< Index of the first sample taken for each pixel
+      int num_samples = 0; //!< Number of consecutive samples taken for each pixel
+      bool has_features = false; //!< Whether pixel features were saved
+    };
+
+    /*!
+     * Read the header of a film checkpoint written by
+     * Film::write_checkpoint().
+     *
+     * \param filename The checkpoint to read.
+     *
+     * \returns Description of the checkpoint.
+     */
+    FilmCheckpointInfo read_film_checkpoint_info(const std::string& filename);
+
     /*!
      * \brief Struct representing a tile of pixels in the film which can be
      * independently processed.
@@ -39,12 +139,16 @@ namespace cannon {
     struct FilmTile {
 
       /*!
-       * \brief Add a sample to this film tile.
+       * \brief Add a sample to this film tile. The sample is also added to
+       * the variance estimate of the pixel containing p_film, and its
+       * features, if given, are splatted alongside its color.
        *
        * \param p_film Point on film that sample hits.
        * \param color Color of sample
+       * \param features Features of sample, or nullptr.
        */
-      void add_sample(const Vector2d& p_film, const Vector3d& color);
+      void add_sample(const Vector2d& p_film, const Vector3d& color, const
+          FilmFeatures* features = nullptr);
 
       /*!
        * \brief Get pixel in this tile at location (i, j)
@@ -58,6 +162,10 @@ namespace cannon {
 
       unsigned int origin_x_, origin_y_; //!< Origin of this tile
       unsigned int extent_x_, extent_y_; //!< Extent of this tile
+      unsigned int sample_origin_x_, sample_origin_y_; //!< Origin of pixels sampled for this tile
+      unsigned int sample_extent_x_, sample_extent_y_; //!< Extent of pixels sampled for this tile
+      unsigned int interior_origin_x_, interior_origin_y_; //!< Origin of pixels no other tile covers
+      unsigned int interior_extent_x_, interior_extent_y_; //!< Extent of pixels no other tile covers
       Vector2d filter_radius_; //!< Filter radius for film
       Vector2d inv_filter_radius_; //!< 1 / filter_radius
       const double *filter_table_; //!< Filter table for film
@@ -78,36 +186,140 @@ namespace cannon {
              std::unique_ptr<Filter> filter);
 
         /*!
-         * \brief Get tile (i, j) of this film.
+         * \brief Get tile (i, j) of this film. The tile covers the pixels
+         * sampled for it, extended by the filter radius.
          */
         std::unique_ptr<FilmTile> get_film_tile(int i, int j) const;
 
         /*!
-         * \brief Merge input film tile into the final image.
+         * \brief Merge input film tile into the final image. Interior pixels
+         * of the tile, which no other tile covers, are written without
+         * locking, and pixels shared with neighboring tiles are written under
+         * a lock striped by image row. Different tiles may therefore be
+         * merged concurrently, but the same tile may not.
          *
          * \param tile The tile to merge.
          */
         void merge_film_tile(std::unique_ptr<FilmTile> tile);
 
         /*!
-         * \brief Write this film to the input file.
+         * \brief Get pixel (x, y) of this film, in raster coordinates as
+         * used by film tiles. Not synchronized with merge_film_tile().
+         *
+         * \param x Horizontal coordinate of pixel
+         * \param y Vertical coordinate of pixel
+         *
+         * \returns Reference to pixel.
+         */
+        const FilmPixel& get_pixel(unsigned int x, unsigned int y) const;
+
+        /*!
+         * \brief Get the number of tiles needed to cover this film in each
+         * direction, including partial tiles at the right and bottom edges.
+         *
+         * \returns Number of horizontal and vertical tiles.
+         */
+        Vector2i num_tiles() const;
+
+        /*!
+         * \brief Write this film to the input file, in a format chosen by
+         * extension: binary PPM for .ppm, linear floating point PFM for
+         * .pfm, or compact film channels for .cfilm, which can be
+         * read back and merged with other renders. Unrecognized extensions
+         * are written as PPM.
          *
-         * \param filename The filename to write this film to in PPM format.
+         * \param filename The filename to write this film to.
          */
         void write_image(const std::string& filename);
 
+        /*!
+         * \brief Write the full state of this film to a binary checkpoint,
+         * so that it can be resumed or merged with films rendered by other
+         * processes without loss. The format is a text header
+         *
+         *     CFILMSTATE
+         *     <width> <height> <first sample> <sample count> <has features>
+         *
+         * followed by the color sum, filter weight sum, sample count, sample
+         * mean, and sum of squared deviations of each pixel, and then its
+         * feature sums if saved, as little-endian doubles in pixel order.
+         * The checkpoint is written to a temporary file which then replaces
+         * filename, so an interrupted write leaves any previous checkpoint
+         * intact.
+         *
+         * \param filename The file to write the checkpoint to.
+         * \param first_sample Index of the first sample taken for each pixel.
+         * \param num_samples Number of consecutive samples taken for each pixel.
+         */
+        void write_checkpoint(const std::string& filename, int first_sample,
+            int num_samples) const;
+
+        /*!
+         * \brief Add the pixels saved in a checkpoint to this film, as
+         * though their samples had been merged in as tiles. Merging into an
+         * empty film restores the checkpoint. Not synchronized with
+         * merge_film_tile().
+         *
+         * \param filename The checkpoint to merge.
+         *
+         * \returns Description of the checkpoint.
+         */
+        FilmCheckpointInfo merge_checkpoint(const std::string& filename);
+
+        /*!
+         * \brief Write the mean features of each pixel as linear PFM images
+         * named <prefix>_albedo.pfm, <prefix>_normal.pfm, and
+         * <prefix>_depth.pfm.
+         *
+         * \param prefix Path prefix of the images.
+         */
+        void write_features(const std::string& prefix) const;
+
+        /*!
+         * \brief Denoise this film with denoise_atrous(), guided by the
+         * features of each pixel, and write the result to the input file as
+         * in write_image(). The film itself is unchanged.
+         *
+         * \param filename The filename to write the denoised image to.
+         * \param params Denoiser settings.
+         * \param num_threads Number of threads to denoise with.
+         */
+        void write_denoised_image(const std::string& filename, const
+            DenoiserParams& params, unsigned int num_threads = 1) const;
+
         /*!
          * \brief Write this film to the input data pointer. 
          *
-         * \param data Array in which to write data as RGB triples. Should have
-         * size = 3 * width_ * height_.
+         * \param data Array in which to write data as RGB triples, with the
+         * bottom row first. Should have size = 3 * width_ * height_.
          */
         void write_image(float *data);
 
+        /*!
+         * \brief Write only the tiles of this film that have changed since
+         * they were last written to the input data pointer, e.g. for
+         * display while rendering. May be called while tiles are merged, in
+         * which case pixels being merged may be displayed partially updated.
+         *
+         * \param data Array in which to write data as RGB triples, with the
+         * bottom row first. Should have size = 3 * width_ * height_.
+         */
+        void update_image(float *data);
+
+      private:
+
+        /*!
+         * \brief Write the pixels sampled for tile (i, j) to the input data
+         * pointer, as in write_image().
+         */
+        void write_tile_(int i, int j, float *data) const;
+
       public:
         unsigned int width_, height_; //!< Width and height of film
         unsigned int tile_size_; //!< Size of each film tile
-        std::mutex mut_; //!< Mutex controlling image data writing/reading
+        static constexpr unsigned int num_row_locks_ = 64; //!< Number of striped row locks
+        std::mutex row_locks_[num_row_locks_]; //!< Locks for pixels shared between tiles, by image row
+        std::unique_ptr<std::atomic<bool>[]> dirty_tiles_; //!< Whether each tile has changed since it was last displayed
         std::vector<FilmPixel> pixels_; //!< Rendered image data
         std::unique_ptr<Filter> filter_; //!< Image reconstruction filter
 
@@ -1,7 +1,257 @@
+#include <thread>
 #include <catch2/catch.hpp>
 
 #include <cannon/ray/film.hpp>
+#include <cannon/ray/filter.hpp>
+#include <cannon/math/random_double.hpp>
+
+using namespace cannon::ray;
+using namespace cannon::math;
 
 TEST_CASE("Film", "[ray]") {
+  // Running variance matches the two-pass estimate, including when merged
+  std::vector<Vector3d> samples;
+  for (int i = 0; i < 100; i++)
+    samples.push_back(random_vec(0, 2));
+
+  Vector3d mean = Vector3d::Zero();
+  for (auto& s : samples)
+    mean += s;
+  mean /= samples.size();
+
+  Vector3d var = Vector3d::Zero();
+  for (auto& s : samples)
+    var += ((s - mean).array().square()).matrix();
+  var /= samples.size() - 1;
+
+  FilmPixel all, first, second;
+  REQUIRE(all.relative_error() == std::numeric_limits<double>::infinity());
+  for (unsigned int i = 0; i < samples.size(); i++) {
+    all.add_sample_statistics(samples[i]);
+    if (i < 30)
+      first.add_sample_statistics(samples[i]);
+    else
+      second.add_sample_statistics(samples[i]);
+  }
+
+  first.merge_sample_statistics(second);
+  REQUIRE(all.sample_count_ == 100);
+  REQUIRE(first.sample_count_ == 100);
+  REQUIRE(all.sample_mean_.isApprox(mean));
+  REQUIRE(first.sample_mean_.isApprox(mean));
+  REQUIRE(all.variance().isApprox(var));
+  REQUIRE(first.variance().isApprox(var));
+
+  // Constant pixels converge immediately
+  FilmPixel constant;
+  constant.add_sample_statistics(Vector3d::Ones());
+  constant.add_sample_statistics(Vector3d::Ones());
+  REQUIRE(constant.relative_error() == 0.0);
+
+  // Statistics are kept for the pixel each sample was taken for, and
+  // survive merging into the film
+  Film film(4, 4, 4, std::make_unique<BoxFilter>(Vector2d::Ones() * 0.5));
+  auto tile = film.get_film_tile(0, 0);
+  tile->add_sample(Vector2d(1.5, 2.5), Vector3d::Ones());
+  tile->add_sample(Vector2d(1.25, 2.75), Vector3d::Zero());
+  film.merge_film_tile(std::move(tile));
+
+  REQUIRE(film.get_pixel(1, 2).sample_count_ == 2);
+  REQUIRE(film.get_pixel(1, 2).sample_mean_.isApprox(Vector3d::Constant(0.5)));
+  REQUIRE(film.get_pixel(2, 1).sample_count_ == 0);
+
+  // Features are averaged per pixel with filter weights, with normals
+  // renormalized
+  FilmFeatures up, right;
+  up.albedo = Vector3d(0.2, 0.4, 0.6);
+  up.normal = Vector3d::UnitY();
+  up.depth = 2.0;
+  right.albedo = Vector3d(0.4, 0.4, 0.4);
+  right.normal = Vector3d::UnitX();
+  right.depth = 4.0;
+
+  tile = film.get_film_tile(0, 0);
+  tile->add_sample(Vector2d(0.5, 0.5), Vector3d::Ones(), &up);
+  tile->add_sample(Vector2d(0.5, 0.5), Vector3d::Ones(), &right);
+  tile->add_sample(Vector2d(0.5, 0.5), Vector3d::Ones());
+  film.merge_film_tile(std::move(tile));
+
+  FilmFeatures features = film.get_pixel(0, 0).features();
+  REQUIRE(film.get_pixel(0, 0).feature_weight_sum_ > 0.0);
+  REQUIRE(features.albedo.isApprox(Vector3d(0.3, 0.4, 0.5)));
+  REQUIRE(features.normal.isApprox(Vector3d(1, 1, 0).normalized()));
+  REQUIRE(features.depth == Approx(3.0));
+  REQUIRE(film.get_pixel(3, 3).features().normal == Vector3d::Zero());
+}
+
+TEST_CASE("Film tiles", "[ray]") {
+  // Sampled regions of tiles cover every pixel exactly once, including
+  // partial tiles at the edges
+  Film film(23, 17, 8, std::make_unique<GaussianFilter>(Vector2d::Ones() * 2.0, 1.0));
+  REQUIRE(film.num_tiles() == Vector2i(3, 3));
+
+  std::vector<int> covered(23 * 17, 0);
+  for (int i = 0; i < film.num_tiles().x(); i++) {
+    for (int j = 0; j < film.num_tiles().y(); j++) {
+      auto tile = film.get_film_tile(i, j);
+      for (unsigned int x = 0; x < tile->sample_extent_x_; x++) {
+        for (unsigned int y = 0; y < tile->sample_extent_y_; y++) {
+          unsigned int px = tile->sample_origin_x_ + x;
+          unsigned int py = tile->sample_origin_y_ + y;
+
+          // Tiles extend past their sampled pixels to hold filter splats
+          REQUIRE(px >= tile->origin_x_);
+          REQUIRE(px < tile->origin_x_ + tile->extent_x_);
+          REQUIRE(py >= tile->origin_y_);
+          REQUIRE(py < tile->origin_y_ + tile->extent_y_);
+          covered[py * 23 + px]++;
+        }
+      }
+    }
+  }
+
+  for (int c : covered)
+    REQUIRE(c == 1);
+
+  // Interior pixels of tiles are covered by no other tile
+  std::vector<int> extent_covered(23 * 17, 0);
+  for (int i = 0; i < film.num_tiles().x(); i++) {
+    for (int j = 0; j < film.num_tiles().y(); j++) {
+      auto tile = film.get_film_tile(i, j);
+      for (unsigned int x = tile->origin_x_; x < tile->origin_x_ + tile->extent_x_; x++)
+        for (unsigned int y = tile->origin_y_; y < tile->origin_y_ + tile->extent_y_; y++)
+          extent_covered[y * 23 + x]++;
+    }
+  }
+
+  for (int i = 0; i < film.num_tiles().x(); i++) {
+    for (int j = 0; j < film.num_tiles().y(); j++) {
+      auto tile = film.get_film_tile(i, j);
+      REQUIRE(tile->interior_origin_x_ >= tile->origin_x_);
+      REQUIRE(tile->interior_origin_x_ + tile->interior_extent_x_ <= tile->origin_x_ + tile->extent_x_);
+      REQUIRE(tile->interior_origin_y_ >= tile->origin_y_);
+      REQUIRE(tile->interior_origin_y_ + tile->interior_extent_y_ <= tile->origin_y_ + tile->extent_y_);
+
+      for (unsigned int x = 0; x < tile->interior_extent_x_; x++)
+        for (unsigned int y = 0; y < tile->interior_extent_y_; y++)
+          REQUIRE(extent_covered[(tile->interior_origin_y_ + y) * 23 + tile->interior_origin_x_ + x] == 1);
+    }
+  }
+
+  // Merging tiles concurrently gives the same image as merging serially
+  Film serial_film(23, 17, 8, std::make_unique<GaussianFilter>(Vector2d::Ones() * 2.0, 1.0));
+  std::vector<std::pair<int, int>> tile_coords;
+  std::vector<std::unique_ptr<FilmTile>> tiles;
+  for (int i = 0; i < film.num_tiles().x(); i++) {
+    for (int j = 0; j < film.num_tiles().y(); j++) {
+      auto tile = film.get_film_tile(i, j);
+      for (int s = 0; s < 200; s++) {
+        Vector2d p(tile->sample_origin_x_ + random_double() * tile->sample_extent_x_,
+            tile->sample_origin_y_ + random_double() * tile->sample_extent_y_);
+        tile->add_sample(p, random_vec(0, 1));
+      }
+
+      serial_film.merge_film_tile(std::make_unique<FilmTile>(*tile));
+      tiles.push_back(std::move(tile));
+    }
+  }
+
+  std::vector<std::thread> threads;
+  for (auto& tile : tiles)
+    threads.emplace_back([&film, &tile]() { film.merge_film_tile(std::move(tile)); });
+  for (auto& thread : threads)
+    thread.join();
+
+  for (unsigned int x = 0; x < 23; x++) {
+    for (unsigned int y = 0; y < 17; y++) {
+      REQUIRE(film.get_pixel(x, y).color_sum_.isApprox(serial_film.get_pixel(x, y).color_sum_));
+      REQUIRE(film.get_pixel(x, y).filter_weight_sum_ == Approx(serial_film.get_pixel(x, y).filter_weight_sum_));
+      REQUIRE(film.get_pixel(x, y).sample_count_ == serial_film.get_pixel(x, y).sample_count_);
+    }
+  }
+
+  // Only tiles changed since the last update are converted for display
+  std::vector<float> data(3 * 23 * 17, -1.f);
+  film.update_image(data.data());
+  for (float f : data)
+    REQUIRE(f >= 0.f);
+
+  std::fill(data.begin(), data.end(), -1.f);
+  film.update_image(data.data());
+  for (float f : data)
+    REQUIRE(f == -1.f);
+}
+
+TEST_CASE("Film checkpoints", "[ray]") {
+  // Films rendered separately and merged through checkpoints match a film
+  // with every sample merged directly
+  Film all(13, 9, 4, std::make_unique<GaussianFilter>(Vector2d::Ones() * 1.5, 1.0));
+  Film first(13, 9, 4, std::make_unique<GaussianFilter>(Vector2d::Ones() * 1.5, 1.0));
+  Film second(13, 9, 4, std::make_unique<GaussianFilter>(Vector2d::Ones() * 1.5, 1.0));
+
+  FilmFeatures features;
+  features.albedo = Vector3d(0.1, 0.2, 0.3);
+  features.normal = Vector3d::UnitZ();
+  features.depth = 1.5;
+
+  Vector2i num_tiles = all.num_tiles();
+  for (int s = 0; s < 8; s++) {
+    for (int i = 0; i < num_tiles.x(); i++) {
+      for (int j = 0; j < num_tiles.y(); j++) {
+        auto tile = all.get_film_tile(i, j);
+        auto part_tile = (s < 3 ? first : second).get_film_tile(i, j);
+        for (unsigned int x = 0; x < tile->sample_extent_x_; x++) {
+          for (unsigned int y = 0; y < tile->sample_extent_y_; y++) {
+            Vector2d p(tile->sample_origin_x_ + x + random_double(),
+                tile->sample_origin_y_ + y + random_double());
+            Vector3d color = random_vec(0, 4);
+            tile->add_sample(p, color, &features);
+            part_tile->add_sample(p, color, &features);
+          }
+        }
+
+        all.merge_film_tile(std::move(tile));
+        (s < 3 ? first : second).merge_film_tile(std::move(part_tile));
+      }
+    }
+  }
+
+  first.write_checkpoint("test_first.film", 0, 3);
+  second.write_checkpoint("test_second.film", 3, 5);
+
+  FilmCheckpointInfo info = read_film_checkpoint_info("test_second.film");
+  REQUIRE(info.width == 13);
+  REQUIRE(info.height == 9);
+  REQUIRE(info.first_sample == 3);
+  REQUIRE(info.num_samples == 5);
+  REQUIRE(info.has_features);
+
+  // Restoring a checkpoint into an empty film is exact
+  Film restored(13, 9, 4, std::make_unique<BoxFilter>(Vector2d::Ones() * 0.5));
+  restored.merge_checkpoint("test_first.film");
+  for (unsigned int x = 0; x < 13; x++) {
+    for (unsigned int y = 0; y < 9; y++) {
+      REQUIRE(restored.get_pixel(x, y).color_sum_ == first.get_pixel(x, y).color_sum_);
+      REQUIRE(restored.get_pixel(x, y).sample_m2_ == first.get_pixel(x, y).sample_m2_);
+      REQUIRE(restored.get_pixel(x, y).albedo_sum_ == first.get_pixel(x, y).albedo_sum_);
+    }
+  }
+
+  restored.merge_checkpoint("test_second.film");
+  for (unsigned int x = 0; x < 13; x++) {
+    for (unsigned int y = 0; y < 9; y++) {
+      const FilmPixel& merged = restored.get_pixel(x, y);
+      const FilmPixel& direct = all.get_pixel(x, y);
+      REQUIRE(merged.color_sum_.isApprox(direct.color_sum_));
+      REQUIRE(merged.filter_weight_sum_ == Approx(direct.filter_weight_sum_));
+      REQUIRE(merged.sample_count_ == direct.sample_count_);
+      REQUIRE(merged.variance().isApprox(direct.variance()));
+      REQUIRE(merged.features().albedo.isApprox(direct.features().albedo));
+    }
+  }
 
+  // Checkpoints must match the film they are merged into
+  Film other(12, 9, 4, std::make_unique<BoxFilter>(Vector2d::Ones() * 0.5));
+  REQUIRE_THROWS(other.merge_checkpoint("test_first.film"));
+  REQUIRE_THROWS(other.merge_checkpoint("test_missing.film"));
 }
@@ -0,0 +1,60 @@
+#pragma once
+#ifndef CANNON_RAY_FLOAT_H
+#define CANNON_RAY_FLOAT_H
+
+/*!
+ * \file cannon/ray/float.hpp
+ * \brief File containing the floating-point type used for ray-geometry
+ * intersection, and utilities for bounding its rounding error.
+ */
+
+#include <cmath>
+#include <limits>
+
+namespace cannon {
+  namespace ray {
+
+#ifdef CANNON_RAY_FLOAT_AS_FLOAT
+    typedef float Float;
+#else
+    typedef double Float;
+#endif
+
+    /*!
+     * Maximum relative error of a single correctly-rounded operation on
+     * Float values.
+     */
+    static constexpr double machine_epsilon = std::numeric_limits<Float>::epsilon() * 0.5;
+
+    /*!
+     * Conservative bound on the relative error accumulated by n successive
+     * floating-point operations at Float precision, from Chapter 3 of PBRT.
+     * Because the bound uses Float's epsilon, it also holds for arithmetic
+     * carried out at any higher precision.
+     *
+     * \param n Number of operations.
+     *
+     * \returns Bound on the relative error.
+     */
+    inline constexpr double error_gamma(int n) {
+      return (n * machine_epsilon) / (1 - n * machine_epsilon);
+    }
+
+    /*!
+     * Get the smallest representable value greater than the input.
+     */
+    inline double next_float_up(double v) {
+      return std::nextafter(v, std::numeric_limits<double>::infinity());
+    }
+
+    /*!
+     * Get the largest representable value less than the input.
+     */
+    inline double next_float_down(double v) {
+      return std::nextafter(v, -std::numeric_limits<double>::infinity());
+    }
+
+  } // namespace ray
+} // namespace cannon
+
+#endif /* ifndef CANNON_RAY_FLOAT_H */
@@ -0,0 +1,247 @@
+#include <cannon/ray/grid_medium.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include <cannon/math/random_double.hpp>
+#include <cannon/ray/aabb.hpp>
+#include <cannon/ray/material.hpp>
+#include <cannon/ray/ray.hpp>
+#include <cannon/utils/statistics.hpp>
+
+using namespace cannon::ray;
+using namespace cannon::utils;
+
+STAT_COUNTER("Integrator/Majorant cells visited", nMajorantCells);
+STAT_COUNTER("Integrator/Delta tracking steps", nDeltaTrackingSteps);
+STAT_COUNTER("Integrator/Ratio tracking steps", nRatioTrackingSteps);
+
+GridMedium::GridMedium(const Vector3d& min, const Vector3d& max, const
+    Vector3i& resolution, std::vector<float> densities, double density_scale,
+    TexturePtr albedo, const Vector3i& majorant_resolution) : min_(min),
+  max_(max), resolution_(resolution), densities_(std::move(densities)),
+  density_scale_(density_scale), majorant_resolution_(majorant_resolution),
+  phase_function_(std::make_shared<Isotropic>(albedo)) {
+  if ((resolution_.array() < 2).any())
+    throw std::runtime_error("Grid medium resolution must be at least two along each axis");
+
+  if ((majorant_resolution_.array() < 1).any())
+    throw std::runtime_error("Grid medium must have at least one majorant cell along each axis");
+
+  if ((max_.array() <= min_.array()).any())
+    throw std::runtime_error("Grid medium must have positive extent");
+
+  if (densities_.size() != static_cast<size_t>(resolution_.x()) * resolution_.y() * resolution_.z())
+    throw std::runtime_error("Grid medium density count does not match resolution");
+
+  if (std::any_of(densities_.begin(), densities_.end(), [](float d) { return !(d >= 0); }))
+    throw std::runtime_error("Grid medium densities must be non-negative");
+
+  // Trilinear interpolation is bounded by the grid points around it, so
+  // each majorant is the largest density at any grid point whose cells
+  // overlap the majorant cell
+  majorants_.resize(static_cast<size_t>(majorant_resolution_.x()) *
+      majorant_resolution_.y() * majorant_resolution_.z());
+
+  int lo[3][2], idx[3];
+  for (idx[2] = 0; idx[2] < majorant_resolution_.z(); idx[2]++) {
+    for (idx[1] = 0; idx[1] < majorant_resolution_.y(); idx[1]++) {
+      for (idx[0] = 0; idx[0] < majorant_resolution_.x(); idx[0]++) {
+        for (int a = 0; a < 3; a++) {
+          double scale = static_cast<double>(resolution_[a] - 1) / majorant_resolution_[a];
+          lo[a][0] = std::max(static_cast<int>(std::floor(idx[a] * scale)), 0);
+          lo[a][1] = std::min(static_cast<int>(std::ceil((idx[a] + 1) * scale)), resolution_[a] - 1);
+        }
+
+        float m = 0.0f;
+        for (int k = lo[2][0]; k <= lo[2][1]; k++)
+          for (int j = lo[1][0]; j <= lo[1][1]; j++)
+            for (int i = lo[0][0]; i <= lo[0][1]; i++)
+              m = std::max(m, density_(i, j, k));
+
+        majorants_[(static_cast<size_t>(idx[2]) * majorant_resolution_.y() +
+            idx[1]) * majorant_resolution_.x() + idx[0]] = m;
+      }
+    }
+  }
+}
+
+bool GridMedium::object_space_hit(const Ray& r, double t_min, double t_max, hit_record& rec) const {
+  // Shadow rays are attenuated by transmittance() instead
+  if (r.shadow_ || !clip_(r, t_min, t_max))
+    return false;
+
+  const double sigma_scale = density_scale_ * r.dir_.norm();
+
+  // Candidate collisions are sampled against the majorant of each cell, and
+  // accepted as real scattering with probability density / majorant
+  bool scattered = false;
+  double t_hit = 0.0;
+  traverse_majorants_(r, t_min, t_max, [&](double t_0, double t_1, double majorant) {
+    ++nMajorantCells;
+    if (majorant <= 0.0)
+      return true;
+
+    double sigma_maj = majorant * sigma_scale;
+    double t = t_0;
+    while (true) {
+      t -= std::log(1.0 - random_double()) / sigma_maj;
+      if (t >= t_1)
+        return true;
+
+      ++nDeltaTrackingSteps;
+      if (random_double() * majorant < density(r.at(t))) {
+        scattered = true;
+        t_hit = t;
+        return false;
+      }
+    }
+  });
+
+  if (!scattered)
+    return false;
+
+  rec.t = t_hit;
+  rec.p = r.at(rec.t);
+  rec.p_error = Vector3d::Zero(); // Scattering is not off a surface, so needs no offset
+
+  rec.normal = Vector3d(1, 0, 0); // Arbitrary
+  rec.geometric_normal = rec.normal;
+  rec.dpdu = Vector3d::Zero();
+  rec.dpdv = Vector3d::Zero();
+  rec.front_face = true;          // Arbitrary
+  rec.mat_ptr = phase_function_.get();
+
+  return true;
+}
+
+bool GridMedium::object_space_bounding_box(double /*time_0*/, double /*time_1*/, Aabb& output_box) const {
+  output_box = Aabb(min_, max_);
+  return true;
+}
+
+double GridMedium::density(const Vector3d& p) const {
+  if ((p.array() < min_.array()).any() || (p.array() > max_.array()).any())
+    return 0.0;
+
+  Vector3d g = (p - min_).cwiseQuotient(max_ - min_).cwiseProduct(
+      (resolution_ - Vector3i::Ones()).cast<double>());
+
+  int idx[3];
+  double frac[3];
+  for (int a = 0; a < 3; a++) {
+    idx[a] = std::min(static_cast<int>(g[a]), resolution_[a] - 2);
+    frac[a] = g[a] - idx[a];
+  }
+
+  double accum = 0.0;
+  for (int di = 0; di < 2; di++)
+    for (int dj = 0; dj < 2; dj++)
+      for (int dk = 0; dk < 2; dk++)
+        accum += (di ? frac[0] : 1 - frac[0]) * (dj ? frac[1] : 1 - frac[1]) *
+          (dk ? frac[2] : 1 - frac[2]) * density_(idx[0] + di, idx[1] + dj, idx[2] + dk);
+
+  return accum;
+}
+
+double GridMedium::transmittance(const Ray& r, double t_min, double t_max, Rng& rng) const {
+  if (!clip_(r, t_min, t_max))
+    return 1.0;
+
+  const double sigma_scale = density_scale_ * r.dir_.norm();
+
+  // Each candidate collision scales the estimate by the probability that it
+  // is a null collision, rather than ending the walk when it is not
+  double tr = 1.0;
+  traverse_majorants_(r, t_min, t_max, [&](double t_0, double t_1, double majorant) {
+    ++nMajorantCells;
+    if (majorant <= 0.0)
+      return true;
+
+    double sigma_maj = majorant * sigma_scale;
+    double t = t_0;
+    while (true) {
+      t -= std::log(1.0 - random_double(rng)) / sigma_maj;
+      if (t >= t_1)
+        return true;
+
+      ++nRatioTrackingSteps;
+      tr *= 1.0 - density(r.at(t)) / majorant;
+      if (tr <= 0.0)
+        return false;
+    }
+  });
+
+  return std::max(tr, 0.0);
+}
+
+bool GridMedium::clip_(const Ray& r, double& t_min, double& t_max) const {
+  for (int a = 0; a < 3; a++) {
+    double inv_d = 1.0 / r.dir_[a];
+    double t0 = (min_[a] - r.orig_[a]) * inv_d;
+    double t1 = (max_[a] - r.orig_[a]) * inv_d;
+
+    if (inv_d < 0.0)
+      std::swap(t0, t1);
+
+    // Rays parallel to a slab and inside it give NaN bounds, which are
+    // ignored by the comparisons
+    t_min = t0 > t_min ? t0 : t_min;
+    t_max = t1 < t_max ? t1 : t_max;
+
+    if (t_max <= t_min)
+      return false;
+  }
+
+  return true;
+}
+
+template <typename F>
+void GridMedium::traverse_majorants_(const Ray& r, double t_min, double t_max, F f) const {
+  // Majorant grid coordinates along the ray are o + t * d
+  Vector3d cell_size = (max_ - min_).cwiseQuotient(majorant_resolution_.cast<double>());
+  Vector3d o = (r.orig_ - min_).cwiseQuotient(cell_size);
+  Vector3d d = r.dir_.cwiseQuotient(cell_size);
+
+  int cell[3], step[3];
+  double next_t[3], delta_t[3];
+  for (int a = 0; a < 3; a++) {
+    double entry = o[a] + t_min * d[a];
+    cell[a] = std::min(std::max(static_cast<int>(std::floor(entry)), 0), majorant_resolution_[a] - 1);
+
+    if (d[a] > 0.0) {
+      step[a] = 1;
+      next_t[a] = (cell[a] + 1 - o[a]) / d[a];
+      delta_t[a] = 1.0 / d[a];
+    } else if (d[a] < 0.0) {
+      step[a] = -1;
+      next_t[a] = (cell[a] - o[a]) / d[a];
+      delta_t[a] = -1.0 / d[a];
+    } else {
+      step[a] = 0;
+      next_t[a] = std::numeric_limits<double>::infinity();
+      delta_t[a] = std::numeric_limits<double>::infinity();
+    }
+  }
+
+  double t = t_min;
+  while (true) {
+    int a = next_t[0] < next_t[1] ? (next_t[0] < next_t[2] ? 0 : 2) : (next_t[1] < next_t[2] ? 1 : 2);
+    double t_exit = std::min(std::max(next_t[a], t), t_max);
+
+    if (!f(t, t_exit, static_cast<double>(majorant(cell[0], cell[1], cell[2]))))
+      return;
+
+    if (t_exit >= t_max)
+      return;
+
+    t = t_exit;
+    cell[a] += step[a];
+    if (cell[a] < 0 || cell[a] >= majorant_resolution_[a])
+      return;
+
+    next_t[a] += delta_t[a];
+  }
+}
@@ -0,0 +1,154 @@
+#pragma once
+#ifndef CANNON_RAY_GRID_MEDIUM_H
+#define CANNON_RAY_GRID_MEDIUM_H
+
+/*!
+ * \file cannon/ray/grid_medium.hpp
+ * \brief File containing GridMedium class definition.
+ */
+
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <cannon/ray/hittable.hpp>
+#include <cannon/utils/class_forward.hpp>
+
+using namespace Eigen;
+
+namespace cannon {
+  namespace ray {
+
+    CANNON_CLASS_FORWARD(Texture);
+    CANNON_CLASS_FORWARD(Material);
+    CANNON_CLASS_FORWARD(GridMedium);
+
+    /*!
+     * \brief Class representing a heterogeneous scattering medium filling an
+     * axis-aligned box, with density given on a regular grid and
+     * interpolated trilinearly. A coarse grid of majorants, each bounding
+     * the density over one cell, is built alongside the densities.
+     * Scattering distances are sampled by delta tracking against the
+     * majorant of each cell a ray passes through, so that empty cells are
+     * skipped outright and no boundary geometry is ever intersected. See
+     * Section 11.2 of PBRT (4th edition).
+     */
+    class GridMedium : public Hittable {
+      public:
+
+        GridMedium() = delete;
+
+        /*!
+         * Constructor taking the box filled by the medium and its densities.
+         *
+         * \param min Minimum corner of the box.
+         * \param max Maximum corner of the box.
+         * \param resolution Number of density grid points along each axis,
+         * at least two. Grid points lie on the faces of the box.
+         * \param densities Density at each grid point, with x varying
+         * fastest, then y, then z.
+         * \param density_scale Extinction coefficient of unit density.
+         * \param albedo Color of scattered light.
+         * \param majorant_resolution Number of majorant cells along each
+         * axis.
+         */
+        GridMedium(const Vector3d& min, const Vector3d& max, const Vector3i&
+            resolution, std::vector<float> densities, double density_scale,
+            TexturePtr albedo, const Vector3i& majorant_resolution =
+            Vector3i::Constant(16));
+
+        /*!
+         * Destructor.
+         */
+        virtual ~GridMedium() {}
+
+        /*!
+         * Inherited from Hittable. The hit record is a scattering event
+         * sampled by delta tracking. Shadow rays pass through without
+         * scattering, since their attenuation is estimated with
+         * transmittance() instead.
+         */
+        virtual bool object_space_hit(const Ray& r, double t_min, double t_max, hit_record& rec) const override;
+
+        /*!
+         * Inherited from Hittable.
+         */
+        virtual bool object_space_bounding_box(double time_0, double time_1, Aabb& output_box) const override;
+
+        /*!
+         * Get the interpolated density at an object-space point, or zero
+         * outside the box.
+         */
+        double density(const Vector3d& p) const;
+
+        /*!
+         * Estimate the fraction of light transmitted along an object-space
+         * ray segment by ratio tracking. Unlike sampling a scattering event,
+         * every candidate collision contributes to the estimate, which has
+         * much lower variance than the zero-or-one estimate of whether a
+         * scattering event occurs.
+         *
+         * \param r The ray to estimate transmittance along.
+         * \param t_min Start of the segment.
+         * \param t_max End of the segment.
+         * \param rng Random number generator for sampling collisions.
+         *
+         * \returns Unbiased transmittance estimate in [0, 1].
+         */
+        double transmittance(const Ray& r, double t_min, double t_max, Rng& rng) const;
+
+        /*!
+         * Get the majorant of a cell of the majorant grid.
+         */
+        double majorant(int i, int j, int k) const {
+          return majorants_[(static_cast<size_t>(k) * majorant_resolution_.y() + j) *
+            majorant_resolution_.x() + i];
+        }
+
+        /*!
+         * Get the memory used by densities and majorants.
+         */
+        size_t memory_bytes() const {
+          return (densities_.size() + majorants_.size()) * sizeof(float);
+        }
+
+      private:
+
+        /*!
+         * Get a density grid value.
+         */
+        float density_(int i, int j, int k) const {
+          return densities_[(static_cast<size_t>(k) * resolution_.y() + j) * resolution_.x() + i];
+        }
+
+        /*!
+         * Clip a ray segment to the box.
+         *
+         * \returns Whether any of the segment lies within the box.
+         */
+        bool clip_(const Ray& r, double& t_min, double& t_max) const;
+
+        /*!
+         * Walk the majorant cells overlapping a ray segment in order,
+         * calling f(t_0, t_1, majorant) with each cell's part of the segment
+         * and its majorant, until f returns false.
+         */
+        template <typename F>
+        void traverse_majorants_(const Ray& r, double t_min, double t_max, F f) const;
+
+        Vector3d min_; //!< Minimum corner of the box
+        Vector3d max_; //!< Maximum corner of the box
+        Vector3i resolution_; //!< Number of density grid points along each axis
+        std::vector<float> densities_; //!< Densities, with x varying fastest
+        double density_scale_; //!< Extinction coefficient of unit density
+
+        Vector3i majorant_resolution_; //!< Number of majorant cells along each axis
+        std::vector<float> majorants_; //!< Largest density in each majorant cell, with x varying fastest
+
+        MaterialPtr phase_function_; //!< Material determining color
+    };
+
+  } // namespace ray
+} // namespace cannon
+
+#endif /* ifndef CANNON_RAY_GRID_MEDIUM_H */
@@ -0,0 +1,92 @@
+#include <cmath>
+#include <limits>
+
+#include <catch2/catch.hpp>
+
+#include <cannon/ray/grid_medium.hpp>
+#include <cannon/ray/aabb.hpp>
+#include <cannon/ray/ray.hpp>
+#include <cannon/ray/texture.hpp>
+
+using namespace cannon::ray;
+
+TEST_CASE("GridMedium", "[ray]") {
+  // Density increasing linearly along x, which trilinear interpolation
+  // reproduces exactly
+  Vector3i resolution(5, 2, 2);
+  std::vector<float> densities;
+  for (int k = 0; k < 2; k++)
+    for (int j = 0; j < 2; j++)
+      for (int i = 0; i < 5; i++)
+        densities.push_back(i / 4.0f);
+
+  auto albedo = std::make_shared<SolidColor>(Vector3d(0.5, 0.5, 0.5));
+  GridMedium medium(Vector3d::Zero(), Vector3d::Ones(), resolution,
+      densities, 2.0, albedo, Vector3i(2, 1, 1));
+
+  REQUIRE(medium.density(Vector3d(0.25, 0.5, 0.5)) == Approx(0.25));
+  REQUIRE(medium.density(Vector3d(0.6, 0.1, 0.9)) == Approx(0.6));
+  REQUIRE(medium.density(Vector3d(1.5, 0.5, 0.5)) == 0.0);
+  REQUIRE(medium.majorant(0, 0, 0) == Approx(0.5));
+  REQUIRE(medium.majorant(1, 0, 0) == Approx(1.0));
+
+  Aabb box;
+  REQUIRE(medium.bounding_box(0, 1, box));
+  REQUIRE(box.minimum_.isApprox(Vector3d::Zero()));
+  REQUIRE(box.maximum_.isApprox(Vector3d::Ones()));
+
+  // Optical depth through the box along x is the integral of 2x over [0, 1]
+  double expected = std::exp(-1.0);
+  Ray r(Vector3d(-1, 0.5, 0.5), Vector3d(2, 0, 0));
+  const int n = 20000;
+
+  Rng rng(1);
+  double total = 0.0;
+  for (int i = 0; i < n; i++) {
+    double tr = medium.transmittance(r, 0.0, std::numeric_limits<double>::infinity(), rng);
+    REQUIRE(tr >= 0.0);
+    REQUIRE(tr <= 1.0);
+    total += tr;
+  }
+  REQUIRE(total / n == Approx(expected).margin(0.01));
+
+  int misses = 0;
+  for (int i = 0; i < n; i++) {
+    hit_record rec;
+    if (!medium.hit(r, 0.0, std::numeric_limits<double>::infinity(), rec)) {
+      misses++;
+      continue;
+    }
+
+    REQUIRE(rec.t >= 0.5);
+    REQUIRE(rec.t <= 1.0);
+    REQUIRE(rec.mat_ptr != nullptr);
+  }
+  REQUIRE(static_cast<double>(misses) / n == Approx(expected).margin(0.015));
+
+  // Shadow rays pass through, to be attenuated by transmittance() instead
+  hit_record rec;
+  Ray shadow = r;
+  shadow.shadow_ = true;
+  for (int i = 0; i < 100; i++)
+    REQUIRE_FALSE(medium.hit(shadow, 0.0, std::numeric_limits<double>::infinity(), rec));
+
+  // Segments ending before the box, and rays missing it, are unaffected
+  REQUIRE(medium.transmittance(r, 0.0, 0.5, rng) == 1.0);
+  REQUIRE_FALSE(medium.hit(r, 0.0, 0.5, rec));
+
+  Ray miss(Vector3d(-1, 2, 0.5), Vector3d(1, 0, 0));
+  REQUIRE(medium.transmittance(miss, 0.0, std::numeric_limits<double>::infinity(), rng) == 1.0);
+  REQUIRE_FALSE(medium.hit(miss, 0.0, std::numeric_limits<double>::infinity(), rec));
+
+  // Empty media are skipped without sampling
+  GridMedium empty(Vector3d::Zero(), Vector3d::Ones(), resolution,
+      std::vector<float>(densities.size(), 0.0f), 2.0, albedo);
+  REQUIRE(empty.transmittance(r, 0.0, std::numeric_limits<double>::infinity(), rng) == 1.0);
+  REQUIRE_FALSE(empty.hit(r, 0.0, std::numeric_limits<double>::infinity(), rec));
+
+  REQUIRE_THROWS(GridMedium(Vector3d::Zero(), Vector3d::Ones(), resolution,
+        std::vector<float>(3, 1.0f), 1.0, albedo));
+  REQUIRE_THROWS(GridMedium(Vector3d::Zero(), Vector3d::Ones(), Vector3i(1, 2, 2),
+        std::vector<float>(4, 1.0f), 1.0, albedo));
+}
@@ -0,0 +1,259 @@
+#include <cannon/ray/hdr_image.hpp>
+
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <limits>
+#include <stdexcept>
+
+#include <cannon/ray/film.hpp>
+
+using namespace cannon::ray;
+
+static const char* film_channel_names[film_channel_count] = {"R:half",
+  "G:half", "B:half", "VR:half", "VG:half", "VB:half", "W:float", "N:uint"};
+
+static constexpr float max_half = 65504.0f;
+
+static constexpr int film_pixel_bytes = 6 * 2 + 4 + 4; //!< Six half channels, then a float and an unsigned int
+
+/*!
+ * Get the normalized color of a pixel, or black if it has no samples.
+ */
+static Vector3d normalized_color(const FilmPixel& pixel) {
+  if (pixel.filter_weight_sum_ == 0.0)
+    return Vector3d::Zero();
+
+  return pixel.color_sum_ / pixel.filter_weight_sum_;
+}
+
+/*!
+ * Store a 16-bit value little-endian.
+ */
+static void put_uint16(unsigned char* dst, uint16_t v) {
+  dst[0] = v & 0xff;
+  dst[1] = v >> 8;
+}
+
+/*!
+ * Load a little-endian 16-bit value.
+ */
+static uint16_t get_uint16(const unsigned char* src) {
+  return src[0] | (src[1] << 8);
+}
+
+/*!
+ * Store a 32-bit value little-endian.
+ */
+static void put_uint32(unsigned char* dst, uint32_t v) {
+  for (int i = 0; i < 4; i++)
+    dst[i] = (v >> (8 * i)) & 0xff;
+}
+
+/*!
+ * Load a little-endian 32-bit value.
+ */
+static uint32_t get_uint32(const unsigned char* src) {
+  uint32_t v = 0;
+  for (int i = 0; i < 4; i++)
+    v |= static_cast<uint32_t>(src[i]) << (8 * i);
+  return v;
+}
+
+/*!
+ * Whether this machine stores multibyte values little-endian.
+ */
+static bool is_little_endian() {
+  uint16_t one = 1;
+  unsigned char first_byte;
+  std::memcpy(&first_byte, &one, 1);
+  return first_byte == 1;
+}
+
+uint16_t cannon::ray::float_to_half(float f) {
+  uint32_t bits;
+  std::memcpy(&bits, &f, sizeof(bits));
+
+  uint16_t sign = (bits >> 16) & 0x8000;
+  int exponent = (bits >> 23) & 0xff;
+  uint32_t mantissa = bits & 0x7fffff;
+
+  // Infinity and NaN, keeping NaNs quiet
+  if (exponent == 0xff)
+    return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+
+  int half_exponent = exponent - 127 + 15;
+  if (half_exponent >= 31)
+    return sign | 0x7c00;
+
+  if (half_exponent <= 0) {
+    // Too small even for a subnormal half
+    if (half_exponent < -10)
+      return sign;
+
+    // Subnormal half, including the implicit leading bit
+    mantissa |= 0x800000;
+    unsigned int shift = 14 - half_exponent;
+    uint32_t half_mantissa = mantissa >> shift;
+    uint32_t remainder = mantissa & ((1u << shift) - 1);
+    uint32_t halfway = 1u << (shift - 1);
+    if (remainder > halfway || (remainder == halfway && (half_mantissa & 1)))
+      half_mantissa++;
+
+    return sign | half_mantissa;
+  }
+
+  // Rounding may carry into the exponent, which correctly gives the next
+  // power of two or infinity
+  uint16_t half = sign | (half_exponent << 10) | (mantissa >> 13);
+  uint32_t remainder = mantissa & 0x1fff;
+  if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+    half++;
+
+  return half;
+}
+
+float cannon::ray::half_to_float(uint16_t h) {
+  uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+  uint32_t exponent = (h >> 10) & 0x1f;
+  uint32_t mantissa = h & 0x3ff;
+
+  if (exponent == 0) {
+    float f = std::ldexp(static_cast<float>(mantissa), -24);
+    return sign ? -f : f;
+  }
+
+  uint32_t bits;
+  if (exponent == 31)
+    bits = sign | 0x7f800000 | (mantissa << 13);
+  else
+    bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+
+  float f;
+  std::memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+void cannon::ray::write_pfm(std::ostream& os, const std::vector<FilmPixel>&
+    pixels, unsigned int width, unsigned int height) {
+  if (pixels.size() != width * height)
+    throw std::runtime_error("Pixel count does not match image dimensions");
+
+  // Negative scale marks little-endian data
+  os << "PF\n" << width << ' ' << height << '\n' << (is_little_endian() ? "-1.0" : "1.0") << '\n';
+
+  // PFM stores the bottom row first
+  std::vector<float> row(3 * width);
+  for (unsigned int y = height; y-- > 0;) {
+    for (unsigned int x = 0; x < width; x++) {
+      Vector3d color = normalized_color(pixels[y * width + x]);
+      for (int c = 0; c < 3; c++)
+        row[3 * x + c] = static_cast<float>(color[c]);
+    }
+
+    os.write(reinterpret_cast<const char*>(row.data()), row.size() * sizeof(float));
+  }
+}
+
+void cannon::ray::write_film_channels(std::ostream& os, const
+    std::vector<FilmPixel>& pixels, unsigned int width, unsigned int height) {
+  if (pixels.size() != width * height)
+    throw std::runtime_error("Pixel count does not match image dimensions");
+
+  os << "CFILM\n" << width << ' ' << height << ' ' << film_channel_count << '\n';
+  for (int c = 0; c < film_channel_count; c++)
+    os << film_channel_names[c] << (c + 1 < film_channel_count ? ' ' : '\n');
+
+  std::vector<unsigned char> row(film_pixel_bytes * width);
+  for (unsigned int y = 0; y < height; y++) {
+    for (unsigned int x = 0; x < width; x++) {
+      const FilmPixel& pixel = pixels[y * width + x];
+      Vector3d color = normalized_color(pixel);
+      Vector3d variance = pixel.variance();
+
+      // Directly visible emitters and variance from rare bright samples may
+      // exceed half range, so they are clamped rather than becoming infinite
+      float half_channels[6] = {
+        std::min(max_half, static_cast<float>(color.x())),
+        std::min(max_half, static_cast<float>(color.y())),
+        std::min(max_half, static_cast<float>(color.z())),
+        std::min(max_half, static_cast<float>(variance.x())),
+        std::min(max_half, static_cast<float>(variance.y())),
+        std::min(max_half, static_cast<float>(variance.z()))
+      };
+
+      unsigned char* dst = &row[film_pixel_bytes * x];
+      for (int c = 0; c < 6; c++)
+        put_uint16(dst + 2 * c, float_to_half(half_channels[c]));
+
+      uint32_t weight_bits;
+      float weight = static_cast<float>(pixel.filter_weight_sum_);
+      std::memcpy(&weight_bits, &weight, sizeof(weight_bits));
+      put_uint32(dst + 12, weight_bits);
+      put_uint32(dst + 16, pixel.sample_count_);
+    }
+
+    os.write(reinterpret_cast<const char*>(row.data()), row.size());
+  }
+}
+
+std::vector<FilmPixel> cannon::ray::read_film_channels(std::istream& is,
+    unsigned int& width, unsigned int& height) {
+  std::string magic;
+  int channel_count;
+  is >> magic >> width >> height >> channel_count;
+  if (!is || magic != "CFILM")
+    throw std::runtime_error("Stream does not contain film channels");
+
+  if (channel_count != film_channel_count)
+    throw std::runtime_error("Unsupported number of film channels");
+
+  for (int c = 0; c < film_channel_count; c++) {
+    std::string name;
+    is >> name;
+    if (name != film_channel_names[c])
+      throw std::runtime_error("Unexpected film channel " + name);
+  }
+
+  // Single newline before binary data
+  is.get();
+
+  std::vector<FilmPixel> pixels(width * height);
+  std::vector<unsigned char> row(film_pixel_bytes * width);
+  for (unsigned int y = 0; y < height; y++) {
+    if (!is.read(reinterpret_cast<char*>(row.data()), row.size()))
+      throw std::runtime_error("Film channel data ended early");
+
+    for (unsigned int x = 0; x < width; x++) {
+      const unsigned char* src = &row[film_pixel_bytes * x];
+      float half_channels[6];
+      for (int c = 0; c < 6; c++)
+        half_channels[c] = half_to_float(get_uint16(src + 2 * c));
+
+      float weight;
+      uint32_t weight_bits = get_uint32(src + 12);
+      std::memcpy(&weight, &weight_bits, sizeof(weight));
+      unsigned int sample_count = get_uint32(src + 16);
+
+      for (int c = 0; c < 6; c++)
+        if (!std::isfinite(half_channels[c]))
+          throw std::runtime_error("Film channels contain a non-finite color or variance");
+      if (!std::isfinite(weight))
+        throw std::runtime_error("Film channels contain a non-finite filter weight sum");
+
+      // The mean of unfiltered samples is not stored, so it is approximated
+      // by the filtered color
+      FilmPixel& pixel = pixels[y * width + x];
+      Vector3d color(half_channels[0], half_channels[1], half_channels[2]);
+      pixel.filter_weight_sum_ = weight;
+      pixel.color_sum_ = color * pixel.filter_weight_sum_;
+      pixel.sample_count_ = sample_count;
+      pixel.sample_mean_ = color;
+      if (pixel.sample_count_ > 1)
+        pixel.sample_m2_ = Vector3d(half_channels[3], half_channels[4],
+            half_channels[5]) * (pixel.sample_count_ - 1);
+    }
+  }
+
+  return pixels;
+}
@@ -0,0 +1,105 @@
+#pragma once
+#ifndef CANNON_RAY_HDR_IMAGE_H
+#define CANNON_RAY_HDR_IMAGE_H
+
+/*!
+ * \file cannon/ray/hdr_image.hpp
+ * \brief File containing functions for writing and reading high dynamic
+ * range film images, as single-precision PFM or as half-precision film
+ * channels which keep enough per-pixel data to merge renders later.
+ */
+
+#include <iostream>
+#include <vector>
+#include <cstdint>
+
+#include <Eigen/Dense>
+
+using namespace Eigen;
+
+namespace cannon {
+  namespace ray {
+
+    struct FilmPixel;
+
+    /*!
+     * Number of channels stored per pixel in film channel images: normalized
+     * RGB color and per-channel sample variance as half floats, then filter
+     * weight sum as a float and sample count as an unsigned int.
+     */
+    static constexpr int film_channel_count = 8;
+
+    /*!
+     * Convert a float to IEEE 754 half precision, rounding to nearest even.
+     * Values too large for half precision become infinity.
+     *
+     * \param f The float to convert.
+     *
+     * \returns Bits of the half precision value.
+     */
+    uint16_t float_to_half(float f);
+
+    /*!
+     * Convert an IEEE 754 half precision value to a float. Conversion is
+     * exact.
+     *
+     * \param h Bits of the half precision value.
+     *
+     * \returns The float value.
+     */
+    float half_to_float(uint16_t h);
+
+    /*!
+     * Write film pixels as a little-endian PFM image to the input stream,
+     * including the header. Colors are normalized by filter weight but
+     * otherwise written linearly, without clamping or gamma correction.
+     *
+     * \param os The stream to write this image to.
+     * \param pixels Vector of pixels to write, top row first.
+     * \param width Width of the image.
+     * \param height Height of the image.
+     */
+    void write_pfm(std::ostream& os, const std::vector<FilmPixel>& pixels,
+        unsigned int width, unsigned int height);
+
+    /*!
+     * Write film pixels as film channels to the input stream. The format is
+     * a text header
+     *
+     *     CFILM
+     *     <width> <height> <channel count>
+     *     R:half G:half B:half VR:half VG:half VB:half W:float N:uint
+     *
+     * followed by the little-endian channels of each pixel, top row first.
+     * Colors are normalized by filter weight, so that values stay within
+     * half-precision range, and colors and variances beyond it are clamped
+     * to the largest half. The filter weight sum grows with the sample
+     * count, so it and the count are stored at full 32-bit precision.
+     *
+     * \param os The stream to write this image to.
+     * \param pixels Vector of pixels to write, top row first.
+     * \param width Width of the image.
+     * \param height Height of the image.
+     */
+    void write_film_channels(std::ostream& os, const std::vector<FilmPixel>&
+        pixels, unsigned int width, unsigned int height);
+
+    /*!
+     * Read film pixels written by write_film_channels(). The running sample
+     * statistics of each pixel are reconstructed from its variance and sample
+     * count, so read pixels can be merged with others. Throws if any stored
+     * value is not finite.
+     *
+     * \param is The stream to read from.
+     * \param width Set to the width of the image.
+     * \param height Set to the height of the image.
+     *
+     * \returns The pixels read, top row first.
+     */
+    std::vector<FilmPixel> read_film_channels(std::istream& is, unsigned int&
+        width, unsigned int& height);
+
+  } // namespace ray
+} // namespace cannon
+
+#endif /* ifndef CANNON_RAY_HDR_IMAGE_H */
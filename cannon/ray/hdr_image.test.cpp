@@ -0,0 +1,117 @@
+#include <cmath>
+#include <limits>
+#include <sstream>
+
+#include <catch2/catch.hpp>
+
+#include <cannon/ray/hdr_image.hpp>
+#include <cannon/ray/film.hpp>
+#include <cannon/math/random_double.hpp>
+
+using namespace cannon::ray;
+using namespace cannon::math;
+
+TEST_CASE("HdrImage", "[ray]") {
+  // Half precision conversion
+  REQUIRE(float_to_half(0.0f) == 0x0000);
+  REQUIRE(float_to_half(-0.0f) == 0x8000);
+  REQUIRE(float_to_half(1.0f) == 0x3c00);
+  REQUIRE(float_to_half(-2.0f) == 0xc000);
+  REQUIRE(float_to_half(65504.0f) == 0x7bff);
+  REQUIRE(float_to_half(1e6f) == 0x7c00);
+  REQUIRE(float_to_half(std::ldexp(1.0f, -24)) == 0x0001);
+  REQUIRE(float_to_half(std::ldexp(1.0f, -26)) == 0x0000);
+  REQUIRE(std::isnan(half_to_float(float_to_half(std::nanf("")))));
+
+  // Ties round to even
+  REQUIRE(float_to_half(1.0f + std::ldexp(1.0f, -11)) == 0x3c00);
+  REQUIRE(float_to_half(1.0f + 3 * std::ldexp(1.0f, -11)) == 0x3c02);
+
+  // Every finite half converts to float and back exactly
+  for (uint32_t h = 0; h < 0x10000; h++) {
+    if ((h & 0x7c00) == 0x7c00)
+      continue;
+    REQUIRE(float_to_half(half_to_float(h)) == h);
+  }
+
+  for (int i = 0; i < 1000; i++) {
+    float f = random_double(-100, 100);
+    REQUIRE(half_to_float(float_to_half(f)) == Approx(f).epsilon(1e-3));
+  }
+
+  // Film with random pixels
+  unsigned int width = 5, height = 3;
+  std::vector<FilmPixel> pixels(width * height);
+  for (auto& pixel : pixels) {
+    for (int s = 0; s < 10; s++) {
+      Vector3d c = random_vec(0, 1);
+      pixel.color_sum_ += c;
+      pixel.filter_weight_sum_ += 1.0;
+      pixel.add_sample_statistics(c);
+    }
+  }
+
+  // PFM stores linear colors, bottom row first
+  std::stringstream pfm;
+  write_pfm(pfm, pixels, width, height);
+  std::string magic;
+  unsigned int w, h;
+  double scale;
+  pfm >> magic >> w >> h >> scale;
+  pfm.get();
+  REQUIRE(magic == "PF");
+  REQUIRE(w == width);
+  REQUIRE(h == height);
+
+  std::vector<float> data(3 * width * height);
+  pfm.read(reinterpret_cast<char*>(data.data()), data.size() * sizeof(float));
+  REQUIRE(pfm.gcount() == (std::streamsize)(data.size() * sizeof(float)));
+  Vector3d top_left = pixels[0].color_sum_ / pixels[0].filter_weight_sum_;
+  REQUIRE(data[3 * (height - 1) * width] == Approx(top_left.x()));
+
+  // Film channels round trip to half precision
+  std::stringstream channels;
+  write_film_channels(channels, pixels, width, height);
+  auto read_pixels = read_film_channels(channels, w, h);
+  REQUIRE(w == width);
+  REQUIRE(h == height);
+  REQUIRE(read_pixels.size() == pixels.size());
+  for (unsigned int i = 0; i < pixels.size(); i++) {
+    REQUIRE(read_pixels[i].filter_weight_sum_ == Approx(pixels[i].filter_weight_sum_));
+    REQUIRE(read_pixels[i].sample_count_ == pixels[i].sample_count_);
+    REQUIRE(read_pixels[i].color_sum_.isApprox(pixels[i].color_sum_, 1e-3));
+    REQUIRE(read_pixels[i].variance().isApprox(pixels[i].variance(), 1e-3));
+  }
+
+  // Weight sums and sample counts beyond half range stay exact
+  std::vector<FilmPixel> dense(1);
+  dense[0].color_sum_ = Vector3d(0.25, 0.5, 0.75) * 100000.0;
+  dense[0].filter_weight_sum_ = 100000.0;
+  dense[0].sample_count_ = 6000;
+  std::stringstream dense_channels;
+  write_film_channels(dense_channels, dense, 1, 1);
+  auto read_dense = read_film_channels(dense_channels, w, h);
+  REQUIRE(read_dense[0].filter_weight_sum_ == 100000.0);
+  REQUIRE(read_dense[0].sample_count_ == 6000);
+  REQUIRE(read_dense[0].color_sum_.isApprox(dense[0].color_sum_, 1e-3));
+
+  // Colors beyond half range are clamped, so the file can still be read
+  std::vector<FilmPixel> bright(1);
+  bright[0].color_sum_ = Vector3d(1e6, 0.5, 0.25);
+  bright[0].filter_weight_sum_ = 1.0;
+  bright[0].sample_count_ = 1;
+  std::stringstream bright_channels;
+  write_film_channels(bright_channels, bright, 1, 1);
+  auto read_bright = read_film_channels(bright_channels, w, h);
+  REQUIRE(read_bright[0].color_sum_.x() == 65504.0);
+  REQUIRE(read_bright[0].color_sum_.y() == 0.5);
+
+  // Non-finite values are rejected on read
+  dense[0].filter_weight_sum_ = std::numeric_limits<double>::infinity();
+  std::stringstream inf_channels;
+  write_film_channels(inf_channels, dense, 1, 1);
+  REQUIRE_THROWS(read_film_channels(inf_channels, w, h));
+
+  std::stringstream bad("P3\n1 1\n255\n");
+  REQUIRE_THROWS(read_film_channels(bad, w, h));
+}
@@ -1,5 +1,7 @@
 #include <cannon/ray/hittable.hpp>
 
+#include <cmath>
+
 #include <cannon/ray/ray.hpp>
 #include <cannon/ray/aabb.hpp>
 
@@ -8,26 +10,119 @@ using namespace cannon::ray;
 void hit_record::set_face_normal(const Ray& r, const Vector3d& outward_normal) {
   front_face = r.dir_.dot(outward_normal) < 0;
   normal = front_face ? outward_normal : -outward_normal;
+  geometric_normal = normal;
+}
+
+Ray hit_record::spawn_ray(const Vector3d& d, double time) const {
+  return Ray(offset_ray_origin(p, p_error, geometric_normal, d), d, time);
+}
+
+void hit_record::compute_differentials(const Ray& r) {
+  dudx = dvdx = dudy = dvdy = 0;
+
+  double width = r.cone_width(t);
+  if (width <= 0 || (dpdu.isZero() && dpdv.isZero()))
+    return;
+
+  // Axes of the cone footprint on the surface, across the ray and along
+  // its projection onto the surface
+  Vector3d d = r.dir_.normalized();
+  Vector3d across = d.cross(geometric_normal);
+  if (across.squaredNorm() < 1e-12)
+    across = geometric_normal.unitOrthogonal();
+  across.normalize();
+  Vector3d along = geometric_normal.cross(across);
+
+  // Grazing angles stretch the footprint without bound, so the stretch is
+  // clamped; filters clamp anisotropy more tightly anyway
+  double cos_theta = std::max(std::fabs(d.dot(geometric_normal)), 1e-2);
+  Vector3d dpdx = width * across;
+  Vector3d dpdy = (width / cos_theta) * along;
+
+  // Solve dpdx = dudx * dpdu + dvdx * dpdv (and likewise for y) in the
+  // least-squares sense, since the footprint need not lie exactly in the
+  // tangent plane
+  Matrix2d ata;
+  ata << dpdu.dot(dpdu), dpdu.dot(dpdv),
+         dpdu.dot(dpdv), dpdv.dot(dpdv);
+  double det = ata.determinant();
+  if (std::fabs(det) < 1e-24)
+    return;
+
+  Matrix2d ata_inv = ata.inverse();
+  Vector2d dx = ata_inv * Vector2d(dpdu.dot(dpdx), dpdv.dot(dpdx));
+  Vector2d dy = ata_inv * Vector2d(dpdu.dot(dpdy), dpdv.dot(dpdy));
+
+  if (!dx.allFinite() || !dy.allFinite())
+    return;
+
+  dudx = dx[0];
+  dvdx = dx[1];
+  dudy = dy[0];
+  dvdy = dy[1];
 }
 
 bool Hittable::hit(const Ray& r, double t_min, double t_max, hit_record& rec) const { 
   Vector3d object_space_origin = (*world_to_object_) * r.orig_;
   Vector3d object_space_dir = world_to_object_->linear() * r.dir_;
 
+  // Rounding in the transform may move the origin of a ray spawned from a
+  // surface back onto the surface, so the origin is advanced along the ray
+  // past its error bound, and hit distances corrected afterward
+  Vector3d o_error = error_gamma(3) * (world_to_object_->linear().cwiseAbs() *
+      r.orig_.cwiseAbs() + world_to_object_->translation().cwiseAbs());
+  double length_squared = object_space_dir.squaredNorm();
+  double dt = 0.0;
+  if (length_squared > 0) {
+    dt = object_space_dir.cwiseAbs().dot(o_error) / length_squared;
+    object_space_origin += dt * object_space_dir;
+  }
+
   Ray object_space_ray(object_space_origin, object_space_dir, r.time_);
+  object_space_ray.shadow_ = r.shadow_;
 
-  if (!object_space_hit(object_space_ray, t_min, t_max, rec))
+  if (!object_space_hit(object_space_ray, t_min, t_max - dt, rec))
     return false;
 
-  Vector3d world_space_p = (*object_to_world_) * rec.p;
-  Vector3d world_space_normal = object_to_world_->linear() * rec.normal;
-
-  rec.p = world_space_p;
-  rec.set_face_normal(object_space_ray, world_space_normal);
+  // Normals transform by the inverse transpose, which keeps them
+  // perpendicular to surfaces under non-uniform scaling. The sign of the
+  // normal's dot product with the ray direction is unchanged, so the
+  // normal still faces against the ray and front_face stays valid.
+  Vector3d object_space_p = rec.p;
+  rec.t += dt;
+  rec.p = (*object_to_world_) * object_space_p;
+  rec.p_error = (error_gamma(3) + 1) * (object_to_world_->linear().cwiseAbs() * rec.p_error) +
+    error_gamma(3) * (object_to_world_->linear().cwiseAbs() * object_space_p.cwiseAbs() +
+        object_to_world_->translation().cwiseAbs());
+  rec.normal = (world_to_object_->linear().transpose() * rec.normal).normalized();
+  rec.geometric_normal = (world_to_object_->linear().transpose() * rec.geometric_normal).normalized();
+  rec.dpdu = object_to_world_->linear() * rec.dpdu;
+  rec.dpdv = object_to_world_->linear() * rec.dpdv;
 
   return true;
 }
 
+double Hittable::pdf_value(const Vector3d& origin, const Vector3d& direction, double time) const {
+  // Densities are computed in object space, then converted to world-space
+  // solid angle. A linear map M takes a unit direction w to a solid angle
+  // scaled by |det M| / |M w|^3, which is one for rigid transforms and
+  // uniform scales, but not for non-uniform scales.
+  const auto& linear = world_to_object_->linear();
+  Vector3d object_space_direction = linear * direction;
+  double pdf = object_space_pdf_value((*world_to_object_) * origin,
+      object_space_direction, time);
+  if (pdf == 0.0)
+    return 0.0;
+
+  double stretch = object_space_direction.norm() / direction.norm();
+  return pdf * std::fabs(linear.determinant()) / (stretch * stretch * stretch);
+}
+
+Vector3d Hittable::random_direction(const Vector3d& origin, double time, Rng& rng) const {
+  return object_to_world_->linear() *
+    object_space_random_direction((*world_to_object_) * origin, time, rng);
+}
+
 bool Hittable::bounding_box(double time_0, double time_1, Aabb& output_box) const {
   Aabb object_space_box;
   bool has_box = object_space_bounding_box(time_0, time_1, object_space_box);
@@ -10,10 +10,13 @@
 
 #include <Eigen/Dense>
 
+#include <cannon/math/rng.hpp>
 #include <cannon/utils/class_forward.hpp>
 
 using namespace Eigen;
 
+using namespace cannon::math;
+
 namespace cannon {
   namespace ray {
 
@@ -26,19 +29,51 @@ namespace cannon {
      */
     struct hit_record {
       Vector3d p; //!< Point where ray hit geometry
+      Vector3d p_error = Vector3d::Zero(); //!< Bound on absolute rounding error in each component of p
       Vector3d normal; //!< Normal at hit point
-      std::shared_ptr<Material> mat_ptr; //!< Pointer to material for hit surface
+      Vector3d geometric_normal; //!< Normal of the underlying surface at hit point, which may differ from an interpolated normal
+      const Material* mat_ptr; //!< Material for hit surface, owned by the hit geometry
 
       double t; //!< Distance of hit along ray
       double u; //!< Horizontal surface texture coordinate at hit point
       double v; //!< Vertical surface texture coordinate at hit point
 
+      Vector3d dpdu = Vector3d::Zero(); //!< Partial derivative of hit point with respect to u, or zero if unknown
+      Vector3d dpdv = Vector3d::Zero(); //!< Partial derivative of hit point with respect to v, or zero if unknown
+      double dudx = 0, dvdx = 0; //!< Texture-space footprint of the hit ray along one axis
+      double dudy = 0, dvdy = 0; //!< Texture-space footprint of the hit ray along the other axis
+
       bool front_face; //!< Whether the ray originated from outside the geometry
 
       /*!
-       * Method to store normal with direction always opposite intersecting ray.
+       * Method to store normal with direction always opposite intersecting
+       * ray. The geometric normal is set to the same value.
        */
       void set_face_normal(const Ray& r, const Vector3d& outward_normal);
+
+      /*!
+       * Create a ray leaving the hit point, with its origin offset by the
+       * error bound on the hit point so that it cannot hit the same surface
+       * again at distance zero.
+       *
+       * \param d Direction of the new ray.
+       * \param time Time of the new ray.
+       *
+       * \returns The spawned ray.
+       */
+      Ray spawn_ray(const Vector3d& d, double time) const;
+
+      /*!
+       * Compute the texture-space footprint of the hit ray from its cone
+       * and the surface partial derivatives, for filtered texture lookups.
+       * The footprint is an ellipse on the surface, as wide as the cone
+       * across the ray and stretched along it at grazing angles. Rays
+       * without a cone, and surfaces without partial derivatives, have a
+       * zero footprint.
+       *
+       * \param r The ray that produced this hit.
+       */
+      void compute_differentials(const Ray& r);
     };
 
     /*!
@@ -62,6 +97,16 @@ namespace cannon {
           object_to_world_(object_to_world),
           world_to_object_(std::make_shared<Affine3d>(object_to_world->inverse())) {}
 
+        /*!
+         * Constructor taking both transforms, so that geometry sharing a
+         * transform (e.g. the triangles of a mesh) can share its inverse
+         * rather than each computing and storing a copy.
+         */
+        Hittable(std::shared_ptr<Affine3d> object_to_world,
+            std::shared_ptr<Affine3d> world_to_object) :
+          object_to_world_(object_to_world),
+          world_to_object_(world_to_object) {}
+
         /*!
          * Method to test whether this geometry is hit by the input ray in
          * world space between distance t_min and t_max.
@@ -70,6 +115,8 @@ namespace cannon {
          * \param t_min Minimal distance along the ray to register an intersection.
          * \param t_max Maximum distance along the ray to register an intersection.
          * \param rec Hit record in which to put details about the intersection.
+         * Only modified if there is an intersection, so that one record can
+         * be passed to successive tests against closer and closer t_max.
          *
          * \returns Whether the ray intersects this geometry.
          */
@@ -110,6 +157,63 @@ namespace cannon {
          */
         virtual bool object_space_bounding_box(double time_0, double time_1, Aabb& output_box) const = 0;
 
+        /*!
+         * Method to compute the solid angle density with which
+         * random_direction() generates the input world-space direction from
+         * the input origin. Used for sampling lights directly.
+         *
+         * \param origin Point from which directions are sampled.
+         * \param direction Direction to compute the density of.
+         * \param time Time at which directions are sampled.
+         *
+         * \returns The density, or zero if this geometry cannot be sampled.
+         */
+        virtual double pdf_value(const Vector3d& origin, const Vector3d& direction, double time) const;
+
+        /*!
+         * Method to generate a world-space direction from the input origin
+         * towards a random point on this geometry.
+         *
+         * \param origin Point from which to sample a direction.
+         * \param time Time at which to sample a direction.
+         * \param rng Random number generator for sampling.
+         *
+         * \returns The sampled direction, not necessarily normalized.
+         */
+        virtual Vector3d random_direction(const Vector3d& origin, double time, Rng& rng) const;
+
+        /*!
+         * Method to compute the solid angle density of a direction in object
+         * space, as in pdf_value(). Geometry which can be sampled as a light
+         * should override this.
+         *
+         * \param origin Point from which directions are sampled.
+         * \param direction Direction to compute the density of.
+         * \param time Time at which directions are sampled.
+         *
+         * \returns The density, or zero if this geometry cannot be sampled.
+         */
+        virtual double object_space_pdf_value(const Vector3d& /*origin*/,
+            const Vector3d& /*direction*/, double /*time*/) const {
+          return 0.0;
+        }
+
+        /*!
+         * Method to generate a random direction in object space, as in
+         * random_direction(). Geometry which can be sampled as a light should
+         * override this.
+         *
+         * \param origin Point from which to sample a direction.
+         * \param time Time at which to sample a direction.
+         * \param rng Random number generator for sampling.
+         *
+         * \returns The sampled direction, not necessarily normalized.
+         */
+        virtual Vector3d object_space_random_direction(const Vector3d& /*origin*/,
+            double /*time*/, Rng& /*rng*/) const {
+          return Vector3d::UnitX();
+        }
+
       public:
         std::shared_ptr<Affine3d> object_to_world_;
         std::shared_ptr<Affine3d> world_to_object_;
@@ -1,8 +1,10 @@
 #include <cannon/ray/hittable_list.hpp>
 
 #include <cannon/ray/aabb.hpp>
+#include <cannon/math/random_double.hpp>
 
 using namespace cannon::ray;
+using namespace cannon::math;
 
 void HittableList::clear() {
   objects_.clear();
@@ -13,15 +15,15 @@ void HittableList::add(std::shared_ptr<Hittable> obj) {
 }
 
 bool HittableList::object_space_hit(const Ray& r, double t_min, double t_max, hit_record& rec) const {
-  hit_record temp_rec;
   bool hit_anything = false;
   auto closest = t_max;
 
+  // Hit records are only written on a hit, which is always closer than any
+  // previous one, so there is no need for a temporary record
   for (const auto& obj : objects_) {
-    if (obj->hit(r, t_min, closest, temp_rec)) {
+    if (obj->hit(r, t_min, closest, rec)) {
       hit_anything = true;
-      closest = temp_rec.t;
-      rec = temp_rec;
+      closest = rec.t;
     }
   }
 
@@ -45,3 +47,24 @@ bool HittableList::object_space_bounding_box(double time_0, double time_1, Aabb&
 
   return true;
 }
+
+double HittableList::object_space_pdf_value(const Vector3d& origin, const
+    Vector3d& direction, double time) const {
+  if (objects_.empty())
+    return 0.0;
+
+  double sum = 0.0;
+  for (const auto& object : objects_)
+    sum += object->pdf_value(origin, direction, time);
+
+  return sum / objects_.size();
+}
+
+Vector3d HittableList::object_space_random_direction(const Vector3d& origin,
+    double time, Rng& rng) const {
+  if (objects_.empty())
+    return Vector3d::UnitX();
+
+  size_t i = rng.uniform_uint32(objects_.size());
+  return objects_[i]->random_direction(origin, time, rng);
+}
@@ -58,6 +58,20 @@ namespace cannon {
          */
         virtual bool object_space_bounding_box(double time_0, double time_1, Aabb& output_box) const override;
 
+        /*!
+         * Inherited from Hittable. The density of sampling a uniformly chosen
+         * object in this list.
+         */
+        virtual double object_space_pdf_value(const Vector3d& origin, const
+            Vector3d& direction, double time) const override;
+
+        /*!
+         * Inherited from Hittable. Samples a direction towards a uniformly
+         * chosen object in this list.
+         */
+        virtual Vector3d object_space_random_direction(const Vector3d& origin,
+            double time, Rng& rng) const override;
+
       public:
         std::vector<std::shared_ptr<Hittable>> objects_; //!< Internal vector of Hittables.
 
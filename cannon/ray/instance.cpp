@@ -0,0 +1,58 @@
+#include <cannon/ray/instance.hpp>
+
+#include <stdexcept>
+
+#include <cannon/ray/aabb.hpp>
+#include <cannon/ray/hittable_list.hpp>
+#include <cannon/ray/linear_bvh.hpp>
+#include <cannon/utils/statistics.hpp>
+
+using namespace cannon::ray;
+using namespace cannon::utils;
+
+STAT_COUNTER("Integrator/Instance hit tests", nInstanceHitTests);
+
+Instance::Instance(std::shared_ptr<Affine3d> object_to_world, HittablePtr
+    object) : Hittable(object_to_world), object_(object) {
+  if (!object_)
+    throw std::runtime_error("Instance created without geometry");
+}
+
+bool Instance::object_space_hit(const Ray& r, double t_min, double t_max, hit_record& rec) const {
+  ++nInstanceHitTests;
+
+  // Object space here is the world space of the shared geometry
+  return object_->hit(r, t_min, t_max, rec);
+}
+
+bool Instance::object_space_bounding_box(double time_0, double time_1, Aabb& output_box) const {
+  return object_->bounding_box(time_0, time_1, output_box);
+}
+
+double Instance::object_space_pdf_value(const Vector3d& origin, const
+    Vector3d& direction, double time) const {
+  return object_->pdf_value(origin, direction, time);
+}
+
+Vector3d Instance::object_space_random_direction(const Vector3d& origin,
+    double time, Rng& rng) const {
+  return object_->random_direction(origin, time, rng);
+}
+
+// Public Functions
+
+LinearBvhPtr cannon::ray::make_bottom_level_bvh(HittableListPtr geometry,
+    double time_0, double time_1, unsigned int num_threads) {
+  auto t = std::make_shared<Affine3d>(Affine3d::Identity());
+  return std::make_shared<LinearBvh>(t, geometry, time_0, time_1, 4, num_threads);
+}
+
+HittableListPtr cannon::ray::make_instances(HittablePtr object, const
+    std::vector<Affine3d, Eigen::aligned_allocator<Affine3d>>& transforms) {
+  auto instances = std::make_shared<HittableList>();
+
+  for (auto& transform : transforms)
+    instances->add(std::make_shared<Instance>(std::make_shared<Affine3d>(transform), object));
+
+  return instances;
+}
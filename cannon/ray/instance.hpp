@@ -0,0 +1,111 @@
+#pragma once
+#ifndef CANNON_RAY_INSTANCE_H
+#define CANNON_RAY_INSTANCE_H
+
+/*!
+ * \file cannon/ray/instance.hpp
+ * \brief File containing Instance class definition and instancing helpers.
+ */
+
+#include <memory>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <cannon/ray/hittable.hpp>
+#include <cannon/utils/class_forward.hpp>
+
+using namespace Eigen;
+
+namespace cannon {
+  namespace ray {
+
+    CANNON_CLASS_FORWARD(Hittable);
+    CANNON_CLASS_FORWARD(HittableList);
+    CANNON_CLASS_FORWARD(LinearBvh);
+
+    /*!
+     * \brief Class representing a transformed copy of shared geometry. The
+     * shared geometry is usually a bottom-level LinearBvh built once over a
+     * model in its own space; any number of instances can refer to it, each
+     * storing only its transform. Instances are in turn collected into a
+     * top-level LinearBvh, so that a scene of many copies of a few models
+     * takes memory proportional to the unique geometry.
+     */
+    class Instance : public Hittable {
+      public:
+
+        Instance() = delete;
+
+        /*!
+         * Constructor taking the transform from the shared geometry's space
+         * to world space, and the shared geometry.
+         */
+        Instance(std::shared_ptr<Affine3d> object_to_world, HittablePtr object);
+
+        /*!
+         * Destructor.
+         */
+        virtual ~Instance() {}
+
+        /*!
+         * Inherited from Hittable.
+         */
+        virtual bool object_space_hit(const Ray& r, double t_min, double t_max, hit_record& rec) const override;
+
+        /*!
+         * Inherited from Hittable.
+         */
+        virtual bool object_space_bounding_box(double time_0, double time_1, Aabb& output_box) const override;
+
+        /*!
+         * Inherited from Hittable.
+         */
+        virtual double object_space_pdf_value(const Vector3d& origin, const
+            Vector3d& direction, double time) const override;
+
+        /*!
+         * Inherited from Hittable.
+         */
+        virtual Vector3d object_space_random_direction(const Vector3d& origin,
+            double time, Rng& rng) const override;
+
+      public:
+        HittablePtr object_; //!< Shared geometry that this is an instance of
+
+    };
+
+    // Public Functions
+
+    /*!
+     * Build a bottom-level hierarchy over geometry to be instanced. The
+     * hierarchy has the identity transform, so the geometry stays in its own
+     * space.
+     *
+     * \param geometry The geometry to instance, in its own space.
+     * \param time_0 Start time for bounding boxes.
+     * \param time_1 End time for bounding boxes.
+     * \param num_threads Number of threads to build with.
+     *
+     * \returns The bottom-level hierarchy.
+     */
+    LinearBvhPtr make_bottom_level_bvh(HittableListPtr geometry, double
+        time_0, double time_1, unsigned int num_threads = 1);
+
+    /*!
+     * Make one instance of shared geometry for each input transform.
+     *
+     * \param object The shared geometry.
+     * \param transforms Transform from the geometry's space to world space
+     * for each instance.
+     *
+     * \returns A list of the instances, to be built into a top-level
+     * hierarchy.
+     */
+    HittableListPtr make_instances(HittablePtr object, const
+        std::vector<Affine3d, Eigen::aligned_allocator<Affine3d>>& transforms);
+
+  } // namespace ray
+} // namespace cannon
+
+#endif /* ifndef CANNON_RAY_INSTANCE_H */
@@ -0,0 +1,111 @@
+#include <cmath>
+
+#include <catch2/catch.hpp>
+
+#include <cannon/ray/instance.hpp>
+#include <cannon/ray/sphere.hpp>
+#include <cannon/ray/aa_rect.hpp>
+#include <cannon/ray/hittable_list.hpp>
+#include <cannon/ray/linear_bvh.hpp>
+#include <cannon/ray/material.hpp>
+#include <cannon/ray/aabb.hpp>
+#include <cannon/ray/ray.hpp>
+#include <cannon/math/random_double.hpp>
+
+using namespace cannon::ray;
+using namespace cannon::math;
+
+TEST_CASE("Instance", "[ray]") {
+  auto mat = std::make_shared<Lambertian>(Vector3d(0.5, 0.5, 0.5));
+  auto geometry = std::make_shared<HittableList>();
+  geometry->add(std::make_shared<Sphere>(Vector3d::Zero(), 1, mat));
+  auto blas = make_bottom_level_bvh(geometry, 0, 1);
+
+  // Many instances share one bottom-level hierarchy
+  std::vector<Affine3d, Eigen::aligned_allocator<Affine3d>> transforms;
+  for (int i = 0; i < 100; i++) {
+    Affine3d t = Affine3d::Identity();
+    t.translate(Vector3d(3 * i, 0, 0));
+    transforms.push_back(t);
+  }
+
+  auto instances = make_instances(blas, transforms);
+  REQUIRE(instances->objects_.size() == 100);
+  REQUIRE(blas.use_count() == 101);
+
+  auto t = std::make_shared<Affine3d>(Affine3d::Identity());
+  LinearBvh tlas(t, instances, 0, 1);
+
+  Aabb box;
+  REQUIRE(tlas.bounding_box(0, 1, box));
+  REQUIRE(box.minimum_.isApprox(Vector3d(-1, -1, -1)));
+  REQUIRE(box.maximum_.isApprox(Vector3d(298, 1, 1)));
+
+  // Rays hit each instance where it was placed
+  hit_record rec;
+  for (int i : {0, 17, 99}) {
+    Ray r(Vector3d(3 * i, 0, -5), Vector3d(0, 0, 1));
+    REQUIRE(tlas.hit(r, 0.001, 100.0, rec));
+    REQUIRE(rec.t == Approx(4.0));
+    REQUIRE(rec.p.isApprox(Vector3d(3 * i, 0, -1)));
+    REQUIRE(rec.normal.isApprox(Vector3d(0, 0, -1)));
+    REQUIRE(rec.front_face);
+  }
+
+  REQUIRE(!tlas.hit(Ray(Vector3d(1.5, 0, -5), Vector3d(0, 0, 1)), 0.001, 100.0, rec));
+
+  // Non-uniformly scaled instances get correct normals, i.e. the gradient
+  // of x^2 / 4 + y^2 + z^2 for a sphere stretched along x
+  auto scale = std::make_shared<Affine3d>(Affine3d::Identity());
+  scale->scale(Vector3d(2, 1, 1));
+  Instance ellipsoid(scale, blas);
+
+  Vector3d p = Vector3d(2, 0, 0) * std::sqrt(0.5) + Vector3d(0, 1, 0) * std::sqrt(0.5);
+  Ray r(Vector3d(p.x(), p.y(), 0) + Vector3d(0, 5, 0), Vector3d(0, -1, 0));
+  REQUIRE(ellipsoid.hit(r, 0.001, 100.0, rec));
+  REQUIRE(rec.p.isApprox(p));
+  REQUIRE(rec.normal.isApprox(Vector3d(1, 2, 0).normalized()));
+  REQUIRE(rec.front_face);
+
+  // Rays from inside report back faces
+  REQUIRE(ellipsoid.hit(Ray(Vector3d::Zero(), Vector3d(0, 0, 1)), 0.001, 100.0, rec));
+  REQUIRE(!rec.front_face);
+  REQUIRE(rec.normal.isApprox(Vector3d(0, 0, -1)));
+}
+
+TEST_CASE("Instance_light_pdf", "[ray]") {
+  auto light = std::make_shared<DiffuseLight>(Vector3d(1, 1, 1));
+  auto rect = std::make_shared<XZRect>(-1, 1, -1, 1, 1, light);
+
+  // Non-uniform scale does not preserve solid angle, so densities must
+  // still integrate to one over the sphere of directions
+  auto t = std::make_shared<Affine3d>(Affine3d::Identity());
+  t->rotate(AngleAxisd(0.3, Vector3d(1, 0, 1).normalized()));
+  t->scale(Vector3d(3.0, 0.5, 0.25));
+  Instance scaled(t, rect);
+
+  Vector3d origin(0.1, -0.2, 0.05);
+  int n = 400000;
+  double sum = 0.0;
+  for (int i = 0; i < n; i++)
+    sum += scaled.pdf_value(origin, random_unit_vec(), 0.0);
+  REQUIRE(4.0 * M_PI * sum / n == Approx(1.0).epsilon(0.05));
+
+  // Sampled directions reach the light, with densities consistent with
+  // the solid angle it covers
+  Rng rng;
+  double inverse_pdf_sum = 0.0;
+  int n_sampled = 20000;
+  for (int i = 0; i < n_sampled; i++) {
+    Vector3d d = scaled.random_direction(origin, 0.0, rng);
+    double pdf = scaled.pdf_value(origin, d, 0.0);
+    REQUIRE(pdf > 0.0);
+    inverse_pdf_sum += 1.0 / pdf;
+  }
+
+  int n_hits = 0;
+  for (int i = 0; i < n; i++)
+    if (scaled.pdf_value(origin, random_unit_vec(), 0.0) > 0.0)
+      n_hits++;
+  REQUIRE(inverse_pdf_sum / n_sampled == Approx(4.0 * M_PI * n_hits / n).epsilon(0.05));
+}
@@ -0,0 +1,744 @@
+#include <cannon/ray/linear_bvh.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <array>
+#include <atomic>
+#include <thread>
+
+#include <cannon/ray/hittable_list.hpp>
+#include <cannon/ray/compressed_bvh.hpp>
+#include <cannon/ray/ray.hpp>
+#include <cannon/ray/mesh.hpp>
+#include <cannon/utils/statistics.hpp>
+#include <cannon/utils/parallel_for.hpp>
+
+using namespace cannon::ray;
+using namespace cannon::utils;
+
+STAT_RATIO("Integrator/Linear BVH node visits per hit test", nLinearBvhNodeVisits, nLinearBvhHitTests);
+STAT_COUNTER("Accelerator/Linear BVH nodes built", nLinearBvhNodes);
+STAT_COUNTER("Integrator/Linear BVH packet tests", nLinearBvhPacketTests);
+STAT_COUNTER("Integrator/Linear BVH packet node visits", nLinearBvhPacketNodeVisits);
+STAT_COUNTER("Integrator/Linear BVH packet lanes retraced", nLinearBvhPacketRetraces);
+STAT_COUNTER("Accelerator/Lazy BVHs built", nLazyBvhBuilds);
+STAT_COUNTER("Accelerator/Linear BVHs with motion bounds", nLinearBvhMotionBuilds);
+
+static constexpr int n_sah_buckets = 12; //!< Number of buckets for SAH split evaluation
+static constexpr int max_build_depth = 60; //!< Maximum tree depth, bounded by the traversal stack
+static constexpr size_t max_leaf_prims = std::numeric_limits<uint16_t>::max(); //!< Maximum primitives representable in a leaf
+static constexpr size_t parallel_chunk_size = 16384; //!< Minimum primitives per thread for parallel binning
+static constexpr size_t parallel_subtree_size = 4096; //!< Minimum primitives in a subtree to build it on its own thread
+static constexpr double traversal_cost = 0.125; //!< Cost of a node traversal relative to a primitive intersection
+
+/*!
+ * Convert bounds to single precision, rounding outwards so that the box
+ * never shrinks.
+ */
+static void round_bounds(const Aabb& bounds, float bounds_min[3], float bounds_max[3]) {
+  for (int i = 0; i < 3; i++) {
+    float lo = static_cast<float>(bounds.minimum_[i]);
+    if (lo > bounds.minimum_[i])
+      lo = std::nextafter(lo, -std::numeric_limits<float>::infinity());
+
+    float hi = static_cast<float>(bounds.maximum_[i]);
+    if (hi < bounds.maximum_[i])
+      hi = std::nextafter(hi, std::numeric_limits<float>::infinity());
+
+    bounds_min[i] = lo;
+    bounds_max[i] = hi;
+  }
+}
+
+/*!
+ * Set the bounds of a flattened node, rounding outwards.
+ */
+static void set_node_bounds(LinearBvhNode& node, const Aabb& bounds) {
+  round_bounds(bounds, node.bounds_min_, node.bounds_max_);
+}
+
+/*!
+ * Compute the surface area of a flattened node.
+ */
+static double node_surface_area(const LinearBvhNode& node) {
+  double dx = node.bounds_max_[0] - node.bounds_min_[0];
+  double dy = node.bounds_max_[1] - node.bounds_min_[1];
+  double dz = node.bounds_max_[2] - node.bounds_min_[2];
+  return 2 * (dx * dy + dx * dz + dy * dz);
+}
+
+/*!
+ * Compute the SAH bucket of a primitive centroid along an axis.
+ */
+static int sah_bucket(const Aabb& centroid_bounds, const Vector3d& centroid, int dim) {
+  int b = n_sah_buckets * centroid_bounds.offset(centroid)[dim];
+  return std::min(std::max(b, 0), n_sah_buckets - 1);
+}
+
+LinearBvh::LinearBvh(std::shared_ptr<Affine3d> object_to_world, const
+    HittableListPtr list, double time_0, double time_1, unsigned int
+    max_prims_in_node, unsigned int num_threads) : LinearBvh(object_to_world,
+      list->objects_, time_0, time_1, max_prims_in_node, num_threads) {}
+
+LinearBvh::LinearBvh(std::shared_ptr<Affine3d> object_to_world, const
+    std::vector<std::shared_ptr<Hittable>>& src_objects, double time_0, double
+    time_1, unsigned int max_prims_in_node, unsigned int num_threads) :
+  Hittable(object_to_world),
+  time_0_(time_0), time_1_(time_1),
+  max_prims_in_node_(std::min<unsigned int>(std::max(1u, max_prims_in_node), max_leaf_prims)) {
+  build_(src_objects, std::max(1u, num_threads));
+}
+
+bool LinearBvh::object_space_hit(const Ray& r, double t_min, double t_max, hit_record& rec) const {
+  ++nLinearBvhHitTests;
+
+  if (nodes_.empty())
+    return false;
+
+  Vector3d inv_dir(1.0 / r.dir_.x(), 1.0 / r.dir_.y(), 1.0 / r.dir_.z());
+  int dir_is_neg[3] = {inv_dir.x() < 0, inv_dir.y() < 0, inv_dir.z() < 0};
+
+  bool hit_anything = false;
+  const Triangle* closest_triangle = nullptr;
+  double closest_triangle_t = 0.0;
+  Vector3d closest_triangle_b;
+
+  // Rays within the time interval test nodes over moving primitives against
+  // their bounds at the ray's time. Motion is linear between the endpoints,
+  // so interpolating the endpoint bounds of a node bounds everything in it.
+  bool use_motion_bounds = !motion_bounds_.empty() && r.time_ >= time_0_ && r.time_ <= time_1_;
+  double s = use_motion_bounds ? (r.time_ - time_0_) / (time_1_ - time_0_) : 0.0;
+
+  int to_visit_offset = 0;
+  int current_node_index = 0;
+  int nodes_to_visit[64];
+
+  while (true) {
+    ++nLinearBvhNodeVisits;
+    const LinearBvhNode& node = nodes_[current_node_index];
+
+    double bounds[2][3];
+    if (use_motion_bounds) {
+      const LinearBvhMotionBounds& motion = motion_bounds_[current_node_index];
+      for (int i = 0; i < 3; i++) {
+        bounds[0][i] = motion.bounds_min_0_[i] + s * (motion.bounds_min_1_[i] - motion.bounds_min_0_[i]);
+        bounds[1][i] = motion.bounds_max_0_[i] + s * (motion.bounds_max_1_[i] - motion.bounds_max_0_[i]);
+      }
+    } else {
+      for (int i = 0; i < 3; i++) {
+        bounds[0][i] = node.bounds_min_[i];
+        bounds[1][i] = node.bounds_max_[i];
+      }
+    }
+
+    // Slab test against node bounds, using precomputed reciprocal direction
+    double t0 = t_min, t1 = t_max;
+    bool node_hit = true;
+    for (int i = 0; i < 3; i++) {
+      double near = (bounds[dir_is_neg[i]][i] - r.orig_[i]) * inv_dir[i];
+      double far = (bounds[1 - dir_is_neg[i]][i] - r.orig_[i]) * inv_dir[i];
+
+      t0 = near > t0 ? near : t0;
+      t1 = far < t1 ? far : t1;
+
+      if (t1 < t0) {
+        node_hit = false;
+        break;
+      }
+    }
+
+    if (node_hit) {
+      if (node.n_primitives_ > 0) {
+        for (int i = 0; i < node.n_primitives_; i++) {
+          int prim = node.primitives_offset_ + i;
+
+          // Filling in triangle hit records is deferred until the closest
+          // intersection is known
+          if (!packet_triangle_index_.empty() && packet_triangle_index_[prim] >= 0) {
+            auto tri = static_cast<const Triangle*>(primitives_[prim].get());
+            double t;
+            Vector3d b;
+            if (tri->intersect(r, t_max, t, b)) {
+              hit_anything = true;
+              t_max = t;
+              closest_triangle = tri;
+              closest_triangle_t = t;
+              closest_triangle_b = b;
+            }
+          } else if (primitives_[prim]->hit(r, t_min, t_max, rec)) {
+            hit_anything = true;
+            t_max = rec.t;
+            closest_triangle = nullptr;
+          }
+        }
+
+        if (to_visit_offset == 0)
+          break;
+        current_node_index = nodes_to_visit[--to_visit_offset];
+      } else {
+        // Visit the child nearer along the ray first
+        if (dir_is_neg[node.axis_]) {
+          nodes_to_visit[to_visit_offset++] = current_node_index + 1;
+          current_node_index = node.second_child_offset_;
+        } else {
+          nodes_to_visit[to_visit_offset++] = node.second_child_offset_;
+          current_node_index = current_node_index + 1;
+        }
+      }
+    } else {
+      if (to_visit_offset == 0)
+        break;
+      current_node_index = nodes_to_visit[--to_visit_offset];
+    }
+  }
+
+  if (closest_triangle)
+    closest_triangle->finalize_hit(r, closest_triangle_t, closest_triangle_b, rec);
+
+  return hit_anything;
+}
+
+bool LinearBvh::object_space_bounding_box(double /*time_0*/, double /*time_1*/, Aabb& output_box) const {
+  if (nodes_.empty())
+    return false;
+
+  output_box = box_;
+  return true;
+}
+
+double LinearBvh::sah_cost() const {
+  if (nodes_.empty())
+    return 0.0;
+
+  double root_area = node_surface_area(nodes_[0]);
+  if (root_area <= 0.0)
+    return nodes_[0].n_primitives_;
+
+  double cost = 0.0;
+  for (auto& node : nodes_) {
+    double p = node_surface_area(node) / root_area;
+    if (node.n_primitives_ > 0)
+      cost += p * node.n_primitives_;
+    else
+      cost += p * traversal_cost;
+  }
+
+  return cost;
+}
+
+void LinearBvh::build_(const std::vector<std::shared_ptr<Hittable>>&
+    src_objects, unsigned int num_threads) {
+  primitives_.clear();
+  nodes_.clear();
+  motion_bounds_.clear();
+  packet_triangle_index_.clear();
+  packet_triangles_.clear();
+
+  if (src_objects.empty())
+    return;
+
+  // Exceptions cannot cross thread boundaries, so failures are flagged and
+  // thrown once all workers have joined
+  std::vector<BvhPrimitiveInfo> primitive_info(src_objects.size());
+  std::atomic<bool> missing_box(false);
+  parallel_for(0, src_objects.size(), num_threads, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++) {
+        primitive_info[i].primitive_number_ = i;
+        if (!src_objects[i]->bounding_box(time_0_, time_1_, primitive_info[i].bounds_))
+          missing_box = true;
+        primitive_info[i].centroid_ = primitive_info[i].bounds_.centroid();
+      }
+    }, parallel_chunk_size);
+
+  if (missing_box)
+    throw std::runtime_error("No bounding box for primitive in LinearBvh constructor");
+
+  // A binary tree over n leaves has at most 2n - 1 nodes
+  nodes_.reserve(2 * src_objects.size() - 1);
+  recursive_build_(primitive_info, 0, src_objects.size(), 0, num_threads, nodes_);
+  nodes_.shrink_to_fit();
+  nLinearBvhNodes += nodes_.size();
+
+  box_ = empty_box();
+  for (auto& info : primitive_info)
+    box_ = surrounding_box(box_, info.bounds_);
+
+  // Leaves refer to ranges of the partitioned primitive info
+  primitives_.resize(src_objects.size());
+  for (size_t i = 0; i < primitive_info.size(); i++)
+    primitives_[i] = src_objects[primitive_info[i].primitive_number_];
+
+  build_packet_triangles_();
+  build_motion_bounds_(num_threads);
+}
+
+void LinearBvh::recursive_build_(std::vector<BvhPrimitiveInfo>&
+    primitive_info, size_t start, size_t end, int depth, unsigned int
+    num_threads, std::vector<LinearBvhNode>& nodes) const {
+  size_t n_primitives = end - start;
+
+  // Compute node and centroid bounds, in parallel chunks for large nodes
+  unsigned int n_chunks = std::min<size_t>(num_threads,
+      std::max<size_t>(1, n_primitives / parallel_chunk_size));
+  std::vector<Aabb> chunk_bounds(n_chunks, empty_box());
+  std::vector<Aabb> chunk_centroid_bounds(n_chunks, empty_box());
+  size_t chunk_size = (n_primitives + n_chunks - 1) / n_chunks;
+
+  parallel_for(0, n_chunks, n_chunks, [&](size_t chunk_begin, size_t chunk_end) {
+      for (size_t c = chunk_begin; c < chunk_end; c++) {
+        size_t range_end = std::min(end, start + (c + 1) * chunk_size);
+        for (size_t i = start + c * chunk_size; i < range_end; i++) {
+          chunk_bounds[c] = surrounding_box(chunk_bounds[c], primitive_info[i].bounds_);
+          chunk_centroid_bounds[c] = surrounding_box(chunk_centroid_bounds[c],
+              primitive_info[i].centroid_);
+        }
+      }
+    });
+
+  Aabb bounds = empty_box();
+  Aabb centroid_bounds = empty_box();
+  for (unsigned int c = 0; c < n_chunks; c++) {
+    bounds = surrounding_box(bounds, chunk_bounds[c]);
+    centroid_bounds = surrounding_box(centroid_bounds, chunk_centroid_bounds[c]);
+  }
+
+  size_t node_offset = nodes.size();
+  nodes.emplace_back();
+  set_node_bounds(nodes[node_offset], bounds);
+
+  auto make_leaf = [&]() {
+    nodes[node_offset].primitives_offset_ = start;
+    nodes[node_offset].n_primitives_ = n_primitives;
+  };
+
+  if (n_primitives == 1 || (depth >= max_build_depth && n_primitives <= max_leaf_prims)) {
+    make_leaf();
+    return;
+  }
+
+  int dim = centroid_bounds.maximum_extent();
+  size_t mid = (start + end) / 2;
+
+  auto split_equal_counts = [&]() {
+    mid = (start + end) / 2;
+    std::nth_element(&primitive_info[start], &primitive_info[mid],
+        &primitive_info[end - 1] + 1, [dim](const BvhPrimitiveInfo& a,
+          const BvhPrimitiveInfo& b) {
+          return a.centroid_[dim] < b.centroid_[dim];
+        });
+  };
+
+  if (centroid_bounds.maximum_[dim] == centroid_bounds.minimum_[dim]) {
+    // All centroids coincide, so no split can separate primitives
+    if (n_primitives <= max_leaf_prims) {
+      make_leaf();
+      return;
+    }
+  } else if (n_primitives <= 2) {
+    split_equal_counts();
+  } else {
+    // Bin primitive centroids, in parallel chunks for large nodes
+    std::vector<std::array<int, n_sah_buckets>> chunk_counts(n_chunks);
+    std::vector<std::array<Aabb, n_sah_buckets>> chunk_bucket_bounds(n_chunks);
+
+    parallel_for(0, n_chunks, n_chunks, [&](size_t chunk_begin, size_t chunk_end) {
+        for (size_t c = chunk_begin; c < chunk_end; c++) {
+          chunk_counts[c].fill(0);
+          chunk_bucket_bounds[c].fill(empty_box());
+
+          size_t range_end = std::min(end, start + (c + 1) * chunk_size);
+          for (size_t i = start + c * chunk_size; i < range_end; i++) {
+            int b = sah_bucket(centroid_bounds, primitive_info[i].centroid_, dim);
+            chunk_counts[c][b]++;
+            chunk_bucket_bounds[c][b] = surrounding_box(chunk_bucket_bounds[c][b],
+                primitive_info[i].bounds_);
+          }
+        }
+      });
+
+    int counts[n_sah_buckets] = {0};
+    Aabb bucket_bounds[n_sah_buckets];
+    for (int b = 0; b < n_sah_buckets; b++) {
+      bucket_bounds[b] = empty_box();
+      for (unsigned int c = 0; c < n_chunks; c++) {
+        counts[b] += chunk_counts[c][b];
+        bucket_bounds[b] = surrounding_box(bucket_bounds[b], chunk_bucket_bounds[c][b]);
+      }
+    }
+
+    // Sweep from both sides so that every split is evaluated in linear time
+    double cost[n_sah_buckets - 1];
+    Aabb below = empty_box();
+    int count_below = 0;
+    for (int b = 0; b < n_sah_buckets - 1; b++) {
+      below = surrounding_box(below, bucket_bounds[b]);
+      count_below += counts[b];
+      cost[b] = count_below > 0 ? count_below * below.surface_area() : 0.0;
+    }
+
+    Aabb above = empty_box();
+    int count_above = 0;
+    for (int b = n_sah_buckets - 1; b > 0; b--) {
+      above = surrounding_box(above, bucket_bounds[b]);
+      count_above += counts[b];
+      if (count_above > 0)
+        cost[b - 1] += count_above * above.surface_area();
+    }
+
+    int min_cost_bucket = 0;
+    double min_cost = cost[0];
+    for (int b = 1; b < n_sah_buckets - 1; b++) {
+      if (cost[b] < min_cost) {
+        min_cost = cost[b];
+        min_cost_bucket = b;
+      }
+    }
+
+    double bounds_area = bounds.surface_area();
+    min_cost = traversal_cost + (bounds_area > 0 ? min_cost / bounds_area : 0.0);
+    double leaf_cost = n_primitives;
+
+    if (n_primitives > max_prims_in_node_ || min_cost < leaf_cost) {
+      BvhPrimitiveInfo *p_mid = std::partition(&primitive_info[start],
+          &primitive_info[end - 1] + 1, [&](const BvhPrimitiveInfo& pi) {
+            return sah_bucket(centroid_bounds, pi.centroid_, dim) <= min_cost_bucket;
+          });
+      mid = p_mid - &primitive_info[0];
+
+      // Guard against degenerate partitions from floating point binning
+      if (mid == start || mid == end)
+        split_equal_counts();
+    } else {
+      make_leaf();
+      return;
+    }
+  }
+
+  nodes[node_offset].axis_ = dim;
+  nodes[node_offset].n_primitives_ = 0;
+
+  if (num_threads > 1 && n_primitives >= parallel_subtree_size) {
+    // Fork: build the first child on a new thread and splice both children
+    // in depth-first order once they are done
+    unsigned int left_threads = num_threads / 2;
+    std::vector<LinearBvhNode> left_nodes, right_nodes;
+
+    std::thread left_thread([&]() {
+        recursive_build_(primitive_info, start, mid, depth + 1, left_threads, left_nodes);
+        });
+    recursive_build_(primitive_info, mid, end, depth + 1, num_threads - left_threads, right_nodes);
+    left_thread.join();
+
+    size_t left_offset = nodes.size();
+    size_t right_offset = left_offset + left_nodes.size();
+    nodes[node_offset].second_child_offset_ = right_offset;
+
+    for (auto& node : left_nodes) {
+      if (node.n_primitives_ == 0)
+        node.second_child_offset_ += left_offset;
+      nodes.push_back(node);
+    }
+
+    for (auto& node : right_nodes) {
+      if (node.n_primitives_ == 0)
+        node.second_child_offset_ += right_offset;
+      nodes.push_back(node);
+    }
+  } else {
+    recursive_build_(primitive_info, start, mid, depth + 1, 1, nodes);
+    nodes[node_offset].second_child_offset_ = nodes.size();
+    recursive_build_(primitive_info, mid, end, depth + 1, 1, nodes);
+  }
+}
+
+void LinearBvh::build_packet_triangles_() {
+  packet_triangle_index_.assign(primitives_.size(), -1);
+
+  for (size_t i = 0; i < primitives_.size(); i++) {
+    // Triangles are stored in world space, like the scalar Triangle::hit
+    auto tri = std::dynamic_pointer_cast<Triangle>(primitives_[i]);
+    if (!tri)
+      continue;
+
+    packet_triangle_index_[i] = packet_triangles_.size();
+    packet_triangles_.push_back(make_packet_triangle(
+          tri->parent_mesh_->face_vertex(tri->mesh_index_, 0),
+          tri->parent_mesh_->face_vertex(tri->mesh_index_, 1),
+          tri->parent_mesh_->face_vertex(tri->mesh_index_, 2)));
+  }
+
+  if (packet_triangles_.empty())
+    packet_triangle_index_.clear();
+}
+
+void LinearBvh::build_motion_bounds_(unsigned int num_threads) {
+  if (!(time_1_ > time_0_))
+    return;
+
+  // Leaves are bounded directly, flagging whether anything moves
+  motion_bounds_.resize(nodes_.size());
+  std::atomic<bool> moving(false);
+  parallel_for(0, nodes_.size(), num_threads, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++) {
+        const LinearBvhNode& node = nodes_[i];
+        if (node.n_primitives_ == 0)
+          continue;
+
+        Aabb box_0 = empty_box(), box_1 = empty_box();
+        for (int j = 0; j < node.n_primitives_; j++) {
+          Aabb prim_box;
+          primitives_[node.primitives_offset_ + j]->bounding_box(time_0_, time_0_, prim_box);
+          box_0 = surrounding_box(box_0, prim_box);
+          primitives_[node.primitives_offset_ + j]->bounding_box(time_1_, time_1_, prim_box);
+          box_1 = surrounding_box(box_1, prim_box);
+        }
+
+        LinearBvhMotionBounds& motion = motion_bounds_[i];
+        round_bounds(box_0, motion.bounds_min_0_, motion.bounds_max_0_);
+        round_bounds(box_1, motion.bounds_min_1_, motion.bounds_max_1_);
+        if (box_0.minimum_ != box_1.minimum_ || box_0.maximum_ != box_1.maximum_)
+          moving = true;
+      }
+    }, parallel_chunk_size);
+
+  if (!moving) {
+    motion_bounds_.clear();
+    motion_bounds_.shrink_to_fit();
+    return;
+  }
+
+  // Children follow their parents in depth-first order, so interior nodes
+  // are bounded in reverse order
+  for (size_t i = nodes_.size(); i-- > 0;) {
+    const LinearBvhNode& node = nodes_[i];
+    if (node.n_primitives_ > 0)
+      continue;
+
+    const LinearBvhMotionBounds& a = motion_bounds_[i + 1];
+    const LinearBvhMotionBounds& b = motion_bounds_[node.second_child_offset_];
+    LinearBvhMotionBounds& motion = motion_bounds_[i];
+    for (int j = 0; j < 3; j++) {
+      motion.bounds_min_0_[j] = std::min(a.bounds_min_0_[j], b.bounds_min_0_[j]);
+      motion.bounds_max_0_[j] = std::max(a.bounds_max_0_[j], b.bounds_max_0_[j]);
+      motion.bounds_min_1_[j] = std::min(a.bounds_min_1_[j], b.bounds_min_1_[j]);
+      motion.bounds_max_1_[j] = std::max(a.bounds_max_1_[j], b.bounds_max_1_[j]);
+    }
+  }
+
+  ++nLinearBvhMotionBuilds;
+}
+
+void LinearBvh::packet_hit(const RayPacket& packet, double t_min, hit_record
+    recs[max_packet_size], bool hits[max_packet_size]) const {
+  ++nLinearBvhPacketTests;
+
+  RayPacket object_packet(packet.size_);
+  uint32_t active = packet.active_mask();
+  for (int i = 0; i < packet.size_; i++) {
+    hits[i] = false;
+    if (active & (1u << i)) {
+      const Ray& r = packet.rays_[i];
+      object_packet.set_ray(i, Ray((*world_to_object_) * r.orig_,
+            world_to_object_->linear() * r.dir_, r.time_), packet.t_max_d_[i]);
+    }
+  }
+
+  if (nodes_.empty())
+    return;
+
+  int closest_triangle[max_packet_size];
+  uint32_t hit_mask = traverse_packet_(object_packet, t_min, recs, closest_triangle, false);
+
+  for (int i = 0; i < packet.size_; i++) {
+    if (!(hit_mask & (1u << i)))
+      continue;
+
+    const Ray& object_space_ray = object_packet.rays_[i];
+
+    // Candidate triangles were found in single precision, so confirm them
+    // with the exact test and retrace the lane if the candidate is rejected
+    if (closest_triangle[i] >= 0 && !primitives_[closest_triangle[i]]->hit(
+          object_space_ray, t_min, packet.t_max_d_[i], recs[i])) {
+      ++nLinearBvhPacketRetraces;
+      if (!object_space_hit(object_space_ray, t_min, packet.t_max_d_[i], recs[i]))
+        continue;
+    }
+
+    hits[i] = true;
+
+    Vector3d world_space_p = (*object_to_world_) * recs[i].p;
+    Vector3d world_space_normal = object_to_world_->linear() * recs[i].normal;
+
+    recs[i].p = world_space_p;
+    recs[i].set_face_normal(object_space_ray, world_space_normal);
+  }
+}
+
+uint32_t LinearBvh::packet_occluded(const RayPacket& packet, double t_min) const {
+  ++nLinearBvhPacketTests;
+
+  if (nodes_.empty())
+    return 0;
+
+  RayPacket object_packet(packet.size_);
+  uint32_t active = packet.active_mask();
+  for (int i = 0; i < packet.size_; i++) {
+    if (active & (1u << i)) {
+      const Ray& r = packet.rays_[i];
+      object_packet.set_ray(i, Ray((*world_to_object_) * r.orig_,
+            world_to_object_->linear() * r.dir_, r.time_), packet.t_max_d_[i]);
+    }
+  }
+
+  hit_record recs[max_packet_size];
+  int closest_triangle[max_packet_size];
+  return traverse_packet_(object_packet, t_min, recs, closest_triangle, true);
+}
+
+uint32_t LinearBvh::traverse_packet_(RayPacket& packet, double t_min,
+    hit_record recs[max_packet_size], int closest_triangle[max_packet_size],
+    bool any_hit) const {
+  uint32_t active = packet.active_mask();
+  uint32_t hit_mask = 0;
+  if (active == 0)
+    return 0;
+
+  for (int i = 0; i < max_packet_size; i++)
+    closest_triangle[i] = -1;
+
+  // Children are ordered using the first active ray, since the packet is
+  // assumed to be coherent
+  int first_lane = __builtin_ctz(active);
+  int dir_is_neg[3] = {packet.dir_[0][first_lane] < 0,
+    packet.dir_[1][first_lane] < 0, packet.dir_[2][first_lane] < 0};
+
+  float t_min_f = static_cast<float>(t_min);
+  float t_hit[max_packet_size];
+  hit_record scratch_rec;
+
+  int to_visit_offset = 0;
+  int current_node_index = 0;
+  int nodes_to_visit[64];
+
+  while (true) {
+    ++nLinearBvhPacketNodeVisits;
+    const LinearBvhNode& node = nodes_[current_node_index];
+
+    uint32_t node_mask = packet_box_hit(packet, node.bounds_min_,
+        node.bounds_max_, t_min_f) & active;
+
+    if (node_mask != 0 && node.n_primitives_ > 0) {
+      for (int p = 0; p < node.n_primitives_ && node_mask != 0; p++) {
+        int prim = node.primitives_offset_ + p;
+        int tri = packet_triangle_index_.empty() ? -1 : packet_triangle_index_[prim];
+
+        if (tri >= 0) {
+          uint32_t tri_mask = packet_triangle_hit(packet, packet_triangles_[tri],
+              t_min_f, t_hit) & node_mask;
+
+          for (; tri_mask != 0; tri_mask &= tri_mask - 1) {
+            int lane = __builtin_ctz(tri_mask);
+
+            if (any_hit) {
+              if (!primitives_[prim]->hit(packet.rays_[lane], t_min,
+                    packet.t_max_d_[lane], scratch_rec))
+                continue;
+
+              active &= ~(1u << lane);
+              node_mask &= ~(1u << lane);
+            } else {
+              closest_triangle[lane] = prim;
+              packet.set_t_max(lane, t_hit[lane]);
+            }
+
+            hit_mask |= 1u << lane;
+          }
+        } else {
+          for (uint32_t lanes = node_mask; lanes != 0; lanes &= lanes - 1) {
+            int lane = __builtin_ctz(lanes);
+
+            if (!primitives_[prim]->hit(packet.rays_[lane], t_min,
+                  packet.t_max_d_[lane], any_hit ? scratch_rec : recs[lane]))
+              continue;
+
+            if (any_hit) {
+              active &= ~(1u << lane);
+              node_mask &= ~(1u << lane);
+            } else {
+              closest_triangle[lane] = -1;
+              packet.set_t_max(lane, recs[lane].t);
+            }
+
+            hit_mask |= 1u << lane;
+          }
+        }
+      }
+
+      if (active == 0 || to_visit_offset == 0)
+        break;
+      current_node_index = nodes_to_visit[--to_visit_offset];
+    } else if (node_mask != 0) {
+      // Visit the child nearer along the rays first
+      if (dir_is_neg[node.axis_]) {
+        nodes_to_visit[to_visit_offset++] = current_node_index + 1;
+        current_node_index = node.second_child_offset_;
+      } else {
+        nodes_to_visit[to_visit_offset++] = node.second_child_offset_;
+        current_node_index = current_node_index + 1;
+      }
+    } else {
+      if (to_visit_offset == 0)
+        break;
+      current_node_index = nodes_to_visit[--to_visit_offset];
+    }
+  }
+
+  return hit_mask;
+}
+
+LazyBvh::LazyBvh(std::shared_ptr<Affine3d> object_to_world, const
+    HittableListPtr list, double time_0, double time_1, unsigned int
+    max_prims_in_node, unsigned int num_threads, BvhType type) :
+  Hittable(object_to_world), list_(list), time_0_(time_0), time_1_(time_1),
+  max_prims_in_node_(max_prims_in_node), num_threads_(num_threads),
+  type_(type), box_(empty_box()), has_box_(false), built_(false) {
+  for (auto& obj : list_->objects_) {
+    Aabb obj_box;
+    if (obj->bounding_box(time_0_, time_1_, obj_box)) {
+      box_ = surrounding_box(box_, obj_box);
+      has_box_ = true;
+    }
+  }
+}
+
+bool LazyBvh::object_space_hit(const Ray& r, double t_min, double t_max, hit_record& rec) const {
+  return get()->hit(r, t_min, t_max, rec);
+}
+
+bool LazyBvh::object_space_bounding_box(double /*time_0*/, double /*time_1*/, Aabb& output_box) const {
+  output_box = box_;
+  return has_box_;
+}
+
+const HittablePtr& LazyBvh::get() const {
+  std::call_once(build_flag_, [this]() {
+    ++nLazyBvhBuilds;
+    auto t = std::make_shared<Affine3d>(Affine3d::Identity());
+    if (type_ == BvhType::Compressed)
+      bvh_ = std::make_shared<CompressedBvh>(t, list_, time_0_, time_1_,
+          max_prims_in_node_, num_threads_);
+    else
+      bvh_ = std::make_shared<LinearBvh>(t, list_, time_0_, time_1_,
+          max_prims_in_node_, num_threads_);
+    list_.reset();
+    built_ = true;
+  });
+
+  return bvh_;
+}
+
+bool LazyBvh::is_built() const {
+  return built_;
+}
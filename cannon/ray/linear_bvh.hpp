@@ -0,0 +1,325 @@
+#pragma once
+#ifndef CANNON_RAY_LINEAR_BVH_H
+#define CANNON_RAY_LINEAR_BVH_H
+
+/*!
+ * \file cannon/ray/linear_bvh.hpp
+ * \brief File containing LinearBvh class definition, a flattened bounding
+ * volume hierarchy built with the surface area heuristic.
+ */
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+#include <cannon/ray/hittable.hpp>
+#include <cannon/ray/aabb.hpp>
+#include <cannon/ray/ray_packet.hpp>
+#include <cannon/utils/class_forward.hpp>
+
+namespace cannon {
+  namespace ray {
+
+    CANNON_CLASS_FORWARD(HittableList);
+    CANNON_CLASS_FORWARD(Hittable);
+    CANNON_CLASS_FORWARD(LinearBvh);
+
+    /*!
+     * \brief Struct representing a single node of a LinearBvh. Nodes are
+     * stored in depth-first order, so the first child of an interior node
+     * immediately follows it and only the offset of the second child needs
+     * to be stored. Bounds are stored in single precision, rounded outwards,
+     * so that each node fits in 32 bytes.
+     */
+    struct LinearBvhNode {
+      float bounds_min_[3]; //!< Minimum corner of node bounds
+      float bounds_max_[3]; //!< Maximum corner of node bounds
+
+      union {
+        int32_t primitives_offset_; //!< Offset of first primitive, for leaves
+        int32_t second_child_offset_; //!< Offset of second child, for interior nodes
+      };
+
+      uint16_t n_primitives_; //!< Number of primitives, 0 for interior nodes
+      uint8_t axis_; //!< Split axis for interior nodes
+      uint8_t pad_; //!< Padding to 32 bytes
+    };
+
+    static_assert(sizeof(LinearBvhNode) == 32, "LinearBvhNode should be 32 bytes");
+
+    /*!
+     * \brief Struct holding the bounds of a LinearBvh node at the start and
+     * end of the hierarchy's time interval, so that nodes over moving
+     * primitives can be tested against their bounds at a ray's time rather
+     * than over the whole interval. Bounds are rounded outwards like those
+     * of LinearBvhNode.
+     */
+    struct LinearBvhMotionBounds {
+      float bounds_min_0_[3]; //!< Minimum corner of node bounds at the start time
+      float bounds_max_0_[3]; //!< Maximum corner of node bounds at the start time
+      float bounds_min_1_[3]; //!< Minimum corner of node bounds at the end time
+      float bounds_max_1_[3]; //!< Maximum corner of node bounds at the end time
+    };
+
+    /*!
+     * \brief Struct holding cached bounds information for a primitive during
+     * BVH construction.
+     */
+    struct BvhPrimitiveInfo {
+      size_t primitive_number_; //!< Index of primitive in source vector
+      Aabb bounds_; //!< Bounding box of primitive
+      Vector3d centroid_; //!< Centroid of primitive bounding box
+    };
+
+    /*!
+     * \brief Class representing a bounding volume hierarchy which is built
+     * using the surface area heuristic and then flattened into a compact
+     * array of nodes for iterative traversal. Adapted from PBRT Ch. 4.3.
+     *
+     * Construction can use multiple threads: primitive bounds and the SAH
+     * binning of large nodes are computed in parallel chunks, and large
+     * subtrees are built concurrently, each into its own node array which is
+     * spliced into the parent's array once both children are done. The
+     * resulting hierarchy does not depend on the number of threads used.
+     *
+     * Coherent packets of rays can be traced together with packet_hit() and
+     * packet_occluded(), which test boxes and triangles with SIMD kernels and
+     * fall back to scalar intersection for other primitives.
+     *
+     * If any primitive moves over the time interval, each node also stores
+     * its bounds at the start and end of the interval, and scalar traversal
+     * tests nodes against bounds interpolated to the ray's time. This is
+     * conservative for primitives moving linearly, like MovingSphere, and
+     * keeps nodes over fast-moving primitives from overlapping as they
+     * would with bounds over the whole interval. Packets, whose lanes may
+     * have different times, use the bounds over the whole interval.
+     */
+    class LinearBvh : public Hittable {
+      public:
+
+        LinearBvh() = delete;
+
+        /*!
+         * Constructor taking a HittableList and time interval.
+         */
+        LinearBvh(std::shared_ptr<Affine3d> object_to_world, const
+            HittableListPtr list, double time_0, double time_1, unsigned int
+            max_prims_in_node = 4, unsigned int num_threads = 1);
+
+        /*!
+         * Constructor taking a vector of Hittables to include and a time
+         * interval.
+         */
+        LinearBvh(std::shared_ptr<Affine3d> object_to_world, const
+            std::vector<std::shared_ptr<Hittable>>& src_objects, double time_0,
+            double time_1, unsigned int max_prims_in_node = 4, unsigned int
+            num_threads = 1);
+
+        /*!
+         * Destructor.
+         */
+        virtual ~LinearBvh() {}
+
+        /*!
+         * Inherited from Hittable.
+         */
+        virtual bool object_space_hit(const Ray& r, double t_min, double t_max, hit_record& rec) const override;
+
+        /*!
+         * Inherited from Hittable.
+         */
+        virtual bool object_space_bounding_box(double time_0, double time_1, Aabb& output_box) const override;
+
+        /*!
+         * Compute the surface area heuristic cost of this hierarchy, i.e. the
+         * expected cost of tracing a ray which hits the root bounds, in units
+         * of primitive intersection tests.
+         *
+         * \returns The SAH cost.
+         */
+        double sah_cost() const;
+
+        /*!
+         * Find the closest intersection of each lane of a packet of
+         * world-space rays with this hierarchy. The packet is traversed as a
+         * whole, so this is only faster than tracing each ray separately when
+         * the rays are coherent, e.g. camera rays for nearby pixels.
+         *
+         * \param packet The rays to test.
+         * \param t_min Minimal distance along rays to register an intersection.
+         * \param recs Hit records in which to put details about each lane's intersection.
+         * \param hits Array in which to put whether each lane hit anything.
+         */
+        void packet_hit(const RayPacket& packet, double t_min, hit_record
+            recs[max_packet_size], bool hits[max_packet_size]) const;
+
+        /*!
+         * Test whether each lane of a packet of world-space rays intersects
+         * anything in this hierarchy, stopping at the first intersection
+         * found for each lane. Intended for shadow rays.
+         *
+         * \param packet The rays to test.
+         * \param t_min Minimal distance along rays to register an intersection.
+         *
+         * \returns A mask with one bit set for each occluded lane.
+         */
+        uint32_t packet_occluded(const RayPacket& packet, double t_min) const;
+
+      private:
+
+        /*!
+         * Build this hierarchy over the input objects.
+         *
+         * \param src_objects Objects to build hierarchy over.
+         * \param num_threads Number of threads to use during construction.
+         */
+        void build_(const std::vector<std::shared_ptr<Hittable>>& src_objects,
+            unsigned int num_threads);
+
+        /*!
+         * Recursively build the subtree over a range of primitive info,
+         * partitioning the range in place and appending the flattened subtree
+         * to the input node array in depth-first order. Leaves refer directly
+         * to ranges of the partitioned primitive info.
+         *
+         * \param primitive_info Cached primitive bounds, reordered by this method.
+         * \param start Start of range to build over.
+         * \param end End of range to build over.
+         * \param depth Depth of the node being built.
+         * \param num_threads Number of threads available to this subtree.
+         * \param nodes Node array to append the flattened subtree to.
+         */
+        void recursive_build_(std::vector<BvhPrimitiveInfo>& primitive_info,
+            size_t start, size_t end, int depth, unsigned int num_threads,
+            std::vector<LinearBvhNode>& nodes) const;
+
+        /*!
+         * Build single-precision packet intersection data for each triangle
+         * primitive.
+         */
+        void build_packet_triangles_();
+
+        /*!
+         * Build the bounds of each node at the start and end of the time
+         * interval, leaving motion_bounds_ empty if no primitive moves.
+         *
+         * \param num_threads Number of threads to use.
+         */
+        void build_motion_bounds_(unsigned int num_threads);
+
+        /*!
+         * Traverse this hierarchy with an object-space packet of rays.
+         *
+         * \param packet The rays to test, whose maximum distances are updated
+         * as intersections are found.
+         * \param t_min Minimal distance along rays to register an intersection.
+         * \param recs Hit records for intersections with non-triangle primitives.
+         * \param closest_triangle Array in which to put the primitive index of
+         * the closest candidate triangle for each lane, or -1 if the closest
+         * intersection is in recs.
+         * \param any_hit Whether to stop at the first confirmed intersection
+         * for each lane.
+         *
+         * \returns A mask with one bit set for each lane that hit anything.
+         */
+        uint32_t traverse_packet_(RayPacket& packet, double t_min, hit_record
+            recs[max_packet_size], int closest_triangle[max_packet_size], bool
+            any_hit) const;
+
+      public:
+        std::vector<std::shared_ptr<Hittable>> primitives_; //!< Primitives, ordered so that each leaf refers to a contiguous range
+        std::vector<LinearBvhNode> nodes_; //!< Flattened nodes in depth-first order
+        std::vector<LinearBvhMotionBounds> motion_bounds_; //!< Bounds of each node at time_0_ and time_1_, empty unless primitives move
+        Aabb box_; //!< Bounding box of the whole hierarchy
+        double time_0_, time_1_; //!< Time interval the hierarchy was built for
+        unsigned int max_prims_in_node_; //!< Maximum number of primitives in a leaf
+
+        std::vector<int32_t> packet_triangle_index_; //!< Index of each primitive in packet_triangles_, or -1
+        std::vector<PacketTriangle> packet_triangles_; //!< Single-precision data for triangle primitives
+
+    };
+
+    /*!
+     * Kinds of hierarchy that a LazyBvh can build.
+     */
+    enum class BvhType {
+      Linear, //!< LinearBvh, supporting packets and motion bounds
+      Compressed //!< CompressedBvh, for meshes whose hierarchy memory matters
+    };
+
+    /*!
+     * \brief Class representing a LinearBvh or CompressedBvh which is not
+     * built until a ray first reaches its bounds. Scenes with many meshes
+     * then only pay to build hierarchies over the meshes that are actually
+     * seen, and loading a scene does not wait on any builds. The first ray
+     * to arrive builds the hierarchy while any others wait for it.
+     */
+    class LazyBvh : public Hittable {
+      public:
+
+        LazyBvh() = delete;
+
+        /*!
+         * Constructor taking the same arguments as LinearBvh, and the kind
+         * of hierarchy to build. Only the bounds of the primitives are
+         * computed here.
+         */
+        LazyBvh(std::shared_ptr<Affine3d> object_to_world, const HittableListPtr
+            list, double time_0, double time_1, unsigned int max_prims_in_node
+            = 4, unsigned int num_threads = 1, BvhType type = BvhType::Linear);
+
+        /*!
+         * Destructor.
+         */
+        virtual ~LazyBvh() {}
+
+        /*!
+         * Inherited from Hittable. Builds the hierarchy if it has not been
+         * built yet.
+         */
+        virtual bool object_space_hit(const Ray& r, double t_min, double t_max, hit_record& rec) const override;
+
+        /*!
+         * Inherited from Hittable. Does not require the hierarchy to be
+         * built.
+         */
+        virtual bool object_space_bounding_box(double time_0, double time_1, Aabb& output_box) const override;
+
+        /*!
+         * Get the hierarchy, building it if it has not been built yet. A
+         * reference is returned so that hit tests do not touch the reference
+         * count.
+         *
+         * \returns The built hierarchy.
+         */
+        const HittablePtr& get() const;
+
+        /*!
+         * Check whether the hierarchy has been built.
+         *
+         * \returns Whether the hierarchy has been built.
+         */
+        bool is_built() const;
+
+      private:
+        mutable HittableListPtr list_; //!< Primitives to build over, released once built
+        double time_0_, time_1_; //!< Time interval to build for
+        unsigned int max_prims_in_node_; //!< Maximum number of primitives in a leaf
+        unsigned int num_threads_; //!< Number of threads to build with
+        BvhType type_; //!< Kind of hierarchy to build
+
+        Aabb box_; //!< Bounding box of all primitives
+        bool has_box_; //!< Whether any primitive has a bounding box
+
+        mutable std::once_flag build_flag_; //!< Flag ensuring the hierarchy is built once
+        mutable HittablePtr bvh_; //!< The hierarchy, once built
+        mutable std::atomic<bool> built_; //!< Whether bvh_ has been built
+
+    };
+
+  } // namespace ray
+} // namespace cannon
+
+#endif /* ifndef CANNON_RAY_LINEAR_BVH_H */
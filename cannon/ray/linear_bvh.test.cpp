@@ -0,0 +1,155 @@
+#include <catch2/catch.hpp>
+
+#include <cannon/ray/linear_bvh.hpp>
+#include <cannon/ray/hittable_list.hpp>
+#include <cannon/ray/sphere.hpp>
+#include <cannon/ray/moving_sphere.hpp>
+#include <cannon/ray/material.hpp>
+#include <cannon/ray/mesh.hpp>
+#include <cannon/ray/ray.hpp>
+#include <cannon/math/random_double.hpp>
+
+using namespace cannon::ray;
+using namespace cannon::math;
+
+TEST_CASE("LinearBvh", "[ray]") {
+  auto mat = std::make_shared<Lambertian>(Vector3d(0.5, 0.5, 0.5));
+  auto list = std::make_shared<HittableList>();
+
+  for (int i = 0; i < 200; i++)
+    list->add(std::make_shared<Sphere>(random_vec(-10, 10), random_double(0.1, 1.0), mat));
+
+  auto t = std::make_shared<Affine3d>(Affine3d::Identity());
+  LinearBvh bvh(t, list, 0.0, 1.0);
+
+  REQUIRE(bvh.primitives_.size() == 200);
+  REQUIRE(bvh.nodes_.size() > 1);
+  REQUIRE(bvh.nodes_.size() < 400);
+
+  // Every primitive should be referenced by exactly one leaf
+  unsigned int leaf_prims = 0;
+  for (auto& node : bvh.nodes_)
+    leaf_prims += node.n_primitives_;
+  REQUIRE(leaf_prims == 200);
+
+  Aabb list_box, bvh_box;
+  REQUIRE(list->bounding_box(0.0, 1.0, list_box));
+  REQUIRE(bvh.bounding_box(0.0, 1.0, bvh_box));
+  REQUIRE(bvh_box.minimum_.isApprox(list_box.minimum_));
+  REQUIRE(bvh_box.maximum_.isApprox(list_box.maximum_));
+
+  // Closest hits should agree with brute-force intersection
+  for (int i = 0; i < 1000; i++) {
+    Ray r(random_vec(-15, 15), random_unit_vec());
+
+    hit_record list_rec, bvh_rec;
+    bool list_hit = list->hit(r, 0.001, std::numeric_limits<double>::infinity(), list_rec);
+    bool bvh_hit = bvh.hit(r, 0.001, std::numeric_limits<double>::infinity(), bvh_rec);
+
+    REQUIRE(list_hit == bvh_hit);
+    if (list_hit)
+      REQUIRE(list_rec.t == Approx(bvh_rec.t));
+  }
+
+  REQUIRE(bvh.sah_cost() > 0.0);
+  REQUIRE(bvh.sah_cost() < 200.0);
+
+  // Parallel construction should produce exactly the same hierarchy
+  std::vector<std::shared_ptr<Hittable>> many;
+  for (int i = 0; i < 20000; i++)
+    many.push_back(std::make_shared<Sphere>(random_vec(-100, 100), random_double(0.1, 1.0), mat));
+
+  LinearBvh serial(t, many, 0.0, 1.0, 4, 1);
+  LinearBvh parallel(t, many, 0.0, 1.0, 4, 4);
+  REQUIRE(serial.nodes_.size() == parallel.nodes_.size());
+  REQUIRE(serial.primitives_ == parallel.primitives_);
+  for (size_t i = 0; i < serial.nodes_.size(); i++) {
+    REQUIRE(serial.nodes_[i].n_primitives_ == parallel.nodes_[i].n_primitives_);
+    REQUIRE(serial.nodes_[i].second_child_offset_ == parallel.nodes_[i].second_child_offset_);
+    REQUIRE(serial.nodes_[i].bounds_min_[0] == parallel.nodes_[i].bounds_min_[0]);
+    REQUIRE(serial.nodes_[i].bounds_max_[2] == parallel.nodes_[i].bounds_max_[2]);
+  }
+  REQUIRE(serial.sah_cost() == Approx(parallel.sah_cost()));
+
+  // Packets of coherent rays should find the same closest hits as scalar
+  // traversal, for both analytic primitives and triangles
+  std::vector<std::shared_ptr<Hittable>> triangles;
+  MatrixX3d vertices(300, 3), normals(300, 3);
+  MatrixX3u indices(100, 3);
+  for (int i = 0; i < 100; i++) {
+    Vector3d center = random_vec(-10, 10);
+    for (int j = 0; j < 3; j++) {
+      vertices.row(3 * i + j) = (center + random_vec(-2, 2)).transpose();
+      normals.row(3 * i + j) = Vector3d::UnitZ().transpose();
+      indices(i, j) = 3 * i + j;
+    }
+  }
+  auto mesh = std::make_shared<TriangleMesh>(t, mat, vertices, normals,
+      MatrixX2d::Zero(300, 2), indices);
+  auto mixed = make_mesh_triangle_list(mesh);
+  for (int i = 0; i < 50; i++)
+    mixed->add(std::make_shared<Sphere>(random_vec(-10, 10), random_double(0.1, 1.0), mat));
+
+  LinearBvh mixed_bvh(t, mixed, 0.0, 1.0);
+  for (int p = 0; p < 200; p++) {
+    RayPacket packet(8);
+    Vector3d origin = random_vec(-15, 15);
+    Vector3d target = random_vec(-5, 5);
+    for (int i = 0; i < packet.size_; i++)
+      packet.set_ray(i, Ray(origin, target + random_vec(-1, 1) - origin));
+
+    hit_record recs[max_packet_size];
+    bool hits[max_packet_size];
+    mixed_bvh.packet_hit(packet, 0.001, recs, hits);
+    uint32_t occluded = mixed_bvh.packet_occluded(packet, 0.001);
+
+    for (int i = 0; i < packet.size_; i++) {
+      hit_record rec;
+      bool hit = mixed_bvh.hit(packet.rays_[i], 0.001, std::numeric_limits<double>::infinity(), rec);
+
+      REQUIRE(hits[i] == hit);
+      REQUIRE(((occluded & (1u << i)) != 0) == hit);
+      if (hit) {
+        REQUIRE(recs[i].t == Approx(rec.t));
+        REQUIRE(recs[i].p.isApprox(rec.p));
+      }
+    }
+  }
+
+  // Static hierarchies keep no motion bounds, while hierarchies over moving
+  // spheres are tested against bounds at each ray's time
+  REQUIRE(bvh.motion_bounds_.empty());
+
+  auto moving = std::make_shared<HittableList>();
+  for (int i = 0; i < 200; i++) {
+    Vector3d center = random_vec(-10, 10);
+    moving->add(std::make_shared<MovingSphere>(center, center + random_vec(-5, 5),
+          0.0, 1.0, random_double(0.1, 0.5), mat));
+  }
+
+  LinearBvh moving_bvh(t, moving, 0.0, 1.0);
+  REQUIRE(moving_bvh.motion_bounds_.size() == moving_bvh.nodes_.size());
+  for (int i = 0; i < 3; i++) {
+    REQUIRE(moving_bvh.motion_bounds_[0].bounds_min_0_[i] >= moving_bvh.nodes_[0].bounds_min_[i]);
+    REQUIRE(moving_bvh.motion_bounds_[0].bounds_max_1_[i] <= moving_bvh.nodes_[0].bounds_max_[i]);
+  }
+
+  for (int i = 0; i < 1000; i++) {
+    Ray r(random_vec(-15, 15), random_unit_vec(), random_double());
+
+    hit_record list_rec, bvh_rec;
+    bool list_hit = moving->hit(r, 0.001, std::numeric_limits<double>::infinity(), list_rec);
+    bool bvh_hit = moving_bvh.hit(r, 0.001, std::numeric_limits<double>::infinity(), bvh_rec);
+
+    REQUIRE(list_hit == bvh_hit);
+    if (list_hit)
+      REQUIRE(list_rec.t == Approx(bvh_rec.t));
+  }
+
+  // Empty hierarchies have no bounding box and are never hit
+  LinearBvh empty(t, std::make_shared<HittableList>(), 0.0, 1.0);
+  Aabb empty_box;
+  hit_record rec;
+  REQUIRE(!empty.bounding_box(0.0, 1.0, empty_box));
+  REQUIRE(!empty.hit(Ray(Vector3d::Zero(), Vector3d::Ones()), 0.0, 1.0, rec));
+}
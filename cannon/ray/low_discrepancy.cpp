@@ -0,0 +1,259 @@
+#include <cannon/ray/low_discrepancy.hpp>
+
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+
+#include <cannon/ray/sampler.hpp>
+
+using namespace cannon::ray;
+
+const unsigned int cannon::ray::primes[prime_table_size] = {
+  2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53,
+  59, 61, 67, 71, 73, 79, 83, 89, 97, 101, 103, 107, 109, 113, 127, 131,
+  137, 139, 149, 151, 157, 163, 167, 173, 179, 181, 191, 193, 197, 199, 211, 223,
+  227, 229, 233, 239, 241, 251, 257, 263, 269, 271, 277, 281, 283, 293, 307, 311,
+  313, 317, 331, 337, 347, 349, 353, 359, 367, 373, 379, 383, 389, 397, 401, 409,
+  419, 421, 431, 433, 439, 443, 449, 457, 461, 463, 467, 479, 487, 491, 499, 503,
+  509, 521, 523, 541, 547, 557, 563, 569, 571, 577, 587, 593, 599, 601, 607, 613,
+  617, 619, 631, 641, 643, 647, 653, 659, 661, 673, 677, 683, 691, 701, 709, 719
+};
+
+const unsigned int cannon::ray::prime_sums[prime_table_size] = {
+  0, 2, 5, 10, 17, 28, 41, 58, 77, 100, 129, 160, 197, 238, 281, 328,
+  381, 440, 501, 568, 639, 712, 791, 874, 963, 1060, 1161, 1264, 1371, 1480, 1593, 1720,
+  1851, 1988, 2127, 2276, 2427, 2584, 2747, 2914, 3087, 3266, 3447, 3638, 3831, 4028, 4227, 4438,
+  4661, 4888, 5117, 5350, 5589, 5830, 6081, 6338, 6601, 6870, 7141, 7418, 7699, 7982, 8275, 8582,
+  8893, 9206, 9523, 9854, 10191, 10538, 10887, 11240, 11599, 11966, 12339, 12718, 13101, 13490, 13887, 14288,
+  14697, 15116, 15537, 15968, 16401, 16840, 17283, 17732, 18189, 18650, 19113, 19580, 20059, 20546, 21037, 21536,
+  22039, 22548, 23069, 23592, 24133, 24680, 25237, 25800, 26369, 26940, 27517, 28104, 28697, 29296, 29897, 30504,
+  31117, 31734, 32353, 32984, 33625, 34268, 34915, 35568, 36227, 36888, 37561, 38238, 38921, 39612, 40313, 41022
+};
+
+namespace {
+
+  /*!
+   * \brief Struct holding Joe and Kuo's parameters for one Sobol dimension:
+   * the degree and coefficients of its primitive polynomial, and its initial
+   * direction numbers.
+   */
+  struct SobolParams {
+    unsigned int s;
+    unsigned int a;
+    uint32_t m[7];
+  };
+
+  // Dimensions 2 to 32 of new-joe-kuo-6.21201. Dimension 1 is the van der
+  // Corput sequence, which has no parameters.
+  const SobolParams sobol_params[sobol_dimensions - 1] = {
+    {1, 0, {1}},
+    {2, 1, {1, 3}},
+    {3, 1, {1, 3, 1}},
+    {3, 2, {1, 1, 1}},
+    {4, 1, {1, 1, 3, 3}},
+    {4, 4, {1, 3, 5, 13}},
+    {5, 2, {1, 1, 5, 5, 17}},
+    {5, 4, {1, 1, 5, 5, 5}},
+    {5, 7, {1, 1, 7, 11, 19}},
+    {5, 11, {1, 1, 5, 1, 1}},
+    {5, 13, {1, 1, 1, 3, 11}},
+    {5, 14, {1, 3, 5, 5, 31}},
+    {6, 1, {1, 3, 3, 9, 7, 49}},
+    {6, 13, {1, 1, 1, 15, 21, 21}},
+    {6, 16, {1, 3, 1, 13, 27, 49}},
+    {6, 19, {1, 1, 1, 15, 7, 5}},
+    {6, 22, {1, 3, 1, 15, 13, 25}},
+    {6, 25, {1, 1, 5, 5, 19, 61}},
+    {7, 1, {1, 3, 7, 11, 23, 15, 103}},
+    {7, 4, {1, 3, 7, 13, 13, 15, 69}},
+    {7, 7, {1, 1, 3, 13, 7, 35, 63}},
+    {7, 8, {1, 3, 5, 9, 1, 25, 53}},
+    {7, 14, {1, 3, 1, 13, 9, 35, 107}},
+    {7, 19, {1, 3, 1, 5, 27, 61, 31}},
+    {7, 21, {1, 1, 5, 11, 19, 41, 61}},
+    {7, 28, {1, 3, 5, 3, 3, 13, 69}},
+    {7, 31, {1, 1, 7, 13, 1, 19, 1}},
+    {7, 32, {1, 3, 7, 5, 13, 19, 59}},
+    {7, 37, {1, 1, 3, 9, 25, 29, 41}},
+    {7, 41, {1, 3, 5, 13, 23, 1, 55}},
+    {7, 42, {1, 3, 7, 3, 13, 59, 17}}
+  };
+
+  /*!
+   * Compute generator matrices for all precomputed Sobol dimensions.
+   */
+  std::vector<uint32_t> compute_sobol_matrices() {
+    std::vector<uint32_t> matrices(sobol_dimensions * sobol_matrix_size);
+
+    // Van der Corput sequence
+    for (unsigned int j = 0; j < sobol_matrix_size; j++)
+      matrices[j] = 1u << (31 - j);
+
+    for (unsigned int d = 1; d < sobol_dimensions; d++) {
+      const SobolParams& params = sobol_params[d - 1];
+      uint32_t* v = &matrices[d * sobol_matrix_size];
+
+      for (unsigned int k = 0; k < sobol_matrix_size; k++) {
+        if (k < params.s) {
+          v[k] = params.m[k] << (31 - k);
+        } else {
+          v[k] = v[k - params.s] ^ (v[k - params.s] >> params.s);
+          for (unsigned int i = 1; i < params.s; i++) {
+            if ((params.a >> (params.s - 1 - i)) & 1)
+              v[k] ^= v[k - i];
+          }
+        }
+      }
+    }
+
+    return matrices;
+  }
+
+  void extended_gcd(int64_t a, int64_t b, int64_t* x, int64_t* y) {
+    if (b == 0) {
+      *x = 1;
+      *y = 0;
+      return;
+    }
+
+    int64_t d = a / b, xp, yp;
+    extended_gcd(b, a % b, &xp, &yp);
+    *x = yp;
+    *y = xp - (d * yp);
+  }
+
+} // namespace
+
+uint32_t cannon::ray::reverse_bits_32(uint32_t n) {
+  n = (n << 16) | (n >> 16);
+  n = ((n & 0x00ff00ff) << 8) | ((n & 0xff00ff00) >> 8);
+  n = ((n & 0x0f0f0f0f) << 4) | ((n & 0xf0f0f0f0) >> 4);
+  n = ((n & 0x33333333) << 2) | ((n & 0xcccccccc) >> 2);
+  n = ((n & 0x55555555) << 1) | ((n & 0xaaaaaaaa) >> 1);
+  return n;
+}
+
+uint64_t cannon::ray::reverse_bits_64(uint64_t n) {
+  uint64_t n0 = reverse_bits_32(static_cast<uint32_t>(n));
+  uint64_t n1 = reverse_bits_32(static_cast<uint32_t>(n >> 32));
+  return (n0 << 32) | n1;
+}
+
+double cannon::ray::radical_inverse(unsigned int base_index, uint64_t a) {
+  if (base_index >= prime_table_size)
+    throw std::runtime_error("Radical inverse base index out of range");
+
+  // Base 2 reduces to reversing bits
+  if (base_index == 0)
+    return std::min(reverse_bits_64(a) * 0x1p-64, ONE_MINUS_EPSILON);
+
+  unsigned int base = primes[base_index];
+  double inv_base = 1.0 / base;
+  double inv_base_n = 1.0;
+  uint64_t reversed_digits = 0;
+  while (a) {
+    uint64_t next = a / base;
+    uint64_t digit = a - next * base;
+    reversed_digits = reversed_digits * base + digit;
+    inv_base_n *= inv_base;
+    a = next;
+  }
+
+  return std::min(reversed_digits * inv_base_n, ONE_MINUS_EPSILON);
+}
+
+double cannon::ray::scrambled_radical_inverse(unsigned int base_index,
+    uint64_t a, const uint16_t* perm) {
+  if (base_index >= prime_table_size)
+    throw std::runtime_error("Radical inverse base index out of range");
+
+  unsigned int base = primes[base_index];
+  double inv_base = 1.0 / base;
+  double inv_base_n = 1.0;
+  uint64_t reversed_digits = 0;
+  while (a) {
+    uint64_t next = a / base;
+    uint64_t digit = a - next * base;
+    reversed_digits = reversed_digits * base + perm[digit];
+    inv_base_n *= inv_base;
+    a = next;
+  }
+
+  // Trailing zero digits are permuted too, which sums to a geometric series
+  return std::min(inv_base_n * (reversed_digits + inv_base * perm[0] / (1 - inv_base)),
+      ONE_MINUS_EPSILON);
+}
+
+uint64_t cannon::ray::inverse_radical_inverse(unsigned int base, uint64_t
+    inverse, int n_digits) {
+  uint64_t index = 0;
+  for (int i = 0; i < n_digits; i++) {
+    uint64_t digit = inverse % base;
+    inverse /= base;
+    index = index * base + digit;
+  }
+
+  return index;
+}
+
+uint64_t cannon::ray::multiplicative_inverse(int64_t a, int64_t n) {
+  int64_t x, y;
+  extended_gcd(a, n, &x, &y);
+  return ((x % n) + n) % n;
+}
+
+const std::vector<uint16_t>& cannon::ray::radical_inverse_permutations() {
+  static const std::vector<uint16_t> perms = []() {
+    std::vector<uint16_t> p(prime_sums[prime_table_size - 1] + primes[prime_table_size - 1]);
+
+    // Fixed seed, so that renders are repeatable
+    std::mt19937 rng(0);
+    for (unsigned int i = 0; i < prime_table_size; i++) {
+      uint16_t* perm = &p[prime_sums[i]];
+      for (unsigned int j = 0; j < primes[i]; j++)
+        perm[j] = j;
+      std::shuffle(perm, perm + primes[i], rng);
+    }
+
+    return p;
+  }();
+
+  return perms;
+}
+
+const uint32_t* cannon::ray::sobol_matrix(unsigned int dimension) {
+  static const std::vector<uint32_t> matrices = compute_sobol_matrices();
+
+  if (dimension >= sobol_dimensions)
+    throw std::runtime_error("Sobol dimension out of range");
+
+  return &matrices[dimension * sobol_matrix_size];
+}
+
+uint32_t cannon::ray::sobol_sample(uint64_t index, unsigned int dimension) {
+  const uint32_t* c = sobol_matrix(dimension);
+
+  uint32_t v = 0;
+  for (unsigned int j = 0; index && j < sobol_matrix_size; index >>= 1, j++) {
+    if (index & 1)
+      v ^= c[j];
+  }
+
+  return v;
+}
+
+uint32_t cannon::ray::owen_scramble(uint32_t v, uint32_t seed) {
+  // Laine-Karras style hash, applied to reversed bits so that each digit is
+  // only affected by more significant digits
+  v = reverse_bits_32(v);
+  v ^= v * 0x3d20adea;
+  v += seed;
+  v *= (seed >> 16) | 1;
+  v ^= v * 0x05526c56;
+  v ^= v * 0x53a22864;
+  return reverse_bits_32(v);
+}
+
+double cannon::ray::fixed_to_double(uint32_t v) {
+  return std::min(v * 0x1p-32, ONE_MINUS_EPSILON);
+}
@@ -0,0 +1,126 @@
+#pragma once
+#ifndef CANNON_RAY_LOW_DISCREPANCY_H
+#define CANNON_RAY_LOW_DISCREPANCY_H
+
+/*!
+ * \file cannon/ray/low_discrepancy.hpp
+ * \brief File containing functions for generating low-discrepancy point
+ * sequences (radical inverses, Sobol points, and Owen scrambling), as used by
+ * the Halton, Sobol, and (0,2)-sequence samplers. Adapted from PBRT.
+ */
+
+#include <cstdint>
+#include <vector>
+
+namespace cannon {
+  namespace ray {
+
+    static constexpr unsigned int prime_table_size = 128; //!< Number of Halton dimensions with precomputed primes
+    static constexpr unsigned int sobol_dimensions = 32; //!< Number of Sobol dimensions with precomputed generator matrices
+    static constexpr unsigned int sobol_matrix_size = 32; //!< Number of columns in each Sobol generator matrix
+
+    extern const unsigned int primes[prime_table_size]; //!< First prime_table_size primes
+    extern const unsigned int prime_sums[prime_table_size]; //!< Sum of all primes before each prime
+
+    /*!
+     * Reverse the bits of a 32-bit integer.
+     */
+    uint32_t reverse_bits_32(uint32_t n);
+
+    /*!
+     * Reverse the bits of a 64-bit integer.
+     */
+    uint64_t reverse_bits_64(uint64_t n);
+
+    /*!
+     * Compute the radical inverse of an integer in a prime base, by
+     * mirroring its digits about the decimal point.
+     *
+     * \param base_index Index of the base in primes.
+     * \param a The integer to invert.
+     *
+     * \returns The radical inverse, in [0, 1).
+     */
+    double radical_inverse(unsigned int base_index, uint64_t a);
+
+    /*!
+     * Compute the radical inverse of an integer in a prime base, after
+     * permuting each of its digits, including the infinite trailing zeros.
+     *
+     * \param base_index Index of the base in primes.
+     * \param a The integer to invert.
+     * \param perm Digit permutation for the base, of size primes[base_index].
+     *
+     * \returns The scrambled radical inverse, in [0, 1).
+     */
+    double scrambled_radical_inverse(unsigned int base_index, uint64_t a,
+        const uint16_t* perm);
+
+    /*!
+     * Recover the integer whose radical inverse in the input base has the
+     * input leading digits.
+     *
+     * \param base The base of the radical inverse.
+     * \param inverse The leading digits of the radical inverse, as an integer.
+     * \param n_digits The number of leading digits.
+     *
+     * \returns The integer.
+     */
+    uint64_t inverse_radical_inverse(unsigned int base, uint64_t inverse, int n_digits);
+
+    /*!
+     * Compute the inverse of a modulo n, for coprime a and n.
+     */
+    uint64_t multiplicative_inverse(int64_t a, int64_t n);
+
+    /*!
+     * Get random digit permutations for each base in primes, generated once
+     * from a fixed seed. The permutation for base_index starts at offset
+     * prime_sums[base_index].
+     *
+     * \returns Concatenated digit permutations.
+     */
+    const std::vector<uint16_t>& radical_inverse_permutations();
+
+    /*!
+     * Get the generator matrix for a dimension of the Sobol sequence, computed
+     * once from Joe and Kuo's direction numbers. Column j holds the digits
+     * contributed by bit j of the sample index, most significant digit first.
+     *
+     * \param dimension The Sobol dimension, less than sobol_dimensions.
+     *
+     * \returns Pointer to sobol_matrix_size matrix columns.
+     */
+    const uint32_t* sobol_matrix(unsigned int dimension);
+
+    /*!
+     * Compute a dimension of a Sobol point as a 32-bit fixed point fraction.
+     *
+     * \param index Index of the point, less than 2^32.
+     * \param dimension The Sobol dimension, less than sobol_dimensions.
+     *
+     * \returns The digits of the point in this dimension.
+     */
+    uint32_t sobol_sample(uint64_t index, unsigned int dimension);
+
+    /*!
+     * Apply a hash-based Owen scramble to a 32-bit fixed point fraction,
+     * which randomly permutes each digit depending only on the digits before
+     * it. Scrambling keeps the stratification of (t,m,s)-nets.
+     *
+     * \param v The fraction to scramble.
+     * \param seed Seed selecting the scramble.
+     *
+     * \returns The scrambled fraction.
+     */
+    uint32_t owen_scramble(uint32_t v, uint32_t seed);
+
+    /*!
+     * Convert a 32-bit fixed point fraction to a double in [0, 1).
+     */
+    double fixed_to_double(uint32_t v);
+
+  } // namespace ray
+} // namespace cannon
+
+#endif /* ifndef CANNON_RAY_LOW_DISCREPANCY_H */
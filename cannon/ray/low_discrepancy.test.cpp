@@ -0,0 +1,67 @@
+#include <vector>
+#include <algorithm>
+
+#include <catch2/catch.hpp>
+
+#include <cannon/ray/low_discrepancy.hpp>
+
+using namespace cannon::ray;
+
+TEST_CASE("LowDiscrepancy", "[ray]") {
+  // Radical inverses mirror digits about the decimal point
+  REQUIRE(radical_inverse(0, 0) == 0.0);
+  REQUIRE(radical_inverse(0, 1) == Approx(0.5));
+  REQUIRE(radical_inverse(0, 3) == Approx(0.75));
+  REQUIRE(radical_inverse(0, 6) == Approx(0.375));
+  REQUIRE(radical_inverse(1, 1) == Approx(1.0 / 3.0));
+  REQUIRE(radical_inverse(1, 5) == Approx(2.0 / 3.0 + 1.0 / 9.0));
+  REQUIRE(inverse_radical_inverse(3, 7, 2) == 5);
+  REQUIRE(multiplicative_inverse(3, 8) == 3);
+
+  // Permuted radical inverses stay in [0, 1), and differ only by a shift
+  // from their permuted leading digit
+  const auto& perms = radical_inverse_permutations();
+  for (unsigned int b = 1; b < 8; b++) {
+    unsigned int base = primes[b];
+    const uint16_t* perm = &perms[prime_sums[b]];
+    double shift = scrambled_radical_inverse(b, 0, perm) - perm[0] / double(base);
+    for (unsigned int i = 0; i < base; i++) {
+      double v = scrambled_radical_inverse(b, i, perm);
+      REQUIRE(v >= 0.0);
+      REQUIRE(v < 1.0);
+      REQUIRE(v == Approx(perm[i] / double(base) + shift));
+    }
+  }
+
+  // Each Sobol dimension is stratified in one dimension
+  for (unsigned int d = 0; d < sobol_dimensions; d++) {
+    std::vector<int> strata(64, 0);
+    for (unsigned int i = 0; i < 64; i++)
+      strata[sobol_sample(i, d) >> 26]++;
+    REQUIRE(std::all_of(strata.begin(), strata.end(), [](int c) { return c == 1; }));
+  }
+
+  // The first two Sobol dimensions form a (0,2)-sequence, so the first 2^m
+  // points put one point in every elementary interval of area 2^-m, which
+  // Owen scrambling preserves
+  unsigned int m = 6;
+  for (uint32_t seed : {0u, 12345u}) {
+    for (unsigned int k = 0; k <= m; k++) {
+      std::vector<int> strata(1u << m, 0);
+      for (unsigned int i = 0; i < (1u << m); i++) {
+        uint32_t x = sobol_sample(i, 0), y = sobol_sample(i, 1);
+        if (seed != 0) {
+          x = owen_scramble(x, seed);
+          y = owen_scramble(y, seed + 1);
+        }
+
+        uint32_t cx = k == 0 ? 0 : x >> (32 - k);
+        uint32_t cy = k == m ? 0 : y >> (32 - (m - k));
+        strata[(cx << (m - k)) | cy]++;
+      }
+      REQUIRE(std::all_of(strata.begin(), strata.end(), [](int c) { return c == 1; }));
+    }
+  }
+
+  REQUIRE(fixed_to_double(0xffffffff) < 1.0);
+}
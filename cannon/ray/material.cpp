@@ -6,12 +6,37 @@
 
 using namespace cannon::ray;
 
+/*!
+ * Call the input function on a material cast to its concrete type. Material
+ * classes in this file are final, so calls through the cast reference are
+ * resolved statically and can be inlined.
+ */
+template <typename F>
+static auto dispatch_material(const Material& m, F&& f) {
+  switch (m.type_) {
+    case MaterialType::NormalDebug:
+      return f(static_cast<const NormalDebug&>(m));
+    case MaterialType::Lambertian:
+      return f(static_cast<const Lambertian&>(m));
+    case MaterialType::Metal:
+      return f(static_cast<const Metal&>(m));
+    case MaterialType::Dielectric:
+      return f(static_cast<const Dielectric&>(m));
+    case MaterialType::DiffuseLight:
+      return f(static_cast<const DiffuseLight&>(m));
+    case MaterialType::Isotropic:
+      return f(static_cast<const Isotropic&>(m));
+    default:
+      return f(m);
+  }
+}
+
 bool NormalDebug::scatter(const Ray& r_in, const hit_record& rec, Vector3d& attenuation,
-    Ray& scattered) const {
+    Ray& scattered, Rng& rng) const {
   attenuation = 0.5 * Vector3d(rec.normal.x() + 1, rec.normal.y() + 1, rec.normal.z() + 1);
 
   // Just Lambertian for now
-  Vector3d scatter_direction = rec.normal + random_unit_vec();
+  Vector3d scatter_direction = rec.normal + random_unit_vec(rng);
 
   // Catch degenerate scatter direction
   if ((std::fabs(scatter_direction[0]) < 1e-8) &&
@@ -20,15 +45,20 @@ bool NormalDebug::scatter(const Ray& r_in, const hit_record& rec, Vector3d& atte
     scatter_direction = rec.normal;
   }
 
-  scattered = Ray(rec.p, scatter_direction, r_in.time_);
+  scattered = rec.spawn_ray(scatter_direction, r_in.time_);
   return true;
 }
 
-Lambertian::Lambertian(const Vector3d& a) : albedo_(std::make_shared<SolidColor>(a)) {}
+Vector3d NormalDebug::albedo(const hit_record& rec) const {
+  return 0.5 * (rec.normal + Vector3d::Ones());
+}
+
+Lambertian::Lambertian(const Vector3d& a) : Material(MaterialType::Lambertian),
+  albedo_(std::make_shared<SolidColor>(a)) {}
 
 bool Lambertian::scatter(const Ray& r_in, const hit_record& rec, Vector3d&
-    attenuation, Ray& scattered) const {
-  Vector3d scatter_direction = rec.normal + random_unit_vec();
+    attenuation, Ray& scattered, Rng& rng) const {
+  Vector3d scatter_direction = rec.normal + random_unit_vec(rng);
 
   // Catch degenerate scatter direction
   if ((std::fabs(scatter_direction[0]) < 1e-8) &&
@@ -37,21 +67,41 @@ bool Lambertian::scatter(const Ray& r_in, const hit_record& rec, Vector3d&
     scatter_direction = rec.normal;
   }
 
-  scattered = Ray(rec.p, scatter_direction, r_in.time_);
-  attenuation = albedo_->value(rec.u, rec.v, rec.p);
+  scattered = rec.spawn_ray(scatter_direction, r_in.time_);
+  attenuation = albedo_->evaluate(rec);
   return true;
 }
 
+Vector3d Lambertian::eval(const Ray& r_in, const hit_record& rec, const
+    Vector3d& direction) const {
+  return scattering_pdf(r_in, rec, direction) * albedo_->evaluate(rec);
+}
+
+Vector3d Lambertian::albedo(const hit_record& rec) const {
+  return albedo_->evaluate(rec);
+}
+
+double Lambertian::scattering_pdf(const Ray& /*r_in*/, const hit_record& rec,
+    const Vector3d& direction) const {
+  // Scattered directions are cosine-distributed about the normal
+  double cosine = rec.normal.dot(direction.normalized());
+  return cosine < 0 ? 0 : cosine / M_PI;
+}
+
 bool Metal::scatter(const Ray& r_in, const hit_record& rec, Vector3d&
-    attenuation, Ray& scattered) const {
+    attenuation, Ray& scattered, Rng& rng) const {
   Vector3d reflected = reflect(r_in.dir_.normalized(), rec.normal);
-  scattered = Ray(rec.p, reflected + fuzz_ * random_in_unit_sphere(), r_in.time_);
+  scattered = rec.spawn_ray(reflected + fuzz_ * random_in_unit_sphere(rng), r_in.time_);
   attenuation = albedo_;
   return (scattered.dir_.dot(rec.normal) > 0);
 }
 
+Vector3d Metal::albedo(const hit_record& /*rec*/) const {
+  return albedo_;
+}
+
 bool Dielectric::scatter(const Ray& r_in, const hit_record& rec, Vector3d&
-    attenuation, Ray& scattered) const {
+    attenuation, Ray& scattered, Rng& rng) const {
   attenuation = Vector3d::Ones();
   double refraction_ratio = rec.front_face ? (1.0 / ir_) : ir_;
   Vector3d unit_direction = r_in.dir_.normalized();
@@ -64,32 +114,94 @@ bool Dielectric::scatter(const Ray& r_in, const hit_record& rec, Vector3d&
 
   Vector3d direction;
 
-  if (cannot_refract || reflectance(cos_theta, refraction_ratio) > random_double())
+  if (cannot_refract || reflectance(cos_theta, refraction_ratio) > random_double(rng))
     direction = reflect(unit_direction, rec.normal);
   else
     direction = refract(unit_direction, rec.normal.normalized(), refraction_ratio);
 
-  scattered = Ray(rec.p, direction, r_in.time_);
+  scattered = rec.spawn_ray(direction, r_in.time_);
   return true;
 }
 
 bool Isotropic::scatter(const Ray& r_in, const hit_record& rec,
-    Vector3d& attenuation, Ray& scattered) const {
-  scattered = Ray(rec.p, random_in_unit_sphere(), r_in.time_);
-  attenuation = albedo_->value(rec.u, rec.v, rec.p);
+    Vector3d& attenuation, Ray& scattered, Rng& rng) const {
+  scattered = rec.spawn_ray(random_in_unit_sphere(rng), r_in.time_);
+  attenuation = albedo_->evaluate(rec);
 
   return true;
 }
 
-DiffuseLight::DiffuseLight(const Vector3d& c) : emit_(std::make_shared<SolidColor>(c)) {}
+Vector3d Isotropic::eval(const Ray& r_in, const hit_record& rec, const
+    Vector3d& direction) const {
+  return scattering_pdf(r_in, rec, direction) * albedo_->evaluate(rec);
+}
+
+Vector3d Isotropic::albedo(const hit_record& rec) const {
+  return albedo_->evaluate(rec);
+}
+
+double Isotropic::scattering_pdf(const Ray& /*r_in*/, const hit_record& /*rec*/,
+    const Vector3d& /*direction*/) const {
+  // Scattered directions are uniform over the sphere
+  return 1 / (4 * M_PI);
+}
+
+DiffuseLight::DiffuseLight(const Vector3d& c) : Material(MaterialType::DiffuseLight),
+  emit_(std::make_shared<SolidColor>(c)) {}
 
 Vector3d DiffuseLight::emitted(double u, double v, const Vector3d& p) const {
   return emit_->value(u, v, p);
 }
 
-Isotropic::Isotropic(const Vector3d& c) : albedo_(std::make_shared<SolidColor>(c)) {}
+Vector3d DiffuseLight::albedo(const hit_record& rec) const {
+  // Emission is unbounded, so it is clamped to the range of reflectances
+  return emit_->evaluate(rec).cwiseMin(1.0);
+}
+
+Isotropic::Isotropic(const Vector3d& c) : Material(MaterialType::Isotropic),
+  albedo_(std::make_shared<SolidColor>(c)) {}
 
 // Public Functions
+bool cannon::ray::material_scatter(const Material& m, const Ray& r_in, const
+    hit_record& rec, Vector3d& attenuation, Ray& scattered, Rng& rng) {
+  return dispatch_material(m, [&](const auto& mat) {
+    return mat.scatter(r_in, rec, attenuation, scattered, rng);
+  });
+}
+
+Vector3d cannon::ray::material_emitted(const Material& m, double u, double v,
+    const Vector3d& p) {
+  return dispatch_material(m, [&](const auto& mat) {
+    return mat.emitted(u, v, p);
+  });
+}
+
+bool cannon::ray::material_is_specular(const Material& m) {
+  return dispatch_material(m, [&](const auto& mat) {
+    return mat.is_specular();
+  });
+}
+
+Vector3d cannon::ray::material_albedo(const Material& m, const hit_record& rec) {
+  return dispatch_material(m, [&](const auto& mat) {
+    return mat.albedo(rec);
+  });
+}
+
+Vector3d cannon::ray::material_eval(const Material& m, const Ray& r_in, const
+    hit_record& rec, const Vector3d& direction) {
+  return dispatch_material(m, [&](const auto& mat) {
+    return mat.eval(r_in, rec, direction);
+  });
+}
+
+double cannon::ray::material_scattering_pdf(const Material& m, const Ray& r_in,
+    const hit_record& rec, const Vector3d& direction) {
+  return dispatch_material(m, [&](const auto& mat) {
+    return mat.scattering_pdf(r_in, rec, direction);
+  });
+}
+
 Vector3d cannon::ray::reflect(const Vector3d& v, const Vector3d& n) {
   return v - 2*v.dot(n)*n;
 }
@@ -9,6 +9,7 @@
 
 #include <Eigen/Dense>
 
+#include <cannon/math/rng.hpp>
 #include <cannon/math/random_double.hpp>
 #include <cannon/utils/class_forward.hpp>
 
@@ -23,12 +24,38 @@ namespace cannon {
     CANNON_CLASS_FORWARD(Texture);
     CANNON_CLASS_FORWARD(hit_record);
 
+    /*!
+     * \brief Enumeration of the materials defined in this file, so that the
+     * integrator can dispatch on the type of a material rather than through
+     * virtual calls. See material_scatter() and friends.
+     */
+    enum class MaterialType {
+      NormalDebug,
+      Lambertian,
+      Metal,
+      Dielectric,
+      DiffuseLight,
+      Isotropic,
+      Other //!< Any other material, which is dispatched virtually
+    };
+
     /*!
      * \brief Abstract class representing a hittable geometry's material.
      */
     class Material {
       public:
 
+        /*!
+         * Constructor taking the type of this material. Materials defined
+         * outside this file should leave it as MaterialType::Other.
+         */
+        Material(MaterialType type=MaterialType::Other) : type_(type) {}
+
+        /*!
+         * Destructor.
+         */
+        virtual ~Material() {}
+
         /*!
          * Method that scatters an incoming ray using the properties of the
          * specific material implementing this abstract class.
@@ -37,11 +64,12 @@ namespace cannon {
          * \param rec Hit record for the incoming ray, modified by this method.
          * \param attenuation Color of attenuated child ray.
          * \param scattered Scattered child ray.
+         * \param rng Random number generator for sampling the scattered ray.
          *
          * \returns Whether the input ray was scattered.
          */
         virtual bool scatter(const Ray& r_in, const hit_record& rec, Vector3d&
-            attenuation, Ray& scattered) const = 0;
+            attenuation, Ray& scattered, Rng& rng) const = 0;
 
         /*!
          * Method that returns the emitted color for this material at a
@@ -56,14 +84,78 @@ namespace cannon {
         virtual Vector3d emitted(double /*u*/, double /*v*/, const Vector3d& /*p*/) const {
           return Vector3d::Zero();
         }
+
+        /*!
+         * Method that returns whether this material scatters light only in
+         * directions which cannot be evaluated by eval(), such as mirrors
+         * and glass. Lights are not sampled directly from such materials.
+         *
+         * \returns Whether this material is specular.
+         */
+        virtual bool is_specular() const {
+          return true;
+        }
+
+        /*!
+         * Method that evaluates the scattering function of this material
+         * times the cosine of the scattered direction, i.e. the attenuation
+         * scatter() would report for the scattered direction multiplied by
+         * the density with which it is sampled.
+         *
+         * \param r_in Incoming ray.
+         * \param rec Hit record for the incoming ray.
+         * \param direction Scattered direction.
+         *
+         * \returns Scattered color per unit solid angle.
+         */
+        virtual Vector3d eval(const Ray& /*r_in*/, const hit_record& /*rec*/,
+            const Vector3d& /*direction*/) const {
+          return Vector3d::Zero();
+        }
+
+        /*!
+         * Method that returns the solid angle density with which scatter()
+         * samples the input scattered direction.
+         *
+         * \param r_in Incoming ray.
+         * \param rec Hit record for the incoming ray.
+         * \param direction Scattered direction.
+         *
+         * \returns The sampling density.
+         */
+        virtual double scattering_pdf(const Ray& /*r_in*/, const hit_record&
+            /*rec*/, const Vector3d& /*direction*/) const {
+          return 0.0;
+        }
+
+        /*!
+         * Method that returns the reflectance of this material at a hit
+         * point, for feature buffers guiding denoising. Materials which
+         * reflect all light, such as glass, return one.
+         *
+         * \param rec Hit record for the point.
+         *
+         * \returns Albedo color.
+         */
+        virtual Vector3d albedo(const hit_record& /*rec*/) const {
+          return Vector3d::Ones();
+        }
+
+      public:
+        MaterialType type_; //!< Type of this material, for dispatch without virtual calls
     };
 
     /*!
      * \brief Class representing a debugging material displaying normal direction.
      */
-    class NormalDebug : public Material {
+    class NormalDebug final : public Material {
       public:
 
+        /*!
+         * Default constructor.
+         */
+        NormalDebug() : Material(MaterialType::NormalDebug) {}
+
         /*!
          * Destructor.
          */
@@ -73,14 +165,18 @@ namespace cannon {
          * Inherited from Material.
          */
         virtual bool scatter(const Ray& r_in, const hit_record& rec, Vector3d&
-            attenuation, Ray& scattered) const override;
+            attenuation, Ray& scattered, Rng& rng) const override;
 
+        /*!
+         * Inherited from Material.
+         */
+        virtual Vector3d albedo(const hit_record& rec) const override;
     };
 
     /*!
      * \brief Class representing a Lambertian diffuse material.
      */
-    class Lambertian : public Material {
+    class Lambertian final : public Material {
       public:
 
         /*!
@@ -91,7 +187,7 @@ namespace cannon {
         /*!
          * Constructor taking albedo texture.
          */
-        Lambertian(TexturePtr a) : albedo_(a) {}
+        Lambertian(TexturePtr a) : Material(MaterialType::Lambertian), albedo_(a) {}
 
         /*!
          * Destructor.
@@ -102,7 +198,31 @@ namespace cannon {
          * Inherited from Material.
          */
         virtual bool scatter(const Ray& r_in, const hit_record& rec, Vector3d&
-            attenuation, Ray& scattered) const override;
+            attenuation, Ray& scattered, Rng& rng) const override;
+
+        /*!
+         * Inherited from Material.
+         */
+        virtual bool is_specular() const override {
+          return false;
+        }
+
+        /*!
+         * Inherited from Material.
+         */
+        virtual Vector3d eval(const Ray& r_in, const hit_record& rec, const
+            Vector3d& direction) const override;
+
+        /*!
+         * Inherited from Material.
+         */
+        virtual double scattering_pdf(const Ray& r_in, const hit_record& rec,
+            const Vector3d& direction) const override;
+
+        /*!
+         * Inherited from Material.
+         */
+        virtual Vector3d albedo(const hit_record& rec) const override;
 
       public:
         TexturePtr albedo_; //!< Albedo color for this material.
@@ -112,13 +232,14 @@ namespace cannon {
     /*!
      * \brief Class representing a simple reflective metal material.
      */
-    class Metal : public Material {
+    class Metal final : public Material {
       public:
 
         /*!
          * Constructor taking albedo and fuzziness.
          */
-        Metal(const Vector3d& a, double f) : albedo_(a), fuzz_(f < 1 ? f : 1) {}
+        Metal(const Vector3d& a, double f) : Material(MaterialType::Metal),
+          albedo_(a), fuzz_(f < 1 ? f : 1) {}
 
         /*!
          * Destructor.
@@ -129,7 +250,12 @@ namespace cannon {
          * Inherited from Material.
          */
         virtual bool scatter(const Ray& r_in, const hit_record& rec, Vector3d&
-            attenuation, Ray& scattered) const override;
+            attenuation, Ray& scattered, Rng& rng) const override;
+
+        /*!
+         * Inherited from Material.
+         */
+        virtual Vector3d albedo(const hit_record& rec) const override;
 
       public:
         Vector3d albedo_; //!< Albedo color for this material.
@@ -139,13 +265,13 @@ namespace cannon {
     /*!
      * \brief Class representing a dielectric material (such as glass)
      */
-    class Dielectric : public Material {
+    class Dielectric final : public Material {
       public:
 
         /*!
          * Constructor taking index of refraction.
          */
-        Dielectric(double ir) : ir_(ir) {}
+        Dielectric(double ir) : Material(MaterialType::Dielectric), ir_(ir) {}
 
         /*!
          * Destructor.
@@ -156,19 +282,19 @@ namespace cannon {
          * Inherited from Material.
          */
         virtual bool scatter(const Ray& r_in, const hit_record& rec, Vector3d&
-            attenuation, Ray& scattered) const override;
+            attenuation, Ray& scattered, Rng& rng) const override;
 
       public:
         double ir_; //!< Index of refraction
     };
 
-    class DiffuseLight : public Material {
+    class DiffuseLight final : public Material {
       public:
 
         /*!
          * Constructor taking a texture for this material.
          */
-        DiffuseLight(TexturePtr a) : emit_(a) {}
+        DiffuseLight(TexturePtr a) : Material(MaterialType::DiffuseLight), emit_(a) {}
 
         /*!
          * Constructor taking a color for this material.
@@ -184,7 +310,7 @@ namespace cannon {
          * Inherited from Material.
          */
         virtual bool scatter(const Ray& /*r_in*/, const hit_record& /*rec*/, Vector3d&
-            /*attenuation*/, Ray& /*scattered*/) const override {
+            /*attenuation*/, Ray& /*scattered*/, Rng& /*rng*/) const override {
           return false;
         }
 
@@ -193,11 +319,16 @@ namespace cannon {
          */
         virtual Vector3d emitted(double u, double v, const Vector3d& p) const override;
 
+        /*!
+         * Inherited from Material.
+         */
+        virtual Vector3d albedo(const hit_record& rec) const override;
+
       public:
         TexturePtr emit_; //!< Emissive texture
     };
 
-    class Isotropic : public Material {
+    class Isotropic final : public Material {
       public:
 
         /*!
@@ -208,7 +339,7 @@ namespace cannon {
         /*!
          * Constructor taking a texture for this material.
          */
-        Isotropic(TexturePtr a) : albedo_(a) {}
+        Isotropic(TexturePtr a) : Material(MaterialType::Isotropic), albedo_(a) {}
 
         /*!
          * Destructor.
@@ -219,8 +350,32 @@ namespace cannon {
          * Inherited from Material.
          */
         virtual bool scatter(const Ray& r_in, const hit_record& rec, Vector3d&
-            attenuation, Ray& scattered) const override;
+            attenuation, Ray& scattered, Rng& rng) const override;
 
+        /*!
+         * Inherited from Material.
+         */
+        virtual bool is_specular() const override {
+          return false;
+        }
+
+        /*!
+         * Inherited from Material.
+         */
+        virtual Vector3d eval(const Ray& r_in, const hit_record& rec, const
+            Vector3d& direction) const override;
+
+        /*!
+         * Inherited from Material.
+         */
+        virtual double scattering_pdf(const Ray& r_in, const hit_record& rec,
+            const Vector3d& direction) const override;
+
+
+        /*!
+         * Inherited from Material.
+         */
+        virtual Vector3d albedo(const hit_record& rec) const override;
 
       public:
         TexturePtr albedo_; //!< Albedo for this material
@@ -228,6 +383,47 @@ namespace cannon {
     };
 
     // Public Functions
+
+    /*!
+     * Function that scatters an incoming ray off a material, dispatching on
+     * the material's type so that materials defined in this file are
+     * called directly rather than virtually. See Material::scatter().
+     */
+    bool material_scatter(const Material& m, const Ray& r_in, const
+        hit_record& rec, Vector3d& attenuation, Ray& scattered, Rng& rng);
+
+    /*!
+     * Function that computes the color emitted by a material, dispatching
+     * on its type. See Material::emitted().
+     */
+    Vector3d material_emitted(const Material& m, double u, double v, const Vector3d& p);
+
+    /*!
+     * Function that returns whether a material is specular, dispatching on
+     * its type. See Material::is_specular().
+     */
+    bool material_is_specular(const Material& m);
+
+    /*!
+     * Function that returns the albedo of a material, dispatching on its
+     * type. See Material::albedo().
+     */
+    Vector3d material_albedo(const Material& m, const hit_record& rec);
+
+    /*!
+     * Function that evaluates the scattering function of a material,
+     * dispatching on its type. See Material::eval().
+     */
+    Vector3d material_eval(const Material& m, const Ray& r_in, const
+        hit_record& rec, const Vector3d& direction);
+
+    /*!
+     * Function that returns the density with which a material samples a
+     * scattered direction, dispatching on its type. See
+     * Material::scattering_pdf().
+     */
+    double material_scattering_pdf(const Material& m, const Ray& r_in, const
+        hit_record& rec, const Vector3d& direction);
     
     /*!
      * Function that computes reflected direction for an incoming ray.
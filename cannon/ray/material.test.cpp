@@ -1,7 +1,98 @@
 #include <catch2/catch.hpp>
 
 #include <cannon/ray/material.hpp>
+#include <cannon/ray/ray.hpp>
+#include <cannon/ray/hittable.hpp>
+
+using namespace cannon::ray;
+
+/*!
+ * Material defined outside material.hpp, which must be dispatched virtually.
+ */
+class Absorber : public Material {
+  public:
+    virtual bool scatter(const Ray& /*r_in*/, const hit_record& /*rec*/,
+        Vector3d& /*attenuation*/, Ray& /*scattered*/, Rng& /*rng*/) const override {
+      return false;
+    }
+
+    virtual Vector3d emitted(double /*u*/, double /*v*/, const Vector3d& /*p*/) const override {
+      return Vector3d::Constant(2.0);
+    }
+};
 
 TEST_CASE("Material", "[ray]") {
+  auto mat = std::make_shared<Lambertian>(Vector3d(0.5, 0.5, 0.5));
+  REQUIRE(!mat->is_specular());
+
+  Ray r(Vector3d(0, 1, 0), Vector3d(0, -1, 0));
+  hit_record rec;
+  rec.p = Vector3d::Zero();
+  rec.set_face_normal(r, Vector3d::UnitY());
+  rec.mat_ptr = mat.get();
+
+  Vector3d up = Vector3d::UnitY();
+  REQUIRE(mat->scattering_pdf(r, rec, up) == Approx(1.0 / M_PI));
+  REQUIRE(mat->scattering_pdf(r, rec, -up) == 0.0);
+  REQUIRE(mat->eval(r, rec, up).isApprox(Vector3d::Constant(0.5 / M_PI)));
+
+  // Scattered directions lie in the hemisphere where the pdf is nonzero
+  Rng rng;
+  for (int i = 0; i < 100; i++) {
+    Vector3d attenuation;
+    Ray scattered;
+    REQUIRE(mat->scatter(r, rec, attenuation, scattered, rng));
+    REQUIRE(mat->scattering_pdf(r, rec, scattered.dir_) > 0.0);
+  }
+
+  REQUIRE(std::make_shared<Metal>(Vector3d(0.5, 0.5, 0.5), 0.0)->is_specular());
+}
+
+TEST_CASE("Material_dispatch", "[ray]") {
+  Ray r(Vector3d(0, 1, 0), Vector3d(0, -1, 0));
+  hit_record rec;
+  rec.p = Vector3d::Zero();
+  rec.set_face_normal(r, Vector3d::UnitY());
+
+  std::vector<std::shared_ptr<Material>> materials = {
+    std::make_shared<NormalDebug>(),
+    std::make_shared<Lambertian>(Vector3d(0.5, 0.5, 0.5)),
+    std::make_shared<Metal>(Vector3d(0.5, 0.5, 0.5), 0.1),
+    std::make_shared<Dielectric>(1.5),
+    std::make_shared<DiffuseLight>(Vector3d(4, 4, 4)),
+    std::make_shared<Isotropic>(Vector3d(0.5, 0.5, 0.5)),
+    std::make_shared<Absorber>()
+  };
+
+  REQUIRE(materials[1]->type_ == MaterialType::Lambertian);
+  REQUIRE(materials.back()->type_ == MaterialType::Other);
+
+  // Dispatching on type gives the same results as virtual calls, including
+  // random scattering given the same generator state
+  Vector3d d = Vector3d(1, 1, 0).normalized();
+  for (auto& mat : materials) {
+    rec.mat_ptr = mat.get();
+    REQUIRE(material_is_specular(*mat) == mat->is_specular());
+    REQUIRE(material_emitted(*mat, 0.5, 0.5, rec.p) == mat->emitted(0.5, 0.5, rec.p));
+    REQUIRE(material_eval(*mat, r, rec, d) == mat->eval(r, rec, d));
+    REQUIRE(material_scattering_pdf(*mat, r, rec, d) == mat->scattering_pdf(r, rec, d));
+    REQUIRE(material_albedo(*mat, rec) == mat->albedo(rec));
+
+    Rng rng_0(7), rng_1(7);
+    Vector3d attenuation_0, attenuation_1;
+    Ray scattered_0, scattered_1;
+    bool scattered = mat->scatter(r, rec, attenuation_0, scattered_0, rng_0);
+    REQUIRE(material_scatter(*mat, r, rec, attenuation_1, scattered_1, rng_1) == scattered);
+    if (scattered) {
+      REQUIRE(attenuation_0 == attenuation_1);
+      REQUIRE(scattered_0.dir_ == scattered_1.dir_);
+    }
+  }
+
+  REQUIRE(material_emitted(*materials.back(), 0, 0, rec.p) == Vector3d::Constant(2.0));
 
+  // Albedos are reflectances, so emission is clamped and glass reflects all
+  REQUIRE(material_albedo(*materials[1], rec).isApprox(Vector3d::Constant(0.5)));
+  REQUIRE(material_albedo(*materials[3], rec) == Vector3d::Ones());
+  REQUIRE(material_albedo(*materials[4], rec) == Vector3d::Ones());
 }
@@ -1,29 +1,65 @@
 #include <cannon/ray/mesh.hpp>
 
+#include <cstring>
+#include <fstream>
+#include <functional>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <cannon/ray/hittable_list.hpp>
 #include <cannon/ray/aabb.hpp>
 #include <cannon/ray/ray.hpp>
 
 using namespace cannon::ray;
 
-bool Triangle::bounding_box(double /*time_0*/, double /*time_1*/, Aabb& output_box) const {
-  Vector3u verts = parent_mesh_->indices_.row(mesh_index_).transpose();
+static const char mesh_binary_magic[4] = {'C', 'M', 'S', 'H'}; //!< First bytes of binary mesh files
+static const uint32_t mesh_binary_version = 1; //!< Version of binary mesh files written
+
+/*!
+ * \brief Struct representing the header of a binary mesh file.
+ */
+struct MeshBinaryHeader {
+  char magic[4]; //!< Always mesh_binary_magic
+  uint32_t version; //!< File format version
+  uint64_t n_vertices; //!< Number of vertices
+  uint64_t n_faces; //!< Number of faces
+};
+
+void TriangleMesh::build_face_data_() {
+  // Pad each array to a multiple of 16 floats so that every array starts
+  // on a 64-byte boundary relative to the first
+  size_t n_faces = indices_.rows();
+  face_stride_ = ((n_faces + 15) / 16) * 16;
+  face_data_.assign(9 * face_stride_, 0.0f);
+
+  for (size_t f = 0; f < n_faces; f++) {
+    for (int v = 0; v < 3; v++) {
+      for (int a = 0; a < 3; a++) {
+        face_data_[(3 * v + a) * face_stride_ + f] =
+          static_cast<float>(vertices_(indices_(f, v), a));
+      }
+    }
+  }
+}
 
-  Vector3d p0 = parent_mesh_->vertices_.row(verts[0]).transpose();
-  Vector3d p1 = parent_mesh_->vertices_.row(verts[1]).transpose();
-  Vector3d p2 = parent_mesh_->vertices_.row(verts[2]).transpose();
+bool Triangle::bounding_box(double /*time_0*/, double /*time_1*/, Aabb& output_box) const {
+  // Bounds come from the same single-precision vertices used for intersection
+  Vector3d p0 = parent_mesh_->face_vertex(mesh_index_, 0);
+  Vector3d p1 = parent_mesh_->face_vertex(mesh_index_, 1);
+  Vector3d p2 = parent_mesh_->face_vertex(mesh_index_, 2);
 
   output_box = surrounding_box(Aabb(p0, p1), p2);
   return true;
 }
 
 bool Triangle::object_space_bounding_box(double /*time_0*/, double /*time_1*/, Aabb& output_box) const {
-  Vector3u verts = parent_mesh_->indices_.row(mesh_index_).transpose();
-
   // Transform back to object space
-  Vector3d p0 = (*world_to_object_) * parent_mesh_->vertices_.row(verts[0]).transpose();
-  Vector3d p1 = (*world_to_object_) * parent_mesh_->vertices_.row(verts[1]).transpose();
-  Vector3d p2 = (*world_to_object_) * parent_mesh_->vertices_.row(verts[2]).transpose();
+  Vector3d p0 = (*world_to_object_) * parent_mesh_->face_vertex(mesh_index_, 0);
+  Vector3d p1 = (*world_to_object_) * parent_mesh_->face_vertex(mesh_index_, 1);
+  Vector3d p2 = (*world_to_object_) * parent_mesh_->face_vertex(mesh_index_, 2);
 
   output_box = surrounding_box(Aabb(p0, p1), p2);
   return true;
@@ -33,38 +69,37 @@ STAT_COUNTER("Integrator/Triangle hit tests", nTriangleHitTests);
 STAT_COUNTER("Integrator/Triangle intersections", nTriangleHits);
 
 bool Triangle::hit(const Ray& r, double /*t_min*/, double t_max, hit_record& rec) const {
+  double t;
+  Vector3d b;
+  if (!intersect(r, t_max, t, b))
+    return false;
+
+  finalize_hit(r, t, b, rec);
+  return true;
+}
+
+bool Triangle::intersect(const Ray& r, double t_max, double& t, Vector3d& b) const {
   // This implementation from Chapter 3 of PBRT
   
   ++nTriangleHitTests;
 
-  // Transform into ray-local coordinate space.
-  // Note this transformation calculation could be cached in Ray, since it's
-  // independent of the triangle coords
-  Vector3u verts = parent_mesh_->indices_.row(mesh_index_).transpose();
-  Vector3d p0 = parent_mesh_->vertices_.row(verts[0]).transpose();
-  Vector3d p1 = parent_mesh_->vertices_.row(verts[1]).transpose();
-  Vector3d p2 = parent_mesh_->vertices_.row(verts[2]).transpose();
-
-  Vector3d p0t = p0 - r.orig_;
-  Vector3d p1t = p1 - r.orig_;
-  Vector3d p2t = p2 - r.orig_;
+  typedef Matrix<Float, 3, 1> Vector3F;
 
-  // Permute coordinates so that the ray's z-axis has the greatest magnitude
-  int kz;
-  r.dir_.cwiseAbs().maxCoeff(&kz);
-  int kx = kz + 1; if (kx == 3) kx = 0; 
-  int ky = kx + 1; if (ky == 3) ky = 0;
+  // Transform into ray-local coordinate space, using the permutation and
+  // shear cached in the ray
+  Vector3F orig = r.orig_.cast<Float>();
+  Vector3F p0t = parent_mesh_->face_vertex(mesh_index_, 0).cast<Float>() - orig;
+  Vector3F p1t = parent_mesh_->face_vertex(mesh_index_, 1).cast<Float>() - orig;
+  Vector3F p2t = parent_mesh_->face_vertex(mesh_index_, 2).cast<Float>() - orig;
 
-  Vector3d d = permute_vec(r.dir_, kx, ky, kz);
-  p0t = permute_vec(p0t, kx, ky, kz);
-  p1t = permute_vec(p1t, kx, ky, kz);
-  p2t = permute_vec(p2t, kx, ky, kz);
+  p0t = Vector3F(p0t[r.kx_], p0t[r.ky_], p0t[r.kz_]);
+  p1t = Vector3F(p1t[r.kx_], p1t[r.ky_], p1t[r.kz_]);
+  p2t = Vector3F(p2t[r.kx_], p2t[r.ky_], p2t[r.kz_]);
 
   // Shear x and y dimensions of vertices to align ray with z axis
-  double sx = -d.x() / d.z();
-  double sy = -d.y() / d.z();
-  double sz = 1.0 / d.z();
-
+  Float sx = static_cast<Float>(r.sx_);
+  Float sy = static_cast<Float>(r.sy_);
+  Float sz = static_cast<Float>(r.sz_);
   p0t.x() += sx * p0t.z();
   p0t.y() += sy * p0t.z();
   p1t.x() += sx * p1t.z();
@@ -76,15 +111,15 @@ bool Triangle::hit(const Ray& r, double /*t_min*/, double t_max, hit_record& rec
   // projection of p0t, p1t, p2t
   //
   // For derivation of these coefficients, see pg. 161. 
-  double e0 = p1t.x() * p2t.y() - p1t.y() * p2t.x();
-  double e1 = p2t.x() * p0t.y() - p2t.y() * p0t.x();
-  double e2 = p0t.x() * p1t.y() - p0t.y() * p1t.x();
+  Float e0 = p1t.x() * p2t.y() - p1t.y() * p2t.x();
+  Float e1 = p2t.x() * p0t.y() - p2t.y() * p0t.x();
+  Float e2 = p0t.x() * p1t.y() - p0t.y() * p1t.x();
 
   if ((e0 < 0 || e1 < 0 || e2 < 0) && (e0 > 0 || e1 > 0 || e2 > 0))
     return false;
 
   // Ray approaches triangle edge-on, so we don't report intersection
-  double det = e0 + e1 + e2;
+  Float det = e0 + e1 + e2;
   if (det == 0)
     return false;
 
@@ -92,67 +127,87 @@ bool Triangle::hit(const Ray& r, double /*t_min*/, double t_max, hit_record& rec
   p0t.z() *= sz;
   p1t.z() *= sz;
   p2t.z() *= sz;
-  double t_scaled = e0 * p0t.z() + e1 * p1t.z() + e2 * p2t.z();
+  Float t_scaled = e0 * p0t.z() + e1 * p1t.z() + e2 * p2t.z();
   if (det < 0 && (t_scaled >= 0 || t_scaled < t_max * det))
     return false;
   else if (det > 0 && (t_scaled <= 0 || t_scaled > t_max * det))
     return false;
 
   // There is an intersection, so we compute barycentric coordinates
-  double inv_det = 1.0 / det;
-  double b0 = e0 * inv_det;
-  double b1 = e1 * inv_det;
-  double b2 = e2 * inv_det;
-  double t = t_scaled * inv_det;
-
-  // Computing UV coords
-  Vector3d dpdu, dpdv;
-  Vector2d uv[3];
-
-  uv[0] = parent_mesh_->tex_coords_.row(verts[0]).transpose();
-  uv[1] = parent_mesh_->tex_coords_.row(verts[1]).transpose();
-  uv[2] = parent_mesh_->tex_coords_.row(verts[2]).transpose();
-
-  Vector2d duv02 = uv[0] - uv[2];
-  Vector2d duv12 = uv[1] - uv[2];
-  Vector3d dp02 = p0 - p2;
-  Vector3d dp12 = p1 - p2;
-  
-  double determinant = duv02[0] * duv12[1] - duv02[1] * duv12[0];
-  if (determinant == 0) {
-    // Make an arbitrary coordinate system
-    Vector3d v = (p2 - p0).cross(p1 - p0).normalized();
-    if (std::abs(v.x()) > std::abs(v.y())) {
-      dpdu = Vector3d(-v.z(), 0, v.x()) / std::sqrt(v.x() * v.x() + v.z() * v.z());
-    } else {
-      dpdu = Vector3d(0, v.z(), -v.y()) / std::sqrt(v.y() * v.y() + v.z() * v.z());
-    }
-    dpdv = v.cross(dpdu);
-  } else {
-    double inv_determinant = 1 / determinant;
+  Float inv_det = 1 / det;
+  Float t_hit = t_scaled * inv_det;
+
+  // Reject hits closer than the bound on the rounding error in t, which
+  // are indistinguishable from hits behind the ray origin. See pg. 234.
+  double max_zt = std::max({std::fabs(p0t.z()), std::fabs(p1t.z()), std::fabs(p2t.z())});
+  double max_xt = std::max({std::fabs(p0t.x()), std::fabs(p1t.x()), std::fabs(p2t.x())});
+  double max_yt = std::max({std::fabs(p0t.y()), std::fabs(p1t.y()), std::fabs(p2t.y())});
+  double max_e = std::max({std::fabs(e0), std::fabs(e1), std::fabs(e2)});
+
+  double delta_z = error_gamma(3) * max_zt;
+  double delta_x = error_gamma(5) * (max_xt + max_zt);
+  double delta_y = error_gamma(5) * (max_yt + max_zt);
+  double delta_e = 2 * (error_gamma(2) * max_xt * max_yt + delta_y * max_xt + delta_x * max_yt);
+  double delta_t = 3 * (error_gamma(3) * max_e * max_zt + delta_e * max_zt +
+      delta_z * max_e) * std::fabs(inv_det);
+  if (t_hit <= delta_t)
+    return false;
 
-    dpdu = (duv12[1] * dp02 - duv02[1] * dp12) * inv_determinant;
-    dpdv = (-duv12[0] * dp02 + duv02[0] * dp12) * inv_determinant;
-  }
+  b = Vector3d(e0 * inv_det, e1 * inv_det, e2 * inv_det);
+  t = t_hit;
 
-  Vector3d pHit = b0 * p0 + b1 * p1 + b2 * p2;
-  Vector2d uvHit = b0 * uv[0] + b1 * uv[1] + b2 * uv[2];
+  nTriangleHits++;
+  return true;
+}
 
-  rec.p = pHit;
-  rec.u = uvHit[0];
-  rec.v = uvHit[1];
+void Triangle::finalize_hit(const Ray& r, double t, const Vector3d& b, hit_record& rec) const {
+  Vector3u verts = parent_mesh_->indices_.row(mesh_index_).transpose();
+
+  Vector3d p0 = parent_mesh_->face_vertex(mesh_index_, 0);
+  Vector3d p1 = parent_mesh_->face_vertex(mesh_index_, 1);
+  Vector3d p2 = parent_mesh_->face_vertex(mesh_index_, 2);
+
+  // Interpolating with barycentric coordinates is more accurate than
+  // evaluating the ray at t. See pg. 227.
+  rec.p = b[0] * p0 + b[1] * p1 + b[2] * p2;
+  rec.p_error = error_gamma(7) * ((b[0] * p0).cwiseAbs() + (b[1] * p1).cwiseAbs() +
+      (b[2] * p2).cwiseAbs());
+
+  Vector2d uv_hit = b[0] * parent_mesh_->tex_coords_.row(verts[0]).transpose() +
+                    b[1] * parent_mesh_->tex_coords_.row(verts[1]).transpose() +
+                    b[2] * parent_mesh_->tex_coords_.row(verts[2]).transpose();
+  rec.u = uv_hit[0];
+  rec.v = uv_hit[1];
+
+  // Partial derivatives from the texture coordinates at the vertices. See
+  // pg. 164.
+  Vector2d duv02 = parent_mesh_->tex_coords_.row(verts[0]).transpose() -
+    parent_mesh_->tex_coords_.row(verts[2]).transpose();
+  Vector2d duv12 = parent_mesh_->tex_coords_.row(verts[1]).transpose() -
+    parent_mesh_->tex_coords_.row(verts[2]).transpose();
+  double uv_det = duv02[0] * duv12[1] - duv02[1] * duv12[0];
+  if (std::fabs(uv_det) < 1e-12) {
+    rec.dpdu = Vector3d::Zero();
+    rec.dpdv = Vector3d::Zero();
+  } else {
+    Vector3d dp02 = p0 - p2;
+    Vector3d dp12 = p1 - p2;
+    rec.dpdu = (duv12[1] * dp02 - duv02[1] * dp12) / uv_det;
+    rec.dpdv = (-duv12[0] * dp02 + duv02[0] * dp12) / uv_det;
+  }
   rec.t = t;
-  rec.mat_ptr = parent_mesh_->mat_ptr_;
+  rec.mat_ptr = parent_mesh_->mat_ptr_.get();
 
   // Interpolate normals at vertices
-  Vector3d ns = b0 * parent_mesh_->normals_.row(verts[0]).transpose() + 
-                b1 * parent_mesh_->normals_.row(verts[1]).transpose() + 
-                b2 * parent_mesh_->normals_.row(verts[2]).transpose();
+  Vector3d ns = b[0] * parent_mesh_->normals_.row(verts[0]).transpose() + 
+                b[1] * parent_mesh_->normals_.row(verts[1]).transpose() + 
+                b[2] * parent_mesh_->normals_.row(verts[2]).transpose();
   ns.normalize();
   rec.set_face_normal(r, ns);
 
-  nTriangleHits++;
-  return true;
+  // Interpolated normals need not be perpendicular to the face, so spawned
+  // rays are offset along the face normal instead
+  rec.geometric_normal = (p0 - p2).cross(p1 - p2).normalized();
 }
 
 bool Triangle::object_space_hit(const Ray & /*r*/, double /*t_min*/,
@@ -235,6 +290,88 @@ cannon::ray::process_model_mesh(std::shared_ptr<Affine3d> t, std::shared_ptr<Mat
   return std::make_shared<TriangleMesh>(t, m, vertices, normals, tex_coords, indices);
 }
 
+void cannon::ray::write_mesh_binary(const std::string& path, const MatrixX3d&
+    vertices, const MatrixX3d& normals, const MatrixX2d& tex_coords, const
+    MatrixX3u& indices) {
+  if (normals.rows() != vertices.rows() || tex_coords.rows() != vertices.rows())
+    throw std::runtime_error("Mesh normals and texture coordinates must match vertices");
+
+  std::ofstream os(path, std::ios::binary);
+  if (!os)
+    throw std::runtime_error("Could not open " + path + " for writing");
+
+  MeshBinaryHeader header;
+  std::memcpy(header.magic, mesh_binary_magic, sizeof(header.magic));
+  header.version = mesh_binary_version;
+  header.n_vertices = vertices.rows();
+  header.n_faces = indices.rows();
+
+  os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  os.write(reinterpret_cast<const char*>(vertices.data()), vertices.size() * sizeof(double));
+  os.write(reinterpret_cast<const char*>(normals.data()), normals.size() * sizeof(double));
+  os.write(reinterpret_cast<const char*>(tex_coords.data()), tex_coords.size() * sizeof(double));
+  os.write(reinterpret_cast<const char*>(indices.data()), indices.size() * sizeof(unsigned int));
+
+  if (!os)
+    throw std::runtime_error("Could not write mesh to " + path);
+}
+
+std::shared_ptr<TriangleMesh> cannon::ray::load_mesh_binary(std::shared_ptr<Affine3d>
+    t, std::shared_ptr<Material> m, const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error("Could not open mesh file " + path);
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(MeshBinaryHeader)) {
+    close(fd);
+    throw std::runtime_error("Mesh file " + path + " is too short");
+  }
+
+  size_t size = st.st_size;
+  void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED)
+    throw std::runtime_error("Could not map mesh file " + path);
+
+  // The mapping is released however this function exits
+  std::unique_ptr<void, std::function<void(void*)>> mapping(mapped,
+      [size](void* p) { munmap(p, size); });
+  const char* data = static_cast<const char*>(mapped);
+
+  MeshBinaryHeader header;
+  std::memcpy(&header, data, sizeof(header));
+  if (std::memcmp(header.magic, mesh_binary_magic, sizeof(header.magic)) != 0 ||
+      header.version != mesh_binary_version)
+    throw std::runtime_error(path + " is not a binary mesh file of a supported version");
+
+  // Counts are bounded by the file size first, so that computing the
+  // expected size cannot overflow
+  uint64_t nv = header.n_vertices, nf = header.n_faces;
+  size_t data_size = size - sizeof(header);
+  if (nv > data_size / (8 * sizeof(double)) || nf > data_size / (3 * sizeof(unsigned int)))
+    throw std::runtime_error("Mesh file " + path + " is too short for its header");
+
+  size_t expected_size = sizeof(header) + nv * 8 * sizeof(double) + nf * 3 * sizeof(unsigned int);
+  if (size != expected_size)
+    throw std::runtime_error("Mesh file " + path + " has the wrong size for its header");
+
+  // Arrays are stored in Eigen's layout, so they are copied out of the
+  // mapping wholesale
+  const double* vertex_data = reinterpret_cast<const double*>(data + sizeof(header));
+  const unsigned int* index_data = reinterpret_cast<const unsigned int*>(vertex_data + 8 * nv);
+
+  MatrixX3d vertices = Map<const MatrixX3d>(vertex_data, nv, 3);
+  MatrixX3d normals = Map<const MatrixX3d>(vertex_data + 3 * nv, nv, 3);
+  MatrixX2d tex_coords = Map<const MatrixX2d>(vertex_data + 6 * nv, nv, 2);
+  MatrixX3u indices = Map<const MatrixX3u>(index_data, nf, 3);
+
+  if (nf > 0 && (nv == 0 || indices.maxCoeff() >= nv))
+    throw std::runtime_error("Mesh file " + path + " has out of range vertex indices");
+
+  return std::make_shared<TriangleMesh>(t, m, vertices, normals, tex_coords, indices);
+}
+
 std::shared_ptr<HittableList> cannon::ray::make_mesh_triangle_list(std::shared_ptr<TriangleMesh> mesh) {
   auto triangles = std::make_shared<HittableList>();
 
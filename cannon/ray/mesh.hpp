@@ -37,6 +37,11 @@ namespace cannon {
 
     /*!
      * \brief Class representing a mesh composed of a collection of triangles.
+     *
+     * In addition to the indexed vertex data, the mesh keeps a precomputed
+     * single-precision copy of each face's vertex positions in
+     * structure-of-arrays layout, so that intersection tests read contiguous
+     * aligned memory rather than gathering rows through the index matrix.
      */
     class TriangleMesh {
       public:
@@ -50,22 +55,63 @@ namespace cannon {
         TriangleMesh(std::shared_ptr<Affine3d> object_to_world,
             std::shared_ptr<Material> mat, const MatrixX3d& vertices, const
             MatrixX3d& normals, const MatrixX2d& tex_coords, const MatrixX3u&
-            indices) : object_to_world_(object_to_world), mat_ptr_(mat),
-        vertices_(vertices), normals_(normals), tex_coords_(tex_coords),
-        indices_(indices) {
+            indices) : object_to_world_(object_to_world),
+        world_to_object_(std::make_shared<Affine3d>(object_to_world->inverse())),
+        mat_ptr_(mat), vertices_(vertices), normals_(normals),
+        tex_coords_(tex_coords), indices_(indices) {
 
             // Transform all vertices and normals to world space to save on ray testing computation
             assert(vertices.rows() == normals.rows());
 
+            // Normals transform by the inverse transpose, to stay
+            // perpendicular to faces under non-uniform scaling
+            Matrix3d normal_transform = world_to_object_->linear().transpose();
             for (unsigned int i = 0; i < vertices.rows(); i++) {
               vertices_.row(i) = (*object_to_world) * vertices.row(i).transpose();
-              normals_.row(i) = object_to_world->linear() * normals.row(i).transpose();
+              normals_.row(i) = normal_transform * normals.row(i).transpose();
             }
+
+            build_face_data_();
           }
 
+        /*!
+         * Get the precomputed positions of one vertex coordinate for every
+         * face, aligned for SIMD loads.
+         *
+         * \param vertex Index of vertex within faces, from 0 to 2.
+         * \param axis Coordinate axis, from 0 to 2.
+         *
+         * \returns Pointer to the coordinate of that vertex for each face.
+         */
+        const float* face_vertex_component(int vertex, int axis) const {
+          return face_data_.data() + (3 * vertex + axis) * face_stride_;
+        }
+
+        /*!
+         * Get the precomputed position of a vertex of a face.
+         *
+         * \param face Index of face.
+         * \param vertex Index of vertex within face, from 0 to 2.
+         *
+         * \returns The vertex position.
+         */
+        Vector3d face_vertex(int face, int vertex) const {
+          return Vector3d(face_vertex_component(vertex, 0)[face],
+                          face_vertex_component(vertex, 1)[face],
+                          face_vertex_component(vertex, 2)[face]);
+        }
+
+      private:
+
+        /*!
+         * Gather world-space face vertex positions into face_data_.
+         */
+        void build_face_data_();
+
 
       public:
         std::shared_ptr<Affine3d> object_to_world_; //!< Object to world transform for this mesh
+        std::shared_ptr<Affine3d> world_to_object_; //!< Inverse of object_to_world_, shared by triangles of this mesh
         std::shared_ptr<Material> mat_ptr_; //!< Material for this mesh
 
         MatrixX3d vertices_; //!< Vertices
@@ -73,6 +119,10 @@ namespace cannon {
         MatrixX2d tex_coords_; //!< Texture coordinates (UV)
         MatrixX3u indices_; //!< Indices into vertices/normals for each face
 
+      private:
+        std::vector<float, Eigen::aligned_allocator<float>> face_data_; //!< Face vertex coordinates, one padded array per vertex and axis
+        size_t face_stride_; //!< Number of floats between consecutive face_data_ arrays
+
     };
 
     /*!
@@ -85,12 +135,15 @@ namespace cannon {
 
         /*!
          * Constructor taking object_to_world transform, parent mesh, and face
-         * index within mesh.
+         * index within mesh. Triangles with the mesh's transform share its
+         * inverse.
          */
         Triangle(std::shared_ptr<Affine3d> object_to_world,
             std::shared_ptr<TriangleMesh> mesh, int mesh_index) :
-          Hittable(object_to_world), parent_mesh_(mesh),
-          mesh_index_(mesh_index) {}
+          Hittable(object_to_world, object_to_world == mesh->object_to_world_ ?
+              mesh->world_to_object_ :
+              std::make_shared<Affine3d>(object_to_world->inverse())),
+          parent_mesh_(mesh), mesh_index_(mesh_index) {}
 
         /*!
          * Destructor.
@@ -117,6 +170,31 @@ namespace cannon {
          */
         virtual bool object_space_hit(const Ray& r, double t_min, double t_max, hit_record& rec) const override;
 
+        /*!
+         * Test whether the input ray hits this triangle, computing only the
+         * distance and barycentric coordinates of the intersection. This
+         * allows callers searching for the closest of many triangles to
+         * defer the rest of the hit record until the search is done.
+         *
+         * \param r The ray to check for intersection, in world space.
+         * \param t_max Maximum distance along the ray to register an intersection.
+         * \param t Place to put the distance of the intersection.
+         * \param b Place to put the barycentric coordinates of the intersection.
+         *
+         * \returns Whether the ray intersects this triangle.
+         */
+        bool intersect(const Ray& r, double t_max, double& t, Vector3d& b) const;
+
+        /*!
+         * Fill in a hit record for an intersection found by intersect().
+         *
+         * \param r The intersecting ray.
+         * \param t Distance of the intersection.
+         * \param b Barycentric coordinates of the intersection.
+         * \param rec Hit record in which to put details about the intersection.
+         */
+        void finalize_hit(const Ray& r, double t, const Vector3d& b, hit_record& rec) const;
+
       public:
         std::shared_ptr<TriangleMesh> parent_mesh_; //!< Mesh that this triangle is a part of
         int mesh_index_; //!< Index of this triangle in the parent mesh
@@ -164,6 +242,35 @@ namespace cannon {
     std::shared_ptr<TriangleMesh> process_model_mesh(std::shared_ptr<Affine3d>
         t, std::shared_ptr<Material> m, aiMesh *mesh, const aiScene *scene);
 
+    /*!
+     * Write mesh data to a binary file which load_mesh_binary() can map
+     * straight into memory, for meshes too large to parse quickly from text
+     * formats. The file holds a short header followed by each array in
+     * Eigen's column-major layout.
+     *
+     * \param path The file to write.
+     * \param vertices Vertex positions.
+     * \param normals Vertex normals.
+     * \param tex_coords Vertex texture coordinates.
+     * \param indices Vertex indices for each face.
+     */
+    void write_mesh_binary(const std::string& path, const MatrixX3d& vertices,
+        const MatrixX3d& normals, const MatrixX2d& tex_coords, const
+        MatrixX3u& indices);
+
+    /*!
+     * Load a mesh written by write_mesh_binary(). The file is memory-mapped
+     * and its arrays copied directly into the mesh, without any parsing.
+     *
+     * \param t Object-to-world transform for the loaded mesh.
+     * \param m Material for the loaded mesh.
+     * \param path The file to load.
+     *
+     * \returns The loaded mesh.
+     */
+    std::shared_ptr<TriangleMesh> load_mesh_binary(std::shared_ptr<Affine3d>
+        t, std::shared_ptr<Material> m, const std::string& path);
+
     /*!
      * Create list of hittable triangles for the input mesh.
      *
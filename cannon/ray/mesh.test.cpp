@@ -1,7 +1,183 @@
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
 #include <catch2/catch.hpp>
 
 #include <cannon/ray/mesh.hpp>
+#include <cannon/ray/ray.hpp>
+#include <cannon/ray/aabb.hpp>
+#include <cannon/ray/material.hpp>
+#include <cannon/math/random_double.hpp>
+
+using namespace cannon::ray;
+using namespace cannon::math;
 
 TEST_CASE("Mesh", "[ray]") {
+  MatrixX3d vertices(4, 3);
+  vertices << 0, 0, 0,
+              1, 0, 0,
+              0, 1, 0,
+              1, 1, 0;
+  MatrixX3d normals = MatrixX3d::Zero(4, 3);
+  normals.col(2).setOnes();
+  MatrixX2d tex_coords(4, 2);
+  tex_coords << 0, 0,
+                1, 0,
+                0, 1,
+                1, 1;
+  MatrixX3u indices(2, 3);
+  indices << 0, 1, 2,
+             1, 3, 2;
+
+  auto t = std::make_shared<Affine3d>(Affine3d::Identity());
+  t->translate(Vector3d(0, 0, 1));
+  auto mat = std::make_shared<Lambertian>(Vector3d(0.5, 0.5, 0.5));
+  auto mesh = std::make_shared<TriangleMesh>(t, mat, vertices, normals, tex_coords, indices);
+
+  // Precomputed face data is in world space and aligned
+  REQUIRE(mesh->face_vertex(1, 1).isApprox(Vector3d(1, 1, 1)));
+  REQUIRE(reinterpret_cast<uintptr_t>(mesh->face_vertex_component(0, 0)) % 16 == 0);
+  REQUIRE(reinterpret_cast<uintptr_t>(mesh->face_vertex_component(2, 2)) % 16 == 0);
+
+  Triangle tri(t, mesh, 0);
+  Aabb box;
+  REQUIRE(tri.bounding_box(0, 1, box));
+  REQUIRE(box.minimum_.isApprox(Vector3d(0, 0, 1)));
+  REQUIRE(box.maximum_.isApprox(Vector3d(1, 1, 1)));
+
+  // Hits report distance, barycentric UVs, and a normal facing the ray
+  hit_record rec;
+  Ray r(Vector3d(0.25, 0.25, 0), Vector3d(0, 0, 1));
+  REQUIRE(tri.hit(r, 0.001, 10.0, rec));
+  REQUIRE(rec.t == Approx(1.0));
+  REQUIRE(rec.p.isApprox(Vector3d(0.25, 0.25, 1)));
+  REQUIRE(rec.u == Approx(0.25));
+  REQUIRE(rec.v == Approx(0.25));
+  REQUIRE(rec.normal.isApprox(Vector3d(0, 0, -1)));
+  REQUIRE(!rec.front_face);
+
+  REQUIRE(!tri.hit(r, 0.001, 0.5, rec));
+  REQUIRE(!tri.hit(Ray(Vector3d(0.75, 0.75, 0), Vector3d(0, 0, 1)), 0.001, 10.0, rec));
+
+  // Rays through the shared edge hit one of the two triangles
+  Triangle other(t, mesh, 1);
+  Ray edge_ray(Vector3d(0.5, 0.5, 0), Vector3d(0, 0, 1));
+  double t_hit;
+  Vector3d b;
+  REQUIRE((tri.intersect(edge_ray, 10.0, t_hit, b) || other.intersect(edge_ray, 10.0, t_hit, b)));
+  REQUIRE(b.sum() == Approx(1.0));
+
+  // Triangles share the mesh's inverse transform
+  REQUIRE(tri.world_to_object_ == mesh->world_to_object_);
+
+  // Normals stay perpendicular to faces under non-uniform scaling
+  MatrixX3d slope_vertices(3, 3);
+  slope_vertices << 0, 0, 0,
+                    1, 0, 0,
+                    0, 1, 1;
+  MatrixX3d slope_normals(3, 3);
+  for (int i = 0; i < 3; i++)
+    slope_normals.row(i) = Vector3d(0, -1, 1).normalized().transpose();
+
+  auto scale = std::make_shared<Affine3d>(Affine3d::Identity());
+  scale->scale(Vector3d(1, 1, 3));
+  auto slope = std::make_shared<TriangleMesh>(scale, mat, slope_vertices,
+      slope_normals, tex_coords.topRows(3), indices.topRows(1));
+  Triangle slope_tri(scale, slope, 0);
+
+  REQUIRE(slope_tri.hit(Ray(Vector3d(0.25, 0.5, 10), Vector3d(0, 0, -1)), 0.001, 100.0, rec));
+  Vector3d edge = slope->face_vertex(0, 2) - slope->face_vertex(0, 0);
+  REQUIRE(std::abs(rec.normal.dot(edge)) < 1e-6);
+}
+
+TEST_CASE("Mesh_spawn_ray", "[ray]") {
+  MatrixX3d vertices(3, 3);
+  vertices << 0, 0, 0,
+              1, 0, 0,
+              0, 1, 0.3;
+  MatrixX3d normals = MatrixX3d::Zero(3, 3);
+  normals.col(2).setOnes();
+  MatrixX2d tex_coords = MatrixX2d::Zero(3, 2);
+  MatrixX3u indices(1, 3);
+  indices << 0, 1, 2;
+
+  // Vertices are stored in single precision, so a transform far from the
+  // origin leaves hit points well away from the exact surface
+  auto t = std::make_shared<Affine3d>(Affine3d::Identity());
+  t->translate(Vector3d(1000.3, -2000.7, 500.1));
+  t->rotate(AngleAxisd(0.7, Vector3d(1, 2, 3).normalized()));
+  auto mat = std::make_shared<Lambertian>(Vector3d(0.5, 0.5, 0.5));
+  auto mesh = std::make_shared<TriangleMesh>(t, mat, vertices, normals, tex_coords, indices);
+  Triangle tri(t, mesh, 0);
+
+  Rng rng;
+  for (int i = 0; i < 1000; i++) {
+    double u = random_double(rng, 0.05, 0.45);
+    double v = random_double(rng, 0.05, 0.45);
+    Vector3d target = (1 - u - v) * mesh->face_vertex(0, 0) +
+      u * mesh->face_vertex(0, 1) + v * mesh->face_vertex(0, 2);
+    Vector3d origin = target + random_unit_vec(rng);
+
+    hit_record rec;
+    if (!tri.hit(Ray(origin, target - origin), 0.0, std::numeric_limits<double>::infinity(), rec))
+      continue;
+
+    // Spawned rays never hit the triangle they leave, whichever side they
+    // leave from
+    Vector3d d = random_unit_vec(rng);
+    hit_record spawned_rec;
+    REQUIRE(!tri.hit(rec.spawn_ray(d, 0.0), 0.0, std::numeric_limits<double>::infinity(), spawned_rec));
+  }
+}
+
+TEST_CASE("Mesh_binary", "[ray]") {
+  MatrixX3d vertices(4, 3);
+  vertices << 0, 0, 0,
+              1, 0, 0,
+              0, 1, 0,
+              1, 1, 0;
+  MatrixX3d normals = MatrixX3d::Zero(4, 3);
+  normals.col(2).setOnes();
+  MatrixX2d tex_coords(4, 2);
+  tex_coords << 0, 0,
+                1, 0,
+                0, 1,
+                1, 1;
+  MatrixX3u indices(2, 3);
+  indices << 0, 1, 2,
+             1, 3, 2;
+
+  std::string path = (std::filesystem::temp_directory_path() / "mesh_binary_test.cmesh").string();
+  write_mesh_binary(path, vertices, normals, tex_coords, indices);
+
+  auto t = std::make_shared<Affine3d>(Affine3d::Identity());
+  auto mat = std::make_shared<Lambertian>(Vector3d(0.5, 0.5, 0.5));
+  auto mesh = load_mesh_binary(t, mat, path);
+  REQUIRE(mesh->vertices_ == vertices);
+  REQUIRE(mesh->normals_ == normals);
+  REQUIRE(mesh->tex_coords_ == tex_coords);
+  REQUIRE(mesh->indices_ == indices);
+
+  // Headers whose vertex count wraps the expected size are rejected
+  auto set_counts = [&](uint64_t nv, uint64_t nf) {
+    std::fstream f(path, std::ios::binary | std::ios::in | std::ios::out);
+    f.seekp(8);
+    f.write(reinterpret_cast<const char*>(&nv), sizeof(nv));
+    f.write(reinterpret_cast<const char*>(&nf), sizeof(nf));
+  };
+  set_counts((uint64_t(1) << 58) + 4, 2);
+  REQUIRE_THROWS(load_mesh_binary(t, mat, path));
+
+  // Faces without vertices are rejected
+  std::filesystem::resize_file(path, 24 + 3 * sizeof(unsigned int));
+  set_counts(0, 1);
+  REQUIRE_THROWS(load_mesh_binary(t, mat, path));
+
+  // Truncated files are rejected rather than read past their end
+  write_mesh_binary(path, vertices, normals, tex_coords, indices);
+  std::filesystem::resize_file(path, std::filesystem::file_size(path) - 4);
+  REQUIRE_THROWS(load_mesh_binary(t, mat, path));
 
+  std::remove(path.c_str());
 }
@@ -0,0 +1,377 @@
+#include <cannon/ray/mipmap.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+
+#include <stb_image/stb_image.h>
+
+#include <cannon/log/registry.hpp>
+#include <cannon/utils/statistics.hpp>
+
+using namespace cannon::ray;
+using namespace cannon::log;
+using namespace cannon::utils;
+
+STAT_COUNTER("Textures/MIP maps loaded", nMIPMapsLoaded);
+STAT_MEMORY_COUNTER("Textures/MIP map memory loaded", nMIPMapBytesLoaded);
+STAT_COUNTER("Textures/MIP map cache hits", nMIPMapCacheHits);
+STAT_COUNTER("Textures/MIP maps evicted", nMIPMapsEvicted);
+STAT_COUNTER("Textures/EWA lookups", nEWALookups);
+STAT_COUNTER("Textures/Trilinear lookups", nTrilinearLookups);
+
+/*!
+ * Number of entries in the table of EWA filter weights.
+ */
+static constexpr int weight_lut_size = 128;
+
+/*!
+ * Table of Gaussian filter weights for EWA filtering, indexed by squared
+ * distance from the ellipse center, which is one at the ellipse edge.
+ */
+static const std::array<float, weight_lut_size>& ewa_weight_lut() {
+  static const std::array<float, weight_lut_size> lut = [] {
+    std::array<float, weight_lut_size> weights;
+    const double alpha = 2.0;
+    for (int i = 0; i < weight_lut_size; i++) {
+      double r2 = static_cast<double>(i) / (weight_lut_size - 1);
+      weights[i] = static_cast<float>(std::exp(-alpha * r2) - std::exp(-alpha));
+    }
+    return weights;
+  }();
+
+  return lut;
+}
+
+MIPMap::MIPMap(int width, int height, const std::vector<Vector3f>& texels) {
+  if (width <= 0 || height <= 0 || texels.size() != static_cast<size_t>(width) * height)
+    throw std::runtime_error("MIP map texels do not match image dimensions");
+
+  pyramid_.emplace_back(width, height, texels.data());
+
+  // Each level box-filters the level above, with every texel of the finer
+  // level falling into exactly one coarser texel so that odd dimensions
+  // lose nothing
+  while (width > 1 || height > 1) {
+    int next_width = std::max(1, width / 2);
+    int next_height = std::max(1, height / 2);
+    const BlockedArray<Vector3f>& prev = pyramid_.back();
+    BlockedArray<Vector3f> next(next_width, next_height);
+
+    for (int t = 0; t < next_height; t++) {
+      int t0 = t * height / next_height;
+      int t1 = (t + 1) * height / next_height;
+      for (int s = 0; s < next_width; s++) {
+        int s0 = s * width / next_width;
+        int s1 = (s + 1) * width / next_width;
+
+        Vector3f sum = Vector3f::Zero();
+        for (int pt = t0; pt < t1; pt++)
+          for (int ps = s0; ps < s1; ps++)
+            sum += prev(ps, pt);
+
+        next(s, t) = sum / static_cast<float>((s1 - s0) * (t1 - t0));
+      }
+    }
+
+    pyramid_.push_back(std::move(next));
+    width = next_width;
+    height = next_height;
+  }
+}
+
+const Vector3f& MIPMap::texel(int level, int s, int t) const {
+  const BlockedArray<Vector3f>& l = pyramid_[level];
+  s = std::min(std::max(s, 0), l.u_size() - 1);
+  t = std::min(std::max(t, 0), l.v_size() - 1);
+
+  return l(s, t);
+}
+
+Vector3d MIPMap::lookup(const Vector2d& st, double width) const {
+  ++nTrilinearLookups;
+
+  // Choose levels whose texel spacing brackets the filter width
+  double level = levels() - 1 + std::log2(std::max(width, 1e-8));
+  if (level < 0)
+    return bilerp_(0, st);
+  else if (level >= levels() - 1)
+    return texel(levels() - 1, 0, 0).cast<double>();
+
+  int i_level = static_cast<int>(std::floor(level));
+  double delta = level - i_level;
+
+  return (1 - delta) * bilerp_(i_level, st) + delta * bilerp_(i_level + 1, st);
+}
+
+Vector3d MIPMap::lookup(const Vector2d& st, Vector2d dst0, Vector2d dst1,
+    TextureFilter filter, double max_anisotropy) const {
+  if (filter == TextureFilter::Bilinear)
+    return bilerp_(0, st);
+
+  if (filter == TextureFilter::Trilinear) {
+    double width = 2 * std::max({std::fabs(dst0[0]), std::fabs(dst0[1]),
+        std::fabs(dst1[0]), std::fabs(dst1[1])});
+    return lookup(st, width);
+  }
+
+  ++nEWALookups;
+
+  // Make dst0 the major axis, and clamp the eccentricity of the ellipse
+  if (dst0.squaredNorm() < dst1.squaredNorm())
+    std::swap(dst0, dst1);
+  double major_length = dst0.norm();
+  double minor_length = dst1.norm();
+
+  if (minor_length * max_anisotropy < major_length && minor_length > 0) {
+    double scale = major_length / (minor_length * max_anisotropy);
+    dst1 *= scale;
+    minor_length *= scale;
+  }
+
+  if (minor_length == 0)
+    return bilerp_(0, st);
+
+  // Filter in the two levels whose texel spacing brackets the minor axis,
+  // which keeps the number of texels under the ellipse bounded
+  double level = std::max(0.0, levels() - 1 + std::log2(minor_length));
+  if (level >= levels() - 1)
+    return texel(levels() - 1, 0, 0).cast<double>();
+
+  int i_level = static_cast<int>(std::floor(level));
+  double delta = level - i_level;
+
+  return (1 - delta) * ewa_(i_level, st, dst0, dst1) + delta * ewa_(i_level + 1, st, dst0, dst1);
+}
+
+size_t MIPMap::memory_bytes() const {
+  size_t bytes = 0;
+  for (const auto& level : pyramid_)
+    bytes += level.memory_bytes();
+
+  return bytes;
+}
+
+Vector3d MIPMap::bilerp_(int level, const Vector2d& st) const {
+  // Texel centers lie at half-integer coordinates
+  double s = st[0] * width(level) - 0.5;
+  double t = st[1] * height(level) - 0.5;
+  int s0 = static_cast<int>(std::floor(s));
+  int t0 = static_cast<int>(std::floor(t));
+  float ds = static_cast<float>(s - s0);
+  float dt = static_cast<float>(t - t0);
+
+  Vector3f value = (1 - ds) * (1 - dt) * texel(level, s0, t0) +
+                   (1 - ds) * dt * texel(level, s0, t0 + 1) +
+                   ds * (1 - dt) * texel(level, s0 + 1, t0) +
+                   ds * dt * texel(level, s0 + 1, t0 + 1);
+
+  return value.cast<double>();
+}
+
+Vector3d MIPMap::ewa_(int level, const Vector2d& st, const Vector2d& dst0,
+    const Vector2d& dst1) const {
+  if (level >= levels())
+    return texel(levels() - 1, 0, 0).cast<double>();
+
+  // Convert to texel coordinates of this level
+  double s = st[0] * width(level) - 0.5;
+  double t = st[1] * height(level) - 0.5;
+  Vector2d d0(dst0[0] * width(level), dst0[1] * height(level));
+  Vector2d d1(dst1[0] * width(level), dst1[1] * height(level));
+
+  // Implicit ellipse A s^2 + B s t + C t^2 < 1, widened by a texel so that
+  // it always covers at least one texel center. See pg. 630 of PBRT.
+  double a = d0[1] * d0[1] + d1[1] * d1[1] + 1;
+  double b = -2 * (d0[0] * d0[1] + d1[0] * d1[1]);
+  double c = d0[0] * d0[0] + d1[0] * d1[0] + 1;
+  double inv_f = 1 / (a * c - b * b * 0.25);
+  a *= inv_f;
+  b *= inv_f;
+  c *= inv_f;
+
+  // Bounding box of the ellipse in texel coordinates
+  double det = -b * b + 4 * a * c;
+  double inv_det = 1 / det;
+  double s_sqrt = std::sqrt(det * c);
+  double t_sqrt = std::sqrt(a * det);
+  int s0 = static_cast<int>(std::ceil(s - 2 * inv_det * s_sqrt));
+  int s1 = static_cast<int>(std::floor(s + 2 * inv_det * s_sqrt));
+  int t0 = static_cast<int>(std::ceil(t - 2 * inv_det * t_sqrt));
+  int t1 = static_cast<int>(std::floor(t + 2 * inv_det * t_sqrt));
+
+  const auto& lut = ewa_weight_lut();
+  Vector3f sum = Vector3f::Zero();
+  float sum_weights = 0;
+  for (int it = t0; it <= t1; it++) {
+    double tt = it - t;
+    for (int is = s0; is <= s1; is++) {
+      double ss = is - s;
+
+      double r2 = a * ss * ss + b * ss * tt + c * tt * tt;
+      if (r2 < 1) {
+        int index = std::min(static_cast<int>(r2 * weight_lut_size), weight_lut_size - 1);
+        float weight = lut[index];
+        sum += weight * texel(level, is, it);
+        sum_weights += weight;
+      }
+    }
+  }
+
+  if (sum_weights <= 0)
+    return bilerp_(level, st);
+
+  return (sum / sum_weights).cast<double>();
+}
+
+/*!
+ * \brief Cache of MIP maps by filename, shared by all image textures.
+ */
+struct MIPMapCache {
+  struct Entry {
+    std::shared_ptr<const MIPMap> mipmap; //!< Cached map
+    size_t bytes; //!< Memory used by the map
+    unsigned long last_used; //!< Load counter value when last requested
+  };
+
+  std::mutex mutex; //!< Lock for all cache state
+  std::map<std::string, Entry> entries; //!< Cached maps by filename
+  size_t bytes = 0; //!< Memory used by cached maps
+  size_t budget = 1ul << 30; //!< Memory budget for cached maps
+  unsigned long counter = 0; //!< Number of requests, for recency
+
+  /*!
+   * Evict least recently used maps which no textures hold until the cache
+   * is within budget. Must be called with the mutex held.
+   */
+  void evict() {
+    while (bytes > budget) {
+      auto oldest = entries.end();
+      for (auto it = entries.begin(); it != entries.end(); it++) {
+        if (it->second.mipmap.use_count() == 1 && (oldest == entries.end() ||
+              it->second.last_used < oldest->second.last_used))
+          oldest = it;
+      }
+
+      if (oldest == entries.end()) {
+        log_warning("MIP map cache is over budget, but all maps are in use");
+        return;
+      }
+
+      bytes -= oldest->second.bytes;
+      entries.erase(oldest);
+      ++nMIPMapsEvicted;
+    }
+  }
+};
+
+/*!
+ * Get the process-wide MIP map cache.
+ */
+static MIPMapCache& mipmap_cache() {
+  static MIPMapCache cache;
+  return cache;
+}
+
+/*!
+ * Load an image file into a new MIP map, converting texels to linear color.
+ */
+static std::shared_ptr<const MIPMap> read_mipmap(const std::string& filename) {
+  int width, height, components;
+  std::vector<Vector3f> texels;
+
+  if (stbi_is_hdr(filename.c_str())) {
+    float *data = stbi_loadf(filename.c_str(), &width, &height, &components, 3);
+    if (!data)
+      throw std::runtime_error("Could not open image file " + filename + " for texture");
+
+    texels.resize(static_cast<size_t>(width) * height);
+    for (size_t i = 0; i < texels.size(); i++)
+      texels[i] = Vector3f(data[3 * i], data[3 * i + 1], data[3 * i + 2]);
+    stbi_image_free(data);
+  } else {
+    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &components, 3);
+    if (!data)
+      throw std::runtime_error("Could not open image file " + filename + " for texture");
+
+    texels.resize(static_cast<size_t>(width) * height);
+    for (size_t i = 0; i < texels.size(); i++)
+      texels[i] = Vector3f(srgb_to_linear(data[3 * i]),
+          srgb_to_linear(data[3 * i + 1]), srgb_to_linear(data[3 * i + 2]));
+    stbi_image_free(data);
+  }
+
+  return std::make_shared<const MIPMap>(width, height, texels);
+}
+
+// Public Functions
+float cannon::ray::srgb_to_linear(unsigned char value) {
+  static const std::array<float, 256> lut = [] {
+    std::array<float, 256> values;
+    for (int i = 0; i < 256; i++) {
+      double v = i / 255.0;
+      values[i] = static_cast<float>(v <= 0.04045 ? v / 12.92 :
+          std::pow((v + 0.055) / 1.055, 2.4));
+    }
+    return values;
+  }();
+
+  return lut[value];
+}
+
+std::shared_ptr<const MIPMap> cannon::ray::load_mipmap(const std::string& filename) {
+  MIPMapCache& cache = mipmap_cache();
+
+  {
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    auto it = cache.entries.find(filename);
+    if (it != cache.entries.end()) {
+      ++nMIPMapCacheHits;
+      it->second.last_used = ++cache.counter;
+      return it->second.mipmap;
+    }
+  }
+
+  // Loading is slow, so happens outside the lock. Threads racing to load
+  // the same file keep whichever map was cached first.
+  auto mipmap = read_mipmap(filename);
+  ++nMIPMapsLoaded;
+  nMIPMapBytesLoaded += mipmap->memory_bytes();
+
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  auto inserted = cache.entries.emplace(filename, MIPMapCache::Entry{mipmap,
+      mipmap->memory_bytes(), ++cache.counter});
+  if (!inserted.second)
+    return inserted.first->second.mipmap;
+
+  cache.bytes += inserted.first->second.bytes;
+
+  // The new map is held by the caller only once returned, so it is
+  // protected from eviction here by the extra reference in mipmap
+  cache.evict();
+
+  return mipmap;
+}
+
+void cannon::ray::set_mipmap_cache_budget(size_t bytes) {
+  MIPMapCache& cache = mipmap_cache();
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  cache.budget = bytes;
+  cache.evict();
+}
+
+size_t cannon::ray::mipmap_cache_bytes() {
+  MIPMapCache& cache = mipmap_cache();
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  return cache.bytes;
+}
+
+void cannon::ray::clear_mipmap_cache() {
+  MIPMapCache& cache = mipmap_cache();
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  cache.entries.clear();
+  cache.bytes = 0;
+}
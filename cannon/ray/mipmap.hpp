@@ -0,0 +1,286 @@
+#pragma once
+#ifndef CANNON_RAY_MIPMAP_H
+#define CANNON_RAY_MIPMAP_H
+
+/*!
+ * \file cannon/ray/mipmap.hpp
+ * \brief File containing BlockedArray and MIPMap class definitions, and a
+ * shared cache of MIP maps loaded from image files.
+ */
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <cannon/utils/class_forward.hpp>
+
+using namespace Eigen;
+
+namespace cannon {
+  namespace ray {
+
+    CANNON_CLASS_FORWARD(MIPMap);
+
+    /*!
+     * \brief Class representing a 2D array stored in square tiles of 2^(log
+     * block size) entries on a side, so that entries which are close in 2D
+     * are also close in memory. See Section A.4.4 of PBRT.
+     */
+    template <typename T, int LogBlockSize = 2>
+    class BlockedArray {
+      public:
+
+        /*!
+         * Default constructor, for an empty array.
+         */
+        BlockedArray() : u_res_(0), v_res_(0), u_blocks_(0) {}
+
+        /*!
+         * Constructor taking array dimensions and optionally data in row-major
+         * order to initialize the array with.
+         *
+         * \param u_res Width of the array.
+         * \param v_res Height of the array.
+         * \param d Row-major data of size u_res * v_res, or nullptr.
+         */
+        BlockedArray(int u_res, int v_res, const T* d = nullptr) : u_res_(u_res),
+          v_res_(v_res), u_blocks_(round_up_(u_res) >> LogBlockSize),
+          data_(static_cast<size_t>(round_up_(u_res)) * round_up_(v_res)) {
+          if (d) {
+            for (int v = 0; v < v_res_; v++)
+              for (int u = 0; u < u_res_; u++)
+                (*this)(u, v) = d[v * u_res_ + u];
+          }
+        }
+
+        /*!
+         * Get the width of this array.
+         */
+        int u_size() const {
+          return u_res_;
+        }
+
+        /*!
+         * Get the height of this array.
+         */
+        int v_size() const {
+          return v_res_;
+        }
+
+        /*!
+         * Access an entry of this array.
+         */
+        T& operator()(int u, int v) {
+          return data_[index_(u, v)];
+        }
+
+        /*!
+         * Access an entry of this array.
+         */
+        const T& operator()(int u, int v) const {
+          return data_[index_(u, v)];
+        }
+
+        /*!
+         * Get the memory used for entries of this array, including padding
+         * out to whole blocks.
+         */
+        size_t memory_bytes() const {
+          return data_.size() * sizeof(T);
+        }
+
+      private:
+
+        /*!
+         * Round up to a whole number of blocks.
+         */
+        static int round_up_(int x) {
+          return (x + block_size_ - 1) & ~(block_size_ - 1);
+        }
+
+        /*!
+         * Compute the offset of an entry in the underlying storage.
+         */
+        size_t index_(int u, int v) const {
+          int bu = u >> LogBlockSize;
+          int bv = v >> LogBlockSize;
+          int ou = u & (block_size_ - 1);
+          int ov = v & (block_size_ - 1);
+
+          size_t offset = static_cast<size_t>(block_size_ * block_size_) * (u_blocks_ * bv + bu);
+          return offset + block_size_ * ov + ou;
+        }
+
+        static constexpr int block_size_ = 1 << LogBlockSize; //!< Side length of blocks
+
+        int u_res_, v_res_; //!< Array dimensions
+        int u_blocks_; //!< Number of blocks along a row
+        std::vector<T> data_; //!< Blocked storage
+    };
+
+    /*!
+     * \brief Method used to filter MIP map lookups over a texture-space
+     * footprint.
+     */
+    enum class TextureFilter {
+      Bilinear, //!< Bilinear interpolation in the finest level, ignoring the footprint
+      Trilinear, //!< Interpolation between the two levels closest to an isotropic footprint
+      EWA //!< Elliptically weighted average over an anisotropic footprint
+    };
+
+    /*!
+     * \brief Class representing an RGB image pyramid in linear color, for
+     * filtered texture lookups. Each level halves the resolution of the
+     * previous one, down to a single texel, and is stored as a BlockedArray
+     * of single-precision texels. Texture coordinates outside [0, 1] are
+     * clamped to the image edge. See Section 10.4 of PBRT.
+     */
+    class MIPMap {
+      public:
+
+        MIPMap() = delete;
+
+        /*!
+         * Constructor taking finest level dimensions and texels in row-major
+         * order, with the first row at the top of the image.
+         *
+         * \param width Image width.
+         * \param height Image height.
+         * \param texels Linear RGB texels of size width * height.
+         */
+        MIPMap(int width, int height, const std::vector<Vector3f>& texels);
+
+        /*!
+         * Get the number of levels in this pyramid.
+         */
+        int levels() const {
+          return static_cast<int>(pyramid_.size());
+        }
+
+        /*!
+         * Get the width of a level.
+         */
+        int width(int level = 0) const {
+          return pyramid_[level].u_size();
+        }
+
+        /*!
+         * Get the height of a level.
+         */
+        int height(int level = 0) const {
+          return pyramid_[level].v_size();
+        }
+
+        /*!
+         * Get a texel of a level, clamping coordinates to the level's edges.
+         *
+         * \param level Pyramid level.
+         * \param s Horizontal texel coordinate.
+         * \param t Vertical texel coordinate.
+         *
+         * \returns The texel.
+         */
+        const Vector3f& texel(int level, int s, int t) const;
+
+        /*!
+         * Look up a value by interpolating between the levels whose texel
+         * spacing brackets the input filter width.
+         *
+         * \param st Texture coordinates, with t increasing down the image.
+         * \param width Filter width in texture coordinates.
+         *
+         * \returns The filtered value.
+         */
+        Vector3d lookup(const Vector2d& st, double width = 0.0) const;
+
+        /*!
+         * Look up a value filtered over the ellipse with the input axes,
+         * which are the texture-space differentials of a footprint.
+         *
+         * \param st Texture coordinates, with t increasing down the image.
+         * \param dst0 First footprint axis in texture coordinates.
+         * \param dst1 Second footprint axis in texture coordinates.
+         * \param filter Filtering method.
+         * \param max_anisotropy Largest ratio of ellipse axes for EWA
+         * filtering. Longer ellipses have their minor axis lengthened, which
+         * bounds the number of texels filtered.
+         *
+         * \returns The filtered value.
+         */
+        Vector3d lookup(const Vector2d& st, Vector2d dst0, Vector2d dst1,
+            TextureFilter filter = TextureFilter::EWA, double max_anisotropy =
+            8.0) const;
+
+        /*!
+         * Get the memory used for texels in all levels of this pyramid.
+         */
+        size_t memory_bytes() const;
+
+      private:
+
+        /*!
+         * Bilinearly interpolate texels of a level.
+         */
+        Vector3d bilerp_(int level, const Vector2d& st) const;
+
+        /*!
+         * Filter texels of a level with a Gaussian over an ellipse.
+         */
+        Vector3d ewa_(int level, const Vector2d& st, const Vector2d& dst0,
+            const Vector2d& dst1) const;
+
+        std::vector<BlockedArray<Vector3f>> pyramid_; //!< Levels from finest to coarsest
+    };
+
+    // Public Functions
+
+    /*!
+     * Convert an 8-bit sRGB-encoded component to a linear value in [0, 1].
+     *
+     * \param value Encoded component.
+     *
+     * \returns Linear component.
+     */
+    float srgb_to_linear(unsigned char value);
+
+    /*!
+     * Load an image file as a MIP map, through a cache shared by all image
+     * textures so that each file is only loaded and filtered once. 8-bit
+     * images are assumed to be sRGB encoded and converted to linear color;
+     * HDR images are already linear. Thread-safe.
+     *
+     * \param filename The image file.
+     *
+     * \returns The MIP map, shared with other users of the same file.
+     */
+    std::shared_ptr<const MIPMap> load_mipmap(const std::string& filename);
+
+    /*!
+     * Set the memory budget of the MIP map cache. When loading a file takes
+     * the cache over budget, the least recently loaded maps which are no
+     * longer in use are evicted. Maps still held by textures are never
+     * evicted, so the budget may be exceeded.
+     *
+     * \param bytes Memory budget in bytes.
+     */
+    void set_mipmap_cache_budget(size_t bytes);
+
+    /*!
+     * Get the memory used by MIP maps in the cache.
+     *
+     * \returns Memory in bytes.
+     */
+    size_t mipmap_cache_bytes();
+
+    /*!
+     * Remove all MIP maps from the cache. Maps still held by textures stay
+     * alive until released, but are loaded again on the next lookup.
+     */
+    void clear_mipmap_cache();
+
+  } // namespace ray
+} // namespace cannon
+
+#endif /* ifndef CANNON_RAY_MIPMAP_H */
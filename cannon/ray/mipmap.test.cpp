@@ -0,0 +1,105 @@
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+#include <catch2/catch.hpp>
+
+#include <cannon/ray/mipmap.hpp>
+
+using namespace cannon::ray;
+
+TEST_CASE("BlockedArray", "[ray]") {
+  std::vector<int> data(7 * 5);
+  for (size_t i = 0; i < data.size(); i++)
+    data[i] = i;
+
+  BlockedArray<int> a(7, 5, data.data());
+  REQUIRE(a.u_size() == 7);
+  REQUIRE(a.v_size() == 5);
+  for (int v = 0; v < 5; v++)
+    for (int u = 0; u < 7; u++)
+      REQUIRE(a(u, v) == v * 7 + u);
+
+  // Storage is padded out to whole 4x4 blocks
+  REQUIRE(a.memory_bytes() == 8 * 8 * sizeof(int));
+}
+
+TEST_CASE("MIPMap", "[ray]") {
+  int width = 6, height = 3;
+  std::vector<Vector3f> texels(width * height);
+  Vector3f mean = Vector3f::Zero();
+  for (int t = 0; t < height; t++) {
+    for (int s = 0; s < width; s++) {
+      texels[t * width + s] = Vector3f(s, t, (s + t) % 2);
+      mean += texels[t * width + s];
+    }
+  }
+  mean /= width * height;
+
+  MIPMap mipmap(width, height, texels);
+  REQUIRE(mipmap.levels() == 3);
+  REQUIRE(mipmap.width(1) == 3);
+  REQUIRE(mipmap.height(1) == 1);
+  REQUIRE(mipmap.width(2) == 1);
+
+  // Every texel contributes to the coarsest level
+  REQUIRE(mipmap.texel(2, 0, 0).isApprox(mean));
+
+  // Lookups at texel centers without a footprint reproduce texels, and
+  // wide footprints average the whole image
+  Vector2d center((3 + 0.5) / width, (1 + 0.5) / height);
+  REQUIRE(mipmap.lookup(center).isApprox(Vector3d(3, 1, 0)));
+  REQUIRE(mipmap.lookup(center, 10.0).isApprox(mean.cast<double>()));
+  REQUIRE(mipmap.lookup(center, Vector2d::Zero(), Vector2d::Zero()).isApprox(Vector3d(3, 1, 0)));
+  REQUIRE(mipmap.lookup(center, Vector2d(10, 0), Vector2d(0, 10)).isApprox(mean.cast<double>()));
+
+  // Coordinates outside the image are clamped
+  REQUIRE(mipmap.lookup(Vector2d(-1, -1)).isApprox(Vector3d(0, 0, 0)));
+
+  // A constant image filters to the same constant everywhere
+  std::vector<Vector3f> constant(64 * 32, Vector3f(0.25, 0.5, 0.75));
+  MIPMap constant_mipmap(64, 32, constant);
+  for (auto filter : {TextureFilter::Bilinear, TextureFilter::Trilinear, TextureFilter::EWA}) {
+    Vector3d value = constant_mipmap.lookup(Vector2d(0.3, 0.6), Vector2d(0.05, 0.01),
+        Vector2d(-0.002, 0.01), filter);
+    REQUIRE(value.isApprox(Vector3d(0.25, 0.5, 0.75)));
+  }
+
+  REQUIRE_THROWS(MIPMap(4, 4, texels));
+}
+
+TEST_CASE("MIPMap_cache", "[ray]") {
+  // A 2x1 binary PPM, with one black and one white texel
+  std::string path = (std::filesystem::temp_directory_path() / "mipmap_cache_test.ppm").string();
+  {
+    std::ofstream f(path, std::ios::binary);
+    f << "P6\n2 1\n255\n";
+    const unsigned char data[6] = {0, 0, 0, 255, 128, 255};
+    f.write(reinterpret_cast<const char*>(data), 6);
+  }
+
+  clear_mipmap_cache();
+  auto mipmap = load_mipmap(path);
+  REQUIRE(mipmap->width() == 2);
+  REQUIRE(mipmap->texel(0, 0, 0).isZero());
+  REQUIRE(mipmap->texel(0, 1, 0).isApprox(Vector3f(1, srgb_to_linear(128), 1)));
+  REQUIRE(srgb_to_linear(128) == Approx(0.2158).epsilon(1e-3));
+
+  // Loading the same file again shares the cached map
+  REQUIRE(load_mipmap(path) == mipmap);
+  REQUIRE(mipmap_cache_bytes() == mipmap->memory_bytes());
+
+  // Maps in use survive going over budget, and others are evicted
+  set_mipmap_cache_budget(0);
+  REQUIRE(mipmap_cache_bytes() == mipmap->memory_bytes());
+  REQUIRE(load_mipmap(path) == mipmap);
+
+  mipmap.reset();
+  set_mipmap_cache_budget(0);
+  REQUIRE(mipmap_cache_bytes() == 0);
+
+  set_mipmap_cache_budget(1ul << 30);
+  REQUIRE_THROWS(load_mipmap(path + ".missing"));
+
+  std::remove(path.c_str());
+}
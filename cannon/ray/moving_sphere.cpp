@@ -2,34 +2,19 @@
 
 #include <cannon/ray/ray.hpp>
 #include <cannon/ray/aabb.hpp>
+#include <cannon/ray/sphere.hpp>
 
 using namespace cannon::ray;
 
 bool MovingSphere::object_space_hit(const Ray& r, double t_min, double t_max, hit_record& rec) const {
-  Vector3d oc = r.orig_ - center(r.time_);
-  auto a = r.dir_.dot(r.dir_);
-  auto b = oc.dot(r.dir_);
-  auto c = oc.dot(oc) - radius_ * radius_;
-
-  auto discriminant = b*b - a*c;
-  if (discriminant < 0)
+  Vector3d c = center(r.time_);
+  if (!hit_sphere(r, c, radius_, t_min, t_max, rec))
     return false;
 
-  auto sqrt_d = std::sqrt(discriminant);
-
-  // Find nearest root of the quadratic that lies between t_min and t_max
-  auto root = (-b - sqrt_d) / a;
-  if (root < t_min || t_max < root) {
-    root = (-b + sqrt_d) / a;
-    if (root < t_min || t_max < root)
-      return false;
-  }
-
-  rec.t = root;
-  rec.p = r.at(rec.t);
-  Vector3d outward_normal = (rec.p - center(r.time_)) / radius_;
-  rec.set_face_normal(r, outward_normal);
-  rec.mat_ptr = mat_ptr_;
+  Vector3d unit_p = (rec.p - c) / radius_;
+  get_sphere_uv(unit_p, rec.u, rec.v);
+  get_sphere_partials(unit_p, radius_, rec.dpdu, rec.dpdv);
+  rec.mat_ptr = mat_ptr_.get();
   
   return true;
 }
@@ -5,3 +5,46 @@ using namespace cannon::ray;
 Vector3d Ray::at(double t) const {
   return orig_ + t * dir_;
 }
+
+double Ray::cone_width(double t) const {
+  if (cone_spread_ == 0.0)
+    return cone_width_;
+
+  return cone_width_ + cone_spread_ * t * dir_.norm();
+}
+
+void Ray::precompute_shear_() {
+  // Permute coordinates so that the ray's z-axis has the greatest magnitude
+  dir_.cwiseAbs().maxCoeff(&kz_);
+  kx_ = kz_ + 1; if (kx_ == 3) kx_ = 0;
+  ky_ = kx_ + 1; if (ky_ == 3) ky_ = 0;
+
+  sz_ = 1.0 / dir_[kz_];
+  sx_ = -dir_[kx_] * sz_;
+  sy_ = -dir_[ky_] * sz_;
+}
+
+// Public Functions
+Vector3d cannon::ray::offset_ray_origin(const Vector3d& p, const Vector3d&
+    p_error, const Vector3d& n, const Vector3d& w) {
+  // The exact surface point lies within the box of half-widths p_error
+  // around p, so moving p along the normal by the box's extent in that
+  // direction puts it strictly on one side of the surface
+  double d = n.cwiseAbs().dot(p_error);
+  Vector3d offset = d * n;
+  if (w.dot(n) < 0)
+    offset = -offset;
+
+  Vector3d po = p + offset;
+
+  // Round away from p, so that rounding in the addition cannot move the
+  // origin back toward the surface
+  for (int i = 0; i < 3; i++) {
+    if (offset[i] > 0)
+      po[i] = next_float_up(po[i]);
+    else if (offset[i] < 0)
+      po[i] = next_float_down(po[i]);
+  }
+
+  return po;
+}
@@ -9,6 +9,8 @@
 
 #include <Eigen/Dense>
 
+#include <cannon/ray/float.hpp>
+
 using namespace Eigen;
 
 namespace cannon {
@@ -28,7 +30,9 @@ namespace cannon {
          * Constructor taking an origin, direction, and time for this ray.
          */
         Ray(const Vector3d& origin, const Vector3d& direction, double time =
-            0.0) : orig_(origin), dir_(direction), time_(time) {}
+            0.0) : orig_(origin), dir_(direction), time_(time) {
+          precompute_shear_();
+        }
 
         /*!
          * Method computing the location in 3D space that is the input distance
@@ -40,13 +44,60 @@ namespace cannon {
          */
         Vector3d at(double t) const;
 
+        /*!
+         * Method computing the width of the cone traced by this ray at the
+         * input distance along it, which approximates the footprint of a
+         * pixel for texture filtering.
+         *
+         * \param t Distance along ray.
+         *
+         * \returns Cone width at distance t, or zero for rays without a cone.
+         */
+        double cone_width(double t) const;
+
+      private:
+
+        /*!
+         * Compute the coordinate permutation and shear which transform this
+         * ray to the +z axis, for watertight triangle intersection.
+         */
+        void precompute_shear_();
+
       public:
         Vector3d orig_; //!< Origin of this ray.
         Vector3d dir_; //!< Direction of this ray.
         double time_; //!< Time that this ray was sent
 
+        double cone_width_ = 0.0; //!< Width of the ray cone at the ray origin
+        double cone_spread_ = 0.0; //!< Growth in ray cone width per unit distance, in radians
+
+        bool shadow_ = false; //!< Whether this ray only tests visibility, so that media whose transmittance is estimated separately let it pass
+
+        int kx_, ky_, kz_; //!< Permutation making kz_ the axis of largest direction magnitude
+        double sx_, sy_, sz_; //!< Shear aligning the permuted direction with the +z axis
+
     };
 
+    // Free Functions
+
+    /*!
+     * Compute an origin for a ray leaving a surface, offset from the
+     * computed surface point far enough along the normal that the ray
+     * cannot intersect the surface again due to rounding error. This
+     * replaces the usual minimum hit distance epsilon, which is too large
+     * for small geometry and too small for geometry far from the origin.
+     *
+     * \param p Computed surface point.
+     * \param p_error Conservative bound on the absolute error in each
+     * component of p.
+     * \param n Surface normal at p.
+     * \param w Direction of the ray leaving the surface.
+     *
+     * \returns Ray origin on the same side of the surface as w.
+     */
+    Vector3d offset_ray_origin(const Vector3d& p, const Vector3d& p_error,
+        const Vector3d& n, const Vector3d& w);
+
   }
 }
 
@@ -13,5 +13,30 @@ TEST_CASE("Ray", "[ray]") {
   REQUIRE(r.at(0.5)[1] == 0.5);
   REQUIRE(r.at(0.5)[2] == 0.5);
 
+  // Shear constants map the direction onto the +z axis
+  Ray r2(o, Vector3d(0.5, -2.0, 1.0));
+  REQUIRE(r2.kz_ == 1);
+  REQUIRE(r2.kx_ == 2);
+  REQUIRE(r2.ky_ == 0);
+  REQUIRE(r2.dir_[r2.kx_] + r2.sx_ * r2.dir_[r2.kz_] == Approx(0.0));
+  REQUIRE(r2.dir_[r2.ky_] + r2.sy_ * r2.dir_[r2.kz_] == Approx(0.0));
+  REQUIRE(r2.sz_ * r2.dir_[r2.kz_] == Approx(1.0));
 
 }
+
+TEST_CASE("Ray_offset_ray_origin", "[ray]") {
+  Vector3d p(1.0, 2.0, -3.0);
+  Vector3d p_error(1e-10, 2e-10, 3e-10);
+  Vector3d n = Vector3d(1, 1, 0).normalized();
+
+  // Origins move along the normal to the side of the outgoing direction,
+  // by at least the error bound in that direction
+  double d = n.cwiseAbs().dot(p_error);
+  Vector3d up = offset_ray_origin(p, p_error, n, Vector3d(0, 1, 0));
+  Vector3d down = offset_ray_origin(p, p_error, n, Vector3d(0, -1, 0));
+  REQUIRE((up - p).dot(n) >= d);
+  REQUIRE((down - p).dot(n) <= -d);
+
+  // Without error, origins are unchanged
+  REQUIRE(offset_ray_origin(p, Vector3d::Zero(), n, n) == p);
+}
@@ -0,0 +1,242 @@
+#include <cannon/ray/ray_packet.hpp>
+
+#include <cmath>
+#include <stdexcept>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+using namespace cannon::ray;
+
+namespace {
+
+  // Thin wrappers over the widest available float vector type, so that each
+  // kernel below is written only once. Comparisons return bitmasks with one
+  // bit per lane.
+
+#if defined(__AVX2__)
+
+  struct Lanes {
+    static constexpr int width = 8;
+    __m256 v;
+  };
+
+  inline Lanes load(const float* p) { return {_mm256_load_ps(p)}; }
+  inline Lanes set(float f) { return {_mm256_set1_ps(f)}; }
+  inline void store(float* p, Lanes a) { _mm256_storeu_ps(p, a.v); }
+  inline Lanes operator+(Lanes a, Lanes b) { return {_mm256_add_ps(a.v, b.v)}; }
+  inline Lanes operator-(Lanes a, Lanes b) { return {_mm256_sub_ps(a.v, b.v)}; }
+  inline Lanes operator*(Lanes a, Lanes b) { return {_mm256_mul_ps(a.v, b.v)}; }
+  inline Lanes operator/(Lanes a, Lanes b) { return {_mm256_div_ps(a.v, b.v)}; }
+  inline Lanes min(Lanes a, Lanes b) { return {_mm256_min_ps(a.v, b.v)}; }
+  inline Lanes max(Lanes a, Lanes b) { return {_mm256_max_ps(a.v, b.v)}; }
+  inline Lanes abs(Lanes a) { return {_mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v)}; }
+  inline uint32_t le(Lanes a, Lanes b) { return _mm256_movemask_ps(_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)); }
+  inline uint32_t lt(Lanes a, Lanes b) { return _mm256_movemask_ps(_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)); }
+  inline uint32_t ne(Lanes a, Lanes b) { return _mm256_movemask_ps(_mm256_cmp_ps(a.v, b.v, _CMP_NEQ_OQ)); }
+
+#elif defined(__SSE2__)
+
+  struct Lanes {
+    static constexpr int width = 4;
+    __m128 v;
+  };
+
+  inline Lanes load(const float* p) { return {_mm_load_ps(p)}; }
+  inline Lanes set(float f) { return {_mm_set1_ps(f)}; }
+  inline void store(float* p, Lanes a) { _mm_storeu_ps(p, a.v); }
+  inline Lanes operator+(Lanes a, Lanes b) { return {_mm_add_ps(a.v, b.v)}; }
+  inline Lanes operator-(Lanes a, Lanes b) { return {_mm_sub_ps(a.v, b.v)}; }
+  inline Lanes operator*(Lanes a, Lanes b) { return {_mm_mul_ps(a.v, b.v)}; }
+  inline Lanes operator/(Lanes a, Lanes b) { return {_mm_div_ps(a.v, b.v)}; }
+  inline Lanes min(Lanes a, Lanes b) { return {_mm_min_ps(a.v, b.v)}; }
+  inline Lanes max(Lanes a, Lanes b) { return {_mm_max_ps(a.v, b.v)}; }
+  inline Lanes abs(Lanes a) { return {_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v)}; }
+  inline uint32_t le(Lanes a, Lanes b) { return _mm_movemask_ps(_mm_cmple_ps(a.v, b.v)); }
+  inline uint32_t lt(Lanes a, Lanes b) { return _mm_movemask_ps(_mm_cmplt_ps(a.v, b.v)); }
+  inline uint32_t ne(Lanes a, Lanes b) {
+    // Ordered not-equal, so that NaN lanes compare false as with AVX
+    return _mm_movemask_ps(_mm_and_ps(_mm_cmpneq_ps(a.v, b.v), _mm_cmpord_ps(a.v, b.v)));
+  }
+
+#else
+
+  struct Lanes {
+    static constexpr int width = 1;
+    float v;
+  };
+
+  inline Lanes load(const float* p) { return {*p}; }
+  inline Lanes set(float f) { return {f}; }
+  inline void store(float* p, Lanes a) { *p = a.v; }
+  inline Lanes operator+(Lanes a, Lanes b) { return {a.v + b.v}; }
+  inline Lanes operator-(Lanes a, Lanes b) { return {a.v - b.v}; }
+  inline Lanes operator*(Lanes a, Lanes b) { return {a.v * b.v}; }
+  inline Lanes operator/(Lanes a, Lanes b) { return {a.v / b.v}; }
+  inline Lanes min(Lanes a, Lanes b) { return {a.v < b.v ? a.v : b.v}; }
+  inline Lanes max(Lanes a, Lanes b) { return {a.v > b.v ? a.v : b.v}; }
+  inline Lanes abs(Lanes a) { return {std::fabs(a.v)}; }
+  inline uint32_t le(Lanes a, Lanes b) { return a.v <= b.v; }
+  inline uint32_t lt(Lanes a, Lanes b) { return a.v < b.v; }
+  inline uint32_t ne(Lanes a, Lanes b) { return a.v < b.v || a.v > b.v; }
+
+#endif
+
+  // Conservative bound on relative rounding error of three float operations,
+  // as gamma(3) in PBRT Ch. 3.9
+  constexpr float gamma_3 = (3 * std::numeric_limits<float>::epsilon() * 0.5f) /
+    (1 - 3 * std::numeric_limits<float>::epsilon() * 0.5f);
+
+  /*!
+   * Round a double to the nearest float that is not smaller.
+   */
+  float round_up(double d) {
+    float f = static_cast<float>(d);
+    if (f < d)
+      f = std::nextafter(f, std::numeric_limits<float>::infinity());
+    return f;
+  }
+
+} // namespace
+
+RayPacket::RayPacket(int size) : size_(size), orig_scale_(0.0f) {
+  if (size != 4 && size != 8 && size != 16)
+    throw std::runtime_error("Ray packet size must be 4, 8, or 16");
+
+  for (int i = 0; i < max_packet_size; i++) {
+    for (int a = 0; a < 3; a++) {
+      orig_[a][i] = 0.0f;
+      dir_[a][i] = 1.0f;
+      inv_dir_[a][i] = 1.0f;
+    }
+
+    t_max_[i] = -std::numeric_limits<float>::infinity();
+    t_max_d_[i] = -std::numeric_limits<double>::infinity();
+  }
+}
+
+void RayPacket::set_ray(int i, const Ray& r, double t_max) {
+  for (int a = 0; a < 3; a++) {
+    orig_[a][i] = static_cast<float>(r.orig_[a]);
+    dir_[a][i] = static_cast<float>(r.dir_[a]);
+    inv_dir_[a][i] = 1.0f / dir_[a][i];
+    orig_scale_ = std::max(orig_scale_, std::fabs(orig_[a][i]));
+  }
+
+  rays_[i] = r;
+  set_t_max(i, t_max);
+}
+
+void RayPacket::set_t_max(int i, double t_max) {
+  t_max_d_[i] = t_max;
+  t_max_[i] = round_up(t_max);
+}
+
+uint32_t RayPacket::active_mask() const {
+  uint32_t mask = 0;
+  for (int i = 0; i < size_; i++) {
+    if (t_max_d_[i] >= 0)
+      mask |= 1u << i;
+  }
+
+  return mask;
+}
+
+// Free functions
+PacketTriangle cannon::ray::make_packet_triangle(const Vector3d& p0, const
+    Vector3d& p1, const Vector3d& p2) {
+  PacketTriangle tri;
+  for (int a = 0; a < 3; a++) {
+    tri.p0_[a] = static_cast<float>(p0[a]);
+    tri.e1_[a] = static_cast<float>(p1[a] - p0[a]);
+    tri.e2_[a] = static_cast<float>(p2[a] - p0[a]);
+  }
+
+  return tri;
+}
+
+uint32_t cannon::ray::packet_box_hit(const RayPacket& packet, const float
+    bounds_min[3], const float bounds_max[3], float t_min) {
+  // Pad the box by the worst-case difference between the single precision
+  // rays and their double precision counterparts over the extent of the box
+  float pad[3];
+  for (int a = 0; a < 3; a++) {
+    float scale = std::max(std::fabs(bounds_min[a]), std::fabs(bounds_max[a])) + packet.orig_scale_;
+    pad[a] = 8 * std::numeric_limits<float>::epsilon() * scale;
+  }
+
+  uint32_t mask = 0;
+  for (int i = 0; i < packet.size_; i += Lanes::width) {
+    Lanes t0 = set(t_min);
+    Lanes t1 = load(&packet.t_max_[i]);
+
+    for (int a = 0; a < 3; a++) {
+      Lanes o = load(&packet.orig_[a][i]);
+      Lanes inv_d = load(&packet.inv_dir_[a][i]);
+
+      Lanes near = (set(bounds_min[a] - pad[a]) - o) * inv_d;
+      Lanes far = (set(bounds_max[a] + pad[a]) - o) * inv_d;
+
+      // Written so that NaNs from rays lying in a slab plane leave the
+      // interval unchanged
+      t0 = max(min(near, far), t0);
+      t1 = min(max(near, far), t1);
+    }
+
+    t1 = t1 * set(1 + 2 * gamma_3);
+    mask |= le(t0, t1) << i;
+  }
+
+  return mask & ((1u << packet.size_) - 1);
+}
+
+uint32_t cannon::ray::packet_triangle_hit(const RayPacket& packet, const
+    PacketTriangle& tri, float t_min, float t_hit[max_packet_size]) {
+  // Moller-Trumbore test, with edge tolerances proportional to the rounding
+  // error of the barycentric coordinates
+  Lanes e1x = set(tri.e1_[0]), e1y = set(tri.e1_[1]), e1z = set(tri.e1_[2]);
+  Lanes e2x = set(tri.e2_[0]), e2y = set(tri.e2_[1]), e2z = set(tri.e2_[2]);
+  Lanes tol = set(16 * std::numeric_limits<float>::epsilon());
+
+  uint32_t mask = 0;
+  for (int i = 0; i < packet.size_; i += Lanes::width) {
+    Lanes dx = load(&packet.dir_[0][i]);
+    Lanes dy = load(&packet.dir_[1][i]);
+    Lanes dz = load(&packet.dir_[2][i]);
+
+    Lanes px = dy * e2z - dz * e2y;
+    Lanes py = dz * e2x - dx * e2z;
+    Lanes pz = dx * e2y - dy * e2x;
+    Lanes det = e1x * px + e1y * py + e1z * pz;
+    Lanes inv_det = set(1.0f) / det;
+
+    Lanes tx = load(&packet.orig_[0][i]) - set(tri.p0_[0]);
+    Lanes ty = load(&packet.orig_[1][i]) - set(tri.p0_[1]);
+    Lanes tz = load(&packet.orig_[2][i]) - set(tri.p0_[2]);
+
+    Lanes qx = ty * e1z - tz * e1y;
+    Lanes qy = tz * e1x - tx * e1z;
+    Lanes qz = tx * e1y - ty * e1x;
+
+    Lanes u = (tx * px + ty * py + tz * pz) * inv_det;
+    Lanes v = (dx * qx + dy * qy + dz * qz) * inv_det;
+    Lanes t = (e2x * qx + e2y * qy + e2z * qz) * inv_det;
+
+    Lanes abs_inv_det = abs(inv_det);
+    Lanes u_tol = tol * (abs(tx) + abs(ty) + abs(tz)) * (abs(px) + abs(py) + abs(pz)) * abs_inv_det;
+    Lanes v_tol = tol * (abs(dx) + abs(dy) + abs(dz)) * (abs(qx) + abs(qy) + abs(qz)) * abs_inv_det;
+
+    uint32_t lane_mask = ne(det, set(0.0f))
+      & le(set(0.0f) - u_tol, u)
+      & le(set(0.0f) - v_tol, v)
+      & le(u + v, set(1.0f) + u_tol + v_tol)
+      & lt(set(t_min), t)
+      & lt(t, load(&packet.t_max_[i]) * set(1 + 2 * gamma_3));
+
+    store(&t_hit[i], t);
+    mask |= lane_mask << i;
+  }
+
+  return mask & ((1u << packet.size_) - 1);
+}
@@ -0,0 +1,141 @@
+#pragma once
+#ifndef CANNON_RAY_RAY_PACKET_H
+#define CANNON_RAY_RAY_PACKET_H
+
+/*!
+ * \file cannon/ray/ray_packet.hpp
+ * \brief File containing RayPacket class definition and SIMD kernels for
+ * testing packets of rays against bounding boxes and triangles.
+ */
+
+#include <cstdint>
+#include <limits>
+
+#include <Eigen/Dense>
+
+#include <cannon/ray/ray.hpp>
+
+using namespace Eigen;
+
+namespace cannon {
+  namespace ray {
+
+    static constexpr int max_packet_size = 16; //!< Maximum number of rays in a packet
+
+    /*!
+     * \brief Struct holding single-precision triangle data for packet
+     * intersection, stored as a vertex and two edges.
+     */
+    struct PacketTriangle {
+      float p0_[3]; //!< First vertex
+      float e1_[3]; //!< Edge from first to second vertex
+      float e2_[3]; //!< Edge from first to third vertex
+    };
+
+    /*!
+     * \brief Class representing a packet of coherent rays stored in
+     * structure-of-arrays layout, so that kernels can test several rays
+     * against the same box or triangle at once.
+     *
+     * Lanes beyond the packet size, and lanes that have not been set, have a
+     * negative maximum distance so that they never report intersections.
+     */
+    class RayPacket {
+      public:
+
+        RayPacket() = delete;
+
+        /*!
+         * Constructor taking the number of rays in this packet, which must
+         * be 4, 8, or 16.
+         */
+        RayPacket(int size);
+
+        /*!
+         * Set a lane of this packet.
+         *
+         * \param i The lane to set.
+         * \param r The ray for this lane.
+         * \param t_max Maximum distance along the ray for this lane.
+         */
+        void set_ray(int i, const Ray& r, double t_max = std::numeric_limits<double>::infinity());
+
+        /*!
+         * Update the maximum distance of a lane, e.g. after an intersection
+         * has been found.
+         *
+         * \param i The lane to update.
+         * \param t_max New maximum distance along the ray for this lane.
+         */
+        void set_t_max(int i, double t_max);
+
+        /*!
+         * Get a mask with one bit set for each lane that has been set.
+         *
+         * \returns The active lane mask.
+         */
+        uint32_t active_mask() const;
+
+      public:
+        int size_; //!< Number of rays in this packet
+
+        alignas(64) float orig_[3][max_packet_size]; //!< Ray origins, by axis
+        alignas(64) float dir_[3][max_packet_size]; //!< Ray directions, by axis
+        alignas(64) float inv_dir_[3][max_packet_size]; //!< Reciprocal ray directions, by axis
+        alignas(64) float t_max_[max_packet_size]; //!< Maximum distance for each ray, rounded up
+
+        float orig_scale_; //!< Largest origin coordinate magnitude, used to pad box tests
+
+        Ray rays_[max_packet_size]; //!< Double precision rays, for scalar intersection
+        double t_max_d_[max_packet_size]; //!< Maximum distance for each ray in double precision
+
+    };
+
+    // Free functions
+
+    /*!
+     * Make single-precision packet intersection data for a triangle.
+     *
+     * \param p0 First vertex.
+     * \param p1 Second vertex.
+     * \param p2 Third vertex.
+     *
+     * \returns The packet triangle.
+     */
+    PacketTriangle make_packet_triangle(const Vector3d& p0, const Vector3d& p1, const Vector3d& p2);
+
+    /*!
+     * Test all lanes of a ray packet against a box. Uses AVX2 or SSE when
+     * available. Results are conservative, so a lane may be reported as
+     * hitting a box it narrowly misses, but never the reverse.
+     *
+     * \param packet The rays to test.
+     * \param bounds_min Minimum corner of the box.
+     * \param bounds_max Maximum corner of the box.
+     * \param t_min Minimum distance along rays.
+     *
+     * \returns A mask with one bit set for each lane that hits the box.
+     */
+    uint32_t packet_box_hit(const RayPacket& packet, const float bounds_min[3],
+        const float bounds_max[3], float t_min);
+
+    /*!
+     * Test all lanes of a ray packet against a triangle. Uses AVX2 or SSE
+     * when available. Edges are slightly enlarged so that rays through
+     * shared edges are never missed, which means candidate hits must be
+     * confirmed with an exact scalar test.
+     *
+     * \param packet The rays to test.
+     * \param tri The triangle to test.
+     * \param t_min Minimum distance along rays.
+     * \param t_hit Array in which to put the distance of each hit.
+     *
+     * \returns A mask with one bit set for each lane that hits the triangle.
+     */
+    uint32_t packet_triangle_hit(const RayPacket& packet, const
+        PacketTriangle& tri, float t_min, float t_hit[max_packet_size]);
+
+  } // namespace ray
+} // namespace cannon
+
+#endif /* ifndef CANNON_RAY_RAY_PACKET_H */
@@ -0,0 +1,72 @@
+#include <catch2/catch.hpp>
+
+#include <cannon/ray/ray_packet.hpp>
+#include <cannon/ray/aabb.hpp>
+#include <cannon/math/random_double.hpp>
+
+using namespace cannon::ray;
+using namespace cannon::math;
+
+TEST_CASE("RayPacket", "[ray]") {
+  REQUIRE_THROWS(RayPacket(3));
+
+  for (int size : {4, 8, 16}) {
+    RayPacket packet(size);
+    REQUIRE(packet.active_mask() == 0);
+
+    Ray rays[max_packet_size];
+    for (int i = 0; i < size; i++) {
+      rays[i] = Ray(random_vec(-5, 5), random_unit_vec());
+      packet.set_ray(i, rays[i]);
+    }
+    REQUIRE(packet.active_mask() == (1u << size) - 1);
+
+    // Box hits should never be missed by the packet kernel
+    for (int b = 0; b < 100; b++) {
+      Aabb box(random_vec(-3, 3), random_vec(-3, 3));
+      float bounds_min[3], bounds_max[3];
+      for (int a = 0; a < 3; a++) {
+        bounds_min[a] = box.minimum_[a];
+        bounds_max[a] = box.maximum_[a];
+      }
+
+      uint32_t mask = packet_box_hit(packet, bounds_min, bounds_max, 0.001f);
+      for (int i = 0; i < size; i++) {
+        if (box.hit(rays[i], 0.001, std::numeric_limits<double>::infinity()))
+          REQUIRE((mask & (1u << i)) != 0);
+      }
+    }
+
+    // Triangle hits should agree with a double precision reference test
+    for (int k = 0; k < 100; k++) {
+      Vector3d p0 = random_vec(-3, 3), p1 = random_vec(-3, 3), p2 = random_vec(-3, 3);
+      PacketTriangle tri = make_packet_triangle(p0, p1, p2);
+
+      float t_hit[max_packet_size];
+      uint32_t mask = packet_triangle_hit(packet, tri, 0.001f, t_hit);
+
+      for (int i = 0; i < size; i++) {
+        Vector3d e1 = p1 - p0, e2 = p2 - p0;
+        Vector3d p = rays[i].dir_.cross(e2);
+        double det = e1.dot(p);
+        Vector3d tv = rays[i].orig_ - p0;
+        Vector3d q = tv.cross(e1);
+        double u = tv.dot(p) / det, v = rays[i].dir_.dot(q) / det, t = e2.dot(q) / det;
+
+        // Skip rays too close to an edge for the reference to be meaningful
+        if (std::fabs(u) < 1e-4 || std::fabs(v) < 1e-4 || std::fabs(1 - u - v) < 1e-4)
+          continue;
+
+        bool hit = u > 0 && v > 0 && u + v < 1 && t > 0.001;
+        REQUIRE(((mask & (1u << i)) != 0) == hit);
+        if (hit)
+          REQUIRE(t_hit[i] == Approx(t).epsilon(1e-4));
+      }
+    }
+
+    // Inactive lanes never hit
+    packet.set_t_max(0, -std::numeric_limits<double>::infinity());
+    float bounds_min[3] = {-100, -100, -100}, bounds_max[3] = {100, 100, 100};
+    REQUIRE((packet_box_hit(packet, bounds_min, bounds_max, 0.0f) & 1u) == 0);
+  }
+}
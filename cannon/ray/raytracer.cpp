@@ -1,15 +1,30 @@
 #include <cannon/ray/raytracer.hpp>
 
+#include <atomic>
+#include <chrono>
+#include <numeric>
+#include <algorithm>
+
 #include <cannon/ray/hittable.hpp>
 #include <cannon/ray/ray.hpp>
 #include <cannon/ray/sphere.hpp>
 #include <cannon/ray/write_ppm.hpp>
+#include <cannon/ray/denoiser.hpp>
 #include <cannon/ray/film.hpp>
 #include <cannon/ray/material.hpp>
 #include <cannon/ray/filter.hpp>
 #include <cannon/ray/sampler.hpp>
+#include <cannon/ray/linear_bvh.hpp>
+#include <cannon/ray/hittable_list.hpp>
+#include <cannon/ray/instance.hpp>
+#include <cannon/ray/grid_medium.hpp>
+#include <cannon/ray/ray_packet.hpp>
+#include <cannon/log/registry.hpp>
 #include <cannon/utils/thread_pool.hpp>
+#include <cannon/utils/work_stealing_pool.hpp>
+#include <cannon/utils/parallel_for.hpp>
 #include <cannon/utils/statistics.hpp>
+#include <cannon/utils/profiler.hpp>
 #include <cannon/math/random_double.hpp>
 
 #ifdef CANNON_BUILD_GRAPHICS
@@ -23,6 +38,14 @@
 using namespace cannon::ray;
 using namespace cannon::math;
 using namespace cannon::utils;
+using namespace cannon::log;
+
+STAT_COUNTER("Integrator/Path bounces", nPathBounces);
+STAT_COUNTER("Integrator/Russian roulette terminations", nRussianRouletteTerminations);
+STAT_PERCENT("Integrator/Shadow rays reaching emitters", nShadowRaysUnoccluded, nShadowRays);
+STAT_INT_DISTRIBUTION("Integrator/Path length", nPathLength);
+STAT_COUNTER("Integrator/Adaptive samples saved", nAdaptiveSamplesSaved);
+STAT_COUNTER("Integrator/Tiles stolen", nTileSteals);
 
 raytracer_params Raytracer::load_config(const std::string& filename) {
   raytracer_params params;
@@ -70,33 +93,276 @@ raytracer_params Raytracer::load_config(const std::string& filename) {
   params.background_color[1] = safe_get_param_<double>(background_params, "y");
   params.background_color[2] = safe_get_param_<double>(background_params, "z");
 
+  // Packet tracing is optional, and off unless requested
+  params.packet_size = get_param_or_<int>(config, "packet_size", params.packet_size);
+  params.russian_roulette_depth = get_param_or_<int>(config,
+      "russian_roulette_depth", params.russian_roulette_depth);
+
+  params.progressive_passes = get_param_or_<int>(config, "progressive_passes", params.progressive_passes);
+  if (params.progressive_passes < 1)
+    throw std::runtime_error("progressive_passes must be at least 1");
+
+  params.adaptive_sampling = get_param_or_<bool>(config, "adaptive_sampling", params.adaptive_sampling);
+  params.adaptive_threshold = get_param_or_<double>(config, "adaptive_threshold", params.adaptive_threshold);
+  params.adaptive_min_samples = get_param_or_<int>(config, "adaptive_min_samples", params.adaptive_min_samples);
+  params.adaptive_round_samples = get_param_or_<int>(config, "adaptive_round_samples", params.adaptive_round_samples);
+  params.adaptive_max_samples = get_param_or_<int>(config, "adaptive_max_samples", 4 * params.samples_per_pixel);
+
+  params.sampler = get_param_or_<std::string>(config, "sampler", params.sampler);
+  params.seed = get_param_or_<unsigned int>(config, "seed", params.seed);
+
+  params.write_features = get_param_or_<bool>(config, "write_features", params.write_features);
+  params.denoise = get_param_or_<bool>(config, "denoise", params.denoise);
+  params.denoise_iterations = get_param_or_<int>(config, "denoise_iterations", params.denoise_iterations);
+  if (params.denoise_iterations < 1)
+    throw std::runtime_error("denoise_iterations must be at least 1");
+
+  params.profile = get_param_or_<bool>(config, "profile", params.profile);
+
+  params.first_sample = get_param_or_<int>(config, "first_sample", params.first_sample);
+  params.num_workers = get_param_or_<int>(config, "num_workers", params.num_workers);
+  params.worker_index = get_param_or_<int>(config, "worker_index", params.worker_index);
+  params.checkpoint = get_param_or_<std::string>(config, "checkpoint", params.checkpoint);
+  if (params.first_sample < 0)
+    throw std::runtime_error("first_sample must be non-negative");
+  if (params.num_workers < 1 || params.worker_index < 0 || params.worker_index >= params.num_workers)
+    throw std::runtime_error("worker_index must be between 0 and num_workers - 1");
+
+  // Adaptive sampling decides which pixels to sample from the whole image
+  if (params.adaptive_sampling && (params.first_sample != 0 ||
+        params.num_workers > 1 || !params.checkpoint.empty()))
+    throw std::runtime_error("Distributed and resumed renders do not support adaptive sampling");
+
+  if (params.adaptive_min_samples < 2 || params.adaptive_round_samples < 1)
+    throw std::runtime_error("adaptive_min_samples must be at least 2 and adaptive_round_samples at least 1");
+
+  // Construct a sampler as large as any made while rendering, so that bad
+  // sampler settings are reported before rendering starts. Global samplers
+  // are sized by the last sample index taken, which adaptive rounds push
+  // past samples_per_pixel for any pixel below adaptive_max_samples.
+  int max_sample_index = params.first_sample + params.samples_per_pixel;
+  if (params.adaptive_sampling)
+    max_sample_index = std::max(params.adaptive_min_samples,
+        params.adaptive_max_samples - 1 + params.adaptive_round_samples);
+  make_sampler(params.sampler, max_sample_index,
+      Vector2i(params.image_width, params.image_height));
+
+  if (params.packet_size != 1 && params.packet_size != 4 &&
+      params.packet_size != 8 && params.packet_size != 16)
+    throw std::runtime_error("packet_size must be 1, 4, 8, or 16");
+
   return params;
 }
 
-Vector3d Raytracer::ray_color(const Ray& r, int depth) {
+Vector3d Raytracer::ray_color(const Ray& r, int depth, Rng& rng, FilmFeatures* features) {
   hit_record rec;
 
   if (depth <= 0)
     return Vector3d::Zero();
 
-  if (!world_->hit(r, 0.001, std::numeric_limits<double>::infinity(), rec))
-    return params_.background_color;
+  bool hit;
+  {
+    PROFILE_HOT_SCOPE("Intersect ray");
+    hit = world_->hit(r, 0.0, std::numeric_limits<double>::infinity(), rec);
+  }
+
+  return shade_(r, hit, rec, depth, rng, features);
+}
+
+void Raytracer::seed_rng_(Rng& rng, const Vector2i& px, uint64_t sample_num) const {
+  uint64_t pixel_index = static_cast<uint64_t>(px.y()) * params_.image_width + px.x();
+  rng.set_sequence(pixel_index, Rng::mix_bits(sample_num ^ (static_cast<uint64_t>(params_.seed) << 32)));
+}
+
+/*!
+ * Power heuristic weight for a sample drawn from a strategy with density f,
+ * combined with a strategy with density g.
+ */
+static double power_heuristic(double f, double g) {
+  return (f * f) / (f * f + g * g);
+}
+
+Vector3d Raytracer::shade_(const Ray& r, bool hit, const hit_record& rec, int
+    depth, Rng& rng, FilmFeatures* features) {
+  PROFILE_HOT_SCOPE("Shade path");
+  Vector3d color = Vector3d::Zero();
+  Vector3d throughput = Vector3d::Ones();
+
+  Ray path_ray = r;
+  hit_record path_rec = rec;
+
+  // Where the previous vertex also sampled lights directly, emission found
+  // by scattering is weighted against light sampling
+  bool prev_sampled_lights = false;
+  Vector3d prev_p = Vector3d::Zero();
+  double prev_scattering_pdf = 0.0;
+
+  // Features are taken from the first surface that is not a mirror or glass
+  bool features_pending = features != nullptr;
+  if (features)
+    *features = FilmFeatures();
+
+  int bounce = 0;
+  for (; ; bounce++) {
+    if (!hit) {
+      color += (throughput.array() * params_.background_color.array()).matrix();
+      if (features_pending)
+        features->albedo = throughput.cwiseProduct(params_.background_color);
+      break;
+    }
+
+    ++nPathBounces;
+    path_rec.compute_differentials(path_ray);
+    Vector3d emitted = material_emitted(*path_rec.mat_ptr, path_rec.u, path_rec.v, path_rec.p);
+    if (!emitted.isZero()) {
+      double weight = 1.0;
+      if (prev_sampled_lights) {
+        double light_pdf = lights_->pdf_value(prev_p, path_ray.dir_, path_ray.time_);
+        weight = power_heuristic(prev_scattering_pdf, light_pdf);
+      }
+
+      color += weight * (throughput.array() * emitted.array()).matrix();
+      if (features_pending)
+        features->emission += weight * (throughput.array() * emitted.array()).matrix();
+    }
+
+    if (features_pending) {
+      if (bounce == 0)
+        features->depth = path_rec.t * path_ray.dir_.norm();
+
+      if (!material_is_specular(*path_rec.mat_ptr) || bounce + 1 >= depth) {
+        features->albedo = throughput.cwiseProduct(material_albedo(*path_rec.mat_ptr, path_rec));
+        features->normal = path_rec.normal;
+        features_pending = false;
+      }
+    }
+
+    // Light arriving directly at the next vertex only counts if the path
+    // could have reached it
+    bool sample_lights = lights_ && !material_is_specular(*path_rec.mat_ptr) && bounce + 1 < depth;
+    if (sample_lights)
+      color += (throughput.array() * sample_light_(path_ray, path_rec, rng).array()).matrix();
+
+    Ray scattered;
+    Vector3d attenuation = Vector3d::Zero();
+    if (!material_scatter(*path_rec.mat_ptr, path_ray, path_rec, attenuation, scattered, rng))
+      break;
+
+    throughput = (throughput.array() * attenuation.array()).matrix();
+
+    // Mirror-like bounces keep the cone of the incoming ray, so reflected
+    // and refracted textures stay filtered. Other bounces spread rays over
+    // the hemisphere, and scattered rays have no cone.
+    if (material_is_specular(*path_rec.mat_ptr)) {
+      scattered.cone_width_ = path_ray.cone_width(path_rec.t);
+      scattered.cone_spread_ = path_ray.cone_spread_;
+    }
+
+    // Anything beyond the final intersection contributes nothing
+    if (bounce + 1 >= depth || throughput.isZero())
+      break;
+
+    prev_sampled_lights = sample_lights;
+    if (sample_lights) {
+      prev_p = path_rec.p;
+      prev_scattering_pdf = material_scattering_pdf(*path_rec.mat_ptr, path_ray, path_rec, scattered.dir_);
+    }
+
+    // Terminate paths carrying little light with probability q, weighting
+    // survivors by 1 / (1 - q) so that the estimate stays unbiased
+    if (bounce + 1 >= params_.russian_roulette_depth) {
+      double q = std::max(0.05, 1.0 - throughput.maxCoeff());
+      if (random_double(rng) < q) {
+        ++nRussianRouletteTerminations;
+        break;
+      }
+
+      throughput /= 1.0 - q;
+    }
+
+    path_ray = scattered;
+    PROFILE_HOT_SCOPE("Intersect ray");
+    hit = world_->hit(path_ray, 0.0, std::numeric_limits<double>::infinity(), path_rec);
+  }
+
+  nPathLength.add(hit ? bounce + 1 : bounce);
+  return color;
+}
+
+Vector3d Raytracer::sample_light_(const Ray& r_in, const hit_record& rec, Rng& rng) {
+  PROFILE_HOT_SCOPE("Sample light");
+  Vector3d direction = lights_->random_direction(rec.p, r_in.time_, rng);
+  double light_pdf = lights_->pdf_value(rec.p, direction, r_in.time_);
+  if (light_pdf <= 0.0)
+    return Vector3d::Zero();
+
+  Vector3d f = material_eval(*rec.mat_ptr, r_in, rec, direction);
+  if (f.isZero())
+    return Vector3d::Zero();
+
+  // The background is not a sampled light, so only emission from surfaces
+  // counts here. Grid media let shadow rays through, and attenuate the
+  // light by their estimated transmittance instead.
+  ++nShadowRays;
+  Ray shadow_ray = rec.spawn_ray(direction, r_in.time_);
+  shadow_ray.shadow_ = true;
+  hit_record light_rec;
+  if (!world_->hit(shadow_ray, 0.0, std::numeric_limits<double>::infinity(), light_rec))
+    return Vector3d::Zero();
+
+  Vector3d emitted = material_emitted(*light_rec.mat_ptr, light_rec.u, light_rec.v, light_rec.p);
+  if (emitted.isZero())
+    return Vector3d::Zero();
 
-  Ray scattered;
-  Vector3d attenuation = Vector3d::Zero();
-  Vector3d emitted = rec.mat_ptr->emitted(rec.u, rec.v, rec.p);
+  double tr = transmittance_(shadow_ray, light_rec.t, rng);
+  if (tr <= 0.0)
+    return Vector3d::Zero();
 
-  if (!rec.mat_ptr->scatter(r, rec, attenuation, scattered))
-    return emitted;
+  ++nShadowRaysUnoccluded;
 
-  return emitted + (attenuation.array() * ray_color(scattered, depth-1).array()).matrix();
+  double weight = power_heuristic(light_pdf, material_scattering_pdf(*rec.mat_ptr, r_in, rec, direction));
+  return (tr * weight / light_pdf) * (f.array() * emitted.array()).matrix();
+}
+
+void Raytracer::collect_media_(const HittablePtr& hittable, const Affine3d& world_to_parent) {
+  if (!hittable)
+    return;
+
+  Affine3d world_to_object = (*hittable->world_to_object_) * world_to_parent;
+  if (auto medium = std::dynamic_pointer_cast<GridMedium>(hittable)) {
+    media_.emplace_back(world_to_object, medium);
+  } else if (auto instance = std::dynamic_pointer_cast<Instance>(hittable)) {
+    collect_media_(instance->object_, world_to_object);
+  } else if (auto list = std::dynamic_pointer_cast<HittableList>(hittable)) {
+    for (auto& object : list->objects_)
+      collect_media_(object, world_to_object);
+  } else if (auto bvh = std::dynamic_pointer_cast<LinearBvh>(hittable)) {
+    for (auto& primitive : bvh->primitives_)
+      collect_media_(primitive, world_to_object);
+  }
+}
+
+double Raytracer::transmittance_(const Ray& r, double t_max, Rng& rng) const {
+  // Affine transforms preserve distances along rays, so the segment is the
+  // same in each medium's object space
+  double tr = 1.0;
+  for (const auto& [world_to_object, medium] : media_) {
+    Ray object_space_ray(world_to_object * r.orig_, world_to_object.linear() * r.dir_, r.time_);
+    tr *= medium->transmittance(object_space_ray, 0.0, t_max, rng);
+    if (tr <= 0.0)
+      break;
+  }
+
+  return tr;
 }
 
 void Raytracer::render(std::ostream& os) {
   os << "P3\n" << params_.image_width << ' ' << params_.image_height << "\n255\n";
 
-  unsigned int rounded_sqrt_samples = std::round(std::sqrt(params_.samples_per_pixel));
-  StratifiedSampler sampler(rounded_sqrt_samples, rounded_sqrt_samples, true, 2);
+  auto sampler = make_sampler(params_.sampler, params_.samples_per_pixel,
+      Vector2i(params_.image_width, params_.image_height));
+  unsigned int num_samples = sampler->samples_per_pixel();
+  Rng& rng = thread_rng();
 
   for (int j = params_.image_height - 1; j >= 0; --j) {
     std::cerr << "\rScanlines remaining: " << j << " " << std::flush;
@@ -104,20 +370,22 @@ void Raytracer::render(std::ostream& os) {
       Vector3d pixel_color = Vector3d::Zero();
 
       Vector2i px(i, j);
-      sampler.start_pixel(px);
-      for (int s = 0; s < params_.samples_per_pixel; s++) {
-        auto sample = sampler.get_camera_sample(px);
+      seed_rng_(rng, px, pixel_seed_bit);
+      sampler->start_pixel(px);
+      for (unsigned int s = 0; s < num_samples; s++) {
+        auto sample = sampler->get_camera_sample(px);
 
         auto u = sample.p_film.x() / (params_.image_width - 1);
         auto v = sample.p_film.y() / (params_.image_height - 1);
 
         Ray r = camera_.get_ray(u, v, sample);
-        pixel_color += ray_color(r, params_.max_depth);
+        seed_rng_(rng, px, s);
+        pixel_color += ray_color(r, params_.max_depth, rng);
 
-        sampler.start_next_sample();
+        sampler->start_next_sample();
       }
 
-      write_color(os, pixel_color, params_.samples_per_pixel);
+      write_color(os, pixel_color, num_samples);
     }
   }
 
@@ -127,51 +395,326 @@ void Raytracer::render(std::ostream& os) {
 void Raytracer::render(const std::string &out_filename,
                        std::unique_ptr<Filter> filter, int tile_size,
                        unsigned int num_threads) {
+  // Profiling starts before tile costs are estimated, so that their sampling
+  // shows in the trace
+  if (params_.profile)
+    set_profiling_enabled(true);
+
   Film film(params_.image_width, params_.image_height, tile_size, std::move(filter));
 
-  ThreadPool<std::pair<int, int>> pool([&](std::shared_ptr<std::pair<int, int>> tile_coord) {
-      auto tile = film.get_film_tile(tile_coord->first, tile_coord->second);
-      unsigned int rounded_sqrt_samples = std::round(std::sqrt(params_.samples_per_pixel));
-      thread_local StratifiedSampler sampler(rounded_sqrt_samples, rounded_sqrt_samples, true, 2);
+  if (params_.packet_size > 1 && !std::dynamic_pointer_cast<LinearBvh>(world_))
+    log_warning("Packet tracing requires a LinearBvh world, tracing rays one at a time");
+
+  // Tiles cover the whole image, including partial tiles at the edges.
+  // Workers sharing a render take interleaved tiles, so that each gets a
+  // similar mix of cheap and expensive tiles.
+  Vector2i num_tiles = film.num_tiles();
+  std::vector<std::pair<int, int>> tiles;
+  for (int i = 0; i < num_tiles.x(); i++) {
+    for (int j = 0; j < num_tiles.y(); j++) {
+      if ((i * num_tiles.y() + j) % params_.num_workers == params_.worker_index)
+        tiles.emplace_back(i, j);
+    }
+  }
 
-      for (unsigned int i = 0; i < tile->extent_x_; i++) {
-        for (unsigned int j = 0; j < tile->extent_y_; j++) {
-          Vector2i px(tile->origin_x_ + i, tile->origin_y_ + j);
-          sampler.start_pixel(px);
+  // Samples restored from a checkpoint are not taken again
+  int samples_done = 0;
+  if (!params_.checkpoint.empty() && std::ifstream(params_.checkpoint)) {
+    FilmCheckpointInfo info = film.merge_checkpoint(params_.checkpoint);
+    if (info.first_sample != params_.first_sample)
+      throw std::runtime_error("Checkpoint " + params_.checkpoint + " holds samples outside this render");
 
-          for (int s = 0; s < params_.samples_per_pixel; s++) {
-            auto sample = sampler.get_camera_sample(px);
+    samples_done = info.num_samples;
+    log_info("Resuming from", params_.checkpoint, "with", samples_done, "samples per pixel done");
+  }
 
-            auto u = sample.p_film.x() / (params_.image_width - 1);
-            auto v = sample.p_film.y() / (params_.image_height - 1);
+  // Costs are estimated up front, then replaced by the measured time of each
+  // tile after every pass
+  std::vector<double> tile_costs = estimate_tile_costs_(film, tiles, num_threads);
+
+  // Features and denoised images are named after the rendered image, with
+  // a suffix before its extension
+  size_t dot = out_filename.find_last_of('.');
+  size_t slash = out_filename.find_last_of('/');
+  bool has_extension = dot != std::string::npos && (slash == std::string::npos || dot > slash);
+  std::string out_stem = has_extension ? out_filename.substr(0, dot) : out_filename;
+  std::string out_extension = has_extension ? out_filename.substr(dot) : "";
+
+  auto write_outputs = [&]() {
+    PROFILE_SCOPE("Write outputs");
+    film.write_image(out_filename);
+
+    if (params_.write_features)
+      film.write_features(out_stem);
+
+    if (params_.denoise) {
+      DenoiserParams denoiser_params;
+      denoiser_params.iterations = params_.denoise_iterations;
+      film.write_denoised_image(out_stem + "_denoised" + out_extension,
+          denoiser_params, num_threads);
+    }
+  };
+
+  // Render one pass over the image, taking the given number of samples for
+  // each pixel in active, continuing from first_sample, and return the
+  // number each pixel actually took. Tiles are started in order of
+  // decreasing cost, so that expensive tiles do not hold up the end of the
+  // pass. Samples taken over all passes are counted for the adaptive
+  // sampling budget.
+  std::atomic<unsigned long> samples_taken(0);
+  auto render_pass = [&](int first_sample, int samples_per_pixel, const std::vector<bool>* active) {
+    int sampler_first_sample = first_sample;
+    int pass_samples = make_pass_sampler_(sampler_first_sample,
+        samples_per_pixel)->samples_per_pixel() - sampler_first_sample;
+
+    std::vector<size_t> order(tiles.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return tile_costs[a] > tile_costs[b];
+        });
+
+    WorkStealingPool<size_t> pool([&](const size_t& t) {
+        auto start = std::chrono::steady_clock::now();
+
+        auto tile = film.get_film_tile(tiles[t].first, tiles[t].second);
+        {
+          PROFILE_SCOPE("Render tile");
+          samples_taken += render_tile_(*tile, first_sample, samples_per_pixel, active);
+        }
 
-            Ray r = camera_.get_ray(u, v, sample);
-            Vector3d pixel_color = ray_color(r, params_.max_depth);
+        std::cerr << "\rFinished tile (" << tiles[t].first << ", " << tiles[t].second << ")" << std::flush;
 
-            tile->add_sample(Vector2d(u * (params_.image_width - 1), v * (params_.image_height - 1)), pixel_color);
-            sampler.start_next_sample();
+        {
+          PROFILE_SCOPE("Merge tile");
+          film.merge_film_tile(std::move(tile));
+        }
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        tile_costs[t] = elapsed.count();
+        }, num_threads);
+
+    pool.run(order);
+    nTileSteals += pool.num_steals();
+
+    if (params_.progressive_passes > 1 || params_.adaptive_sampling)
+      write_outputs();
+
+    return pass_samples;
+  };
+
+  int passes_rendered = 0;
+  if (!params_.adaptive_sampling) {
+    // Each progressive pass brings every pixel up to an equal share of the
+    // samples, continuing from the samples already taken. Samplers may take
+    // more samples than asked for, so passes are scheduled from the samples
+    // actually taken, which makes resumed renders take the same passes as
+    // uninterrupted ones.
+    int pass_end = 0;
+    for (int pass = 0; pass < params_.progressive_passes; pass++) {
+      pass_end += params_.samples_per_pixel / params_.progressive_passes;
+      if (pass < params_.samples_per_pixel % params_.progressive_passes)
+        pass_end++;
+
+      if (samples_done >= pass_end)
+        continue;
+
+      if (params_.progressive_passes > 1)
+        log_info("Rendering pass", pass + 1, "of", params_.progressive_passes);
+      samples_done += render_pass(params_.first_sample + samples_done,
+          pass_end - samples_done, nullptr);
+      passes_rendered++;
+
+      if (!params_.checkpoint.empty())
+        film.write_checkpoint(params_.checkpoint, params_.first_sample, samples_done);
+    }
+  } else {
+    unsigned long num_pixels = params_.image_width * params_.image_height;
+    unsigned long budget = num_pixels * params_.samples_per_pixel;
+
+    // Converged pixels stay converged, so every active pixel has taken the
+    // same number of samples at the start of each round
+    int first_sample = render_pass(0, params_.adaptive_min_samples, nullptr);
+
+    // Keep sampling pixels that have not converged, so that samples saved on
+    // converged pixels are spent on noisy ones instead
+    std::vector<bool> active(num_pixels);
+    int round = 0;
+    while (true) {
+      unsigned long num_active = 0;
+      for (int y = 0; y < params_.image_height; y++) {
+        for (int x = 0; x < params_.image_width; x++) {
+          const FilmPixel& pixel = film.get_pixel(x, y);
+          bool pixel_active = pixel.sample_count_ < (unsigned int)params_.adaptive_max_samples &&
+            pixel.relative_error() > params_.adaptive_threshold;
+
+          active[y * params_.image_width + x] = pixel_active;
+          if (pixel_active)
+            num_active++;
+        }
+      }
+
+      if (num_active == 0 || samples_taken.load() + num_active * params_.adaptive_round_samples > budget)
+        break;
+
+      log_info("Adaptive sampling round", ++round, "over", num_active, "unconverged pixels");
+      first_sample += render_pass(first_sample, params_.adaptive_round_samples, &active);
+    }
+
+    unsigned long saved = budget > samples_taken.load() ? budget - samples_taken.load() : 0;
+    nAdaptiveSamplesSaved += saved;
+    log_info("Adaptive sampling took", samples_taken.load(), "of", budget, "samples, saving", saved);
+  }
+
+  // Progressive passes write outputs as they finish, unless every pass was
+  // restored from a checkpoint
+  if ((params_.progressive_passes <= 1 || passes_rendered == 0) &&
+      !params_.adaptive_sampling)
+    write_outputs();
+
+  if (params_.profile) {
+    set_profiling_enabled(false);
+    write_chrome_trace(out_stem + "_trace.json");
+    log_info("Wrote profile trace to", out_stem + "_trace.json");
+  }
+}
+
+std::vector<double> Raytracer::estimate_tile_costs_(const Film& film, const
+    std::vector<std::pair<int, int>>& tiles, unsigned int num_threads) {
+  std::vector<double> costs(tiles.size(), 0.0);
+
+  parallel_for(0, tiles.size(), num_threads, [&](size_t begin, size_t end) {
+      for (size_t t = begin; t < end; t++) {
+        auto tile = film.get_film_tile(tiles[t].first, tiles[t].second);
+        auto start = std::chrono::steady_clock::now();
+
+        // Trace a coarse grid of single paths through the tile
+        for (int i = 0; i < tile_cost_grid_size; i++) {
+          for (int j = 0; j < tile_cost_grid_size; j++) {
+            double x = tile->sample_origin_x_ + (i + 0.5) * tile->sample_extent_x_ / tile_cost_grid_size;
+            double y = tile->sample_origin_y_ + (j + 0.5) * tile->sample_extent_y_ / tile_cost_grid_size;
+
+            Ray r = camera_.get_ray(x / (params_.image_width - 1), y / (params_.image_height - 1));
+            ray_color(r, params_.max_depth, thread_rng());
           }
         }
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        costs[t] = elapsed.count();
       }
+      });
 
-      std::cerr << "\rFinished tile (" << tile_coord->first << ", " << tile_coord->second << ")" << std::flush;
+  return costs;
+}
 
-      film.merge_film_tile(std::move(tile));
-      
-      report_thread_stats();
-      }, num_threads);
+std::unique_ptr<Sampler> Raytracer::make_pass_sampler_(int& first_sample,
+    int samples_per_pixel) const {
+  // Global samplers are indexed by sample number, so they are made large
+  // enough to continue from first_sample. Pixel samplers draw fresh
+  // randomized samples for each pixel, so they always start from zero.
+  Vector2i resolution(params_.image_width, params_.image_height);
+  auto sampler = make_sampler(params_.sampler, first_sample + samples_per_pixel, resolution);
+  if (!dynamic_cast<GlobalSampler*>(sampler.get())) {
+    sampler = make_sampler(params_.sampler, samples_per_pixel, resolution);
+    first_sample = 0;
+  }
 
-  // Enqueue work, one item per sample. Could alternatively be done by chunking portions of image
-  for (int i = 0; i < std::floor(params_.image_width / tile_size); i++) {
-    for (int j = 0; j < std::floor(params_.image_height / tile_size); j++) {
-      pool.enqueue(std::make_shared<std::pair<int, int>>(std::make_pair(i, j)));
+  return sampler;
+}
+
+unsigned long Raytracer::render_tile_(FilmTile& tile, int first_sample, int
+    samples_per_pixel, const std::vector<bool>* active) {
+  // Packets are traced through the flattened hierarchy, so other worlds
+  // are always traced one ray at a time
+  auto packet_world = std::dynamic_pointer_cast<LinearBvh>(world_);
+  bool use_packets = params_.packet_size > 1 && packet_world && params_.max_depth > 0;
+
+  uint64_t sample_offset = first_sample;
+  auto sampler = make_pass_sampler_(first_sample, samples_per_pixel);
+  unsigned int num_samples = sampler->samples_per_pixel() - first_sample;
+  unsigned long samples_taken = 0;
+
+  // Random numbers for each sample are drawn from the thread's generator,
+  // reseeded per pixel and sample, so that samplers and media (which draw
+  // from it implicitly) are reproducible too
+  Rng& rng = thread_rng();
+
+  // Features are only gathered when something will use them
+  FilmFeatures features;
+  FilmFeatures* sample_features = params_.write_features || params_.denoise ? &features : nullptr;
+
+  // Camera rays for consecutive samples are coherent, so they are
+  // gathered into packets for the primary intersection and then shaded
+  // one at a time
+  RayPacket packet(use_packets ? params_.packet_size : max_packet_size);
+  Vector2d packet_film_points[max_packet_size];
+  Vector2i packet_pixels[max_packet_size];
+  uint64_t packet_sample_nums[max_packet_size];
+  int packet_count = 0;
+
+  auto flush_packet = [&]() {
+    hit_record recs[max_packet_size];
+    bool hits[max_packet_size];
+    {
+      PROFILE_HOT_SCOPE("Intersect packet");
+      packet_world->packet_hit(packet, 0.0, recs, hits);
     }
-  }
 
-  pool.join();
+    for (int l = 0; l < packet_count; l++) {
+      seed_rng_(rng, packet_pixels[l], packet_sample_nums[l]);
+      Vector3d pixel_color = shade_(packet.rays_[l], hits[l], recs[l],
+          params_.max_depth, rng, sample_features);
+      tile.add_sample(packet_film_points[l], pixel_color, sample_features);
+      packet.set_t_max(l, -std::numeric_limits<double>::infinity());
+    }
+
+    packet_count = 0;
+  };
+
+  for (unsigned int i = 0; i < tile.sample_extent_x_; i++) {
+    for (unsigned int j = 0; j < tile.sample_extent_y_; j++) {
+      Vector2i px(tile.sample_origin_x_ + i, tile.sample_origin_y_ + j);
+      if (active && !(*active)[px.y() * params_.image_width + px.x()])
+        continue;
+
+      seed_rng_(rng, px, pixel_seed_bit | sample_offset);
+      sampler->start_pixel(px);
+
+      for (unsigned int s = 0; s < num_samples; s++) {
+        sampler->set_sample_number(first_sample + s);
+        CameraSample sample;
+        {
+          PROFILE_HOT_SCOPE("Sample camera");
+          sample = sampler->get_camera_sample(px);
+        }
+
+        auto u = sample.p_film.x() / (params_.image_width - 1);
+        auto v = sample.p_film.y() / (params_.image_height - 1);
+
+        Ray r = camera_.get_ray(u, v, sample);
+        Vector2d film_point(u * (params_.image_width - 1), v * (params_.image_height - 1));
+
+        if (use_packets) {
+          packet.set_ray(packet_count, r);
+          packet_film_points[packet_count] = film_point;
+          packet_pixels[packet_count] = px;
+          packet_sample_nums[packet_count++] = sample_offset + s;
+          if (packet_count == packet.size_)
+            flush_packet();
+        } else {
+          seed_rng_(rng, px, sample_offset + s);
+          Vector3d pixel_color = ray_color(r, params_.max_depth, rng, sample_features);
+          tile.add_sample(film_point, pixel_color, sample_features);
+        }
+      }
+
+      samples_taken += num_samples;
+    }
+  }
 
-  film.write_image(out_filename);
+  if (packet_count > 0)
+    flush_packet();
 
+  return samples_taken;
 }
 
 #ifdef CANNON_BUILD_GRAPHICS
@@ -179,18 +722,19 @@ void Raytracer::render_interactive(std::unique_ptr<Filter> filter, int tile_size
   Film film(params_.image_width, params_.image_height, tile_size, std::move(filter));
 
   float *data = new float[3 * params_.image_width * params_.image_height];
+  film.write_image(data);
 
   ThreadPool<std::pair<int, int>> pool([&](std::shared_ptr<std::pair<int, int>> tile_coord) {
       auto tile = film.get_film_tile(tile_coord->first, tile_coord->second);
 
-      for (unsigned int i = 0; i < tile->extent_x_; i++) {
-        for (unsigned int j = 0; j < tile->extent_y_; j++) {
+      for (unsigned int i = 0; i < tile->sample_extent_x_; i++) {
+        for (unsigned int j = 0; j < tile->sample_extent_y_; j++) {
           for (int s = 0; s < params_.samples_per_pixel; s++) {
-            auto u = (i + tile->origin_x_ + random_double()) / (params_.image_width - 1);
-            auto v = (j + tile->origin_y_ + random_double()) / (params_.image_height - 1);
+            auto u = (i + tile->sample_origin_x_ + random_double()) / (params_.image_width - 1);
+            auto v = (j + tile->sample_origin_y_ + random_double()) / (params_.image_height - 1);
 
             Ray r = camera_.get_ray(u, v);
-            Vector3d pixel_color = ray_color(r, params_.max_depth);
+            Vector3d pixel_color = ray_color(r, params_.max_depth, thread_rng());
 
             tile->add_sample(Vector2d(u * (params_.image_width - 1), v * (params_.image_height - 1)), pixel_color);
           }
@@ -200,14 +744,12 @@ void Raytracer::render_interactive(std::unique_ptr<Filter> filter, int tile_size
       std::cerr << "\rFinished tile (" << tile_coord->first << ", " << tile_coord->second << ")" << std::flush;
 
       film.merge_film_tile(std::move(tile));
-      film.write_image(data);
-      
-      report_thread_stats();
       });
 
-  // Enqueue work, one item per sample. Could alternatively be done by chunking portions of image
-  for (int i = 0; i < std::floor(params_.image_width / tile_size); i++) {
-    for (int j = 0; j < std::floor(params_.image_height / tile_size); j++) {
+  // Enqueue work, one item per tile, including partial tiles at the edges
+  Vector2i num_tiles = film.num_tiles();
+  for (int i = 0; i < num_tiles.x(); i++) {
+    for (int j = 0; j < num_tiles.y(); j++) {
       pool.enqueue(std::make_shared<std::pair<int, int>>(std::make_pair(i, j)));
     }
   }
@@ -217,7 +759,9 @@ void Raytracer::render_interactive(std::unique_ptr<Filter> filter, int tile_size
       params_.image_height, GL_RGB, GL_FLOAT, GL_RGB, data);
   graphics::geometry::ScreenQuad quad(tex, params_.image_width, params_.image_height);
 
+  // Only tiles merged since the last frame are converted for display
   w.render_loop([&](){
+      film.update_image(data);
       tex->buffer();
       quad.draw();
       });
@@ -9,11 +9,15 @@
 
 #include <iostream>
 #include <fstream>
+#include <vector>
+#include <utility>
 
 #include <Eigen/Dense>
 #include <yaml-cpp/yaml.h>
 
 #include <cannon/ray/camera.hpp>
+#include <cannon/ray/hittable.hpp>
+#include <cannon/math/rng.hpp>
 #include <cannon/utils/class_forward.hpp>
 
 using namespace Eigen;
@@ -25,6 +29,12 @@ namespace cannon {
     CANNON_CLASS_FORWARD(Ray);
     CANNON_CLASS_FORWARD(Filter);
 
+    CANNON_CLASS_FORWARD(Film);
+    CANNON_CLASS_FORWARD(GridMedium);
+    struct FilmTile;
+    struct FilmFeatures;
+    class Sampler;
+
     /*!
      * \brief Struct containing Raytracer params that can be read from YAML config.
      */
@@ -44,6 +54,31 @@ namespace cannon {
       Vector3d vup = Vector3d::Zero();
 
       Vector3d background_color = Vector3d::Zero();
+
+      int packet_size = 1; //!< Number of camera rays traced together, 1 to trace rays one at a time
+      int russian_roulette_depth = 3; //!< Number of bounces after which paths may be terminated randomly
+
+      int progressive_passes = 1; //!< Number of passes over the image, each writing the image out. Unused with adaptive sampling
+
+      bool adaptive_sampling = false; //!< Whether to sample pixels in rounds until they converge
+      double adaptive_threshold = 0.01; //!< Relative error below which a pixel is converged
+      int adaptive_min_samples = 16; //!< Samples taken for every pixel before checking convergence
+      int adaptive_round_samples = 16; //!< Samples taken for each unconverged pixel per round
+      int adaptive_max_samples = 0; //!< Most samples taken for any pixel, 0 for 4 * samples_per_pixel
+
+      std::string sampler = "stratified"; //!< Sampler type, one of stratified, halton, sobol, or zerotwo
+      unsigned int seed = 0; //!< Seed for random numbers, which are otherwise fixed per pixel sample
+
+      bool write_features = false; //!< Whether to write albedo, normal, and depth images next to the rendered image
+      bool denoise = false; //!< Whether to write a denoised image next to the rendered image
+      int denoise_iterations = 5; //!< Number of a-trous passes when denoising
+
+      bool profile = false; //!< Whether to write a trace of where rendering time is spent next to the rendered image
+
+      int first_sample = 0; //!< Index of the first sample taken for each pixel, so that renders of disjoint sample ranges can be merged
+      int num_workers = 1; //!< Number of processes splitting the image's tiles between them
+      int worker_index = 0; //!< Index of this process among num_workers, which renders every num_workers-th tile from this one
+      std::string checkpoint; //!< Film checkpoint to resume from and to save after each pass, or empty for none
     };
 
     /*!
@@ -60,7 +95,21 @@ namespace cannon {
           params_(load_config(config_filename)), world_(world),
           camera_(params_.look_from, params_.look_at, params_.vup,
               params_.vfov, params_.aspect_ratio, params_.aperture,
-              params_.dist_to_focus) {}
+              params_.dist_to_focus) {
+          camera_.set_image_height(params_.image_height);
+          collect_media_(world_, Affine3d::Identity());
+        }
+
+        /*!
+         * Constructor taking raytracer config filename, world geometry, and
+         * light geometry to sample directly. Lights should also be part of
+         * the world, and must implement Hittable::pdf_value() and
+         * Hittable::random_direction(), e.g. rectangles and spheres.
+         */
+        Raytracer(const std::string& config_filename, HittablePtr world,
+            HittablePtr lights) : Raytracer(config_filename, world) {
+          lights_ = lights;
+        }
 
         /*!
          * Load raytracer params from YAML file.
@@ -78,7 +127,31 @@ namespace cannon {
         void render(std::ostream& os);
 
         /*!
-         * \brief Render scene to input file.
+         * \brief Render scene to input file. Tiles are scheduled over
+         * threads in order of estimated cost, with idle threads stealing
+         * work. Samples are split over progressive_passes passes, with the
+         * image written after each. If adaptive_sampling is set, pixels are
+         * instead sampled in rounds until their relative error falls below
+         * adaptive_threshold, within a total budget of samples_per_pixel
+         * samples per pixel.
+         *
+         * If write_features is set, the albedo, normal, and depth seen
+         * through each pixel are written as <name>_albedo.pfm,
+         * <name>_normal.pfm, and <name>_depth.pfm, where out_filename is
+         * <name>.<extension>. If denoise is set, a denoised image is written
+         * as <name>_denoised.<extension> whenever the image is written.
+         * If profile is set, a Chrome trace of each thread's work is written
+         * as <name>_trace.json once rendering finishes.
+         *
+         * A render can be split between processes, either by giving each a
+         * different range of samples with first_sample and
+         * samples_per_pixel, or a different subset of tiles with
+         * num_workers and worker_index. Each process saves its film to a
+         * checkpoint, and the checkpoints are merged into the final image
+         * with Film::merge_checkpoint(). If the checkpoint already exists
+         * when rendering starts, it is restored and the samples it holds
+         * are not taken again, so interrupted renders resume from their
+         * last completed pass. Neither is supported with adaptive sampling.
          *
          * \param out_filename File to write rendered image to.
          * \param filter Reconstruction filter to use for rendering.
@@ -109,16 +182,149 @@ namespace cannon {
           }
         }
 
+        template <typename T>
+        T get_param_or_(YAML::Node config, const std::string& param, const T& default_value) {
+          if (!config[param])
+            return default_value;
+          else
+            return config[param].as<T>();
+        }
+
         /*!
          * Method that performs the actual raycasting into the scene.
          *
          * \param r Ray into the scene.
-         * \param depth Child ray depth limiting infinite recursion.
+         * \param depth Maximum number of intersections along the path.
+         * \param rng Random number generator for sampling the path.
+         * \param features Set to the features seen along the ray, if not
+         * nullptr.
+         */
+        Vector3d ray_color(const Ray& r, int depth, Rng& rng, FilmFeatures*
+            features = nullptr);
+
+        /*!
+         * Method computing the color carried back along a path whose first
+         * intersection with the scene has already been found. The path is
+         * extended iteratively, tracking its throughput, and terminated
+         * with Russian roulette once it is longer than
+         * russian_roulette_depth bounces.
+         *
+         * \param r Ray into the scene.
+         * \param hit Whether the ray hit the scene.
+         * \param rec Hit record for the intersection, if any.
+         * \param depth Maximum number of intersections along the path.
+         * \param rng Random number generator for sampling the path.
+         * \param features Set to the features seen along the ray, if not
+         * nullptr. Specular bounces are followed to the first other
+         * surface, whose albedo is recorded times the specular attenuation.
+         */
+        Vector3d shade_(const Ray& r, bool hit, const hit_record& rec, int
+            depth, Rng& rng, FilmFeatures* features = nullptr);
+
+        /*!
+         * Method making the configured sampler for one pass over the image.
+         * Global samplers are made large enough to continue from
+         * first_sample, while pixel samplers draw fresh randomized samples
+         * and always start from zero. The stratified sampler rounds the
+         * number of samples per pixel to a square, so the number of samples
+         * each pixel takes is the sampler's samples_per_pixel() minus
+         * first_sample, which may differ from samples_per_pixel.
+         *
+         * \param first_sample Number of samples already taken for each
+         * sampled pixel. Set to the index of the first sample to draw from
+         * the sampler.
+         * \param samples_per_pixel Number of samples to take per pixel.
+         *
+         * \returns The sampler.
          */
-        Vector3d ray_color(const Ray& r, int depth);
+        std::unique_ptr<Sampler> make_pass_sampler_(int& first_sample, int
+            samples_per_pixel) const;
+
+        /*!
+         * Method rendering samples for pixels of a film tile, using the
+         * sampler made by make_pass_sampler_().
+         *
+         * \param tile The tile to render into.
+         * \param first_sample Number of samples already taken for each
+         * sampled pixel, so that low-discrepancy samplers continue their
+         * sequences across passes.
+         * \param samples_per_pixel Number of samples to take per pixel.
+         * \param active Mask of pixels to sample, indexed by raster
+         * coordinates as y * image_width + x, or nullptr to sample all.
+         *
+         * \returns The number of samples taken.
+         */
+        unsigned long render_tile_(FilmTile& tile, int first_sample, int
+            samples_per_pixel, const std::vector<bool>* active);
+
+        /*!
+         * Method estimating the relative cost of rendering each tile, by
+         * timing a coarse grid of paths traced through it.
+         *
+         * \param film The film that tiles belong to.
+         * \param tiles Coordinates of tiles to estimate costs for.
+         * \param num_threads Number of threads to use.
+         *
+         * \returns Estimated cost of each tile, in seconds.
+         */
+        std::vector<double> estimate_tile_costs_(const Film& film, const
+            std::vector<std::pair<int, int>>& tiles, unsigned int num_threads);
+
+        /*!
+         * Method estimating light arriving directly from lights_ at a hit
+         * point, by tracing a ray towards a random point on a light. The
+         * estimate is weighted by the power heuristic against sampling the
+         * same direction with the material's scatter().
+         *
+         * \param r_in Ray which hit the point.
+         * \param rec Hit record for the point.
+         * \param rng Random number generator for sampling the light.
+         *
+         * \returns Scattered light arriving directly from lights.
+         */
+        Vector3d sample_light_(const Ray& r_in, const hit_record& rec, Rng& rng);
+
+        /*!
+         * Method reseeding a generator deterministically for a pixel and
+         * sample number, so that renders do not depend on which thread
+         * takes each sample.
+         *
+         * \param rng The generator to seed.
+         * \param px The pixel being sampled.
+         * \param sample_num Index of the sample within the pixel.
+         */
+        void seed_rng_(Rng& rng, const Vector2i& px, uint64_t sample_num) const;
+
+        /*!
+         * Method recording every GridMedium in a hierarchy of Hittables,
+         * looking through LinearBvh, HittableList, and Instance, so that
+         * their transmittance can be estimated along shadow rays.
+         *
+         * \param hittable Root of the hierarchy.
+         * \param world_to_parent Transform from world space to the space the
+         * root is placed in.
+         */
+        void collect_media_(const HittablePtr& hittable, const Affine3d& world_to_parent);
+
+        /*!
+         * Method estimating the transmittance of media along a shadow ray by
+         * ratio tracking.
+         *
+         * \param r The shadow ray.
+         * \param t_max Distance along the ray to the light.
+         * \param rng Random number generator for sampling collisions.
+         *
+         * \returns Product of the transmittance estimates of every medium.
+         */
+        double transmittance_(const Ray& r, double t_max, Rng& rng) const;
+
+        static constexpr int tile_cost_grid_size = 4; //!< Side length of grid of paths traced to estimate tile cost
+        static constexpr uint64_t pixel_seed_bit = uint64_t(1) << 63; //!< Set in seed_rng_ sample numbers when seeding per-pixel sampler setup
 
         raytracer_params params_; //!< Rendering parameters
         HittablePtr world_; //!< World geometry
+        HittablePtr lights_; //!< Light geometry for next event estimation, or null
+        std::vector<std::pair<Affine3d, GridMediumPtr>> media_; //!< Grid media in the world, with their world to object transforms
         Camera camera_; //!< Rendering camera
         Vector3d background_; //!< Background color for rendering
 
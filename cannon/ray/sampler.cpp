@@ -1,5 +1,9 @@
 #include <cannon/ray/sampler.hpp>
 
+#include <cmath>
+#include <random>
+#include <stdexcept>
+
 #include <cannon/ray/camera.hpp>
 #include <cannon/utils/statistics.hpp>
 #include <cannon/math/random_double.hpp>
@@ -31,6 +35,10 @@ unsigned int Sampler::round_count(unsigned int n) const {
   return n;
 }
 
+unsigned int Sampler::samples_per_pixel() const {
+  return samples_per_pixel_;
+}
+
 void Sampler::start_pixel(const Vector2i& p) {
   current_pixel_ = p; 
   current_pixel_sample_idx_ = 0;
@@ -123,7 +131,7 @@ void GlobalSampler::start_pixel(const Vector2i& p) {
   for (size_t i = 0; i < samples_1d_array_sizes_.size(); ++i) {
     int n_samples = samples_1d_array_sizes_[i] * samples_per_pixel_;
     for (int j = 0; j < n_samples; ++j) {
-      unsigned int index = get_index_for_sample(j);
+      uint64_t index = get_index_for_sample(j);
       sample_array_1d_[i][j] = sample_dimension_(index, array_start_dim_ + i);
     }
   }
@@ -132,9 +140,9 @@ void GlobalSampler::start_pixel(const Vector2i& p) {
   for (size_t i = 0; i < samples_2d_array_sizes_.size(); ++i) {
     int n_samples = samples_2d_array_sizes_[i] * samples_per_pixel_;
     for (int j = 0; j < n_samples; ++j) {
-      unsigned int index = get_index_for_sample(j);
+      uint64_t index = get_index_for_sample(j);
       sample_array_2d_[i][j].x() = sample_dimension_(index, dim);
-      sample_array_2d_[i][j].y() = sample_dimension_(index, dim);
+      sample_array_2d_[i][j].y() = sample_dimension_(index, dim + 1);
     }
     dim += 2;
   }
@@ -266,3 +274,263 @@ void StratifiedSampler::latin_hypercube_(std::vector<double> &sample_vec,
     }
   }
 }
+
+HaltonSampler::HaltonSampler(unsigned int samples_per_pixel, const Vector2i&
+    resolution) : GlobalSampler(samples_per_pixel),
+  radical_inverse_permutations_(radical_inverse_permutations()) {
+  // Find powers of 2 and 3 covering the image, so that every pixel in a
+  // max_resolution_ square gets a distinct subsequence of samples
+  for (int i = 0; i < 2; i++) {
+    int base = (i == 0) ? 2 : 3;
+    int scale = 1, exp = 0;
+    while (scale < std::min(resolution[i], max_resolution_)) {
+      scale *= base;
+      ++exp;
+    }
+
+    base_scales_[i] = scale;
+    base_exponents_[i] = exp;
+  }
+
+  sample_stride_ = static_cast<uint64_t>(base_scales_[0]) * base_scales_[1];
+
+  mult_inverse_[0] = multiplicative_inverse(base_scales_[1], base_scales_[0]);
+  mult_inverse_[1] = multiplicative_inverse(base_scales_[0], base_scales_[1]);
+}
+
+STAT_COUNTER("Sampler/Halton Sampler pixels", nHaltonPixels);
+
+uint64_t HaltonSampler::get_index_for_sample(unsigned int sample_num) const {
+  if (sample_num == 0)
+    ++nHaltonPixels;
+
+  // The first two dimensions place sample i in pixel (i mod 2^j, i mod 3^k)
+  // when scaled by base_scales_, so the pixel's offset within the sequence
+  // is found by the Chinese remainder theorem
+  uint64_t offset_for_current_pixel = 0;
+  if (sample_stride_ > 1) {
+    Vector2i pm(current_pixel_[0] % max_resolution_, current_pixel_[1] % max_resolution_);
+    for (int i = 0; i < 2; i++) {
+      uint64_t dim_offset = (i == 0) ?
+        inverse_radical_inverse(2, pm[i], base_exponents_[i]) :
+        inverse_radical_inverse(3, pm[i], base_exponents_[i]);
+
+      offset_for_current_pixel += dim_offset * (sample_stride_ /
+          base_scales_[i]) * mult_inverse_[i];
+    }
+
+    offset_for_current_pixel %= sample_stride_;
+  }
+
+  return offset_for_current_pixel + sample_num * sample_stride_;
+}
+
+double HaltonSampler::sample_dimension_(uint64_t index, unsigned int
+    dimension) const {
+  if (dimension == 0)
+    return radical_inverse(dimension, index >> base_exponents_[0]);
+  else if (dimension == 1)
+    return radical_inverse(dimension, index / base_scales_[1]);
+  else if (dimension < prime_table_size)
+    return scrambled_radical_inverse(dimension, index,
+        &radical_inverse_permutations_[prime_sums[dimension]]);
+  else
+    return random_double();
+}
+
+SobolSampler::SobolSampler(unsigned int samples_per_pixel, const Vector2i&
+    resolution) : GlobalSampler(samples_per_pixel), log2_resolution_(0),
+  resolution_(1) {
+  while (resolution_ < static_cast<unsigned int>(std::max(resolution.x(), resolution.y()))) {
+    resolution_ <<= 1;
+    ++log2_resolution_;
+  }
+
+  unsigned int log2_spp = 0;
+  while ((1u << log2_spp) < samples_per_pixel)
+    ++log2_spp;
+
+  if (2 * log2_resolution_ + log2_spp > sobol_matrix_size)
+    throw std::runtime_error("Image resolution and samples per pixel too large for SobolSampler");
+
+  // Index bits [m, 2m) select the pixel row for a given pixel column, so the
+  // top m digits they contribute to the second dimension form an m x m
+  // matrix. It is invertible, since the first two Sobol dimensions form a
+  // (0,2)-sequence. Invert it by Gauss-Jordan elimination over GF(2), where
+  // each row is stored as a bitmask over the m index bits.
+  unsigned int m = log2_resolution_;
+  const uint32_t* c1 = sobol_matrix(1);
+
+  std::vector<uint32_t> rows(m, 0);
+  pixel_index_inverse_.assign(m, 0);
+  for (unsigned int r = 0; r < m; r++) {
+    for (unsigned int k = 0; k < m; k++) {
+      if ((c1[m + k] >> (31 - r)) & 1)
+        rows[r] |= 1u << k;
+    }
+    pixel_index_inverse_[r] = 1u << r;
+  }
+
+  for (unsigned int col = 0; col < m; col++) {
+    unsigned int pivot = col;
+    while (pivot < m && !((rows[pivot] >> col) & 1))
+      ++pivot;
+
+    if (pivot == m)
+      throw std::runtime_error("Sobol pixel matrix is singular");
+
+    std::swap(rows[col], rows[pivot]);
+    std::swap(pixel_index_inverse_[col], pixel_index_inverse_[pivot]);
+
+    for (unsigned int r = 0; r < m; r++) {
+      if (r != col && ((rows[r] >> col) & 1)) {
+        rows[r] ^= rows[col];
+        pixel_index_inverse_[r] ^= pixel_index_inverse_[col];
+      }
+    }
+  }
+}
+
+STAT_COUNTER("Sampler/Sobol Sampler pixels", nSobolPixels);
+
+uint64_t SobolSampler::get_index_for_sample(unsigned int sample_num) const {
+  if (sample_num == 0)
+    ++nSobolPixels;
+
+  unsigned int m = log2_resolution_;
+  if (m == 0)
+    return sample_num;
+
+  // The first dimension is the van der Corput sequence, so the pixel column
+  // fixes the low m index bits directly
+  uint64_t px = current_pixel_.x();
+  uint64_t py = current_pixel_.y();
+  uint64_t index = static_cast<uint64_t>(sample_num) << (2 * m);
+  for (unsigned int j = 0; j < m; j++) {
+    if ((px >> (m - 1 - j)) & 1)
+      index |= uint64_t(1) << j;
+  }
+
+  // Remove the contribution of every other index bit to the pixel row, then
+  // solve for the remaining bits
+  const uint32_t* c1 = sobol_matrix(1);
+  uint32_t row_digits = 0;
+  for (unsigned int j = 0; j < sobol_matrix_size; j++) {
+    if ((index >> j) & 1)
+      row_digits ^= c1[j];
+  }
+
+  uint32_t target = static_cast<uint32_t>(py) ^ (row_digits >> (32 - m));
+
+  uint64_t b = 0;
+  for (unsigned int r = 0; r < m; r++) {
+    // Row r of the solution pairs with pixel row digit r, most significant
+    // first
+    uint32_t t = 0;
+    for (unsigned int k = 0; k < m; k++) {
+      if ((pixel_index_inverse_[r] >> k) & 1)
+        t ^= (target >> (m - 1 - k)) & 1;
+    }
+    b |= static_cast<uint64_t>(t) << r;
+  }
+
+  return index | (b << m);
+}
+
+double SobolSampler::sample_dimension_(uint64_t index, unsigned int
+    dimension) const {
+  if (dimension >= sobol_dimensions)
+    return random_double();
+
+  double v = fixed_to_double(sobol_sample(index, dimension));
+
+  // The first two dimensions cover the image, and are returned as offsets
+  // within the current pixel
+  if (dimension < 2) {
+    v = v * resolution_ - current_pixel_[dimension];
+    return std::min(std::max(v, 0.0), ONE_MINUS_EPSILON);
+  }
+
+  // Later dimensions get a fixed random digital shift, which keeps their
+  // stratification but decorrelates them from the pixel grid
+  static const std::vector<uint32_t> shifts = []() {
+    std::vector<uint32_t> s(sobol_dimensions);
+    std::mt19937 rng(1);
+    for (auto& shift : s)
+      shift = rng();
+    return s;
+  }();
+
+  return fixed_to_double(sobol_sample(index, dimension) ^ shifts[dimension]);
+}
+
+ZeroTwoSequenceSampler::ZeroTwoSequenceSampler(unsigned int
+    samples_per_pixel, unsigned int n_sampled_dimensions) :
+  PixelSampler(samples_per_pixel, n_sampled_dimensions) {}
+
+STAT_COUNTER("Sampler/(0,2)-Sequence Sampler pixels", nZeroTwoPixels);
+
+void ZeroTwoSequenceSampler::start_pixel(const Vector2i& p) {
+  ++nZeroTwoPixels;
+
+  for (size_t i = 0; i < samples_1d_.size(); ++i)
+    sample_1d_(&samples_1d_[i][0], samples_per_pixel_);
+
+  for (size_t i = 0; i < samples_2d_.size(); ++i)
+    sample_2d_(&samples_2d_[i][0], samples_per_pixel_);
+
+  // Each array is its own (0,2)-sequence prefix, so that the samples of
+  // each array are well distributed
+  for (size_t i = 0; i < samples_1d_array_sizes_.size(); ++i) {
+    unsigned int count = samples_1d_array_sizes_[i];
+    for (unsigned int j = 0; j < samples_per_pixel_; ++j)
+      sample_1d_(&sample_array_1d_[i][j * count], count);
+  }
+
+  for (size_t i = 0; i < samples_2d_array_sizes_.size(); ++i) {
+    unsigned int count = samples_2d_array_sizes_[i];
+    for (unsigned int j = 0; j < samples_per_pixel_; ++j)
+      sample_2d_(&sample_array_2d_[i][j * count], count);
+  }
+
+  PixelSampler::start_pixel(p);
+}
+
+void ZeroTwoSequenceSampler::sample_1d_(double *samples, unsigned int n_samples) {
+  uint32_t seed = static_cast<uint32_t>(random_double() * 4294967296.0);
+  for (unsigned int i = 0; i < n_samples; ++i)
+    samples[i] = fixed_to_double(owen_scramble(sobol_sample(i, 0), seed));
+
+  shuffle_(samples, n_samples, 1);
+}
+
+void ZeroTwoSequenceSampler::sample_2d_(Vector2d *samples, unsigned int n_samples) {
+  uint32_t seed_x = static_cast<uint32_t>(random_double() * 4294967296.0);
+  uint32_t seed_y = static_cast<uint32_t>(random_double() * 4294967296.0);
+  for (unsigned int i = 0; i < n_samples; ++i) {
+    samples[i].x() = fixed_to_double(owen_scramble(sobol_sample(i, 0), seed_x));
+    samples[i].y() = fixed_to_double(owen_scramble(sobol_sample(i, 1), seed_y));
+  }
+
+  shuffle_(samples, n_samples, 1);
+}
+
+// Free functions
+
+std::unique_ptr<Sampler> cannon::ray::make_sampler(const std::string& type,
+    unsigned int samples_per_pixel, const Vector2i& resolution) {
+  samples_per_pixel = std::max(samples_per_pixel, 1u);
+
+  if (type == "stratified") {
+    unsigned int rounded_sqrt_samples = std::max(1.0, std::round(std::sqrt(samples_per_pixel)));
+    return std::make_unique<StratifiedSampler>(rounded_sqrt_samples, rounded_sqrt_samples, true, 2);
+  } else if (type == "halton") {
+    return std::make_unique<HaltonSampler>(samples_per_pixel, resolution);
+  } else if (type == "sobol") {
+    return std::make_unique<SobolSampler>(samples_per_pixel, resolution);
+  } else if (type == "zerotwo") {
+    return std::make_unique<ZeroTwoSequenceSampler>(samples_per_pixel, 2);
+  } else {
+    throw std::runtime_error("Unknown sampler type " + type);
+  }
+}
@@ -7,10 +7,16 @@
  * functions.
  */
 
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
 #include <Eigen/Dense>
 
 #include <cannon/utils/class_forward.hpp>
 #include <cannon/math/random_double.hpp>
+#include <cannon/ray/low_discrepancy.hpp>
 
 using namespace Eigen;
 
@@ -135,6 +141,11 @@ namespace cannon {
          */
         virtual unsigned int round_count(unsigned int n) const;
 
+        /*!
+         * \brief Get the number of samples this sampler generates per pixel.
+         */
+        unsigned int samples_per_pixel() const;
+
       protected:
         const unsigned int samples_per_pixel_; //!< Samples to generate per pixel
         Vector2i current_pixel_; //!< Current pixel for sampling
@@ -186,6 +197,25 @@ namespace cannon {
         virtual Vector2d get_2d() override;
 
       protected:
+        /*!
+         * \brief Randomly shuffle entries of the input vector, which contains the input
+         * count number of elements with the input number of dimensions.
+         *
+         * \param sample_vec The vector to shuffle
+         * \param count The number of elements to shuffle
+         * \param n_dims The number of dimensions in each shuffled element.
+         */
+        template <typename T>
+        void shuffle_(T *sample_vec, unsigned int count, unsigned int n_dims) {
+          for (size_t i = 0; i < count; ++i) {
+            unsigned int other = i + std::floor(random_double(0.0, count - i));
+            for (unsigned int j = 0; j < n_dims; ++j) {
+              std::swap(sample_vec[n_dims * i + j],
+                        sample_vec[n_dims * other + j]);
+            }
+          }
+        }
+
         std::vector<std::vector<double>> samples_1d_; //!< Cached 1d samples for the current pixel
         std::vector<std::vector<Vector2d>> samples_2d_; //!< Cached 2d samples for the current pixel
         unsigned int current_1d_dim_ = 0; //!< Current offset into 1d samples
@@ -213,7 +243,7 @@ namespace cannon {
          *
          * \returns Global sample index.
          */
-        virtual unsigned int get_index_for_sample(unsigned int sample_num) const = 0;
+        virtual uint64_t get_index_for_sample(unsigned int sample_num) const = 0;
 
         /*!
          * \brief Get the input dimension of the input sample index.
@@ -223,7 +253,7 @@ namespace cannon {
          *
          * \returns Sampled value.
          */
-        virtual double sample_dimension_(unsigned int index, unsigned int dimension) const = 0;
+        virtual double sample_dimension_(uint64_t index, unsigned int dimension) const = 0;
 
         /*!
          * \brief Inherited from Sampler.
@@ -252,13 +282,18 @@ namespace cannon {
 
       private:
         unsigned int dimension_; //!< Next dimension that sampler will be asked to generate
-        unsigned int interval_sample_index_; //!< Global index of the current sample in the current pixel
+        uint64_t interval_sample_index_; //!< Global index of the current sample in the current pixel
 
         static const unsigned int array_start_dim_ = 5; //!< Start dimension for array samples
         unsigned int array_end_dim_; //!< End dimension for array samples
 
     };
 
+    /*!
+     * \brief Sampler generating stratified, jittered samples for each
+     * pixel. The number of samples per pixel is x_pixel_samples *
+     * y_pixel_samples.
+     */
     class StratifiedSampler : public PixelSampler {
       public:
         /*!
@@ -294,25 +329,6 @@ namespace cannon {
          */
         void stratified_sample_2d_(std::vector<Vector2d> &sample_vec, bool jitter);
 
-        /*!
-         * \brief Randomly shuffle entries of the input vector, which contains the input
-         * count number of elements with the input number of dimensions.
-         *
-         * \param sample_vec The vector to shuffle
-         * \param count The number of elements to shuffle
-         * \param n_dims The number of dimensions in each shuffled element.
-         */
-        template <typename T>
-        void shuffle_(T *sample_vec, unsigned int count, unsigned int n_dims) {
-          for (size_t i = 0; i < count; ++i) {
-            unsigned int other = i + std::floor(random_double(0.0, count - i));
-            for (unsigned int j = 0; j < n_dims; ++j) {
-              std::swap(sample_vec[n_dims * i + j],
-                        sample_vec[n_dims * other + j]);
-            }
-          }
-        }
-
         /*!
          * \brief Generate Latin Hypercube samples for stratified array sampling.
          *
@@ -329,6 +345,128 @@ namespace cannon {
 
     };
 
+    /*!
+     * \brief Global sampler using the Halton sequence, with digit-permuted
+     * radical inverses for dimensions beyond the first two. The first two
+     * dimensions are mapped to the image so that each pixel receives a
+     * well-distributed subsequence of samples, following PBRT. Supports any
+     * number of samples per pixel.
+     */
+    class HaltonSampler : public GlobalSampler {
+      public:
+        /*!
+         * \brief Constructor taking number of samples per pixel and image
+         * resolution.
+         */
+        HaltonSampler(unsigned int samples_per_pixel, const Vector2i& resolution);
+
+        /*!
+         * \brief Inherited from GlobalSampler.
+         */
+        uint64_t get_index_for_sample(unsigned int sample_num) const override;
+
+        /*!
+         * \brief Inherited from GlobalSampler. Dimensions past
+         * prime_table_size are sampled uniformly at random.
+         */
+        double sample_dimension_(uint64_t index, unsigned int dimension) const override;
+
+      private:
+        static constexpr int max_resolution_ = 128; //!< Resolution over which pixel offsets repeat
+
+        Vector2i base_scales_; //!< Powers of 2 and 3 covering the image, up to max_resolution_
+        Vector2i base_exponents_; //!< Exponents of base_scales_
+        uint64_t sample_stride_; //!< Number of samples between samples in the same pixel
+        uint64_t mult_inverse_[2]; //!< Multiplicative inverses for finding pixel sample offsets
+        const std::vector<uint16_t>& radical_inverse_permutations_; //!< Digit permutations for each dimension
+
+    };
+
+    /*!
+     * \brief Global sampler using the Sobol sequence. The first two
+     * dimensions cover the image, rounded up to a power of two, and the
+     * sample index for each pixel is found by solving for the index bits
+     * that place a sample in that pixel. Remaining dimensions are randomized
+     * with a fixed digital shift. Supports any number of samples per pixel,
+     * as long as resolution^2 * samples_per_pixel fits in 32 bits.
+     */
+    class SobolSampler : public GlobalSampler {
+      public:
+        /*!
+         * \brief Constructor taking number of samples per pixel and image
+         * resolution.
+         */
+        SobolSampler(unsigned int samples_per_pixel, const Vector2i& resolution);
+
+        /*!
+         * \brief Inherited from GlobalSampler.
+         */
+        uint64_t get_index_for_sample(unsigned int sample_num) const override;
+
+        /*!
+         * \brief Inherited from GlobalSampler. Dimensions past
+         * sobol_dimensions are sampled uniformly at random.
+         */
+        double sample_dimension_(uint64_t index, unsigned int dimension) const override;
+
+      private:
+        unsigned int log2_resolution_; //!< Log base 2 of the resolution covered by the first two dimensions
+        unsigned int resolution_; //!< Resolution covered by the first two dimensions
+        std::vector<uint32_t> pixel_index_inverse_; //!< Inverse of the matrix mapping index bits to pixel rows
+
+    };
+
+    /*!
+     * \brief Pixel sampler using Owen-scrambled (0,2)-sequences, i.e. the
+     * van der Corput sequence for one-dimensional samples and the first two
+     * Sobol dimensions for two-dimensional samples. Each dimension of each
+     * pixel is scrambled independently, and samples are shuffled between
+     * dimensions to avoid correlation. Any prefix of a (0,2)-sequence is well
+     * distributed, so any number of samples per pixel is supported.
+     */
+    class ZeroTwoSequenceSampler : public PixelSampler {
+      public:
+        /*!
+         * \brief Constructor taking number of samples per pixel and the
+         * number of sampled dimensions to be generated.
+         */
+        ZeroTwoSequenceSampler(unsigned int samples_per_pixel, unsigned int
+            n_sampled_dimensions);
+
+        /*!
+         * \brief Inherited from Sampler.
+         */
+        void start_pixel(const Vector2i& p) override;
+
+      private:
+
+        /*!
+         * \brief Generate Owen-scrambled 1D (0,2)-sequence samples.
+         */
+        void sample_1d_(double *samples, unsigned int n_samples);
+
+        /*!
+         * \brief Generate Owen-scrambled 2D (0,2)-sequence samples.
+         */
+        void sample_2d_(Vector2d *samples, unsigned int n_samples);
+
+    };
+
+    // Free functions
+
+    /*!
+     * Make a sampler by name.
+     *
+     * \param type One of "stratified", "halton", "sobol", or "zerotwo".
+     * \param samples_per_pixel Number of samples per pixel. The stratified
+     * sampler rounds this to the nearest square.
+     * \param resolution Resolution of the image to be sampled.
+     *
+     * \returns The sampler.
+     */
+    std::unique_ptr<Sampler> make_sampler(const std::string& type, unsigned
+        int samples_per_pixel, const Vector2i& resolution);
+
   }
 }
 
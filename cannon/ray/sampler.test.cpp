@@ -1,9 +1,60 @@
+#include <vector>
+#include <algorithm>
+
 #include <catch2/catch.hpp>
 
 #include <cannon/ray/sampler.hpp>
+#include <cannon/ray/camera.hpp>
 
 using namespace cannon::ray;
 
 TEST_CASE("Sampler", "[ray]") {
+  Vector2i resolution(13, 7);
+
+  for (std::string type : {"stratified", "halton", "sobol", "zerotwo"}) {
+    auto sampler = make_sampler(type, 16, resolution);
+    REQUIRE(sampler->samples_per_pixel() == 16);
+
+    for (int x = 0; x < resolution.x(); x++) {
+      for (int y = 0; y < resolution.y(); y++) {
+        Vector2i px(x, y);
+        sampler->start_pixel(px);
+
+        // Camera samples should land in the pixel and spread over it
+        std::vector<int> quadrants(4, 0);
+        do {
+          auto sample = sampler->get_camera_sample(px);
+          Vector2d offset = sample.p_film - px.cast<double>();
+          REQUIRE(offset.x() >= 0.0);
+          REQUIRE(offset.x() < 1.0);
+          REQUIRE(offset.y() >= 0.0);
+          REQUIRE(offset.y() < 1.0);
+          REQUIRE(sample.time >= 0.0);
+          REQUIRE(sample.time < 1.0);
+
+          quadrants[2 * (offset.x() >= 0.5) + (offset.y() >= 0.5)]++;
+        } while (sampler->start_next_sample());
+
+        REQUIRE(std::all_of(quadrants.begin(), quadrants.end(), [](int c) { return c > 0; }));
+      }
+    }
+  }
+
+  // Stratified samplers round to a square, others take any count
+  REQUIRE(make_sampler("stratified", 10, resolution)->samples_per_pixel() == 9);
+  REQUIRE(make_sampler("halton", 10, resolution)->samples_per_pixel() == 10);
+  REQUIRE(make_sampler("sobol", 10, resolution)->samples_per_pixel() == 10);
+  REQUIRE(make_sampler("zerotwo", 10, resolution)->samples_per_pixel() == 10);
+
+  REQUIRE_THROWS(make_sampler("uniform", 16, resolution));
+  REQUIRE_THROWS(make_sampler("sobol", 1 << 20, Vector2i(4096, 4096)));
 
+  // Global samplers can continue from any sample number
+  SobolSampler sobol(32, resolution);
+  Vector2i px(5, 3);
+  sobol.start_pixel(px);
+  sobol.set_sample_number(20);
+  Vector2d p = sobol.get_2d();
+  REQUIRE(p.x() >= 0.0);
+  REQUIRE(p.x() < 1.0);
 }
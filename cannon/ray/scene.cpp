@@ -0,0 +1,366 @@
+#include <cannon/ray/scene.hpp>
+
+#include <fstream>
+#include <stdexcept>
+
+#include <cannon/ray/aa_rect.hpp>
+#include <cannon/ray/constant_medium.hpp>
+#include <cannon/ray/grid_medium.hpp>
+#include <cannon/ray/hittable_list.hpp>
+#include <cannon/ray/instance.hpp>
+#include <cannon/ray/linear_bvh.hpp>
+#include <cannon/ray/material.hpp>
+#include <cannon/ray/mesh.hpp>
+#include <cannon/ray/moving_sphere.hpp>
+#include <cannon/ray/sphere.hpp>
+#include <cannon/ray/texture.hpp>
+
+using namespace cannon::ray;
+
+/*!
+ * Get a required parameter of a scene element.
+ */
+template <typename T>
+static T get_param(const YAML::Node& node, const std::string& param) {
+  if (!node[param])
+    throw std::runtime_error("Could not get param " + param + " in scene description");
+
+  return node[param].as<T>();
+}
+
+/*!
+ * Get an optional parameter of a scene element.
+ */
+template <typename T>
+static T get_param_or(const YAML::Node& node, const std::string& param, const T& default_value) {
+  if (!node[param])
+    return default_value;
+
+  return node[param].as<T>();
+}
+
+/*!
+ * Read a vector given as a sequence [x, y, z] or a map with keys x, y, z.
+ */
+static Vector3d read_vector(const YAML::Node& node) {
+  if (node.IsSequence()) {
+    if (node.size() != 3)
+      throw std::runtime_error("Vectors in scene description must have three elements");
+
+    return Vector3d(node[0].as<double>(), node[1].as<double>(), node[2].as<double>());
+  }
+
+  if (node.IsMap())
+    return Vector3d(get_param<double>(node, "x"), get_param<double>(node,
+          "y"), get_param<double>(node, "z"));
+
+  throw std::runtime_error("Expected vector in scene description");
+}
+
+/*!
+ * Get a required vector parameter of a scene element.
+ */
+static Vector3d get_vector(const YAML::Node& node, const std::string& param) {
+  if (!node[param])
+    throw std::runtime_error("Could not get param " + param + " in scene description");
+
+  return read_vector(node[param]);
+}
+
+/*!
+ * Get a required grid resolution parameter, given as one count for every
+ * axis or as a vector of counts.
+ */
+static Vector3i get_resolution(const YAML::Node& node, const std::string& param) {
+  if (node[param] && node[param].IsScalar())
+    return Vector3i::Constant(node[param].as<int>());
+
+  return get_vector(node, param).cast<int>();
+}
+
+/*!
+ * Read a grid of single-precision floats stored as raw native-endian
+ * binary, with x varying fastest.
+ */
+static std::vector<float> read_grid(const std::string& path, const Vector3i& resolution) {
+  std::vector<float> values(static_cast<size_t>(resolution.x()) * resolution.y() * resolution.z());
+
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+    throw std::runtime_error("Could not open grid file " + path);
+
+  file.read(reinterpret_cast<char*>(values.data()), values.size() * sizeof(float));
+  if (file.gcount() != static_cast<std::streamsize>(values.size() * sizeof(float)))
+    throw std::runtime_error("Grid file " + path + " is smaller than its resolution");
+
+  return values;
+}
+
+/*!
+ * Read an object transform, applying scale, then rotation, then translation.
+ */
+static std::shared_ptr<Affine3d> read_transform(const YAML::Node& node) {
+  auto t = std::make_shared<Affine3d>(Affine3d::Identity());
+
+  if (node["translate"])
+    t->translate(read_vector(node["translate"]));
+
+  if (node["rotate"]) {
+    YAML::Node rotate = node["rotate"];
+    t->rotate(AngleAxisd(get_param<double>(rotate, "angle"),
+          get_vector(rotate, "axis").normalized()));
+  }
+
+  if (node["scale"]) {
+    if (node["scale"].IsScalar())
+      t->scale(node["scale"].as<double>());
+    else
+      t->scale(read_vector(node["scale"]));
+  }
+
+  return t;
+}
+
+Scene::Scene(const std::string& filename, double time_0, double time_1,
+    unsigned int num_threads) : time_0_(time_0), time_1_(time_1),
+  num_threads_(num_threads) {
+  size_t slash = filename.find_last_of('/');
+  directory_ = slash == std::string::npos ? "" : filename.substr(0, slash + 1);
+
+  YAML::Node config;
+  try {
+    config = YAML::LoadFile(filename);
+  } catch (const YAML::Exception& e) {
+    throw std::runtime_error("Could not load scene file " + filename + ": " + e.what());
+  }
+
+  load_(config);
+}
+
+Scene::Scene(const YAML::Node& config, const std::string& directory, double
+    time_0, double time_1, unsigned int num_threads) : directory_(directory),
+  time_0_(time_0), time_1_(time_1), num_threads_(num_threads) {
+  if (!directory_.empty() && directory_.back() != '/')
+    directory_ += '/';
+
+  load_(config);
+}
+
+void Scene::load_(const YAML::Node& config) {
+  std::string accelerator = get_param_or<std::string>(config, "accelerator", "linear");
+  if (accelerator == "linear")
+    mesh_bvh_type_ = BvhType::Linear;
+  else if (accelerator == "compressed")
+    mesh_bvh_type_ = BvhType::Compressed;
+  else
+    throw std::runtime_error("Unknown accelerator " + accelerator);
+
+  // Textures may refer to textures defined before them, so they are loaded
+  // in order
+  for (const auto& entry : config["textures"])
+    textures_[entry.first.as<std::string>()] = make_texture_(entry.second);
+
+  for (const auto& entry : config["materials"])
+    materials_[entry.first.as<std::string>()] = make_material_(entry.second);
+
+  for (const auto& entry : config["meshes"])
+    meshes_[entry.first.as<std::string>()] = make_mesh_(entry.second);
+
+  auto objects = std::make_shared<HittableList>();
+  for (const auto& node : config["objects"]) {
+    auto object = make_object_(node);
+    objects->add(object);
+
+    if (get_param_or<bool>(node, "light", false)) {
+      if (!lights_)
+        lights_ = std::make_shared<HittableList>();
+      lights_->add(object);
+    }
+  }
+
+  if (objects->objects_.empty())
+    throw std::runtime_error("Scene description has no objects");
+
+  world_ = std::make_shared<LinearBvh>(std::make_shared<Affine3d>(Affine3d::Identity()),
+      objects, time_0_, time_1_, 4, num_threads_);
+}
+
+TexturePtr Scene::make_texture_(const YAML::Node& node) const {
+  std::string type = get_param<std::string>(node, "type");
+
+  if (type == "solid")
+    return std::make_shared<SolidColor>(get_vector(node, "color"));
+  else if (type == "checker")
+    return std::make_shared<CheckerTexture>(get_texture_(node["even"]), get_texture_(node["odd"]));
+  else if (type == "noise") {
+    auto noise = std::make_shared<NoiseTexture>(get_param<double>(node, "scale"));
+    if (node["bake"]) {
+      YAML::Node bake = node["bake"];
+      noise->bake(get_vector(bake, "min"), get_vector(bake, "max"), get_resolution(bake, "resolution"));
+    }
+
+    return noise;
+  }
+  else if (type == "image") {
+    std::string filter_name = get_param_or<std::string>(node, "filter", "ewa");
+    TextureFilter filter;
+    if (filter_name == "bilinear")
+      filter = TextureFilter::Bilinear;
+    else if (filter_name == "trilinear")
+      filter = TextureFilter::Trilinear;
+    else if (filter_name == "ewa")
+      filter = TextureFilter::EWA;
+    else
+      throw std::runtime_error("Unknown texture filter " + filter_name);
+
+    return std::make_shared<ImageTexture>(resolve_path_(get_param<std::string>(node, "file")),
+        filter, get_param_or<double>(node, "max_anisotropy", 8.0));
+  }
+
+  throw std::runtime_error("Unknown texture type " + type);
+}
+
+TexturePtr Scene::get_texture_(const YAML::Node& node) const {
+  if (!node)
+    throw std::runtime_error("Missing color or texture in scene description");
+
+  if (node.IsScalar()) {
+    std::string name = node.as<std::string>();
+    auto it = textures_.find(name);
+    if (it == textures_.end())
+      throw std::runtime_error("Unknown texture " + name);
+
+    return it->second;
+  }
+
+  return std::make_shared<SolidColor>(read_vector(node));
+}
+
+MaterialPtr Scene::make_material_(const YAML::Node& node) const {
+  std::string type = get_param<std::string>(node, "type");
+
+  if (type == "lambertian")
+    return std::make_shared<Lambertian>(get_texture_(node["albedo"]));
+  else if (type == "metal")
+    return std::make_shared<Metal>(get_vector(node, "albedo"), get_param_or<double>(node, "fuzz", 0.0));
+  else if (type == "dielectric")
+    return std::make_shared<Dielectric>(get_param<double>(node, "ir"));
+  else if (type == "diffuse_light")
+    return std::make_shared<DiffuseLight>(get_texture_(node["emit"]));
+  else if (type == "isotropic")
+    return std::make_shared<Isotropic>(get_texture_(node["albedo"]));
+  else if (type == "normal_debug")
+    return std::make_shared<NormalDebug>();
+
+  throw std::runtime_error("Unknown material type " + type);
+}
+
+MaterialPtr Scene::get_material_(const YAML::Node& node) const {
+  std::string name = get_param<std::string>(node, "material");
+  auto it = materials_.find(name);
+  if (it == materials_.end())
+    throw std::runtime_error("Unknown material " + name);
+
+  return it->second;
+}
+
+LazyBvhPtr Scene::make_mesh_(const YAML::Node& node) const {
+  std::string path = resolve_path_(get_param<std::string>(node, "file"));
+  auto material = get_material_(node);
+
+  // Meshes stay in their own space, and are placed by instancing
+  auto t = std::make_shared<Affine3d>(Affine3d::Identity());
+
+  const std::string binary_extension = ".cmesh";
+  auto triangles = std::make_shared<HittableList>();
+  if (path.size() >= binary_extension.size() &&
+      path.compare(path.size() - binary_extension.size(), binary_extension.size(), binary_extension) == 0) {
+    triangles = make_mesh_triangle_list(load_mesh_binary(t, material, path));
+  } else {
+    for (auto& mesh : load_model(t, material, path)) {
+      auto mesh_triangles = make_mesh_triangle_list(mesh);
+      triangles->objects_.insert(triangles->objects_.end(),
+          mesh_triangles->objects_.begin(), mesh_triangles->objects_.end());
+    }
+  }
+
+  return std::make_shared<LazyBvh>(t, triangles, time_0_, time_1_, 4,
+      num_threads_, mesh_bvh_type_);
+}
+
+HittablePtr Scene::make_object_(const YAML::Node& node) const {
+  std::string type = get_param<std::string>(node, "type");
+
+  HittablePtr object;
+  if (type == "sphere") {
+    object = std::make_shared<Sphere>(get_vector(node, "center"),
+        get_param<double>(node, "radius"), get_material_(node));
+  } else if (type == "moving_sphere") {
+    object = std::make_shared<MovingSphere>(get_vector(node, "center_0"),
+        get_vector(node, "center_1"), get_param<double>(node, "time_0"),
+        get_param<double>(node, "time_1"), get_param<double>(node, "radius"),
+        get_material_(node));
+  } else if (type == "xy_rect") {
+    object = std::make_shared<XYRect>(get_param<double>(node, "x0"),
+        get_param<double>(node, "x1"), get_param<double>(node, "y0"),
+        get_param<double>(node, "y1"), get_param<double>(node, "k"),
+        get_material_(node));
+  } else if (type == "xz_rect") {
+    object = std::make_shared<XZRect>(get_param<double>(node, "x0"),
+        get_param<double>(node, "x1"), get_param<double>(node, "z0"),
+        get_param<double>(node, "z1"), get_param<double>(node, "k"),
+        get_material_(node));
+  } else if (type == "yz_rect") {
+    object = std::make_shared<YZRect>(get_param<double>(node, "y0"),
+        get_param<double>(node, "y1"), get_param<double>(node, "z0"),
+        get_param<double>(node, "z1"), get_param<double>(node, "k"),
+        get_material_(node));
+  } else if (type == "box") {
+    object = std::make_shared<Box>(std::make_shared<Affine3d>(Affine3d::Identity()),
+        get_vector(node, "min"), get_vector(node, "max"), get_material_(node));
+  } else if (type == "mesh") {
+    std::string name = get_param<std::string>(node, "mesh");
+    auto it = meshes_.find(name);
+    if (it == meshes_.end())
+      throw std::runtime_error("Unknown mesh " + name);
+
+    object = it->second;
+  } else if (type == "constant_medium") {
+    if (!node["boundary"])
+      throw std::runtime_error("Could not get param boundary in scene description");
+
+    object = std::make_shared<ConstantMedium>(make_object_(node["boundary"]),
+        get_param<double>(node, "density"), get_texture_(node["albedo"]));
+  } else if (type == "grid_medium") {
+    // Checked before the grid file is read, since its size follows from
+    // the resolution
+    Vector3i resolution = get_resolution(node, "resolution");
+    if ((resolution.array() < 2).any())
+      throw std::runtime_error("Grid medium resolution must be at least two along each axis");
+
+    Vector3i majorant_resolution = node["majorant_resolution"] ?
+      get_resolution(node, "majorant_resolution") : Vector3i::Constant(16);
+
+    object = std::make_shared<GridMedium>(get_vector(node, "min"),
+        get_vector(node, "max"), resolution,
+        read_grid(resolve_path_(get_param<std::string>(node, "file")), resolution),
+        get_param<double>(node, "density"), get_texture_(node["albedo"]),
+        majorant_resolution);
+  } else {
+    throw std::runtime_error("Unknown object type " + type);
+  }
+
+  // Transformed objects are instances, so that shared geometry such as
+  // meshes is never copied
+  if (node["transform"])
+    object = std::make_shared<Instance>(read_transform(node["transform"]), object);
+
+  return object;
+}
+
+std::string Scene::resolve_path_(const std::string& path) const {
+  if (path.empty() || path[0] == '/')
+    return path;
+
+  return directory_ + path;
+}
@@ -0,0 +1,161 @@
+#pragma once
+#ifndef CANNON_RAY_SCENE_H
+#define CANNON_RAY_SCENE_H
+
+/*!
+ * \file cannon/ray/scene.hpp
+ * \brief File containing Scene class definition, for loading scene
+ * descriptions from YAML.
+ */
+
+#include <map>
+#include <string>
+#include <memory>
+
+#include <Eigen/Dense>
+#include <yaml-cpp/yaml.h>
+
+#include <cannon/ray/hittable.hpp>
+#include <cannon/ray/linear_bvh.hpp>
+#include <cannon/utils/class_forward.hpp>
+
+using namespace Eigen;
+
+namespace cannon {
+  namespace ray {
+
+    CANNON_CLASS_FORWARD(Hittable);
+    CANNON_CLASS_FORWARD(HittableList);
+    CANNON_CLASS_FORWARD(LinearBvh);
+    CANNON_CLASS_FORWARD(LazyBvh);
+    CANNON_CLASS_FORWARD(Texture);
+    CANNON_CLASS_FORWARD(Material);
+
+    /*!
+     * \brief Class representing a scene loaded from a YAML description, so
+     * that scenes can be rendered without recompiling. A scene file has four
+     * optional top-level sections:
+     *
+     * - textures: map from name to texture, with a type of solid (color),
+     *   checker (even, odd), noise (scale, and optionally bake with min,
+     *   max, and resolution to bake turbulence onto a grid), or image (file,
+     *   and optionally filter of bilinear, trilinear, or ewa, and
+     *   max_anisotropy).
+     * - materials: map from name to material, with a type of lambertian
+     *   (albedo), metal (albedo, fuzz), dielectric (ir), diffuse_light
+     *   (emit), isotropic (albedo), or normal_debug. Colors may be given as
+     *   the name of a texture.
+     * - meshes: map from name to mesh (file, material). Files written by
+     *   write_mesh_binary() are memory-mapped; other files are loaded through
+     *   Assimp. Each mesh gets one LazyBvh, shared by every object using it
+     *   and built the first time a ray reaches it.
+     * - objects: list of objects, with a type of sphere (center, radius),
+     *   moving_sphere (center_0, center_1, time_0, time_1, radius), xy_rect
+     *   (x0, x1, y0, y1, k), xz_rect (x0, x1, z0, z1, k), yz_rect (y0, y1,
+     *   z0, z1, k), box (min, max), mesh (mesh), constant_medium
+     *   (boundary, density, albedo), or grid_medium (min, max, resolution,
+     *   file of raw floats with x varying fastest, density, albedo, and
+     *   optionally majorant_resolution). All but meshes and media take a
+     *   material. Any object may have a transform (translate, rotate with
+     *   axis and angle in radians, and scale, applied in the reverse of that
+     *   order), and may set light to true to be sampled directly.
+     *
+     * A top-level accelerator of compressed builds CompressedBvh rather
+     * than LinearBvh hierarchies over meshes, for scenes whose meshes are
+     * too large for the memory of a LinearBvh. The hierarchy over all
+     * objects stays a LinearBvh, which packet tracing and moving objects
+     * need.
+     *
+     * Vectors are given as sequences [x, y, z] or maps with keys x, y, z,
+     * and relative file paths are relative to the scene file.
+     */
+    class Scene {
+      public:
+
+        Scene() = delete;
+
+        /*!
+         * Constructor loading a scene from a YAML file.
+         *
+         * \param filename The scene file.
+         * \param time_0 Start time for bounding boxes.
+         * \param time_1 End time for bounding boxes.
+         * \param num_threads Number of threads to build hierarchies with.
+         */
+        Scene(const std::string& filename, double time_0 = 0.0, double time_1
+            = 1.0, unsigned int num_threads = 1);
+
+        /*!
+         * Constructor loading a scene from a parsed YAML description.
+         *
+         * \param config The scene description.
+         * \param directory Directory that relative file paths are relative to.
+         * \param time_0 Start time for bounding boxes.
+         * \param time_1 End time for bounding boxes.
+         * \param num_threads Number of threads to build hierarchies with.
+         */
+        Scene(const YAML::Node& config, const std::string& directory, double
+            time_0 = 0.0, double time_1 = 1.0, unsigned int num_threads = 1);
+
+      private:
+
+        /*!
+         * Load all sections of a scene description.
+         */
+        void load_(const YAML::Node& config);
+
+        /*!
+         * Make a texture from its description.
+         */
+        TexturePtr make_texture_(const YAML::Node& node) const;
+
+        /*!
+         * Get a texture from a color or the name of a texture.
+         */
+        TexturePtr get_texture_(const YAML::Node& node) const;
+
+        /*!
+         * Make a material from its description.
+         */
+        MaterialPtr make_material_(const YAML::Node& node) const;
+
+        /*!
+         * Get a material by name.
+         */
+        MaterialPtr get_material_(const YAML::Node& node) const;
+
+        /*!
+         * Make a bottom-level hierarchy over a mesh from its description.
+         */
+        LazyBvhPtr make_mesh_(const YAML::Node& node) const;
+
+        /*!
+         * Make an object from its description, including its transform.
+         */
+        HittablePtr make_object_(const YAML::Node& node) const;
+
+        /*!
+         * Resolve a file path relative to the scene file.
+         */
+        std::string resolve_path_(const std::string& path) const;
+
+      public:
+        LinearBvhPtr world_; //!< Hierarchy over all objects in the scene
+        HittableListPtr lights_; //!< Objects to sample directly, or nullptr if there are none
+
+        std::map<std::string, TexturePtr> textures_; //!< Named textures
+        std::map<std::string, MaterialPtr> materials_; //!< Named materials
+        std::map<std::string, LazyBvhPtr> meshes_; //!< Named mesh hierarchies
+
+      private:
+        std::string directory_; //!< Directory of the scene file
+        double time_0_, time_1_; //!< Time interval for bounding boxes
+        unsigned int num_threads_; //!< Number of threads to build hierarchies with
+        BvhType mesh_bvh_type_ = BvhType::Linear; //!< Kind of hierarchy to build over each mesh
+
+    };
+
+  } // namespace ray
+} // namespace cannon
+
+#endif /* ifndef CANNON_RAY_SCENE_H */
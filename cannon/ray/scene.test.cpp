@@ -0,0 +1,153 @@
+#include <cstdio>
+#include <filesystem>
+#include <limits>
+
+#include <catch2/catch.hpp>
+
+#include <cannon/ray/scene.hpp>
+#include <cannon/ray/hittable_list.hpp>
+#include <cannon/ray/linear_bvh.hpp>
+#include <cannon/ray/compressed_bvh.hpp>
+#include <cannon/ray/material.hpp>
+#include <cannon/ray/mesh.hpp>
+#include <cannon/ray/ray.hpp>
+
+using namespace cannon::ray;
+
+TEST_CASE("Scene", "[ray]") {
+  YAML::Node config = YAML::Load(R"(
+textures:
+  white: {type: solid, color: [0.73, 0.73, 0.73]}
+  checker: {type: checker, even: white, odd: [0.1, 0.1, 0.1]}
+materials:
+  floor: {type: lambertian, albedo: checker}
+  light: {type: diffuse_light, emit: {x: 15, y: 15, z: 15}}
+  glass: {type: dielectric, ir: 1.5}
+objects:
+  - {type: xz_rect, x0: -10, x1: 10, z0: -10, z1: 10, k: 0, material: floor}
+  - {type: xz_rect, x0: -1, x1: 1, z0: -1, z1: 1, k: 10, material: light, light: true}
+  - type: sphere
+    center: [0, 0, 0]
+    radius: 1
+    material: glass
+    transform: {translate: [0, 2, 0], scale: 0.5}
+)");
+
+  Scene scene(config, "");
+  REQUIRE(scene.textures_.size() == 2);
+  REQUIRE(scene.materials_.size() == 3);
+  REQUIRE(scene.lights_ != nullptr);
+  REQUIRE(scene.lights_->objects_.size() == 1);
+
+  hit_record rec;
+  Ray down(Vector3d(0, 5, 0), Vector3d(0, -1, 0));
+  REQUIRE(scene.world_->hit(down, 0.0, std::numeric_limits<double>::infinity(), rec));
+  REQUIRE(rec.t == Approx(2.5));
+  REQUIRE(rec.mat_ptr == scene.materials_["glass"].get());
+
+  Ray up(Vector3d(0, 5, 0), Vector3d(0, 1, 0));
+  REQUIRE(scene.world_->hit(up, 0.0, std::numeric_limits<double>::infinity(), rec));
+  REQUIRE(rec.t == Approx(5));
+  REQUIRE(rec.mat_ptr == scene.materials_["light"].get());
+
+  Ray aside(Vector3d(5, 5, 0), Vector3d(0, -1, 0));
+  REQUIRE(scene.world_->hit(aside, 0.0, std::numeric_limits<double>::infinity(), rec));
+  REQUIRE(rec.t == Approx(5));
+
+  REQUIRE_THROWS(Scene(YAML::Load("objects: [{type: sphere, center: [0, 0, 0], radius: 1, material: missing}]"), ""));
+  REQUIRE_THROWS(Scene(YAML::Load("objects: [{type: teapot}]"), ""));
+}
+
+TEST_CASE("Scene_mesh", "[ray]") {
+  MatrixX3d vertices(3, 3);
+  vertices << -1, 0, -1,
+              1, 0, -1,
+              0, 0, 1;
+  MatrixX3d normals = MatrixX3d::Zero(3, 3);
+  normals.col(1).setOnes();
+  MatrixX2d tex_coords = MatrixX2d::Zero(3, 2);
+  MatrixX3u indices(1, 3);
+  indices << 0, 1, 2;
+
+  auto directory = std::filesystem::temp_directory_path();
+  std::string path = (directory / "scene_test.cmesh").string();
+  write_mesh_binary(path, vertices, normals, tex_coords, indices);
+
+  YAML::Node config = YAML::Load(R"(
+materials:
+  gray: {type: lambertian, albedo: [0.5, 0.5, 0.5]}
+meshes:
+  triangle: {file: scene_test.cmesh, material: gray}
+objects:
+  - {type: mesh, mesh: triangle}
+  - {type: mesh, mesh: triangle, transform: {translate: [10, 0, 0]}}
+)");
+
+  Scene scene(config, directory.string());
+  REQUIRE(scene.meshes_.size() == 1);
+
+  // Mesh hierarchies are only built once a ray reaches them, and are
+  // shared between all instances of the mesh
+  auto mesh = scene.meshes_["triangle"];
+  REQUIRE(!mesh->is_built());
+
+  hit_record rec;
+  Ray miss(Vector3d(0, 5, 0), Vector3d(0, 1, 0));
+  REQUIRE(!scene.world_->hit(miss, 0.0, std::numeric_limits<double>::infinity(), rec));
+  REQUIRE(!mesh->is_built());
+
+  Ray r(Vector3d(10, 5, 0), Vector3d(0, -1, 0));
+  REQUIRE(scene.world_->hit(r, 0.0, std::numeric_limits<double>::infinity(), rec));
+  REQUIRE(rec.t == Approx(5));
+  REQUIRE(mesh->is_built());
+  REQUIRE(std::dynamic_pointer_cast<LinearBvh>(mesh->get()));
+
+  // Compressed mesh hierarchies are hit in the same places
+  config["accelerator"] = "compressed";
+  Scene compressed(config, directory.string());
+  hit_record compressed_rec;
+  REQUIRE(compressed.world_->hit(r, 0.0, std::numeric_limits<double>::infinity(), compressed_rec));
+  REQUIRE(compressed_rec.t == Approx(5));
+  REQUIRE(std::dynamic_pointer_cast<CompressedBvh>(compressed.meshes_["triangle"]->get()));
+
+  config["accelerator"] = "octree";
+  REQUIRE_THROWS(Scene(config, directory.string()));
+
+  std::remove(path.c_str());
+}
+
+TEST_CASE("Scene_grid_medium", "[ray]") {
+  std::string path = (std::filesystem::temp_directory_path() / "scene_grid_medium_test.raw").string();
+  std::vector<float> densities(8, 1e6f);
+  FILE* file = std::fopen(path.c_str(), "wb");
+  REQUIRE(file != nullptr);
+  REQUIRE(std::fwrite(densities.data(), sizeof(float), densities.size(), file) == densities.size());
+  std::fclose(file);
+
+  YAML::Node config = YAML::Load(R"(
+objects:
+  - type: grid_medium
+    min: [-1, -1, -1]
+    max: [1, 1, 1]
+    resolution: 2
+    file: )" + path + R"(
+    density: 1
+    albedo: [0.5, 0.5, 0.5]
+    transform: {translate: [0, 2, 0]}
+)");
+
+  Scene scene(config, "");
+  hit_record rec;
+  Ray down(Vector3d(0, 5, 0), Vector3d(0, -1, 0));
+  REQUIRE(scene.world_->hit(down, 0.0, std::numeric_limits<double>::infinity(), rec));
+  REQUIRE(rec.t == Approx(2).margin(1e-3));
+
+  config["objects"][0]["resolution"] = 3;
+  REQUIRE_THROWS(Scene(config, ""));
+
+  // Negative resolutions are rejected before the grid is allocated
+  config["objects"][0]["resolution"] = YAML::Load("[-2, 2, 2]");
+  REQUIRE_THROWS_AS(Scene(config, ""), std::runtime_error);
+
+  std::remove(path.c_str());
+}
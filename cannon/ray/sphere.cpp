@@ -2,35 +2,19 @@
 
 #include <cannon/ray/ray.hpp>
 #include <cannon/ray/aabb.hpp>
+#include <cannon/math/random_double.hpp>
 
 using namespace cannon::ray;
+using namespace cannon::math;
 
 bool Sphere::object_space_hit(const Ray& r, double t_min, double t_max, hit_record& rec) const {
-  Vector3d oc = r.orig_ - center_;
-  auto a = r.dir_.dot(r.dir_);
-  auto b = oc.dot(r.dir_);
-  auto c = oc.dot(oc) - radius_ * radius_;
-
-  auto discriminant = b*b - a*c;
-  if (discriminant < 0)
+  if (!hit_sphere(r, center_, radius_, t_min, t_max, rec))
     return false;
 
-  auto sqrt_d = std::sqrt(discriminant);
-
-  // Find nearest root of the quadratic that lies between t_min and t_max
-  auto root = (-b - sqrt_d) / a;
-  if (root < t_min || t_max < root) {
-    root = (-b + sqrt_d) / a;
-    if (root < t_min || t_max < root)
-      return false;
-  }
-
-  rec.t = root;
-  rec.p = r.at(rec.t);
-  Vector3d outward_normal = (rec.p - center_) / radius_;
-  rec.set_face_normal(r, outward_normal);
-  get_sphere_uv(outward_normal, rec.u, rec.v);
-  rec.mat_ptr = mat_ptr_;
+  Vector3d unit_p = (rec.p - center_) / radius_;
+  get_sphere_uv(unit_p, rec.u, rec.v);
+  get_sphere_partials(unit_p, radius_, rec.dpdu, rec.dpdv);
+  rec.mat_ptr = mat_ptr_.get();
   
   return true;
 }
@@ -41,6 +25,43 @@ bool Sphere::object_space_bounding_box(double /*time_0*/, double /*time_1*/, Aab
   return true;
 }
 
+double Sphere::object_space_pdf_value(const Vector3d& origin, const Vector3d&
+    direction, double time) const {
+  hit_record rec;
+  if (!object_space_hit(Ray(origin, direction, time), 0.0, std::numeric_limits<double>::infinity(), rec))
+    return 0.0;
+
+  // Points inside the sphere see it in every direction, and are not sampled
+  double distance_squared = (center_ - origin).squaredNorm();
+  if (distance_squared <= radius_ * radius_)
+    return 0.0;
+
+  double cos_theta_max = std::sqrt(1 - radius_ * radius_ / distance_squared);
+  double solid_angle = 2 * M_PI * (1 - cos_theta_max);
+
+  return 1 / solid_angle;
+}
+
+Vector3d Sphere::object_space_random_direction(const Vector3d& origin,
+    double /*time*/, Rng& rng) const {
+  Vector3d direction = center_ - origin;
+  double distance_squared = direction.squaredNorm();
+  if (distance_squared <= radius_ * radius_)
+    return random_unit_vec(rng);
+
+  // Sample uniformly within the cone around +z, then rotate onto the
+  // direction of the sphere center
+  double r1 = random_double(rng);
+  double r2 = random_double(rng);
+  double z = 1 + r2 * (std::sqrt(1 - radius_ * radius_ / distance_squared) - 1);
+
+  double phi = 2 * M_PI * r1;
+  double sin_theta = std::sqrt(std::max(0.0, 1 - z * z));
+  Vector3d local(std::cos(phi) * sin_theta, std::sin(phi) * sin_theta, z);
+
+  return Quaterniond::FromTwoVectors(Vector3d::UnitZ(), direction) * local;
+}
+
 // Free Functions
 void cannon::ray::get_sphere_uv(const Vector3d& p, double& u, double& v) {
   auto theta = std::acos(-p.y());
@@ -49,3 +70,70 @@ void cannon::ray::get_sphere_uv(const Vector3d& p, double& u, double& v) {
   u = phi / (2 * M_PI);
   v = theta / M_PI;
 }
+
+void cannon::ray::get_sphere_partials(const Vector3d& p, double radius,
+    Vector3d& dpdu, Vector3d& dpdv) {
+  double sin_theta = std::sqrt(p.x() * p.x() + p.z() * p.z());
+  if (sin_theta < 1e-8) {
+    dpdu = Vector3d::Zero();
+    dpdv = Vector3d::Zero();
+    return;
+  }
+
+  // With theta = acos(-y) and phi = atan2(-z, x) + pi, the unit sphere is
+  // (-sin(theta) cos(phi), -cos(theta), sin(theta) sin(phi))
+  double r = std::fabs(radius);
+  dpdu = 2 * M_PI * r * Vector3d(p.z(), 0, -p.x());
+  dpdv = M_PI * r * Vector3d(-p.x() * p.y() / sin_theta, sin_theta,
+      -p.z() * p.y() / sin_theta);
+}
+
+bool cannon::ray::hit_sphere(const Ray& r, const Vector3d& center, double
+    radius, double t_min, double t_max, hit_record& rec) {
+  Vector3d oc = r.orig_ - center;
+  auto a = r.dir_.dot(r.dir_);
+  auto b = oc.dot(r.dir_);
+  auto c = oc.dot(oc) - radius * radius;
+
+  auto discriminant = b*b - a*c;
+  if (discriminant < 0)
+    return false;
+
+  // Compute roots without cancellation between b and the square root of
+  // the discriminant. A ray starting on the sphere has c near zero, so its
+  // root near zero is c / q, whose error is dominated by the error in c.
+  auto q = -(b + std::copysign(std::sqrt(discriminant), b));
+  if (q == 0)
+    return false;
+
+  auto root_0 = q / a;
+  auto root_1 = c / q;
+  if (root_0 > root_1)
+    std::swap(root_0, root_1);
+
+  double c_error_over_q = (oc.dot(oc) + radius * radius) / std::fabs(q);
+  auto root_error = [&](double root) {
+    return error_gamma(7) * (std::fabs(root) + c_error_over_q);
+  };
+
+  // Find nearest root of the quadratic that lies between t_min and t_max
+  auto root = root_0;
+  if (root <= t_min || root <= root_error(root) || t_max < root) {
+    root = root_1;
+    if (root <= t_min || root <= root_error(root) || t_max < root)
+      return false;
+  }
+
+  // Reproject the hit point onto the sphere, which leaves it within a few
+  // rounding errors of the true surface
+  rec.t = root;
+  rec.p = center + std::fabs(radius) * (r.at(root) - center).normalized();
+  rec.p_error = error_gamma(5) * (rec.p.cwiseAbs() + center.cwiseAbs());
+
+  // Dividing by a negative radius flips the normal inward, for hollow
+  // spheres
+  Vector3d outward_normal = (rec.p - center) / radius;
+  rec.set_face_normal(r, outward_normal);
+
+  return true;
+}
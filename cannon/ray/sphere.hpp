@@ -46,6 +46,19 @@ namespace cannon {
          */
         virtual bool object_space_bounding_box(double time_0, double time_1, Aabb& output_box) const override;
 
+        /*!
+         * Inherited from Hittable. Directions are sampled uniformly within
+         * the cone subtended by this sphere.
+         */
+        virtual double object_space_pdf_value(const Vector3d& origin, const
+            Vector3d& direction, double time) const override;
+
+        /*!
+         * Inherited from Hittable.
+         */
+        virtual Vector3d object_space_random_direction(const Vector3d& origin,
+            double time, Rng& rng) const override;
+
       public:
         Vector3d center_; //!< Sphere center
         double radius_; //!< Sphere radius
@@ -64,6 +77,38 @@ namespace cannon {
      */
     void get_sphere_uv(const Vector3d& p, double& u, double& v);
 
+    /*!
+     * Compute partial derivatives of a point on a sphere with respect to
+     * the U,V coordinates computed by get_sphere_uv(). At the poles, where
+     * the V derivative is undefined, both are left zero.
+     *
+     * \param p Point on the unit sphere centered at the origin.
+     * \param radius Sphere radius.
+     * \param dpdu Returned derivative with respect to U.
+     * \param dpdv Returned derivative with respect to V.
+     */
+    void get_sphere_partials(const Vector3d& p, double radius, Vector3d& dpdu,
+        Vector3d& dpdv);
+
+    /*!
+     * Intersect a ray with a sphere, filling in the hit distance, point,
+     * point error bound, and face normal of the input hit record. Roots of
+     * the intersection quadratic are only reported when they exceed a
+     * conservative bound on their rounding error, so rays spawned from the
+     * sphere's surface do not hit it again at distance zero.
+     *
+     * \param r Ray to intersect, in the sphere's space.
+     * \param center Sphere center.
+     * \param radius Sphere radius.
+     * \param t_min Exclusive minimum hit distance.
+     * \param t_max Maximum hit distance.
+     * \param rec Hit record to fill in.
+     *
+     * \returns Whether the ray hits the sphere.
+     */
+    bool hit_sphere(const Ray& r, const Vector3d& center, double radius,
+        double t_min, double t_max, hit_record& rec);
+
   } // namespace ray
 } // namespace cannon
 
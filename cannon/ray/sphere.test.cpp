@@ -1,7 +1,61 @@
 #include <catch2/catch.hpp>
 
 #include <cannon/ray/sphere.hpp>
+#include <cannon/ray/ray.hpp>
+#include <cannon/ray/material.hpp>
+#include <cannon/math/random_double.hpp>
+
+using namespace cannon::ray;
+using namespace cannon::math;
 
 TEST_CASE("Sphere", "[ray]") {
+  auto mat = std::make_shared<Lambertian>(Vector3d(0.5, 0.5, 0.5));
+  Sphere s(Vector3d(0, 0, 3), 1, mat);
+  Vector3d origin = Vector3d::Zero();
+  Rng rng;
+
+  // Sampled directions all lie within the cone subtended by the sphere
+  for (int i = 0; i < 100; i++) {
+    Vector3d d = s.random_direction(origin, 0.0, rng);
+    REQUIRE(d.normalized().z() >= std::sqrt(8.0) / 3.0 - 1e-9);
+    REQUIRE(s.pdf_value(origin, d, 0.0) > 0.0);
+  }
+
+  REQUIRE(s.pdf_value(origin, -Vector3d::UnitZ(), 0.0) == 0.0);
+
+  // Density integrates to one over the sphere of directions
+  int n = 200000;
+  double sum = 0.0;
+  for (int i = 0; i < n; i++)
+    sum += s.pdf_value(origin, random_unit_vec(), 0.0);
+  REQUIRE(4.0 * M_PI * sum / n == Approx(1.0).epsilon(0.05));
+}
+
+TEST_CASE("Sphere_spawn_ray", "[ray]") {
+  // Small spheres far from the origin defeat a fixed minimum hit distance
+  auto mat = std::make_shared<Lambertian>(Vector3d(0.5, 0.5, 0.5));
+  Vector3d center(1234.5, -678.9, 4321.0);
+  Sphere s(center, 1e-3, mat);
+  Rng rng;
+
+  for (int i = 0; i < 1000; i++) {
+    Vector3d target = center + 1e-3 * random_unit_vec(rng);
+    Vector3d origin = target + random_unit_vec(rng);
+    hit_record rec;
+    if (!s.hit(Ray(origin, target - origin), 0.0, std::numeric_limits<double>::infinity(), rec))
+      continue;
+
+    REQUIRE(rec.p_error.maxCoeff() > 0.0);
+
+    // Rays leaving the outside of the surface miss the sphere, and rays
+    // entering it hit the far side
+    Vector3d d = random_unit_vec(rng);
+    if (d.dot(rec.normal) < 0)
+      d = -d;
 
+    hit_record spawned_rec;
+    REQUIRE(!s.hit(rec.spawn_ray(d, 0.0), 0.0, std::numeric_limits<double>::infinity(), spawned_rec));
+    REQUIRE(s.hit(rec.spawn_ray(-d, 0.0), 0.0, std::numeric_limits<double>::infinity(), spawned_rec));
+    REQUIRE(spawned_rec.t > 1e-9);
+  }
 }
@@ -1,7 +1,13 @@
 #include <cannon/ray/texture.hpp>
 
+#include <cannon/ray/hittable.hpp>
+
 using namespace cannon::ray;
 
+Vector3d Texture::evaluate(const hit_record& rec) const {
+  return value(rec.u, rec.v, rec.p);
+}
+
 Vector3d CheckerTexture::value(double u, double v, const Vector3d& p) const {
   auto sines = sin(10*p.x()) * sin(10*p.y()) * sin(10 * p.z());
 
@@ -11,26 +17,40 @@ Vector3d CheckerTexture::value(double u, double v, const Vector3d& p) const {
     return even_->value(u, v, p);
 }
 
-Vector3d ImageTexture::value(double u, double v, const Vector3d& /*p*/) const {
-  // Return cyan if no data
-  if (data_ == nullptr)
-    return Vector3d(0, 1, 1);
+Vector3d CheckerTexture::evaluate(const hit_record& rec) const {
+  auto sines = sin(10*rec.p.x()) * sin(10*rec.p.y()) * sin(10 * rec.p.z());
+
+  if (sines < 0)
+    return odd_->evaluate(rec);
+  else
+    return even_->evaluate(rec);
+}
 
-  u = std::min(1.0, std::max(0.0, u));
-  v = 1.0 - std::min(1.0, std::max(0.0, v)); // Flip v to image coords
+Vector3d NoiseTexture::value(double /*u*/, double /*v*/, const Vector3d& p) const {
+  double turbulence = volume_ && volume_->contains(p) ? volume_->lookup(p) :
+    noise_.turbulence(p);
 
-  auto i = static_cast<int>(u * width_);
-  auto j = static_cast<int>(v * height_);
+  return Vector3d(1, 1, 1) * 0.5 * (1.0 + std::sin(scale_ * p.z() + 10*turbulence));
+}
 
-  // Clamp integers
-  if (i >= width_)
-    i = width_ - 1;
+void NoiseTexture::bake(const Vector3d& min, const Vector3d& max, const Vector3i& resolution) {
+  volume_ = std::make_shared<const NoiseVolume>(noise_, min, max, resolution);
+}
 
-  if (j >= height_)
-    j = height_ - 1;
+Vector3d ImageTexture::value(double u, double v, const Vector3d& /*p*/) const {
+  // Return cyan if no data
+  if (!mipmap_)
+    return Vector3d(0, 1, 1);
+
+  // Flip v to image coords
+  return mipmap_->lookup(Vector2d(u, 1.0 - v));
+}
 
-  auto color_scale = 1.0 / 255.0;
-  auto pixel = data_ + j*bytes_per_scanline_ + i*bytes_per_pixel;
+Vector3d ImageTexture::evaluate(const hit_record& rec) const {
+  if (!mipmap_)
+    return Vector3d(0, 1, 1);
 
-  return Vector3d(color_scale*pixel[0], color_scale*pixel[1], color_scale*pixel[2]);
+  // Texture t runs opposite to v, so its differentials do too
+  return mipmap_->lookup(Vector2d(rec.u, 1.0 - rec.v), Vector2d(rec.dudx,
+        -rec.dvdx), Vector2d(rec.dudy, -rec.dvdy), filter_, max_anisotropy_);
 }
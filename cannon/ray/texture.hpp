@@ -8,11 +8,12 @@
  */
 
 #include <memory>
+#include <string>
 
 #include <Eigen/Dense>
-#include <stb_image/stb_image.h>
 
 #include <cannon/math/perlin.hpp>
+#include <cannon/ray/mipmap.hpp>
 
 using namespace Eigen;
 
@@ -21,11 +22,19 @@ using namespace cannon::math;
 namespace cannon {
   namespace ray {
 
+    struct hit_record;
+
     /*!
      * \brief Abstract class representing a texture on some geometry.
      */
     class Texture {
       public:
+
+        /*!
+         * Destructor.
+         */
+        virtual ~Texture() {}
+
         /*!
          * Method to get the value of this texture at U,V surface coordinates.
          *
@@ -36,6 +45,17 @@ namespace cannon {
          * \returns Color of texture at point with surface coords
          */
         virtual Vector3d value(double u, double v, const Vector3d& p) const = 0;
+
+        /*!
+         * Method to get the value of this texture at a hit, filtered over
+         * the texture-space footprint of the hit ray where the texture
+         * supports it. By default, the value at the hit's U,V coordinates.
+         *
+         * \param rec Hit record, with differentials computed.
+         *
+         * \returns Color of texture at hit
+         */
+        virtual Vector3d evaluate(const hit_record& rec) const;
     };
 
     /*!
@@ -108,6 +128,10 @@ namespace cannon {
          */
         virtual Vector3d value(double u, double v, const Vector3d& p) const override;
 
+        /*!
+         * Inherited from Texture.
+         */
+        virtual Vector3d evaluate(const hit_record& rec) const override;
 
       public:
         std::shared_ptr<Texture> even_;
@@ -138,42 +162,52 @@ namespace cannon {
         /*!
          * Inherited from Texture.
          */
-        virtual Vector3d value(double /*u*/, double /*v*/, const Vector3d& p) const override {
-          return Vector3d(1, 1, 1) * 0.5 * (1.0 + 
-              std::sin(scale_ * p.z() + 10*noise_.turbulence(p)));
-        }
+        virtual Vector3d value(double /*u*/, double /*v*/, const Vector3d& p) const override;
+
+        /*!
+         * Bake turbulence over a box onto a grid, so that lookups inside
+         * the box interpolate the grid instead of evaluating every octave.
+         * Octaves finer than the grid spacing are smoothed away, so the
+         * resolution should match how finely the texture is seen.
+         *
+         * \param min Minimum corner of the baked box.
+         * \param max Maximum corner of the baked box.
+         * \param resolution Number of grid points along each axis.
+         */
+        void bake(const Vector3d& min, const Vector3d& max, const Vector3i& resolution);
 
       public:
         Perlin noise_; //!< Perlin noise generator
         double scale_; //!< Noise scale
+        std::shared_ptr<const NoiseVolume> volume_; //!< Baked turbulence, or nullptr
     };
 
     /*!
-     * \brief Class representing a texture derived from an image.
+     * \brief Class representing a texture derived from an image. Images are
+     * loaded through a shared cache as MIP maps in linear color, so
+     * textures using the same file share one copy, and lookups are filtered
+     * over the footprint of the hit ray.
      */
     class ImageTexture : public Texture {
       public:
 
         /*!
-         * Default constructor.
+         * Default constructor, for a texture without an image.
          */
-        ImageTexture() : data_(nullptr), width_(0), height_(0), bytes_per_scanline_(0) {}
+        ImageTexture() : filter_(TextureFilter::EWA), max_anisotropy_(8.0) {}
 
         /*!
          * Constructor taking filename of image to load.
+         *
+         * \param filename The image file.
+         * \param filter Method used to filter lookups.
+         * \param max_anisotropy Largest ratio of footprint axes for EWA
+         * filtering.
          */
-        ImageTexture(const std::string& filename) {
-          auto components_per_pixel = bytes_per_pixel;
-
-          data_ = stbi_load(filename.c_str(), &width_, &height_,
-              &components_per_pixel, components_per_pixel);
-
-          if (!data_) {
-            throw std::runtime_error("Could not open image file for texture.");
-          }
-
-          bytes_per_scanline_ = bytes_per_pixel * width_;
-        }
+        ImageTexture(const std::string& filename, TextureFilter filter =
+            TextureFilter::EWA, double max_anisotropy = 8.0) :
+          mipmap_(load_mipmap(filename)), filter_(filter),
+          max_anisotropy_(max_anisotropy) {}
 
         /*!
          * Destructor.
@@ -181,16 +215,20 @@ namespace cannon {
         virtual ~ImageTexture () {}
 
         /*!
-         * Inherited from Texture.
+         * Inherited from Texture. Without a footprint, the finest level of
+         * the image is interpolated bilinearly.
          */
         virtual Vector3d value(double u, double v, const Vector3d& p) const override;
 
-        const static int bytes_per_pixel = 3; //!< Bytes per pixel in this texture
+        /*!
+         * Inherited from Texture.
+         */
+        virtual Vector3d evaluate(const hit_record& rec) const override;
 
       private:
-        unsigned char *data_; //!< Image data
-        int width_, height_; //!< Image width, height
-        int bytes_per_scanline_; //!< Number of bytes per scanline in image
+        std::shared_ptr<const MIPMap> mipmap_; //!< Image pyramid, shared through the MIP map cache
+        TextureFilter filter_; //!< Filtering method
+        double max_anisotropy_; //!< Largest ratio of footprint axes for EWA filtering
 
     };
 
@@ -1,6 +1,8 @@
 #include <cannon/ray/write_ppm.hpp>
 
 #include <cassert>
+#include <cmath>
+#include <stdexcept>
 
 #include <cannon/ray/film.hpp>
 #include <cannon/log/registry.hpp>
@@ -51,3 +53,30 @@ void cannon::ray::write_colors(std::ostream& os, const std::vector<FilmPixel>& p
     write_color(os, pixels[i].color_sum_, pixels[i].filter_weight_sum_);
   }
 }
+
+void cannon::ray::write_ppm_binary(std::ostream& os, const
+    std::vector<FilmPixel>& pixels, unsigned int width, unsigned int height) {
+  if (pixels.size() != width * height)
+    throw std::runtime_error("Pixel count does not match image dimensions");
+
+  os << "P6\n" << width << ' ' << height << "\n255\n";
+
+  std::vector<unsigned char> row(3 * width);
+  for (unsigned int y = 0; y < height; y++) {
+    for (unsigned int x = 0; x < width; x++) {
+      const FilmPixel& pixel = pixels[y * width + x];
+
+      // Unsampled pixels are written as black
+      Vector3d color = Vector3d::Zero();
+      if (pixel.filter_weight_sum_ != 0.0)
+        color = pixel.color_sum_ / pixel.filter_weight_sum_;
+
+      // Correct for gamma=2.0
+      for (int c = 0; c < 3; c++)
+        row[3 * x + c] = static_cast<unsigned char>(256 * std::min(0.999,
+              std::max(0.0, std::sqrt(color[c]))));
+    }
+
+    os.write(reinterpret_cast<const char*>(row.data()), row.size());
+  }
+}
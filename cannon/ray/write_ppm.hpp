@@ -8,6 +8,7 @@
  */
 
 #include <iostream>
+#include <vector>
 
 #include <Eigen/Dense>
 
@@ -56,6 +57,19 @@ namespace cannon {
      */
     void write_colors(std::ostream& os, const std::vector<FilmPixel>& pixels);
 
+    /*!
+     * Function to write film pixels as a binary (P6) PPM image to the input
+     * stream, including the header. Pixels are gamma corrected and clamped as
+     * for write_color(), and written one buffered row at a time.
+     *
+     * \param os The stream to write this image to.
+     * \param pixels Vector of pixels to write, top row first.
+     * \param width Width of the image.
+     * \param height Height of the image.
+     */
+    void write_ppm_binary(std::ostream& os, const std::vector<FilmPixel>&
+        pixels, unsigned int width, unsigned int height);
+
   }
 }
 
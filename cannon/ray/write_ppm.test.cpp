@@ -3,6 +3,7 @@
 #include <catch2/catch.hpp>
 
 #include <cannon/ray/write_ppm.hpp>
+#include <cannon/ray/film.hpp>
 
 using namespace cannon::ray;
 
@@ -19,4 +20,11 @@ TEST_CASE("WritePPM", "[ray]") {
   REQUIRE(ss.str().compare("255 255 255\n") == 0);
   ss.str("");
 
+  std::vector<FilmPixel> pixels(2);
+  pixels[0].color_sum_ = Vector3d(2, 2, 2);
+  pixels[0].filter_weight_sum_ = 2.0;
+  write_ppm_binary(ss, pixels, 2, 1);
+  REQUIRE(ss.str() == std::string("P6\n2 1\n255\n\xff\xff\xff\0\0\0", 17));
+  REQUIRE_THROWS(write_ppm_binary(ss, pixels, 3, 1));
+
 }
@@ -0,0 +1,78 @@
+#ifndef CANNON_UTILS_PARALLEL_FOR_H
+#define CANNON_UTILS_PARALLEL_FOR_H
+
+/*!
+ * \file cannon/utils/parallel_for.hpp
+ * \brief File containing fork-join parallel loop helpers.
+ */
+
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+namespace cannon {
+  namespace utils {
+
+    /*!
+     * \brief Get a sensible default number of worker threads for this
+     * machine.
+     *
+     * \returns Number of hardware threads, or 1 if it cannot be determined.
+     */
+    inline unsigned int default_num_threads() {
+      return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    /*!
+     * \brief Split the range [begin, end) into contiguous chunks and process
+     * each chunk on its own thread, returning once all chunks are done. The
+     * calling thread processes the first chunk, so at most num_threads - 1
+     * threads are spawned.
+     *
+     * \param begin Start of the range.
+     * \param end End of the range.
+     * \param num_threads Maximum number of threads to use.
+     * \param f Function called with the [chunk_begin, chunk_end) of each chunk.
+     * \param min_chunk_size Minimum number of items per chunk, so that small
+     * ranges are not split across threads.
+     */
+    inline void parallel_for(size_t begin, size_t end, unsigned int num_threads,
+        const std::function<void(size_t, size_t)>& f, size_t min_chunk_size = 1) {
+      if (end <= begin)
+        return;
+
+      size_t n = end - begin;
+      size_t n_chunks = std::min<size_t>(std::max(1u, num_threads),
+          std::max<size_t>(1, n / std::max<size_t>(1, min_chunk_size)));
+
+      if (n_chunks == 1) {
+        f(begin, end);
+        return;
+      }
+
+      size_t chunk_size = (n + n_chunks - 1) / n_chunks;
+
+      std::vector<std::thread> threads;
+      threads.reserve(n_chunks - 1);
+      for (size_t c = 1; c < n_chunks; c++) {
+        size_t chunk_begin = begin + c * chunk_size;
+        size_t chunk_end = std::min(end, chunk_begin + chunk_size);
+        if (chunk_begin >= chunk_end)
+          break;
+
+        threads.emplace_back([&f, chunk_begin, chunk_end]() {
+            f(chunk_begin, chunk_end);
+            });
+      }
+
+      f(begin, std::min(end, begin + chunk_size));
+
+      for (auto& thread : threads)
+        thread.join();
+    }
+
+  } // namespace utils
+} // namespace cannon
+
+#endif /* ifndef CANNON_UTILS_PARALLEL_FOR_H */
@@ -0,0 +1,35 @@
+#include <atomic>
+#include <vector>
+#include <catch2/catch.hpp>
+
+#include <cannon/utils/parallel_for.hpp>
+
+using namespace cannon::utils;
+
+TEST_CASE("ParallelFor", "[utils]") {
+  REQUIRE(default_num_threads() >= 1);
+
+  // Every index should be visited exactly once, whatever the chunking
+  for (unsigned int num_threads : {1u, 3u, 8u}) {
+    std::vector<std::atomic<int>> visits(1000);
+    for (auto& v : visits)
+      v = 0;
+
+    parallel_for(0, visits.size(), num_threads, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+          visits[i]++;
+        });
+
+    for (auto& v : visits)
+      REQUIRE(v == 1);
+  }
+
+  // Small ranges should not be split below the minimum chunk size
+  std::atomic<int> n_chunks(0);
+  parallel_for(0, 100, 8, [&](size_t, size_t) { n_chunks++; }, 64);
+  REQUIRE(n_chunks == 1);
+
+  // Empty ranges should not call the function at all
+  parallel_for(5, 5, 8, [&](size_t, size_t) { n_chunks++; });
+  REQUIRE(n_chunks == 1);
+}
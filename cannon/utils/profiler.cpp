@@ -0,0 +1,199 @@
+#include <cannon/utils/profiler.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace cannon::utils;
+
+/*!
+ * \brief Struct holding the most recent events recorded by one thread.
+ */
+struct ThreadTimeline {
+  unsigned int id; //!< Order in which the thread first recorded an event
+  std::string name; //!< Name of thread in traces
+  uint64_t generation = 0; //!< Value of profiling generation when events were recorded
+  std::vector<ProfileEvent> events; //!< Ring buffer of events
+  size_t next = 0; //!< Index in events of the next event to overwrite, once full
+};
+
+/*!
+ * \brief Struct holding the timelines of all threads that have recorded
+ * events.
+ */
+struct ProfilerRegistry {
+  std::mutex mutex; //!< Mutex guarding registration of timelines
+  std::vector<ThreadTimeline*> live; //!< Timelines of running threads
+  std::vector<std::unique_ptr<ThreadTimeline>> exited; //!< Timelines of exited threads
+  unsigned int num_threads = 0; //!< Number of timelines ever registered
+};
+
+static std::atomic<bool> enabled{false}; //!< Whether profiling is enabled
+static std::atomic<int64_t> epoch_ns{0}; //!< Clock time at which profiling was last enabled
+static std::atomic<size_t> events_per_thread{1 << 16}; //!< Capacity of each timeline
+static std::atomic<uint64_t> generation{1}; //!< Incremented whenever events are cleared
+
+/*!
+ * Get the registry of timelines. It is never destroyed, so that threads
+ * exiting during shutdown can still hand over their timelines.
+ */
+static ProfilerRegistry& registry() {
+  static ProfilerRegistry* registry = new ProfilerRegistry;
+  return *registry;
+}
+
+/*!
+ * \brief Class owning the timeline of the thread it belongs to, and handing
+ * it to the registry when the thread exits so that its events outlive it.
+ */
+class ThreadTimelineOwner {
+  public:
+    ThreadTimelineOwner() : timeline_(new ThreadTimeline) {
+      ProfilerRegistry& r = registry();
+      std::lock_guard<std::mutex> lock(r.mutex);
+      timeline_->id = r.num_threads++;
+      timeline_->name = "Thread " + std::to_string(timeline_->id);
+      r.live.push_back(timeline_.get());
+    }
+
+    ~ThreadTimelineOwner() {
+      ProfilerRegistry& r = registry();
+      std::lock_guard<std::mutex> lock(r.mutex);
+      r.live.erase(std::remove(r.live.begin(), r.live.end(), timeline_.get()), r.live.end());
+      if (timeline_->generation == generation.load() && !timeline_->events.empty())
+        r.exited.push_back(std::move(timeline_));
+    }
+
+    ThreadTimeline& timeline() {
+      return *timeline_;
+    }
+
+  private:
+    std::unique_ptr<ThreadTimeline> timeline_; //!< Timeline of this thread
+};
+
+/*!
+ * Get the calling thread's timeline.
+ */
+static ThreadTimeline& thread_timeline() {
+  static thread_local ThreadTimelineOwner owner;
+  return owner.timeline();
+}
+
+/*!
+ * Get the time on the steady clock, in nanoseconds.
+ */
+static int64_t clock_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool cannon::utils::profiling_enabled() {
+  return enabled.load(std::memory_order_relaxed);
+}
+
+void cannon::utils::set_profiling_enabled(bool enable, size_t num_events) {
+  if (enable) {
+    ProfilerRegistry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    // Running threads clear their own timelines when they next record
+    r.exited.clear();
+    generation++;
+    events_per_thread = std::max(num_events, static_cast<size_t>(1));
+    epoch_ns = clock_ns();
+  }
+
+  enabled = enable;
+}
+
+void cannon::utils::set_profile_thread_name(const std::string& name) {
+  ThreadTimeline& timeline = thread_timeline();
+  std::lock_guard<std::mutex> lock(registry().mutex);
+  timeline.name = name;
+}
+
+int64_t cannon::utils::profile_time_ns() {
+  return clock_ns() - epoch_ns.load(std::memory_order_relaxed);
+}
+
+void cannon::utils::record_profile_event(const char* name, int64_t start_ns, int64_t end_ns) {
+  ThreadTimeline& timeline = thread_timeline();
+
+  uint64_t current = generation.load(std::memory_order_relaxed);
+  if (timeline.generation != current) {
+    timeline.events.clear();
+    timeline.next = 0;
+    timeline.generation = current;
+  }
+
+  ProfileEvent event{name, start_ns, end_ns - start_ns};
+  size_t capacity = events_per_thread.load(std::memory_order_relaxed);
+  if (timeline.events.size() < capacity) {
+    timeline.events.push_back(event);
+  } else {
+    timeline.events[timeline.next] = event;
+    timeline.next = (timeline.next + 1) % timeline.events.size();
+  }
+}
+
+/*!
+ * Call a function on every timeline holding events recorded since
+ * profiling was last enabled. Must be called with the registry locked.
+ */
+template <typename F>
+static void for_each_timeline(ProfilerRegistry& r, F f) {
+  uint64_t current = generation.load();
+  for (auto timeline : r.live)
+    if (timeline->generation == current)
+      f(*timeline);
+  for (auto& timeline : r.exited)
+    f(*timeline);
+}
+
+size_t cannon::utils::num_profile_events() {
+  ProfilerRegistry& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+
+  size_t count = 0;
+  for_each_timeline(r, [&](const ThreadTimeline& timeline) {
+      count += timeline.events.size();
+      });
+
+  return count;
+}
+
+void cannon::utils::write_chrome_trace(const std::string& filename) {
+  ProfilerRegistry& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+
+  std::ofstream out_file(filename);
+  out_file << std::fixed << std::setprecision(3);
+  out_file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+
+  bool first = true;
+  auto separator = [&]() -> const char* {
+    const char* s = first ? "\n" : ",\n";
+    first = false;
+    return s;
+  };
+
+  for_each_timeline(r, [&](const ThreadTimeline& timeline) {
+      out_file << separator() << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": "
+        << timeline.id << ", \"args\": {\"name\": " << json_string(timeline.name) << "}}";
+
+      // Events are written oldest first, so the ring buffer is unrolled
+      size_t n = timeline.events.size();
+      for (size_t i = 0; i < n; i++) {
+        const ProfileEvent& event = timeline.events[(timeline.next + i) % n];
+        out_file << separator() << "{\"name\": \"" << event.name
+          << "\", \"cat\": \"cannon\", \"ph\": \"X\", \"pid\": 0, \"tid\": " << timeline.id
+          << ", \"ts\": " << event.start_ns * 1e-3 << ", \"dur\": " << event.duration_ns * 1e-3 << "}";
+      }
+      });
+
+  out_file << (first ? "]}" : "\n]}") << std::endl;
+}
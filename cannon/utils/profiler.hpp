@@ -0,0 +1,174 @@
+#pragma once
+#ifndef CANNON_UTILS_PROFILER_H
+#define CANNON_UTILS_PROFILER_H
+
+/*!
+ * \file cannon/utils/profiler.hpp
+ * File containing scoped timers for profiling, which are recorded into
+ * per-thread timelines and summarized as statistics.
+ *
+ * Timers are declared at the start of a scope with PROFILE_SCOPE or
+ * PROFILE_HOT_SCOPE, and cost a single relaxed atomic load unless profiling
+ * has been enabled with set_profiling_enabled(). Each timed scope adds its
+ * duration in microseconds to a "Profile/<name> (us)" float distribution in
+ * utils/statistics.hpp. Scopes declared with PROFILE_SCOPE are also
+ * recorded as events in a ring buffer for their thread, which can be
+ * written out as a Chrome trace (chrome://tracing or https://ui.perfetto.dev)
+ * showing what every thread was doing over time. Hot scopes, which run too
+ * often for their events to be useful, are only summarized. Like
+ * statistics, timers are compiled out when CANNON_DISABLE_STATS is defined.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include <cannon/utils/statistics.hpp>
+
+#define CANNON_PROFILE_CONCAT_(a, b) a##b
+#define CANNON_PROFILE_CONCAT(a, b) CANNON_PROFILE_CONCAT_(a, b)
+
+#ifndef CANNON_DISABLE_STATS
+
+/*!
+ * Time the rest of the enclosing scope, recording an event on the thread's
+ * timeline. The name must be a string literal.
+ */
+#define PROFILE_SCOPE(name) CANNON_PROFILE_SCOPE_(name, true)
+
+/*!
+ * Time the rest of the enclosing scope without recording an event on the
+ * thread's timeline, for scopes run many times per traced event. The name
+ * must be a string literal.
+ */
+#define PROFILE_HOT_SCOPE(name) CANNON_PROFILE_SCOPE_(name, false)
+
+// The statistic for a scope is only created once the scope is first timed
+#define CANNON_PROFILE_SCOPE_(name, trace)                                                      \
+cannon::utils::ProfileScope CANNON_PROFILE_CONCAT(profile_scope_, __LINE__)(name, trace,          \
+    []() -> cannon::utils::StatDistributionCounter& {                                           \
+      static cannon::utils::StatRegisterer reg("Profile/" name " (us)",                          \
+          cannon::utils::StatType::float_distribution);                                          \
+      static thread_local cannon::utils::StatDistributionCounter dist(reg);                      \
+      return dist;                                                                               \
+    })
+
+#else
+
+#define PROFILE_SCOPE(name)
+#define PROFILE_HOT_SCOPE(name)
+
+#endif
+
+namespace cannon {
+  namespace utils {
+
+    /*!
+     * \brief Struct representing a single timed scope on a thread's
+     * timeline.
+     */
+    struct ProfileEvent {
+      const char* name; //!< Name of scope, a string literal
+      int64_t start_ns; //!< Start time, in nanoseconds since profiling was enabled
+      int64_t duration_ns; //!< Duration, in nanoseconds
+    };
+
+    /*!
+     * Check whether profiling is enabled.
+     */
+    bool profiling_enabled();
+
+    /*!
+     * Enable or disable profiling. Enabling profiling clears any recorded
+     * events and starts their clock again.
+     *
+     * \param enabled Whether scoped timers should record.
+     * \param events_per_thread Number of most recent events kept for each
+     * thread.
+     */
+    void set_profiling_enabled(bool enabled, size_t events_per_thread = 1 << 16);
+
+    /*!
+     * Set the name of the calling thread in written traces. Threads are
+     * otherwise named by the order in which they first recorded an event.
+     */
+    void set_profile_thread_name(const std::string& name);
+
+    /*!
+     * Get the current time on the profiler's clock, in nanoseconds since
+     * profiling was last enabled.
+     */
+    int64_t profile_time_ns();
+
+    /*!
+     * Record an event on the calling thread's timeline, overwriting its
+     * oldest event if its buffer is full.
+     */
+    void record_profile_event(const char* name, int64_t start_ns, int64_t end_ns);
+
+    /*!
+     * Get the number of events currently recorded, over all threads.
+     */
+    size_t num_profile_events();
+
+    /*!
+     * Write all recorded events as a Chrome trace in JSON. Must not be
+     * called while other threads are recording events.
+     *
+     * \param filename The file to write the trace to.
+     */
+    void write_chrome_trace(const std::string& filename);
+
+    /*!
+     * \brief Class timing the scope it is declared in, used through the
+     * PROFILE_SCOPE and PROFILE_HOT_SCOPE macros.
+     */
+    template <typename F>
+    class ProfileScope {
+      public:
+
+        ProfileScope() = delete;
+
+        /*!
+         * Constructor starting the timer if profiling is enabled.
+         *
+         * \param name Name of scope, a string literal.
+         * \param trace Whether to record an event on the thread's timeline.
+         * \param get_stat Function returning the calling thread's copy of
+         * the statistic summarizing this scope.
+         */
+        ProfileScope(const char* name, bool trace, F get_stat) : name_(name),
+          trace_(trace), get_stat_(get_stat), enabled_(profiling_enabled()) {
+          if (enabled_)
+            start_ns_ = profile_time_ns();
+        }
+
+        ProfileScope(const ProfileScope&) = delete;
+        ProfileScope& operator=(const ProfileScope&) = delete;
+
+        /*!
+         * Destructor stopping the timer and recording the scope.
+         */
+        ~ProfileScope() {
+          if (!enabled_)
+            return;
+
+          int64_t end_ns = profile_time_ns();
+          get_stat_().add((end_ns - start_ns_) * 1e-3);
+          if (trace_)
+            record_profile_event(name_, start_ns_, end_ns);
+        }
+
+      private:
+        const char* name_; //!< Name of scope
+        bool trace_; //!< Whether to record an event on the thread's timeline
+        F get_stat_; //!< Function returning the statistic summarizing this scope
+        bool enabled_; //!< Whether profiling was enabled when the scope started
+        int64_t start_ns_ = 0; //!< Start time of scope
+    };
+
+  } // namespace utils
+} // namespace cannon
+
+#endif /* ifndef CANNON_UTILS_PROFILER_H */
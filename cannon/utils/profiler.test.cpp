@@ -0,0 +1,77 @@
+#include <catch2/catch.hpp>
+
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include <cannon/utils/profiler.hpp>
+
+using namespace cannon::utils;
+
+TEST_CASE("Profiler", "[utils]") {
+#ifndef CANNON_DISABLE_STATS
+  // Nothing is recorded until profiling is enabled
+  reset_stats();
+  set_profiling_enabled(false);
+  {
+    PROFILE_SCOPE("Test disabled");
+  }
+
+  set_profiling_enabled(true, 4);
+  REQUIRE(num_profile_events() == 0);
+  REQUIRE(collect_stats().float_distributions_.count("Profile/Test disabled (us)") == 0);
+
+  // Events of exited threads are kept, and each thread keeps only its most
+  // recent events
+  auto work = [](int n) {
+    for (int i = 0; i < n; i++) {
+      PROFILE_SCOPE("Test outer");
+      for (int j = 0; j < 10; j++) {
+        PROFILE_HOT_SCOPE("Test inner");
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 2; t++) {
+    threads.emplace_back([&work, t]() {
+        set_profile_thread_name("Worker \"" + std::to_string(t) + "\"");
+        work(3);
+        });
+  }
+
+  for (auto& thread : threads)
+    thread.join();
+
+  work(10);
+  REQUIRE(num_profile_events() == 3 + 3 + 4);
+
+  // Every timed scope is summarized, including hot scopes and events no
+  // longer held
+  StatsAccumulator accum = collect_stats();
+  StatDistribution outer = accum.float_distributions_["Profile/Test outer (us)"];
+  StatDistribution inner = accum.float_distributions_["Profile/Test inner (us)"];
+  REQUIRE(outer.count_ == 16);
+  REQUIRE(inner.count_ == 160);
+  REQUIRE(outer.min_ >= 0.0);
+  REQUIRE(outer.sum_ >= inner.sum_);
+
+  // Traces hold complete events for traced scopes, on named threads
+  write_chrome_trace("test_trace.json");
+  std::ifstream f("test_trace.json");
+  std::stringstream ss;
+  ss << f.rdbuf();
+  std::string trace = ss.str();
+
+  REQUIRE(trace.find("{\"displayTimeUnit\": \"ms\", \"traceEvents\": [") == 0);
+  REQUIRE(trace.find("\"name\": \"Worker \\\"1\\\"\"") != std::string::npos);
+  REQUIRE(trace.find("\"name\": \"Test outer\", \"cat\": \"cannon\", \"ph\": \"X\"") != std::string::npos);
+  REQUIRE(trace.find("Test inner") == std::string::npos);
+
+  // Enabling profiling again starts a new trace
+  set_profiling_enabled(true);
+  REQUIRE(num_profile_events() == 0);
+  set_profiling_enabled(false);
+  reset_stats();
+#endif
+}
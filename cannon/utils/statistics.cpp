@@ -1,20 +1,385 @@
 #include <cannon/utils/statistics.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+
 using namespace cannon::utils;
 
 // Initialize static variable
-std::vector<std::function<void(StatsAccumulator &)>> *StatRegisterer::funcs_;
+std::vector<StatRegisterer*> *StatRegisterer::registerers_;
+
+/*!
+ * Get the mutex guarding registration and collection of statistics. It is
+ * never destroyed, so that threads exiting during shutdown can still fold
+ * in their statistics.
+ */
+static std::mutex& stats_mutex() {
+  static std::mutex* mutex = new std::mutex;
+  return *mutex;
+}
+
+double StatDistribution::mean() const {
+  return count_ == 0 ? 0.0 : sum_ / count_;
+}
+
+int StatDistribution::bucket(double value) {
+  if (!(value > 0.0))
+    return 0;
+
+  return std::min(std::max(std::ilogb(value) + 33, 1), num_buckets - 1);
+}
+
+void StatDistribution::add(double value) {
+  if (count_ == 0 || value < min_)
+    min_ = value;
+  if (count_ == 0 || value > max_)
+    max_ = value;
+
+  count_++;
+  sum_ += value;
+  histogram_[bucket(value)]++;
+}
+
+void StatDistribution::merge(const StatDistribution& other) {
+  if (other.count_ == 0)
+    return;
+
+  min_ = count_ == 0 ? other.min_ : std::min(min_, other.min_);
+  max_ = count_ == 0 ? other.max_ : std::max(max_, other.max_);
+  count_ += other.count_;
+  sum_ += other.sum_;
+  for (int b = 0; b < num_buckets; b++)
+    histogram_[b] += other.histogram_[b];
+}
+
+double StatDistribution::percentile(double p) const {
+  if (count_ == 0)
+    return 0.0;
+
+  double rank = std::min(std::max(p, 0.0), 100.0) / 100.0 * count_;
+  int64_t below = 0;
+  for (int b = 0; b < num_buckets; b++) {
+    if (histogram_[b] == 0 || below + histogram_[b] < rank) {
+      below += histogram_[b];
+      continue;
+    }
+
+    // Bucket bounds, narrowed to the range of values actually seen
+    double lo = b == 0 ? min_ : std::ldexp(1.0, b - 33);
+    double hi = b == 0 ? 0.0 : std::ldexp(1.0, b - 32);
+    lo = std::max(lo, min_);
+    hi = std::min(hi, max_);
+    if (hi <= lo)
+      return lo;
+
+    double t = (rank - below) / histogram_[b];
+    return lo + std::min(std::max(t, 0.0), 1.0) * (hi - lo);
+  }
+
+  return max_;
+}
 
-StatRegisterer::StatRegisterer(std::function<void(StatsAccumulator &)> func) {
-  if (!funcs_)
-    funcs_ = new std::vector<std::function<void(StatsAccumulator &)>>;
+void StatsAccumulator::merge(const StatsAccumulator& other) {
+  for (auto& counter : other.counters_)
+    ReportCounter(counter.first, counter.second);
+  for (auto& counter : other.memory_counters_)
+    ReportMemoryCounter(counter.first, counter.second);
+  for (auto& dist : other.int_distributions_)
+    ReportIntDistribution(dist.first, dist.second);
+  for (auto& dist : other.float_distributions_)
+    ReportFloatDistribution(dist.first, dist.second);
+  for (auto& percentage : other.percentages_)
+    ReportPercentage(percentage.first, percentage.second.first, percentage.second.second);
+  for (auto& ratio : other.ratios_)
+    ReportRatio(ratio.first, ratio.second.first, ratio.second.second);
+}
+
+/*!
+ * Format a number of bytes with binary units.
+ */
+static std::string format_bytes(int64_t bytes) {
+  std::stringstream ss;
+  ss << std::fixed << std::setprecision(2);
+
+  double kib = bytes / 1024.0;
+  if (kib < 1024.0)
+    ss << kib << " kiB";
+  else if (kib < 1024.0 * 1024.0)
+    ss << kib / 1024.0 << " MiB";
+  else
+    ss << kib / (1024.0 * 1024.0) << " GiB";
+
+  return ss.str();
+}
+
+/*!
+ * Format a distribution as its mean, range, and estimated percentiles.
+ */
+static std::string format_distribution(const StatDistribution& dist, bool integer) {
+  std::stringstream ss;
+  ss << std::fixed << std::setprecision(3) << dist.mean() << " avg [";
+  if (integer)
+    ss << static_cast<int64_t>(dist.min_) << " - " << static_cast<int64_t>(dist.max_);
+  else
+    ss << dist.min_ << " - " << dist.max_;
 
-  funcs_->push_back(func);
+  ss << "], p50 " << dist.percentile(50) << ", p90 " << dist.percentile(90)
+    << ", p99 " << dist.percentile(99);
+  return ss.str();
+}
+
+/*!
+ * Call a function with the type name and name of every nonzero statistic in
+ * an accumulator, in order of statistic type.
+ */
+static void for_each_stat(const StatsAccumulator& accum, const
+    std::function<void(const std::string&, const std::string&)>& f) {
+  for (auto& counter : accum.counters_)
+    if (counter.second != 0)
+      f("counter", counter.first);
+  for (auto& counter : accum.memory_counters_)
+    if (counter.second != 0)
+      f("memory", counter.first);
+  for (auto& dist : accum.int_distributions_)
+    if (dist.second.count_ != 0)
+      f("int_distribution", dist.first);
+  for (auto& dist : accum.float_distributions_)
+    if (dist.second.count_ != 0)
+      f("float_distribution", dist.first);
+  for (auto& percentage : accum.percentages_)
+    if (percentage.second.second != 0)
+      f("percentage", percentage.first);
+  for (auto& ratio : accum.ratios_)
+    if (ratio.second.second != 0)
+      f("ratio", ratio.first);
+}
+
+void StatsAccumulator::print(const std::string& filename) const {
+  std::ofstream out_file(filename);
+  std::map<std::string, std::vector<std::string>> to_print;
+
+  out_file << "Statistics:" << std::endl;
+
+  for_each_stat(*this, [&](const std::string& type, const std::string& name) {
+      std::string category, title;
+      get_category_and_title(name, &category, &title);
+
+      std::stringstream ss;
+      ss << std::setw(42) << std::left << title;
+      if (type == "counter") {
+        ss << std::setw(12) << counters_.at(name);
+      } else if (type == "memory") {
+        ss << std::setw(12) << format_bytes(memory_counters_.at(name));
+      } else if (type == "int_distribution") {
+        ss << format_distribution(int_distributions_.at(name), true);
+      } else if (type == "float_distribution") {
+        ss << format_distribution(float_distributions_.at(name), false);
+      } else if (type == "percentage") {
+        auto& p = percentages_.at(name);
+        ss << std::setw(12) << p.first << " / " << std::setw(12) << p.second
+          << " (" << std::fixed << std::setprecision(2) << 100.0 * p.first / p.second << "%)";
+      } else {
+        auto& r = ratios_.at(name);
+        ss << std::setw(12) << r.first << " / " << std::setw(12) << r.second
+          << " (" << std::fixed << std::setprecision(2) << static_cast<double>(r.first) / r.second << "x)";
+      }
+
+      to_print[category].push_back(ss.str());
+      });
+
+  for (auto& categories : to_print) {
+    out_file << "  " << categories.first << std::endl;
+    for (auto& item : categories.second) {
+      out_file << "  \t" << item << std::endl;
+    }
+  }
+}
+
+std::string cannon::utils::json_string(const std::string& s) {
+  std::stringstream ss;
+  ss << '"';
+  for (char c : s) {
+    if (c == '"' || c == '\\')
+      ss << '\\' << c;
+    else if (static_cast<unsigned char>(c) < 0x20)
+      ss << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c)
+        << std::dec << std::setfill(' ');
+    else
+      ss << c;
+  }
+  ss << '"';
+  return ss.str();
+}
+
+/*!
+ * Quote a string for CSV, if it needs quoting.
+ */
+static std::string csv_string(const std::string& s) {
+  if (s.find_first_of(",\"\n") == std::string::npos)
+    return s;
+
+  std::string quoted = "\"";
+  for (char c : s) {
+    if (c == '"')
+      quoted += '"';
+    quoted += c;
+  }
+  return quoted + '"';
+}
+
+void StatsAccumulator::print_json(const std::string& filename) const {
+  std::ofstream out_file(filename);
+  out_file << std::setprecision(17) << "{";
+
+  bool first = true;
+  for_each_stat(*this, [&](const std::string& type, const std::string& name) {
+      out_file << (first ? "\n" : ",\n") << "  " << json_string(name)
+        << ": {\"type\": " << json_string(type);
+      first = false;
+
+      if (type == "counter") {
+        out_file << ", \"value\": " << counters_.at(name);
+      } else if (type == "memory") {
+        out_file << ", \"bytes\": " << memory_counters_.at(name);
+      } else if (type == "int_distribution" || type == "float_distribution") {
+        auto& dist = type == "int_distribution" ? int_distributions_.at(name) :
+          float_distributions_.at(name);
+        out_file << ", \"count\": " << dist.count_ << ", \"sum\": " << dist.sum_
+          << ", \"min\": " << dist.min_ << ", \"max\": " << dist.max_
+          << ", \"mean\": " << dist.mean() << ", \"p50\": " << dist.percentile(50)
+          << ", \"p90\": " << dist.percentile(90) << ", \"p99\": " << dist.percentile(99)
+          << ", \"histogram\": [";
+        for (int b = 0; b < StatDistribution::num_buckets; b++)
+          out_file << (b == 0 ? "" : ", ") << dist.histogram_[b];
+        out_file << "]";
+      } else {
+        auto& f = type == "percentage" ? percentages_.at(name) : ratios_.at(name);
+        out_file << ", \"numerator\": " << f.first << ", \"denominator\": " << f.second;
+      }
+
+      out_file << "}";
+      });
+
+  out_file << (first ? "}" : "\n}") << std::endl;
+}
+
+void StatsAccumulator::print_csv(const std::string& filename) const {
+  std::ofstream out_file(filename);
+  out_file << std::setprecision(17);
+  out_file << "category,name,type,value,count,min,max,mean,p50,p90,p99" << std::endl;
+
+  for_each_stat(*this, [&](const std::string& type, const std::string& name) {
+      std::string category, title;
+      get_category_and_title(name, &category, &title);
+      out_file << csv_string(category) << "," << csv_string(title) << "," << type << ",";
+
+      // Fractions are given by their value, and distributions by their mean
+      if (type == "counter") {
+        out_file << counters_.at(name) << ",,,,,,,";
+      } else if (type == "memory") {
+        out_file << memory_counters_.at(name) << ",,,,,,,";
+      } else if (type == "int_distribution" || type == "float_distribution") {
+        auto& dist = type == "int_distribution" ? int_distributions_.at(name) :
+          float_distributions_.at(name);
+        out_file << dist.mean() << "," << dist.count_ << "," << dist.min_ << ","
+          << dist.max_ << "," << dist.mean() << "," << dist.percentile(50) << ","
+          << dist.percentile(90) << "," << dist.percentile(99);
+      } else {
+        auto& f = type == "percentage" ? percentages_.at(name) : ratios_.at(name);
+        double value = static_cast<double>(f.first) / f.second;
+        out_file << (type == "percentage" ? 100.0 * value : value) << ",,,,,,,";
+      }
+
+      out_file << std::endl;
+      });
+}
+
+StatRegisterer::StatRegisterer(const std::string& title, StatType type) :
+  title_(title), type_(type) {
+  std::lock_guard<std::mutex> lock(stats_mutex());
+  if (!registerers_)
+    registerers_ = new std::vector<StatRegisterer*>;
+
+  registerers_->push_back(this);
 }
 
 void StatRegisterer::CallCallbacks(StatsAccumulator &accum) {
-  for (auto func : *funcs_)
-    func(accum);
+  std::lock_guard<std::mutex> lock(stats_mutex());
+  if (!registerers_)
+    return;
+
+  for (auto registerer : *registerers_) {
+    accum.merge(registerer->exited_);
+    for (auto stat : registerer->thread_stats_)
+      stat->report(accum);
+  }
+}
+
+void StatRegisterer::ResetAll() {
+  std::lock_guard<std::mutex> lock(stats_mutex());
+  if (!registerers_)
+    return;
+
+  for (auto registerer : *registerers_) {
+    registerer->exited_ = StatsAccumulator();
+    for (auto stat : registerer->thread_stats_)
+      stat->reset();
+  }
+}
+
+void StatRegisterer::add_thread_stat(ThreadStat* stat) {
+  std::lock_guard<std::mutex> lock(stats_mutex());
+  thread_stats_.push_back(stat);
+}
+
+void StatRegisterer::remove_thread_stat(ThreadStat* stat) {
+  std::lock_guard<std::mutex> lock(stats_mutex());
+  stat->report(exited_);
+  thread_stats_.erase(std::remove(thread_stats_.begin(), thread_stats_.end(),
+        stat), thread_stats_.end());
+}
+
+void StatCounter::report(StatsAccumulator& accum) const {
+  if (registerer_.type_ == StatType::memory)
+    accum.ReportMemoryCounter(registerer_.title_, load());
+  else
+    accum.ReportCounter(registerer_.title_, load());
+}
+
+void StatFraction::report(StatsAccumulator& accum) const {
+  if (registerer_.type_ == StatType::percentage)
+    accum.ReportPercentage(registerer_.title_, num_.load(), denom_.load());
+  else
+    accum.ReportRatio(registerer_.title_, num_.load(), denom_.load());
+}
+
+void StatDistributionCounter::report(StatsAccumulator& accum) const {
+  StatDistribution dist;
+  dist.count_ = count_.load(std::memory_order_relaxed);
+  dist.sum_ = sum_.load(std::memory_order_relaxed);
+  dist.min_ = min_.load(std::memory_order_relaxed);
+  dist.max_ = max_.load(std::memory_order_relaxed);
+  for (int b = 0; b < StatDistribution::num_buckets; b++)
+    dist.histogram_[b] = histogram_[b].load();
+
+  if (registerer_.type_ == StatType::int_distribution)
+    accum.ReportIntDistribution(registerer_.title_, dist);
+  else
+    accum.ReportFloatDistribution(registerer_.title_, dist);
+}
+
+void StatDistributionCounter::reset() {
+  count_.store(0, std::memory_order_relaxed);
+  sum_.store(0.0, std::memory_order_relaxed);
+  min_.store(0.0, std::memory_order_relaxed);
+  max_.store(0.0, std::memory_order_relaxed);
+  for (auto& b : histogram_)
+    b.reset();
 }
 
 void cannon::utils::get_category_and_title(const std::string& str,
@@ -30,12 +395,24 @@ void cannon::utils::get_category_and_title(const std::string& str,
   }
 }
 
-void cannon::utils::report_thread_stats() {
-  static std::mutex mutex;
-  std::lock_guard<std::mutex> lock(mutex);
-  StatRegisterer::CallCallbacks(stats_accumulator);
+StatsAccumulator cannon::utils::collect_stats() {
+  StatsAccumulator accum;
+  StatRegisterer::CallCallbacks(accum);
+  return accum;
+}
+
+void cannon::utils::reset_stats() {
+  StatRegisterer::ResetAll();
 }
 
 void cannon::utils::print_stats(const std::string& filename) {
-  stats_accumulator.print(filename);
+  collect_stats().print(filename);
+}
+
+void cannon::utils::print_stats_json(const std::string& filename) {
+  collect_stats().print_json(filename);
+}
+
+void cannon::utils::print_stats_csv(const std::string& filename) {
+  collect_stats().print_csv(filename);
 }
@@ -1,31 +1,88 @@
 #pragma once
 #ifndef CANNON_UTILS_STATISTICS_H
-#define CANNON_UTILS_STATISTICS_H 
+#define CANNON_UTILS_STATISTICS_H
 
 /*!
  * \file cannon/utils/statistics.hpp
  * File containing statistics collecting utilities. Adapted from PBRT Ch. A.7.
+ *
+ * Each statistic is declared at file scope with one of the STAT_* macros
+ * below, and is then updated like a plain variable. Every thread updates its
+ * own copy of each statistic, without locking, and copies are only combined
+ * when statistics are collected, so updates cost no more than incrementing a
+ * thread-local integer. Defining CANNON_DISABLE_STATS compiles all updates
+ * away.
  */
 
 // Variable titles should be of the format "category/name"
 
-#define STAT_COUNTER(title, var)                        \
-static thread_local int64_t var;                        \
-static void STATS_FUNC##var(StatsAccumulator &accum) {  \
-  accum.ReportCounter(title, var);                      \
-  var = 0;                                              \
-}                                                       \
-static StatRegisterer STATS_REG##var(STATS_FUNC##var)   
+#ifndef CANNON_DISABLE_STATS
 
+/*!
+ * Declare a counter, which is incremented with ++ or +=.
+ */
+#define STAT_COUNTER(title, var)                                                      \
+static cannon::utils::StatRegisterer STATS_REG##var(title, cannon::utils::StatType::counter); \
+static thread_local cannon::utils::StatCounter var(STATS_REG##var)
+
+/*!
+ * Declare a counter of bytes of memory, which is incremented with ++ or +=.
+ */
+#define STAT_MEMORY_COUNTER(title, var)                                               \
+static cannon::utils::StatRegisterer STATS_REG##var(title, cannon::utils::StatType::memory); \
+static thread_local cannon::utils::StatCounter var(STATS_REG##var)
+
+/*!
+ * Declare a distribution of integer values, which are added with add().
+ */
+#define STAT_INT_DISTRIBUTION(title, var)                                             \
+static cannon::utils::StatRegisterer STATS_REG##var(title, cannon::utils::StatType::int_distribution); \
+static thread_local cannon::utils::StatDistributionCounter var(STATS_REG##var)
+
+/*!
+ * Declare a distribution of real values, which are added with add().
+ */
+#define STAT_FLOAT_DISTRIBUTION(title, var)                                           \
+static cannon::utils::StatRegisterer STATS_REG##var(title, cannon::utils::StatType::float_distribution); \
+static thread_local cannon::utils::StatDistributionCounter var(STATS_REG##var)
+
+/*!
+ * Declare a percentage as a pair of counters, num and denom, which are
+ * incremented with ++ or += and reported as num / denom.
+ */
+#define STAT_PERCENT(title, num, denom)                                               \
+static cannon::utils::StatRegisterer STATS_REG##num(title, cannon::utils::StatType::percentage); \
+static thread_local cannon::utils::StatFraction STATS_FRAC##num(STATS_REG##num);     \
+static thread_local cannon::utils::StatValue& num = STATS_FRAC##num.num_;            \
+static thread_local cannon::utils::StatValue& denom = STATS_FRAC##num.denom_
+
+/*!
+ * Declare a ratio as a pair of counters, num and denom, which are
+ * incremented with ++ or += and reported as num / denom.
+ */
+#define STAT_RATIO(title, num, denom)                                                 \
+static cannon::utils::StatRegisterer STATS_REG##num(title, cannon::utils::StatType::ratio); \
+static thread_local cannon::utils::StatFraction STATS_FRAC##num(STATS_REG##num);     \
+static thread_local cannon::utils::StatValue& num = STATS_FRAC##num.num_;            \
+static thread_local cannon::utils::StatValue& denom = STATS_FRAC##num.denom_
+
+#else
+
+#define STAT_COUNTER(title, var) [[maybe_unused]] static cannon::utils::NullStat var
+#define STAT_MEMORY_COUNTER(title, var) [[maybe_unused]] static cannon::utils::NullStat var
+#define STAT_INT_DISTRIBUTION(title, var) [[maybe_unused]] static cannon::utils::NullStat var
+#define STAT_FLOAT_DISTRIBUTION(title, var) [[maybe_unused]] static cannon::utils::NullStat var
+#define STAT_PERCENT(title, num, denom) [[maybe_unused]] static cannon::utils::NullStat num, denom
+#define STAT_RATIO(title, num, denom) [[maybe_unused]] static cannon::utils::NullStat num, denom
+
+#endif
+
+#include <array>
+#include <atomic>
+#include <cstdint>
 #include <cstring>
 #include <string>
 #include <map>
-#include <functional>
-#include <mutex>
-#include <iostream>
-#include <fstream>
-#include <sstream>
-#include <iomanip>
 #include <vector>
 
 namespace cannon {
@@ -40,6 +97,76 @@ namespace cannon {
      */
     void get_category_and_title(const std::string& str, std::string *category, std::string *title);
 
+    /*!
+     * Function to quote and escape a string for JSON output.
+     *
+     * \param s The string to quote.
+     *
+     * \returns The quoted string.
+     */
+    std::string json_string(const std::string& s);
+
+    /*!
+     * \brief Enum of the kinds of statistic that can be declared.
+     */
+    enum class StatType {
+      counter,
+      memory,
+      int_distribution,
+      float_distribution,
+      percentage,
+      ratio
+    };
+
+    /*!
+     * \brief Struct summarizing a distribution of values by their count,
+     * sum, and extremes, and by a histogram with one bucket per power of
+     * two from which percentiles are estimated.
+     */
+    struct StatDistribution {
+      static const int num_buckets = 64; //!< Number of histogram buckets
+
+      /*!
+       * \brief Get the histogram bucket holding a value. Bucket zero holds
+       * values of at most zero, and bucket b > 0 holds values in [2^(b -
+       * 33), 2^(b - 32)), with values outside that range clamped to the
+       * first or last bucket.
+       */
+      static int bucket(double value);
+
+      /*!
+       * \brief Add a single value to this distribution.
+       */
+      void add(double value);
+
+      /*!
+       * \brief Add all values of another distribution to this one.
+       */
+      void merge(const StatDistribution& other);
+
+      /*!
+       * \brief Get the mean of values in this distribution, or zero if it is
+       * empty.
+       */
+      double mean() const;
+
+      /*!
+       * \brief Estimate a percentile of values in this distribution by
+       * interpolating within the histogram bucket that holds it.
+       *
+       * \param p Percentile to estimate, in [0, 100].
+       *
+       * \returns Estimated percentile, or zero if the distribution is empty.
+       */
+      double percentile(double p) const;
+
+      int64_t count_ = 0; //!< Number of values
+      double sum_ = 0.0; //!< Sum of values
+      double min_ = 0.0; //!< Smallest value, if count_ > 0
+      double max_ = 0.0; //!< Largest value, if count_ > 0
+      std::array<int64_t, num_buckets> histogram_ = {}; //!< Number of values in each bucket
+    };
+
     /*!
      * \brief Class that accumulates different statistic counters.
      */
@@ -53,83 +180,377 @@ namespace cannon {
          * \param val The counter value
          */
         void ReportCounter(const std::string& name, int64_t val) {
-          counters_[name] += val; 
+          counters_[name] += val;
         }
 
         /*!
-         * Print all accumulated statistics to the input filename.
+         * Report the results of a memory counter with the given number of
+         * bytes.
          *
-         * \param filename The file to write statistics to.
+         * \param name The name of the counter
+         * \param bytes The counter value
          */
-        void print(const std::string& filename) {
-          std::ofstream out_file(filename);
-          std::map<std::string, std::vector<std::string>> to_print;
+        void ReportMemoryCounter(const std::string& name, int64_t bytes) {
+          memory_counters_[name] += bytes;
+        }
 
-          out_file << "Statistics:" << std::endl;
+        /*!
+         * Report values added to a distribution of integers.
+         *
+         * \param name The name of the distribution
+         * \param dist The values added
+         */
+        void ReportIntDistribution(const std::string& name, const StatDistribution& dist) {
+          int_distributions_[name].merge(dist);
+        }
 
-          for (auto& counter : counters_) {
-            if (counter.second == 0) continue;
+        /*!
+         * Report values added to a distribution of reals.
+         *
+         * \param name The name of the distribution
+         * \param dist The values added
+         */
+        void ReportFloatDistribution(const std::string& name, const StatDistribution& dist) {
+          float_distributions_[name].merge(dist);
+        }
+
+        /*!
+         * Report the numerator and denominator of a percentage.
+         *
+         * \param name The name of the percentage
+         * \param num The numerator
+         * \param denom The denominator
+         */
+        void ReportPercentage(const std::string& name, int64_t num, int64_t denom) {
+          percentages_[name].first += num;
+          percentages_[name].second += denom;
+        }
+
+        /*!
+         * Report the numerator and denominator of a ratio.
+         *
+         * \param name The name of the ratio
+         * \param num The numerator
+         * \param denom The denominator
+         */
+        void ReportRatio(const std::string& name, int64_t num, int64_t denom) {
+          ratios_[name].first += num;
+          ratios_[name].second += denom;
+        }
 
-            std::string category, title;
-            get_category_and_title(counter.first, &category, &title);
+        /*!
+         * Add all statistics of another accumulator to this one.
+         */
+        void merge(const StatsAccumulator& other);
 
-            std::stringstream ss;
-            ss << std::setw(42) << std::left << title;
-            ss << std::setw(12) << counter.second;
+        /*!
+         * Print all accumulated statistics to the input filename, grouped
+         * by category.
+         *
+         * \param filename The file to write statistics to.
+         */
+        void print(const std::string& filename) const;
 
-            to_print[category].push_back(ss.str());
-          }
+        /*!
+         * Write all accumulated statistics to the input filename as a JSON
+         * object, keyed by full statistic name.
+         *
+         * \param filename The file to write statistics to.
+         */
+        void print_json(const std::string& filename) const;
 
-          // TODO More kinds of counters
-          
-          for (auto& categories : to_print) {
-            out_file << "  " << categories.first << std::endl;
-            for (auto& item : categories.second) {
-              out_file << "  \t" << item << std::endl;
-            }
-          }
-        }
+        /*!
+         * Write all accumulated statistics to the input filename as CSV,
+         * one statistic per row.
+         *
+         * \param filename The file to write statistics to.
+         */
+        void print_csv(const std::string& filename) const;
 
       public:
         std::map<std::string, int64_t> counters_; //!< Counters for registered statistics
+        std::map<std::string, int64_t> memory_counters_; //!< Memory counters, in bytes
+        std::map<std::string, StatDistribution> int_distributions_; //!< Distributions of integers
+        std::map<std::string, StatDistribution> float_distributions_; //!< Distributions of reals
+        std::map<std::string, std::pair<int64_t, int64_t>> percentages_; //!< Numerators and denominators of percentages
+        std::map<std::string, std::pair<int64_t, int64_t>> ratios_; //!< Numerators and denominators of ratios
 
     };
 
+    class ThreadStat;
+
     /*!
-     * Class that collects all of the various thread-local statistic reporters for a single variable.
+     * Class that collects the per-thread copies of a single statistic. Copies
+     * register themselves when a thread first uses the statistic, and fold
+     * their values into the registerer when the thread exits.
      */
     class StatRegisterer {
       public:
 
         /*!
-         * Constructor taking a statistic accumulating function.
+         * Constructor taking the name and type of the statistic.
          */
-        StatRegisterer(std::function<void(StatsAccumulator &)> func);
+        StatRegisterer(const std::string& title, StatType type);
 
         /*!
-         * Call all registered callbacks to add to the input accumulator.
+         * Add the values of every live and exited thread's copy of every
+         * registered statistic to the input accumulator.
          */
         static void CallCallbacks(StatsAccumulator &accum);
 
-      private: 
-        static std::vector<std::function<void(StatsAccumulator &)>> *funcs_; //!< Statistic accumulating functions
+        /*!
+         * Reset the values of every registered statistic. Must not be called
+         * while other threads are updating statistics.
+         */
+        static void ResetAll();
+
+        /*!
+         * Register a thread's copy of this statistic.
+         */
+        void add_thread_stat(ThreadStat* stat);
+
+        /*!
+         * Unregister a thread's copy of this statistic, keeping its values.
+         */
+        void remove_thread_stat(ThreadStat* stat);
+
+        const std::string title_; //!< Name of statistic
+        const StatType type_; //!< Type of statistic
+
+      private:
+        std::vector<ThreadStat*> thread_stats_; //!< Copies of live threads
+        StatsAccumulator exited_; //!< Values of copies of exited threads
 
+        static std::vector<StatRegisterer*> *registerers_; //!< All registered statistics
+    };
+
+    /*!
+     * \brief Class representing a single value updated by one thread and
+     * read by others. Updates are a relaxed load and store, which compile
+     * to an ordinary increment but let collecting threads read the value
+     * safely at any time.
+     */
+    class StatValue {
+      public:
+
+        StatValue& operator++() {
+          *this += 1;
+          return *this;
+        }
+
+        void operator++(int) {
+          *this += 1;
+        }
+
+        StatValue& operator+=(int64_t n) {
+          value_.store(value_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+          return *this;
+        }
+
+        /*!
+         * Get the current value.
+         */
+        int64_t load() const {
+          return value_.load(std::memory_order_relaxed);
+        }
+
+        /*!
+         * Reset to zero.
+         */
+        void reset() {
+          value_.store(0, std::memory_order_relaxed);
+        }
+
+      private:
+        std::atomic<int64_t> value_{0}; //!< Current value
+    };
+
+    /*!
+     * \brief Base class for a thread's copy of a statistic, which registers
+     * itself for the lifetime of the thread.
+     */
+    class ThreadStat {
+      public:
+
+        ThreadStat() = delete;
+
+        /*!
+         * Constructor taking the statistic this is a copy of.
+         */
+        ThreadStat(StatRegisterer& registerer) : registerer_(registerer) {}
+
+        ThreadStat(const ThreadStat&) = delete;
+        ThreadStat& operator=(const ThreadStat&) = delete;
+
+        /*!
+         * Destructor. Derived classes call register_() once constructed and
+         * unregister_() before destruction, so that collecting threads only
+         * see complete copies.
+         */
+        virtual ~ThreadStat() {}
+
+        /*!
+         * Add the values of this copy to the input accumulator.
+         */
+        virtual void report(StatsAccumulator& accum) const = 0;
+
+        /*!
+         * Reset the values of this copy.
+         */
+        virtual void reset() = 0;
+
+      protected:
+
+        /*!
+         * Register this copy.
+         */
+        void register_() {
+          registerer_.add_thread_stat(this);
+        }
+
+        /*!
+         * Unregister this copy, keeping its values.
+         */
+        void unregister_() {
+          registerer_.remove_thread_stat(this);
+        }
+
+        StatRegisterer& registerer_; //!< Statistic this is a copy of
+    };
+
+    /*!
+     * \brief Class representing a thread's copy of a counter.
+     */
+    class StatCounter : public ThreadStat, public StatValue {
+      public:
+
+        StatCounter(StatRegisterer& registerer) : ThreadStat(registerer) {
+          register_();
+        }
+
+        virtual ~StatCounter() {
+          unregister_();
+        }
+
+        virtual void report(StatsAccumulator& accum) const override;
+
+        virtual void reset() override {
+          StatValue::reset();
+        }
+    };
+
+    /*!
+     * \brief Class representing a thread's copy of a percentage or ratio.
+     */
+    class StatFraction : public ThreadStat {
+      public:
+
+        StatFraction(StatRegisterer& registerer) : ThreadStat(registerer) {
+          register_();
+        }
+
+        virtual ~StatFraction() {
+          unregister_();
+        }
+
+        virtual void report(StatsAccumulator& accum) const override;
+
+        virtual void reset() override {
+          num_.reset();
+          denom_.reset();
+        }
+
+        StatValue num_; //!< Numerator
+        StatValue denom_; //!< Denominator
+    };
+
+    /*!
+     * \brief Class representing a thread's copy of a distribution.
+     */
+    class StatDistributionCounter : public ThreadStat {
+      public:
+
+        StatDistributionCounter(StatRegisterer& registerer) : ThreadStat(registerer) {
+          register_();
+        }
+
+        virtual ~StatDistributionCounter() {
+          unregister_();
+        }
+
+        /*!
+         * Add a value to the distribution.
+         */
+        void add(double value) {
+          int64_t count = count_.load(std::memory_order_relaxed);
+          double min = min_.load(std::memory_order_relaxed);
+          double max = max_.load(std::memory_order_relaxed);
+          if (count == 0 || value < min)
+            min_.store(value, std::memory_order_relaxed);
+          if (count == 0 || value > max)
+            max_.store(value, std::memory_order_relaxed);
+
+          sum_.store(sum_.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+          histogram_[StatDistribution::bucket(value)] += 1;
+          count_.store(count + 1, std::memory_order_relaxed);
+        }
+
+        virtual void report(StatsAccumulator& accum) const override;
+
+        virtual void reset() override;
+
+      private:
+        std::atomic<int64_t> count_{0}; //!< Number of values
+        std::atomic<double> sum_{0.0}; //!< Sum of values
+        std::atomic<double> min_{0.0}; //!< Smallest value
+        std::atomic<double> max_{0.0}; //!< Largest value
+        std::array<StatValue, StatDistribution::num_buckets> histogram_; //!< Number of values in each bucket
+    };
+
+    /*!
+     * \brief Class standing in for every kind of statistic when statistics
+     * are compiled out, so that updates compile to nothing.
+     */
+    struct NullStat {
+      NullStat& operator++() { return *this; }
+      void operator++(int) {}
+      NullStat& operator+=(int64_t) { return *this; }
+      void add(double) {}
     };
 
     // Public Functions
-    
-    static StatsAccumulator stats_accumulator; //!< Overall stats accumulator for all threads
-    
+
+    /*!
+     * Function to collect the statistics of all threads, including threads
+     * that are still running. Values of running threads may be partway
+     * through an update, so a distribution's count and sum may briefly
+     * disagree.
+     *
+     * \returns Accumulator holding all statistics.
+     */
+    StatsAccumulator collect_stats();
+
     /*!
-     * Function to report stats for this thread.
+     * Function to reset all statistics of all threads. Must not be called
+     * while other threads are updating statistics.
      */
-    void report_thread_stats(); 
+    void reset_stats();
 
     /*!
      * Function to print stats to input filename.
      */
     void print_stats(const std::string& filename);
 
+    /*!
+     * Function to write stats to input filename as JSON.
+     */
+    void print_stats_json(const std::string& filename);
+
+    /*!
+     * Function to write stats to input filename as CSV.
+     */
+    void print_stats_csv(const std::string& filename);
+
   } // namespace utils
 } // namespace cannon
 
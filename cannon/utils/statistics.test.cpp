@@ -1,7 +1,124 @@
 #include <catch2/catch.hpp>
 
+#include <fstream>
+#include <sstream>
+#include <thread>
+
 #include <cannon/utils/statistics.hpp>
 
+using namespace cannon::utils;
+
+STAT_COUNTER("Test/Counter", nTestCounter);
+STAT_MEMORY_COUNTER("Test/Memory", nTestBytes);
+STAT_INT_DISTRIBUTION("Test/Int distribution", nTestInts);
+STAT_FLOAT_DISTRIBUTION("Test/Float distribution", nTestFloats);
+STAT_PERCENT("Test/Percentage", nTestHits, nTestTrials);
+STAT_RATIO("Test/Ratio, with comma", nTestVisits, nTestTests);
+
+#ifndef CANNON_DISABLE_STATS
+/*!
+ * Read a whole file into a string.
+ */
+static std::string read_file(const std::string& filename) {
+  std::ifstream f(filename);
+  std::stringstream ss;
+  ss << f.rdbuf();
+  return ss.str();
+}
+#endif
+
 TEST_CASE("Stats", "[utils]") {
+  // Distributions summarize values and estimate percentiles from their
+  // histograms
+  StatDistribution dist;
+  REQUIRE(dist.percentile(50) == 0.0);
+  for (int i = 1; i <= 1000; i++)
+    dist.add(i);
+
+  REQUIRE(dist.count_ == 1000);
+  REQUIRE(dist.min_ == 1.0);
+  REQUIRE(dist.max_ == 1000.0);
+  REQUIRE(dist.mean() == Approx(500.5));
+  REQUIRE(dist.percentile(0) == 1.0);
+  REQUIRE(dist.percentile(100) == 1000.0);
+  REQUIRE(dist.percentile(50) == Approx(500).epsilon(0.1));
+  REQUIRE(dist.percentile(90) == Approx(900).epsilon(0.1));
+
+  REQUIRE(StatDistribution::bucket(0.0) == 0);
+  REQUIRE(StatDistribution::bucket(-1.0) == 0);
+  REQUIRE(StatDistribution::bucket(1.0) < StatDistribution::bucket(2.0));
+  REQUIRE(StatDistribution::bucket(1e300) == StatDistribution::num_buckets - 1);
+
+  StatDistribution other;
+  other.add(-5.0);
+  dist.merge(other);
+  REQUIRE(dist.count_ == 1001);
+  REQUIRE(dist.min_ == -5.0);
+  REQUIRE(dist.percentile(0) == -5.0);
+
+#ifndef CANNON_DISABLE_STATS
+  // Statistics of running threads are collected without their
+  // cooperation, and statistics of exited threads are kept
+  reset_stats();
+
+  ++nTestCounter;
+  nTestBytes += 1 << 20;
+  nTestFloats.add(0.5);
+  ++nTestTrials;
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([]() {
+        for (int i = 0; i < 1000; i++) {
+          nTestCounter++;
+          nTestInts.add(i % 10);
+          ++nTestTrials;
+          if (i % 4 == 0)
+            ++nTestHits;
+          nTestVisits += 3;
+          ++nTestTests;
+        }
+        });
+  }
+
+  for (auto& thread : threads)
+    thread.join();
+
+  StatsAccumulator accum = collect_stats();
+  REQUIRE(accum.counters_["Test/Counter"] == 4001);
+  REQUIRE(accum.memory_counters_["Test/Memory"] == 1 << 20);
+  REQUIRE(accum.int_distributions_["Test/Int distribution"].count_ == 4000);
+  REQUIRE(accum.int_distributions_["Test/Int distribution"].max_ == 9.0);
+  REQUIRE(accum.int_distributions_["Test/Int distribution"].mean() == Approx(4.5));
+  REQUIRE(accum.float_distributions_["Test/Float distribution"].sum_ == 0.5);
+  REQUIRE(accum.percentages_["Test/Percentage"] == std::make_pair<int64_t, int64_t>(1000, 4001));
+  REQUIRE(accum.ratios_["Test/Ratio, with comma"] == std::make_pair<int64_t, int64_t>(12000, 4000));
+
+  // Collecting does not reset statistics, but resetting does
+  REQUIRE(collect_stats().counters_["Test/Counter"] == 4001);
+  reset_stats();
+  REQUIRE(collect_stats().counters_["Test/Counter"] == 0);
+
+  // Every statistic is written in each format
+  accum.print("test_stats.txt");
+  accum.print_json("test_stats.json");
+  accum.print_csv("test_stats.csv");
+
+  std::string text = read_file("test_stats.txt");
+  REQUIRE(text.find("Test") != std::string::npos);
+  REQUIRE(text.find("1.00 MiB") != std::string::npos);
+  REQUIRE(text.find("(24.99%)") != std::string::npos);
+  REQUIRE(text.find("(3.00x)") != std::string::npos);
+
+  std::string json = read_file("test_stats.json");
+  REQUIRE(json.front() == '{');
+  REQUIRE(json.find("\"Test/Counter\": {\"type\": \"counter\", \"value\": 4001}") != std::string::npos);
+  REQUIRE(json.find("\"Test/Memory\": {\"type\": \"memory\", \"bytes\": 1048576}") != std::string::npos);
+  REQUIRE(json.find("\"histogram\": [") != std::string::npos);
 
+  std::string csv = read_file("test_stats.csv");
+  REQUIRE(csv.find("category,name,type,value") == 0);
+  REQUIRE(csv.find("Test,Counter,counter,4001,") != std::string::npos);
+  REQUIRE(csv.find("Test,\"Ratio, with comma\",ratio,3,") != std::string::npos);
+#endif
 }
@@ -0,0 +1,157 @@
+#ifndef CANNON_UTILS_WORK_STEALING_POOL_H
+#define CANNON_UTILS_WORK_STEALING_POOL_H
+
+/*!
+ * \file cannon/utils/work_stealing_pool.hpp
+ * \brief File containing WorkStealingPool class definition.
+ */
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdexcept>
+#include <exception>
+#include <functional>
+
+#include <cannon/utils/profiler.hpp>
+
+namespace cannon {
+  namespace utils {
+
+    /*!
+     * \brief Class representing a pool of threads which process a batch of
+     * work items from per-thread deques. Each thread takes items from the
+     * front of its own deque, and once that is empty steals from the back of
+     * other threads' deques, so that no thread idles while work remains.
+     *
+     * Items are dealt to threads round-robin in the order given, so passing
+     * items sorted by decreasing cost starts expensive items first and leaves
+     * cheap items to balance the load at the end.
+     */
+    template <typename T>
+    class WorkStealingPool {
+      public:
+        WorkStealingPool() = delete;
+
+        /*!
+         * \brief Constructor taking a function for each thread to run on each
+         * work item and a number of threads to use.
+         */
+        WorkStealingPool(std::function<void(const T&)> f, unsigned int
+            num_threads=4) : f_(f), queues_(num_threads) {
+          if (num_threads == 0)
+            throw std::runtime_error("WorkStealingPool created with improper number of threads");
+        }
+
+        WorkStealingPool(WorkStealingPool& o) = delete;
+        WorkStealingPool(WorkStealingPool&& o) = delete;
+
+        /*!
+         * \brief Process a batch of work items, blocking until all items are
+         * done. If any item throws, the first exception is rethrown once all
+         * threads have stopped.
+         *
+         * \param items The items to process, in order of priority.
+         */
+        void run(const std::vector<T>& items) {
+          for (size_t i = 0; i < items.size(); i++)
+            queues_[i % queues_.size()].items_.push_back(items[i]);
+
+          std::exception_ptr error;
+          std::mutex error_mut;
+
+          auto work = [&](unsigned int thread) {
+            T item;
+            while (true) {
+              {
+                PROFILE_SCOPE("Take work item");
+                if (!pop_(thread, item) && !steal_(thread, item))
+                  break;
+              }
+
+              try {
+                f_(item);
+              } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mut);
+                if (!error)
+                  error = std::current_exception();
+              }
+            }
+          };
+
+          std::vector<std::thread> threads;
+          for (unsigned int i = 1; i < queues_.size(); i++)
+            threads.emplace_back(work, i);
+
+          work(0);
+
+          for (auto& thread : threads)
+            thread.join();
+
+          if (error)
+            std::rethrow_exception(error);
+        }
+
+        /*!
+         * \brief Get the number of items that have been stolen by a thread
+         * other than the one they were dealt to.
+         */
+        unsigned long num_steals() const {
+          return num_steals_;
+        }
+
+      private:
+
+        /*!
+         * \brief Struct holding the work deque of a single thread.
+         */
+        struct WorkerQueue {
+          std::mutex mut_; //!< Mutex protecting items_
+          std::deque<T> items_; //!< Items remaining for this thread
+        };
+
+        /*!
+         * \brief Take the next item from the front of a thread's own deque.
+         */
+        bool pop_(unsigned int thread, T& item) {
+          std::lock_guard<std::mutex> lock(queues_[thread].mut_);
+          if (queues_[thread].items_.empty())
+            return false;
+
+          item = queues_[thread].items_.front();
+          queues_[thread].items_.pop_front();
+          return true;
+        }
+
+        /*!
+         * \brief Steal an item from the back of another thread's deque.
+         * Since no new items are added during a batch, failing to find one
+         * means that the batch is nearly done.
+         */
+        bool steal_(unsigned int thread, T& item) {
+          for (unsigned int i = 1; i < queues_.size(); i++) {
+            WorkerQueue& victim = queues_[(thread + i) % queues_.size()];
+            std::lock_guard<std::mutex> lock(victim.mut_);
+            if (!victim.items_.empty()) {
+              item = victim.items_.back();
+              victim.items_.pop_back();
+              num_steals_++;
+              return true;
+            }
+          }
+
+          return false;
+        }
+
+        std::function<void(const T&)> f_; //!< Function run on each item
+        std::vector<WorkerQueue> queues_; //!< Per-thread work deques
+        std::atomic<unsigned long> num_steals_{0}; //!< Number of stolen items
+
+    };
+
+  } // namespace utils
+} // namespace cannon
+
+#endif /* ifndef CANNON_UTILS_WORK_STEALING_POOL_H */
@@ -0,0 +1,43 @@
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <catch2/catch.hpp>
+
+#include <cannon/utils/work_stealing_pool.hpp>
+
+using namespace cannon::utils;
+
+TEST_CASE("WorkStealingPool", "[utils]") {
+  // Every item should be processed exactly once, over several batches
+  std::vector<std::atomic<int>> visits(100);
+  for (auto& v : visits)
+    v = 0;
+
+  WorkStealingPool<int> pool([&](const int& i) {
+      // Make the first thread's items slow, so that others steal them
+      if (i % 4 == 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      visits[i]++;
+      }, 4);
+
+  std::vector<int> items;
+  for (int i = 0; i < 100; i++)
+    items.push_back(i);
+
+  pool.run(items);
+  pool.run(items);
+
+  for (auto& v : visits)
+    REQUIRE(v == 2);
+  REQUIRE(pool.num_steals() > 0);
+
+  // Exceptions are rethrown after the batch
+  WorkStealingPool<int> throwing_pool([](const int& i) {
+      if (i == 3)
+        throw std::runtime_error("bad item");
+      }, 2);
+  REQUIRE_THROWS(throwing_pool.run(items));
+
+  REQUIRE_THROWS(WorkStealingPool<int>([](const int&) {}, 0));
+}
@@ -0,0 +1,145 @@
+#include <chrono>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <cannon/math/random_double.hpp>
+#include <cannon/ray/bvh.hpp>
+#include <cannon/ray/linear_bvh.hpp>
+#include <cannon/ray/compressed_bvh.hpp>
+#include <cannon/ray/ray.hpp>
+#include <cannon/ray/hittable_list.hpp>
+#include <cannon/ray/material.hpp>
+#include <cannon/ray/mesh.hpp>
+#include <cannon/log/registry.hpp>
+#include <cannon/utils/parallel_for.hpp>
+
+using namespace Eigen;
+
+using namespace cannon::ray;
+using namespace cannon::math;
+using namespace cannon::log;
+using namespace cannon::utils;
+
+/*!
+ * Make a mesh of small randomly placed and oriented triangles.
+ */
+std::shared_ptr<TriangleMesh> random_triangle_soup(unsigned int n_triangles) {
+  MatrixX3d vertices(3 * n_triangles, 3);
+  MatrixX3d normals(3 * n_triangles, 3);
+  MatrixX2d tex_coords = MatrixX2d::Zero(3 * n_triangles, 2);
+  MatrixX3u indices(n_triangles, 3);
+
+  for (unsigned int i = 0; i < n_triangles; i++) {
+    Vector3d center = random_vec(-100, 100);
+    for (unsigned int j = 0; j < 3; j++) {
+      vertices.row(3 * i + j) = (center + random_vec(-1, 1)).transpose();
+      indices(i, j) = 3 * i + j;
+    }
+
+    Vector3d n = (vertices.row(3 * i + 1) - vertices.row(3 * i)).cross(
+        vertices.row(3 * i + 2) - vertices.row(3 * i)).normalized();
+    for (unsigned int j = 0; j < 3; j++)
+      normals.row(3 * i + j) = n.transpose();
+  }
+
+  auto t = std::make_shared<Affine3d>(Affine3d::Identity());
+  auto mat = std::make_shared<Lambertian>(Vector3d(0.5, 0.5, 0.5));
+  return std::make_shared<TriangleMesh>(t, mat, vertices, normals, tex_coords, indices);
+}
+
+/*!
+ * Time tracing random rays through the bounds of a hierarchy.
+ */
+double time_traversal(const Hittable& bvh, const Aabb& bounds, unsigned int n_rays) {
+  std::vector<Ray> rays;
+  for (unsigned int i = 0; i < n_rays; i++) {
+    Vector3d origin = bounds.minimum_ + (bounds.maximum_ - bounds.minimum_).cwiseProduct(random_vec(0, 1));
+    rays.emplace_back(origin, random_unit_vec());
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  for (auto& r : rays) {
+    hit_record rec;
+    bvh.hit(r, 0.0, std::numeric_limits<double>::infinity(), rec);
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  return elapsed.count();
+}
+
+/*!
+ * Compare the memory used by and traversal time of a LinearBvh and a
+ * CompressedBvh.
+ */
+void benchmark_compressed_bvh(HittableListPtr triangles, unsigned int num_threads) {
+  auto t = std::make_shared<Affine3d>(Affine3d::Identity());
+
+  LinearBvh linear(t, triangles, 0.0, 1.0, 4, num_threads);
+  size_t linear_bytes = linear.nodes_.size() * sizeof(LinearBvhNode) +
+    linear.primitives_.size() * sizeof(std::shared_ptr<Hittable>);
+  log_info("LinearBvh uses", linear_bytes / (1 << 20), "MiB over", linear.nodes_.size(),
+      "nodes, traced 1e6 rays in", time_traversal(linear, linear.box_, 1000000), "s");
+
+  auto start = std::chrono::steady_clock::now();
+  CompressedBvh compressed(t, triangles, 0.0, 1.0, 4, num_threads);
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  log_info("CompressedBvh built in", elapsed.count(), "s, uses",
+      compressed.memory_bytes() / (1 << 20), "MiB over", compressed.nodes_.size(),
+      "nodes, traced 1e6 rays in", time_traversal(compressed, compressed.box_, 1000000), "s");
+}
+
+/*!
+ * Time construction of a LinearBvh with the given number of threads.
+ */
+void benchmark_linear_bvh(HittableListPtr triangles, unsigned int num_threads) {
+  auto t = std::make_shared<Affine3d>(Affine3d::Identity());
+
+  auto start = std::chrono::steady_clock::now();
+  LinearBvh bvh(t, triangles, 0.0, 1.0, 4, num_threads);
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  log_info("LinearBvh with", num_threads, "threads built in", elapsed.count(),
+      "s, SAH cost", bvh.sah_cost(), "over", bvh.nodes_.size(), "nodes");
+}
+
+int main(int argc, char** argv) {
+  HittableListPtr triangles = std::make_shared<HittableList>();
+
+  if (argc > 1) {
+    auto t = std::make_shared<Affine3d>(Affine3d::Identity());
+    auto mat = std::make_shared<Lambertian>(Vector3d(0.5, 0.5, 0.5));
+    for (auto& mesh : load_model(t, mat, argv[1])) {
+      auto mesh_triangles = make_mesh_triangle_list(mesh);
+      triangles->objects_.insert(triangles->objects_.end(),
+          mesh_triangles->objects_.begin(), mesh_triangles->objects_.end());
+    }
+  } else {
+    triangles = make_mesh_triangle_list(random_triangle_soup(1000000));
+  }
+
+  log_info("Building hierarchies over", triangles->objects_.size(), "triangles");
+
+  // The recursive constructor copies its input at every level, so it is only
+  // practical for smaller scenes
+  if (triangles->objects_.size() <= 250000) {
+    auto t = std::make_shared<Affine3d>(Affine3d::Identity());
+
+    auto start = std::chrono::steady_clock::now();
+    BvhNode bvh(t, triangles, 0.0, 1.0);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    log_info("BvhNode built in", elapsed.count(), "s, SAH cost", bvh.sah_cost());
+  } else {
+    log_info("Skipping BvhNode for large scene");
+  }
+
+  benchmark_linear_bvh(triangles, 1);
+  if (default_num_threads() > 1)
+    benchmark_linear_bvh(triangles, default_num_threads());
+
+  benchmark_compressed_bvh(triangles, default_num_threads());
+}
@@ -0,0 +1,114 @@
+#include <chrono>
+#include <limits>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <cannon/math/random_double.hpp>
+#include <cannon/math/rng.hpp>
+#include <cannon/ray/bvh.hpp>
+#include <cannon/ray/hittable_list.hpp>
+#include <cannon/ray/material.hpp>
+#include <cannon/ray/ray.hpp>
+#include <cannon/ray/sphere.hpp>
+#include <cannon/log/registry.hpp>
+
+using namespace Eigen;
+
+using namespace cannon::ray;
+using namespace cannon::math;
+using namespace cannon::log;
+
+/*!
+ * Make a list of randomly placed spheres sharing a few materials.
+ */
+HittableListPtr random_spheres(unsigned int n_spheres,
+    const std::vector<std::shared_ptr<Material>>& materials) {
+  Rng rng(n_spheres);
+  auto spheres = std::make_shared<HittableList>();
+  for (unsigned int i = 0; i < n_spheres; i++) {
+    Vector3d center(random_double(rng, -100, 100), random_double(rng, -100, 100),
+        random_double(rng, -100, 100));
+    spheres->add(std::make_shared<Sphere>(center, random_double(rng, 0.5, 2.0),
+          materials[i % materials.size()]));
+  }
+
+  return spheres;
+}
+
+/*!
+ * Time closest-hit queries of random rays through the center of the
+ * scene against the input geometry.
+ */
+void benchmark_hits(const std::string& name, const Hittable& world, unsigned int n_rays) {
+  Rng rng;
+  unsigned int n_hits = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned int i = 0; i < n_rays; i++) {
+    Vector3d origin = 150.0 * random_unit_vec(rng);
+    Ray r(origin, random_in_unit_sphere(rng) * 50.0 - origin);
+
+    hit_record rec;
+    if (world.hit(r, 0.0, std::numeric_limits<double>::infinity(), rec))
+      n_hits++;
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  log_info(name, ":", n_rays / elapsed.count() / 1e6, "Mrays/s,", n_hits, "hits");
+}
+
+/*!
+ * Time scattering off the input materials, through virtual calls and
+ * through dispatch on material type.
+ */
+void benchmark_scatter(const std::vector<std::shared_ptr<Material>>& materials,
+    unsigned int n_scatters) {
+  Ray r(Vector3d(0, 1, 0), Vector3d(0.3, -1, 0.2));
+  hit_record rec;
+  rec.p = Vector3d::Zero();
+  rec.set_face_normal(r, Vector3d::UnitY());
+
+  for (bool dispatch : {false, true}) {
+    Rng rng;
+    Vector3d total = Vector3d::Zero();
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < n_scatters; i++) {
+      const Material& mat = *materials[rng.uniform_uint32(materials.size())];
+      rec.mat_ptr = &mat;
+
+      Vector3d attenuation;
+      Ray scattered;
+      bool did_scatter = dispatch ?
+        material_scatter(mat, r, rec, attenuation, scattered, rng) :
+        mat.scatter(r, rec, attenuation, scattered, rng);
+      if (did_scatter)
+        total += attenuation;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    log_info(dispatch ? "Dispatched" : "Virtual", "scatter:", n_scatters /
+        elapsed.count() / 1e6, "M/s, total", total.sum());
+  }
+}
+
+int main() {
+  std::vector<std::shared_ptr<Material>> materials = {
+    std::make_shared<Lambertian>(Vector3d(0.5, 0.5, 0.5)),
+    std::make_shared<Metal>(Vector3d(0.8, 0.8, 0.8), 0.2),
+    std::make_shared<Dielectric>(1.5),
+    std::make_shared<Isotropic>(Vector3d(0.5, 0.5, 0.5))
+  };
+
+  // A flat list overwrites its hit record with each closer hit, which is
+  // where copying materials held by reference count cost the most
+  auto list = random_spheres(256, materials);
+  benchmark_hits("HittableList of 256 spheres", *list, 200000);
+
+  auto t = std::make_shared<Affine3d>(Affine3d::Identity());
+  BvhNode bvh(t, random_spheres(10000, materials), 0.0, 1.0);
+  benchmark_hits("BvhNode of 10000 spheres", bvh, 1000000);
+
+  benchmark_scatter(materials, 10000000);
+}
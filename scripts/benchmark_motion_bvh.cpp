@@ -0,0 +1,85 @@
+#include <chrono>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <cannon/math/random_double.hpp>
+#include <cannon/ray/linear_bvh.hpp>
+#include <cannon/ray/hittable_list.hpp>
+#include <cannon/ray/material.hpp>
+#include <cannon/ray/moving_sphere.hpp>
+#include <cannon/ray/ray.hpp>
+#include <cannon/log/registry.hpp>
+#include <cannon/utils/statistics.hpp>
+
+using namespace Eigen;
+
+using namespace cannon::ray;
+using namespace cannon::math;
+using namespace cannon::log;
+using namespace cannon::utils;
+
+/*!
+ * Make a list of small spheres, each moving a random distance of up to
+ * max_motion along each axis over the unit time interval.
+ */
+HittableListPtr random_moving_spheres(unsigned int n_spheres, double max_motion) {
+  auto mat = std::make_shared<Lambertian>(Vector3d(0.5, 0.5, 0.5));
+  auto spheres = std::make_shared<HittableList>();
+
+  for (unsigned int i = 0; i < n_spheres; i++) {
+    Vector3d center = random_vec(-100, 100);
+    spheres->add(std::make_shared<MovingSphere>(center, center +
+          random_vec(-max_motion, max_motion), 0.0, 1.0, 0.5, mat));
+  }
+
+  return spheres;
+}
+
+/*!
+ * Time tracing random rays at random times through a hierarchy, reporting
+ * the number of nodes visited per ray.
+ */
+void benchmark_traversal(const std::string& name, const LinearBvh& bvh, const
+    std::vector<Ray>& rays) {
+  reset_stats();
+
+  unsigned int hits = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (auto& r : rays) {
+    hit_record rec;
+    if (bvh.hit(r, 0.0, std::numeric_limits<double>::infinity(), rec))
+      hits++;
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  auto visits = collect_stats().ratios_["Integrator/Linear BVH node visits per hit test"];
+  log_info(name, "traced", rays.size(), "rays in", elapsed.count(), "s,",
+      static_cast<double>(visits.first) / visits.second, "node visits per ray,", hits, "hits");
+}
+
+int main(int argc, char** argv) {
+  unsigned int n_spheres = argc > 1 ? std::stoi(argv[1]) : 100000;
+
+  std::vector<Ray> rays;
+  for (int i = 0; i < 200000; i++)
+    rays.emplace_back(random_vec(-100, 100), random_unit_vec(), random_double());
+
+  // Slower spheres overlap less over the interval, so the bounds over the
+  // whole interval are less of a problem
+  for (double max_motion : {0.0, 1.0, 10.0, 50.0}) {
+    auto spheres = random_moving_spheres(n_spheres, max_motion);
+    auto t = std::make_shared<Affine3d>(Affine3d::Identity());
+
+    LinearBvh bvh(t, spheres, 0.0, 1.0);
+    LinearBvh interval_bvh = bvh;
+    interval_bvh.motion_bounds_.clear();
+
+    log_info("Tracing", n_spheres, "spheres moving up to", max_motion,
+        "units, SAH cost", bvh.sah_cost());
+    benchmark_traversal("Motion bounds:", bvh, rays);
+    benchmark_traversal("Interval bounds:", interval_bvh, rays);
+  }
+}
@@ -0,0 +1,53 @@
+#include <chrono>
+
+#include <Eigen/Dense>
+
+#include <cannon/math/perlin.hpp>
+#include <cannon/math/random_double.hpp>
+#include <cannon/math/rng.hpp>
+#include <cannon/log/registry.hpp>
+
+using namespace Eigen;
+
+using namespace cannon::math;
+using namespace cannon::log;
+
+/*!
+ * Time turbulence evaluation one point at a time, in batches, and through
+ * a baked noise volume, as used by NoiseTexture.
+ */
+int main() {
+  const int n_points = 1000000;
+
+  Rng rng(1);
+  Perlin perlin(rng);
+
+  Matrix3Xd points(3, n_points);
+  for (int i = 0; i < n_points; i++)
+    points.col(i) = Vector3d(random_double(rng, 0, 4), random_double(rng, 0, 4),
+        random_double(rng, 0, 4));
+
+  double total = 0.0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < n_points; i++)
+    total += perlin.turbulence(Vector3d(points.col(i)));
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  log_info("Scalar turbulence:", n_points / elapsed.count() / 1e6, "M/s, total", total);
+
+  start = std::chrono::steady_clock::now();
+  total = perlin.turbulence(points).sum();
+  elapsed = std::chrono::steady_clock::now() - start;
+  log_info("Batched turbulence:", n_points / elapsed.count() / 1e6, "M/s, total", total);
+
+  start = std::chrono::steady_clock::now();
+  NoiseVolume volume(perlin, Vector3d::Zero(), Vector3d::Constant(4), Vector3i::Constant(257));
+  elapsed = std::chrono::steady_clock::now() - start;
+  log_info("Baked", volume.memory_bytes() / 1e6, "MB volume in", elapsed.count(), "s");
+
+  total = 0.0;
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < n_points; i++)
+    total += volume.lookup(points.col(i));
+  elapsed = std::chrono::steady_clock::now() - start;
+  log_info("Baked lookups:", n_points / elapsed.count() / 1e6, "M/s, total", total);
+}
@@ -0,0 +1,144 @@
+#include <cmath>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <yaml-cpp/yaml.h>
+#include <Eigen/Dense>
+
+#include <cannon/ray/raytracer.hpp>
+#include <cannon/ray/linear_bvh.hpp>
+#include <cannon/ray/hittable_list.hpp>
+#include <cannon/ray/aa_rect.hpp>
+#include <cannon/ray/material.hpp>
+#include <cannon/ray/filter.hpp>
+#include <cannon/ray/film.hpp>
+#include <cannon/ray/hdr_image.hpp>
+#include <cannon/log/registry.hpp>
+#include <cannon/utils/parallel_for.hpp>
+
+using namespace Eigen;
+
+using namespace cannon::ray;
+using namespace cannon::log;
+using namespace cannon::utils;
+
+std::shared_ptr<HittableList> cornell_box() {
+  auto world = std::make_shared<HittableList>();
+
+  auto red = std::make_shared<Lambertian>(Vector3d(0.65, 0.05, 0.05));
+  auto white = std::make_shared<Lambertian>(Vector3d(0.73, 0.73, 0.73));
+  auto green = std::make_shared<Lambertian>(Vector3d(0.12, 0.45, 0.15));
+  auto light = std::make_shared<DiffuseLight>(Vector3d(15, 15, 15));
+
+  world->add(std::make_shared<YZRect>(0, 555, 0, 555, 555, green));
+  world->add(std::make_shared<YZRect>(0, 555, 0, 555, 0, red));
+  world->add(std::make_shared<XZRect>(213, 343, 227, 332, 554, light));
+  world->add(std::make_shared<XZRect>(0, 555, 0, 555, 0, white));
+  world->add(std::make_shared<XZRect>(0, 555, 0, 555, 555, white));
+  world->add(std::make_shared<XYRect>(0, 555, 0, 555, 555, white));
+
+  auto t = std::make_shared<Affine3d>(Affine3d::Identity());
+  t->translate(Vector3d(265, 0, 295));
+  t->rotate(AngleAxisd(0.2618, Vector3d::UnitY()));
+  world->add(std::make_shared<Box>(t, Vector3d(0, 0, 0), Vector3d(165, 330, 165), white));
+
+  auto t2 = std::make_shared<Affine3d>(Affine3d::Identity());
+  t2->translate(Vector3d(130, 0, 65));
+  t2->rotate(AngleAxisd(-0.31415, Vector3d::UnitY()));
+  world->add(std::make_shared<Box>(t2, Vector3d(0, 0, 0), Vector3d(165, 165, 165), white));
+
+  return world;
+}
+
+std::shared_ptr<HittableList> cornell_box_lights() {
+  auto lights = std::make_shared<HittableList>();
+
+  auto light = std::make_shared<DiffuseLight>(Vector3d(15, 15, 15));
+  lights->add(std::make_shared<XZRect>(213, 343, 227, 332, 554, light));
+
+  return lights;
+}
+
+/*!
+ * Render the scene with the given sampler and sample count, overriding the
+ * base config, and return the normalized pixel colors.
+ */
+std::vector<Vector3d> render_with(YAML::Node config, HittablePtr world,
+    HittableListPtr lights, const std::string& sampler, int samples_per_pixel,
+    double& seconds) {
+  config["sampler"] = sampler;
+  config["samples_per_pixel"] = samples_per_pixel;
+
+  std::string config_filename = "benchmark_samplers.yaml";
+  std::string image_filename = "benchmark_samplers.cfilm";
+  {
+    std::ofstream config_file(config_filename);
+    config_file << config;
+  }
+
+  Raytracer raytracer(config_filename, world, lights);
+
+  auto start = std::chrono::steady_clock::now();
+  raytracer.render(image_filename, std::make_unique<BoxFilter>(Vector2d::Ones() * 0.5),
+      16, default_num_threads());
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  seconds = elapsed.count();
+
+  std::ifstream image_file(image_filename, std::ios::binary);
+  unsigned int width, height;
+  std::vector<FilmPixel> pixels = read_film_channels(image_file, width, height);
+
+  std::vector<Vector3d> colors;
+  for (auto& pixel : pixels)
+    colors.push_back(pixel.color_sum_ / std::max(pixel.filter_weight_sum_, 1e-12));
+
+  return colors;
+}
+
+/*!
+ * Compute root mean squared error between two images.
+ */
+double rmse(const std::vector<Vector3d>& image, const std::vector<Vector3d>& reference) {
+  double sum = 0.0;
+  for (size_t i = 0; i < image.size(); i++)
+    sum += (image[i] - reference[i]).squaredNorm();
+
+  return std::sqrt(sum / (3.0 * image.size()));
+}
+
+/*!
+ * Compare convergence of the available samplers on the Cornell box, by
+ * rendering at increasing sample counts and measuring error against a high
+ * sample count reference. Usage: benchmark_samplers [config] [width]
+ * [reference samples per pixel].
+ */
+int main(int argc, char** argv) {
+  std::string config_filename = argc > 1 ? argv[1] : "cannon/ray/params/cornell.yaml";
+  int width = argc > 2 ? std::stoi(argv[2]) : 100;
+  int reference_spp = argc > 3 ? std::stoi(argv[3]) : 4096;
+
+  YAML::Node config = YAML::LoadFile(config_filename);
+  config["image_width"] = width;
+  config["progressive_passes"] = 1;
+  config["adaptive_sampling"] = false;
+
+  auto t = std::make_shared<Affine3d>(Affine3d::Identity());
+  auto world = std::make_shared<LinearBvh>(t, cornell_box(), 0.0, 1.0, 4, default_num_threads());
+  auto lights = cornell_box_lights();
+
+  double seconds;
+  log_info("Rendering reference with", reference_spp, "samples per pixel");
+  // The reference uses randomized samples, so that it is not correlated with
+  // prefixes of the deterministic sequences being compared
+  auto reference = render_with(config, world, lights, "stratified", reference_spp, seconds);
+
+  for (std::string sampler : {"stratified", "halton", "sobol", "zerotwo"}) {
+    for (int spp : {4, 16, 64, 256}) {
+      auto image = render_with(config, world, lights, sampler, spp, seconds);
+      log_info(sampler, "sampler with", spp, "samples per pixel: RMSE",
+          rmse(image, reference), "in", seconds, "s");
+    }
+  }
+}
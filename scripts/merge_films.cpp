@@ -0,0 +1,69 @@
+#include <algorithm>
+#include <string>
+#include <stdexcept>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <cannon/ray/film.hpp>
+#include <cannon/ray/filter.hpp>
+#include <cannon/log/registry.hpp>
+
+using namespace Eigen;
+
+using namespace cannon::ray;
+using namespace cannon::log;
+
+/*!
+ * Merge film checkpoints written by separate render processes, e.g. workers
+ * rendering different tiles or sample ranges of one image, and write the
+ * result as an image, or as another checkpoint if the output filename ends
+ * in .film.
+ */
+int main(int argc, char** argv) {
+  if (argc <= 2) {
+    log_error("Usage:", argv[0], "<output image> <checkpoint>...");
+    return 1;
+  }
+
+  try {
+    FilmCheckpointInfo first_info = read_film_checkpoint_info(argv[2]);
+
+    // Pixels are merged directly, so the filter is never used
+    Film film(first_info.width, first_info.height, 50,
+        std::make_unique<BoxFilter>(Vector2d::Ones() * 0.5));
+
+    std::vector<std::pair<int, int>> ranges;
+    for (int i = 2; i < argc; i++) {
+      FilmCheckpointInfo info = film.merge_checkpoint(argv[i]);
+      log_info("Merged", argv[i], "with samples", info.first_sample, "to",
+          info.first_sample + info.num_samples);
+      ranges.emplace_back(info.first_sample, info.num_samples);
+    }
+
+    // Checkpoints of tile subsets share one sample range, while checkpoints
+    // of sample ranges should cover a single range together
+    std::sort(ranges.begin(), ranges.end());
+    int first_sample = ranges.front().first;
+    int num_samples = ranges.front().second;
+    bool same_range = ranges.front() == ranges.back();
+    if (!same_range) {
+      for (size_t i = 1; i < ranges.size(); i++) {
+        if (ranges[i].first != first_sample + num_samples)
+          log_warning("Checkpoints do not cover consecutive sample ranges");
+        num_samples += ranges[i].second;
+      }
+    }
+
+    std::string out_filename(argv[1]);
+    if (out_filename.size() >= 5 && out_filename.compare(out_filename.size() - 5, 5, ".film") == 0)
+      film.write_checkpoint(out_filename, first_sample, num_samples);
+    else
+      film.write_image(out_filename);
+
+    log_info("Wrote", out_filename);
+  } catch (const std::runtime_error& e) {
+    log_error("Could not merge checkpoints:", e.what());
+    return 1;
+  }
+}
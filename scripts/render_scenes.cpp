@@ -0,0 +1,51 @@
+#include <string>
+#include <stdexcept>
+
+#include <Eigen/Dense>
+
+#include <cannon/ray/scene.hpp>
+#include <cannon/ray/raytracer.hpp>
+#include <cannon/ray/linear_bvh.hpp>
+#include <cannon/ray/hittable_list.hpp>
+#include <cannon/ray/filter.hpp>
+#include <cannon/log/registry.hpp>
+#include <cannon/utils/statistics.hpp>
+#include <cannon/utils/parallel_for.hpp>
+
+using namespace Eigen;
+
+using namespace cannon::ray;
+using namespace cannon::log;
+using namespace cannon::utils;
+
+/*!
+ * Render each of a batch of scene files with one raytracer config, writing
+ * each image next to its scene file, so that scene variants can be rendered
+ * without recompiling.
+ */
+int main(int argc, char** argv) {
+  if (argc <= 2) {
+    log_error("Usage:", argv[0], "<raytracer config> <scene file>...");
+    return 1;
+  }
+
+  for (int i = 2; i < argc; i++) {
+    std::string scene_filename(argv[i]);
+    std::string out_filename = scene_filename.substr(0, scene_filename.find_last_of('.')) + ".ppm";
+
+    try {
+      log_info("Loading", scene_filename);
+      Scene scene(scene_filename, 0.0, 1.0, default_num_threads());
+
+      log_info("Rendering to", out_filename);
+      Raytracer raytracer(argv[1], scene.world_, scene.lights_);
+      raytracer.render(out_filename, std::make_unique<MitchellFilter>(Vector2d::Ones()
+            * 2.0, 1.0/3.0, 1.0/3.0), 50, default_num_threads());
+    } catch (const std::runtime_error& e) {
+      log_error("Could not render", scene_filename, ":", e.what());
+    }
+  }
+
+  print_stats("raytracer_stats.txt");
+  print_stats_json("raytracer_stats.json");
+}
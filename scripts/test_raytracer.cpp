@@ -14,7 +14,7 @@
 #include <cannon/ray/camera.hpp>
 #include <cannon/ray/material.hpp>
 #include <cannon/ray/raytracer.hpp>
-#include <cannon/ray/bvh.hpp>
+#include <cannon/ray/linear_bvh.hpp>
 #include <cannon/ray/aa_rect.hpp>
 #include <cannon/ray/constant_medium.hpp>
 #include <cannon/ray/mesh.hpp>
@@ -23,6 +23,7 @@
 #include <cannon/graphics/random_color.hpp>
 #include <cannon/log/registry.hpp>
 #include <cannon/utils/statistics.hpp>
+#include <cannon/utils/parallel_for.hpp>
 
 using namespace Eigen;
 
@@ -161,6 +162,16 @@ std::shared_ptr<HittableList> cornell_box() {
   return world;
 }
 
+std::shared_ptr<HittableList> cornell_box_lights() {
+  auto lights = std::make_shared<HittableList>();
+
+  // Only the geometry is used for light sampling, so the material is unused
+  auto light = std::make_shared<DiffuseLight>(Vector3d(15, 15, 15));
+  lights->add(std::make_shared<XZRect>(213, 343, 227, 332, 554, light));
+
+  return lights;
+}
+
 std::shared_ptr<HittableList> final_scene() {
   auto world = std::make_shared<HittableList>();
   auto ground = std::make_shared<Lambertian>(Vector3d(0.48, 0.83, 0.53));
@@ -216,7 +227,7 @@ std::shared_ptr<HittableList> final_scene() {
   t->translate(Vector3d(-100, 270, 395));
   t->rotate(AngleAxisd(0.2618, Vector3d::UnitY()));
 
-  world->add(std::make_shared<BvhNode>(t, boxes, 0.0, 1.0));
+  world->add(std::make_shared<LinearBvh>(t, boxes, 0.0, 1.0));
 
   return world;
 }
@@ -231,7 +242,7 @@ std::shared_ptr<HittableList> model_test() {
   std::vector<std::shared_ptr<TriangleMesh>> model = load_model(t, c, "assets/backpack/backpack.obj");
   //std::vector<std::shared_ptr<TriangleMesh>> model = load_model(t, c, "assets/sphere/sphere.obj");
   for (auto& mesh : model) {
-    world->add(std::make_shared<BvhNode>(std::make_shared<Affine3d>(Affine3d::Identity()), make_mesh_triangle_list(mesh), 0.0, 1.0));
+    world->add(std::make_shared<LinearBvh>(std::make_shared<Affine3d>(Affine3d::Identity()), make_mesh_triangle_list(mesh), 0.0, 1.0));
   }
 
   auto pertext = std::make_shared<NoiseTexture>(4);
@@ -253,16 +264,17 @@ int main(int argc, char** argv) {
   //auto world = earth_scene();
   //auto world = simple_light_scene();
   auto world = cornell_box();
+  auto lights = cornell_box_lights();
   //auto world = final_scene();
   //auto world = model_test();
 
   auto t = std::make_shared<Affine3d>(Affine3d::Identity());
   //log_info("Building bounding volume hierarchy");
-  auto bvh = std::make_shared<BvhNode>(t, world, 0.0, 1.0);
+  auto bvh = std::make_shared<LinearBvh>(t, world, 0.0, 1.0, 4, default_num_threads());
 
   // Raytracer
   //log_info("Rendering");
-  Raytracer raytracer(argv[1], bvh);
+  Raytracer raytracer(argv[1], bvh, lights);
   raytracer.render(std::cout);
   //raytracer.render("test.ppm", std::make_unique<BoxFilter>(Vector2d::Ones() * 2.0));
   //raytracer.render("test.ppm", std::make_unique<GaussianFilter>(Vector2d::Ones() * 2.0, 1.0));
@@ -270,6 +282,6 @@ int main(int argc, char** argv) {
   //raytracer.render_interactive(std::make_unique<MitchellFilter>(Vector2d::Ones() * 2.0, 1.0/3.0, 1.0/3.0));
   
   // Report and write stats out
-  report_thread_stats();
   print_stats("raytracer_stats.txt");
+  print_stats_json("raytracer_stats.json");
 }